@@ -44,10 +44,29 @@ class TcpSyncClient(
         private const val TAG = "TcpSyncClient"
         private const val CONNECT_TIMEOUT_MS = 5000
         private const val HEARTBEAT_INTERVAL_MS = 10000L
+        // ERROR code sent when the server is at its connection limit
+        private const val ERROR_SERVER_BUSY = 503
     }
     
     private var heartbeatJob: kotlinx.coroutines.Job? = null
 
+    // Uploads the server lets this connection keep open at once (from UPLOAD_ACK).
+    // Stays 1 until a server that supports multiplexing has answered an UPLOAD_INIT.
+    @Volatile
+    var maxConcurrentUploads: Int = 1
+        private set
+
+    // Version of upload control packets: 3 (binary) once the server agreed to it at pairing
+    @Volatile
+    var controlVersion: Int = com.photosync.android.network.protocol.SyncProtocol.VERSION_2
+        private set
+
+    // Largest file the server accepts as a single UPLOAD_INLINE packet (from
+    // PAIRING_RESPONSE); 0 when the server does not support inline uploads.
+    @Volatile
+    var inlineMaxBytes: Long = 0
+        private set
+
     suspend fun connect(): Boolean = withContext(Dispatchers.IO) {
         try {
             isDisconnecting.set(false)
@@ -172,30 +191,7 @@ class TcpSyncClient(
             out.write(bytes)
             out.flush()
             
-            // Read response header
-            val headerBytes = ByteArray(NetworkPacket.HEADER_SIZE)
-            `in`.readFully(headerBytes)
-            
-            val (magic, version, type, length) = NetworkPacket.parseHeader(headerBytes)
-            
-            // Safety check: Prevent massive allocations from corrupt packets or non-protocol data
-            if (length > 10 * 1024 * 1024) { // 10MB limit for response
-                throw java.io.IOException("Packet length too large: $length. Potential protocol mismatch or corruption.")
-            }
-            
-            // Read payload
-            val payloadBytes = ByteArray(length)
-            if (length > 0) {
-                `in`.readFully(payloadBytes)
-            }
-            
-            NetworkPacket(
-                com.photosync.android.network.protocol.PacketHeader(
-                    type = type,
-                    payloadLength = length
-                ),
-                payload = payloadBytes
-            )
+            readPacket(`in`)
         } catch (e: Exception) {
             if (e is CancellationException) throw e
             
@@ -228,6 +224,35 @@ class TcpSyncClient(
         }
     }
 
+    // Read one packet (header + payload) from the server
+    private fun readPacket(`in`: DataInputStream): NetworkPacket {
+        val headerBytes = ByteArray(NetworkPacket.HEADER_SIZE)
+        `in`.readFully(headerBytes)
+        
+        val (magic, version, type, length) = NetworkPacket.parseHeader(headerBytes)
+        
+        // Safety check: Prevent massive allocations from corrupt packets or non-protocol data
+        if (length > 10 * 1024 * 1024) { // 10MB limit for response
+            throw java.io.IOException("Packet length too large: $length. Potential protocol mismatch or corruption.")
+        }
+        
+        // Read payload
+        val payloadBytes = ByteArray(length)
+        if (length > 0) {
+            `in`.readFully(payloadBytes)
+        }
+        
+        return NetworkPacket(
+            com.photosync.android.network.protocol.PacketHeader(
+                magic = magic,
+                version = version, // Selects JSON or binary decoding of the payload
+                type = type,
+                payloadLength = length
+            ),
+            payload = payloadBytes
+        )
+    }
+
     suspend fun batchCheck(hashes: List<String>): List<String> = withContext(Dispatchers.IO) {
         if (hashes.isEmpty()) return@withContext emptyList()
         
@@ -269,6 +294,7 @@ class TcpSyncClient(
             json.put("deviceId", deviceId)
             json.put("token", token)
             json.put("userName", userName)
+            json.put("maxVersion", com.photosync.android.network.protocol.SyncProtocol.VERSION_3)
             
             val packet = NetworkPacket.create(PacketType.PAIRING_REQUEST, json)
             val response = sendRequest(packet)
@@ -276,9 +302,18 @@ class TcpSyncClient(
             if (response != null && response.header.type == PacketType.PAIRING_RESPONSE) {
                 val responseJson = response.getJsonPayload()
                 if (responseJson?.optBoolean("success") == true) {
+                    inlineMaxBytes = responseJson.optLong("inlineMaxBytes", 0L)
+                    controlVersion = responseJson.optInt(
+                        "protocolVersion", com.photosync.android.network.protocol.SyncProtocol.VERSION_2
+                    )
                     val sessionId = responseJson.optInt("sessionId", -1)
                     if (sessionId != -1) return@withContext sessionId
                 }
+            } else if (response != null && response.header.type == PacketType.PROTOCOL_ERROR &&
+                response.getJsonPayload()?.optInt("code") == ERROR_SERVER_BUSY) {
+                // The server closes the connection; the caller's retry backoff applies
+                Log.w(TAG, "Server is at its connection limit")
+                _connectionStatus.value = ConnectionStatus.Error("Server busy")
             }
             null
         } catch (e: Exception) {
@@ -429,7 +464,10 @@ class TcpSyncClient(
         val uploadId: String,
         val offset: Long,
         val chunkSize: Int,
-        val isNew: Boolean
+        val isNew: Boolean,
+        // Windowed mode granted by the server; 0 means stop-and-wait (sendChunk)
+        val windowBytes: Long = 0,
+        val ackEvery: Int = 1
     )
 
     suspend fun resumeUpload(filename: String, size: Long, hash: String): UploadInitResult? = withContext(Dispatchers.IO) {
@@ -444,15 +482,9 @@ class TcpSyncClient(
             json.put("size", size)
             json.put("hash", hash)
             json.put("traceId", traceId)
+            json.put("windowed", true) // Ask for pipelined chunks; older servers ignore it
             
-            // Manual construction to force V2
-            val payloadBytes = json.toString().toByteArray(java.nio.charset.StandardCharsets.UTF_8)
-            val header = com.photosync.android.network.protocol.PacketHeader(
-                version = com.photosync.android.network.protocol.SyncProtocol.VERSION_2.toByte(), 
-                type = PacketType.UPLOAD_INIT,
-                payloadLength = payloadBytes.size
-            )
-            val packet = NetworkPacket(header, payloadBytes)
+            val packet = buildControlPacket(PacketType.UPLOAD_INIT, json)
             
             val response = sendRequest(packet)
             
@@ -463,12 +495,15 @@ class TcpSyncClient(
                     val receivedBytes = respJson.getLong("receivedBytes")
                     val chunkSize = respJson.optInt("chunkSize", 1024 * 1024)
                     val status = respJson.getString("status")
+                    maxConcurrentUploads = respJson.optInt("maxConcurrentUploads", 1)
                     
                     return@withContext UploadInitResult(
                         uploadId = uploadId,
                         offset = receivedBytes,
                         chunkSize = chunkSize,
-                        isNew = (status == "NEW")
+                        isNew = (status == "NEW"),
+                        windowBytes = respJson.optLong("windowBytes", 0),
+                        ackEvery = respJson.optInt("ackEvery", 1)
                     )
                 }
             }
@@ -487,31 +522,7 @@ class TcpSyncClient(
         try {
             if (isDisconnecting.get()) return@withContext false
 
-            // Payload: UploadID (36 bytes fixed) + Offset (8 bytes) + Data
-            val idStrBytes = uploadId.toByteArray(java.nio.charset.StandardCharsets.US_ASCII)
-            val uploadIdBytes = ByteArray(36)
-            System.arraycopy(idStrBytes, 0, uploadIdBytes, 0, Math.min(idStrBytes.size, 36))
-            
-            val buffer = ByteBuffer.allocate(36 + 8 + data.size).order(ByteOrder.BIG_ENDIAN)
-            
-            // UploadID (36 bytes, padded)
-            buffer.put(uploadIdBytes)
-            
-            // Offset (8 bytes)
-            buffer.putLong(offset)
-            
-            // Data
-            buffer.put(data)
-            
-            val payload = buffer.array()
-            
-            val header = com.photosync.android.network.protocol.PacketHeader(
-                version = com.photosync.android.network.protocol.SyncProtocol.VERSION_2.toByte(),
-                type = PacketType.UPLOAD_CHUNK,
-                payloadLength = payload.size
-            )
-            val packet = NetworkPacket(header, payload)
-            
+            val packet = buildChunkPacket(uploadId, offset, data, data.size)
             val response = sendRequest(packet)
             
             if (response != null && response.header.type == PacketType.UPLOAD_CHUNK_ACK) {
@@ -531,19 +542,332 @@ class TcpSyncClient(
         }
     }
     
+    /**
+     * Pipelined chunk upload for sessions where UPLOAD_ACK granted a window.
+     * Keeps up to [windowBytes] unacknowledged on the wire and advances on the
+     * server's cumulative UPLOAD_CHUNK_ACKs instead of waiting a round trip per
+     * chunk. Returns false on an INVALID_OFFSET gap, a short source stream or an
+     * I/O error; the next resumeUpload picks up from the server's offset. After a
+     * server error or I/O error the connection is dropped, since unread replies to
+     * the rest of the window would otherwise be taken for later responses.
+     */
+    suspend fun sendChunksWindowed(
+        uploadId: String,
+        startOffset: Long,
+        totalSize: Long,
+        source: java.io.InputStream,
+        chunkSize: Int,
+        windowBytes: Long,
+        onProgress: suspend (Long) -> Unit
+    ): Boolean = withContext(Dispatchers.IO) {
+        try {
+            val out = outputStream ?: throw java.io.IOException("Not connected")
+            val `in` = inputStream ?: throw java.io.IOException("Not connected")
+            val buffer = ByteArray(chunkSize)
+            var sent = startOffset
+            var acked = startOffset
+
+            while (acked < totalSize) {
+                if (isDisconnecting.get()) throw CancellationException("Client disconnecting")
+
+                // Fill the window (always allow one chunk so a tiny window still progresses)
+                while (sent < totalSize && (sent == acked || sent - acked + chunkSize <= windowBytes)) {
+                    val length = Math.min(chunkSize.toLong(), totalSize - sent).toInt()
+                    if (readFully(source, buffer, length) != length) {
+                        Log.e(TAG, "Source file truncated at offset $sent of $totalSize")
+                        return@withContext false
+                    }
+                    out.write(buildChunkPacket(uploadId, sent, buffer, length).toBytes())
+                    sent += length
+                }
+                out.flush()
+
+                val response = readPacket(`in`)
+                when (response.header.type) {
+                    PacketType.UPLOAD_CHUNK_ACK -> {
+                        val next = response.getJsonPayload()?.optLong("nextExpectedOffset", acked) ?: acked
+                        if (next > acked) {
+                            acked = next
+                            onProgress(acked)
+                        }
+                    }
+                    PacketType.PROTOCOL_ERROR -> {
+                        Log.w(TAG, "Windowed upload $uploadId rejected: ${response.getJsonPayload()}")
+                        // Acks or errors for the other in-flight chunks are still unread;
+                        // start over on a fresh connection
+                        disconnect()
+                        return@withContext false
+                    }
+                    else -> Log.w(TAG, "Unexpected ${response.header.type} during windowed upload")
+                }
+            }
+            true
+        } catch (e: Exception) {
+            if (e is CancellationException) throw e
+            if (isDisconnecting.get()) {
+                throw CancellationException("Interrupted during windowed upload", e)
+            }
+            // The stream may hold unread acks now; start over on a fresh connection
+            Log.e(TAG, "Error in windowed upload", e)
+            disconnect()
+            false
+        }
+    }
+
+    // Payload: UploadID (36 bytes fixed) + Offset (8 bytes) + Data
+    private fun buildChunkPacket(uploadId: String, offset: Long, data: ByteArray, length: Int): NetworkPacket {
+        if (controlVersion >= com.photosync.android.network.protocol.SyncProtocol.VERSION_3) {
+            val rawId = com.photosync.android.network.protocol.BinaryControl.packUploadId(uploadId)
+            if (rawId != null) {
+                // V3: [UploadID (16 raw bytes)][Offset (8 bytes)][Data]
+                val payload = ByteBuffer.allocate(rawId.size + 8 + length).order(ByteOrder.BIG_ENDIAN)
+                    .put(rawId)
+                    .putLong(offset)
+                    .put(data, 0, length)
+                    .array()
+                val header = com.photosync.android.network.protocol.PacketHeader(
+                    version = com.photosync.android.network.protocol.SyncProtocol.VERSION_3.toByte(),
+                    type = PacketType.UPLOAD_CHUNK,
+                    payloadLength = payload.size
+                )
+                return NetworkPacket(header, payload)
+            }
+        }
+
+        val idStrBytes = uploadId.toByteArray(java.nio.charset.StandardCharsets.US_ASCII)
+        val uploadIdBytes = ByteArray(36)
+        System.arraycopy(idStrBytes, 0, uploadIdBytes, 0, Math.min(idStrBytes.size, 36))
+        
+        val buffer = ByteBuffer.allocate(36 + 8 + length).order(ByteOrder.BIG_ENDIAN)
+        
+        // UploadID (36 bytes, padded)
+        buffer.put(uploadIdBytes)
+        
+        // Offset (8 bytes)
+        buffer.putLong(offset)
+        
+        // Data
+        buffer.put(data, 0, length)
+        
+        val payload = buffer.array()
+        
+        val header = com.photosync.android.network.protocol.PacketHeader(
+            version = com.photosync.android.network.protocol.SyncProtocol.VERSION_2.toByte(),
+            type = PacketType.UPLOAD_CHUNK,
+            payloadLength = payload.size
+        )
+        return NetworkPacket(header, payload)
+    }
+
+    private fun readFully(source: java.io.InputStream, buffer: ByteArray, length: Int): Int {
+        var total = 0
+        while (total < length) {
+            val n = source.read(buffer, total, length - total)
+            if (n == -1) break
+            total += n
+        }
+        return total
+    }
+
+    // Upload control packet in the negotiated encoding: V3 binary, or V2 JSON
+    private fun buildControlPacket(type: PacketType, json: JSONObject): NetworkPacket {
+        if (controlVersion >= com.photosync.android.network.protocol.SyncProtocol.VERSION_3) {
+            val binary = com.photosync.android.network.protocol.BinaryControl.encode(type, json)
+            if (binary != null) {
+                val header = com.photosync.android.network.protocol.PacketHeader(
+                    version = com.photosync.android.network.protocol.SyncProtocol.VERSION_3.toByte(),
+                    type = type,
+                    payloadLength = binary.size
+                )
+                return NetworkPacket(header, binary)
+            }
+        }
+        val payloadBytes = json.toString().toByteArray(java.nio.charset.StandardCharsets.UTF_8)
+        val header = com.photosync.android.network.protocol.PacketHeader(
+            version = com.photosync.android.network.protocol.SyncProtocol.VERSION_2.toByte(),
+            type = type,
+            payloadLength = payloadBytes.size
+        )
+        return NetworkPacket(header, payloadBytes)
+    }
+
+    /** One file of a multiplexed batch (see [uploadBatch]) */
+    class BatchUpload(
+        val key: String, // Caller's id for the item
+        val filename: String,
+        val size: Long,
+        val hash: String,
+        val open: () -> java.io.InputStream?
+    ) {
+        // The server keys uploads by hash and size, so these share an uploadId
+        fun sameContent(other: BatchUpload) = hash == other.hash && size == other.size
+    }
+
+    private class BatchState(val file: BatchUpload, val uploadId: String, val window: Long) {
+        var stream: java.io.InputStream? = null
+        var sent = 0L
+        var acked = 0L
+        var finishing = false
+        var failure: String? = null // Set when we aborted it ourselves
+    }
+
+    /**
+     * Upload several files at once over this connection, up to
+     * [maxConcurrentUploads] open at a time. INITs are pipelined, chunks of the
+     * open uploads are interleaved round-robin (one chunk per upload per pass,
+     * each upload limited by its own window) and FINISH is sent as soon as an
+     * upload is fully acknowledged, so small files no longer pay a round trip
+     * per step. Replies are matched by uploadId; UPLOAD_ACKs arrive in INIT
+     * order because the server handles a connection's packets in sequence.
+     * Files with the same content as an open upload would get its uploadId,
+     * so they wait until that upload has its result.
+     *
+     * [onResult] is called once per file the server finished (or rejected).
+     * Returns the files left unfinished when the connection failed; they can be
+     * retried and will resume from the server's offset.
+     */
+    suspend fun uploadBatch(
+        files: List<BatchUpload>,
+        onProgress: suspend (BatchUpload, Long) -> Unit,
+        onResult: suspend (BatchUpload, Boolean, String) -> Unit
+    ): List<BatchUpload> = withContext(Dispatchers.IO) {
+        val pending = ArrayDeque(files)
+        val awaitingAck = ArrayDeque<BatchUpload>()
+        val active = LinkedHashMap<String, BatchState>()
+        val deferred = ArrayDeque<BatchUpload>() // Same content as an open upload
+        try {
+            val out = outputStream ?: throw java.io.IOException("Not connected")
+            val `in` = inputStream ?: throw java.io.IOException("Not connected")
+            var chunkSize = 1024 * 1024
+            var buffer = ByteArray(chunkSize)
+
+            while (pending.isNotEmpty() || awaitingAck.isNotEmpty() || active.isNotEmpty()) {
+                if (isDisconnecting.get()) throw CancellationException("Client disconnecting")
+
+                // Open new uploads up to the server's limit
+                while (pending.isNotEmpty() && awaitingAck.size + active.size < maxConcurrentUploads.coerceAtLeast(1)) {
+                    val file = pending.removeFirst()
+                    if (awaitingAck.any { it.sameContent(file) } || active.values.any { it.file.sameContent(file) }) {
+                        deferred.addLast(file)
+                        continue
+                    }
+                    val json = JSONObject()
+                    json.put("filename", file.filename)
+                    json.put("size", file.size)
+                    json.put("hash", file.hash)
+                    json.put("traceId", java.util.UUID.randomUUID().toString())
+                    json.put("windowed", true)
+                    out.write(buildControlPacket(PacketType.UPLOAD_INIT, json).toBytes())
+                    awaitingAck.addLast(file)
+                }
+
+                // Round-robin one chunk per upload per pass while its window has room
+                var wrote = true
+                while (wrote) {
+                    wrote = false
+                    for (state in active.values) {
+                        if (state.finishing || state.sent >= state.file.size) continue
+                        if (state.sent > state.acked && state.sent - state.acked + chunkSize > state.window) continue
+                        val length = Math.min(chunkSize.toLong(), state.file.size - state.sent).toInt()
+                        val stream = state.stream
+                        if (stream == null || readFully(stream, buffer, length) != length) {
+                            state.failure = "Source file truncated"
+                            state.finishing = true
+                            out.write(buildControlPacket(PacketType.UPLOAD_ABORT, JSONObject().put("uploadId", state.uploadId)).toBytes())
+                            continue
+                        }
+                        out.write(buildChunkPacket(state.uploadId, state.sent, buffer, length).toBytes())
+                        state.sent += length
+                        wrote = true
+                    }
+                }
+
+                // Commit every upload the server has fully acknowledged
+                for (state in active.values) {
+                    if (!state.finishing && state.acked >= state.file.size) {
+                        val json = JSONObject()
+                        json.put("uploadId", state.uploadId)
+                        json.put("sha256", state.file.hash)
+                        out.write(buildControlPacket(PacketType.UPLOAD_FINISH, json).toBytes())
+                        state.finishing = true
+                    }
+                }
+                out.flush()
+
+                if (awaitingAck.isEmpty() && active.isEmpty()) continue
+
+                // Everything in flight is now waiting on the server
+                val response = readPacket(`in`)
+                val json = response.getJsonPayload()
+                val uploadId = json?.optString("uploadId") ?: ""
+                when (response.header.type) {
+                    PacketType.UPLOAD_ACK -> {
+                        val file = awaitingAck.removeFirst()
+                        if (json == null) throw java.io.IOException("Malformed UPLOAD_ACK")
+                        chunkSize = json.optInt("chunkSize", chunkSize)
+                        if (buffer.size < chunkSize) buffer = ByteArray(chunkSize)
+                        maxConcurrentUploads = json.optInt("maxConcurrentUploads", 1)
+
+                        val windowBytes = json.optLong("windowBytes", 0)
+                        if (active.containsKey(json.getString("uploadId"))) {
+                            // Server resumed an upload we already have open; retry after it
+                            deferred.addLast(file)
+                            continue
+                        }
+                        val state = BatchState(file, json.getString("uploadId"), if (windowBytes > 0) windowBytes else chunkSize.toLong())
+                        val offset = json.getLong("receivedBytes")
+                        state.sent = offset
+                        state.acked = offset
+                        if (offset < file.size) {
+                            val stream = file.open()
+                            if (stream != null && offset > 0) stream.skip(offset)
+                            state.stream = stream
+                        }
+                        active[state.uploadId] = state
+                    }
+                    PacketType.UPLOAD_CHUNK_ACK -> {
+                        val state = active[uploadId] ?: continue
+                        val next = json?.optLong("nextExpectedOffset", state.acked) ?: state.acked
+                        if (next > state.acked) {
+                            state.acked = next
+                            onProgress(state.file, next)
+                        }
+                    }
+                    PacketType.UPLOAD_RESULT -> {
+                        val state = active.remove(uploadId) ?: continue
+                        state.stream?.close()
+                        val waiting = deferred.filter { it.sameContent(state.file) }
+                        deferred.removeAll(waiting)
+                        waiting.asReversed().forEach { pending.addFirst(it) }
+                        val status = json?.optString("status")
+                        val success = state.failure == null && (status == "SUCCESS" || status == "COMPLETE")
+                        onResult(state.file, success, state.failure ?: json?.optString("message") ?: "")
+                    }
+                    PacketType.PROTOCOL_ERROR -> {
+                        // Not attributable to one upload; resume everything on a fresh connection
+                        throw java.io.IOException("Server error during batch upload: ${json?.optString("message")}")
+                    }
+                    else -> Log.w(TAG, "Unexpected ${response.header.type} during batch upload")
+                }
+            }
+            deferred.toList()
+        } catch (e: Exception) {
+            if (e is CancellationException) throw e
+            Log.e(TAG, "Batch upload interrupted", e)
+            disconnect()
+            awaitingAck.toList() + active.values.map { it.file } + pending.toList() + deferred.toList()
+        } finally {
+            active.values.forEach { it.stream?.close() }
+        }
+    }
+    
     suspend fun finishUpload(uploadId: String, hash: String): Boolean = withContext(Dispatchers.IO) {
         try {
              val json = JSONObject()
              json.put("uploadId", uploadId)
              json.put("sha256", hash) // Reverted to "sha256" as per server expectation
              
-             val payloadBytes = json.toString().toByteArray(java.nio.charset.StandardCharsets.UTF_8)
-             val header = com.photosync.android.network.protocol.PacketHeader(
-                version = com.photosync.android.network.protocol.SyncProtocol.VERSION_2.toByte(), 
-                type = PacketType.UPLOAD_FINISH,
-                payloadLength = payloadBytes.size
-            )
-            val packet = NetworkPacket(header, payloadBytes)
+            val packet = buildControlPacket(PacketType.UPLOAD_FINISH, json)
             
             val response = sendRequest(packet)
             
@@ -575,18 +899,52 @@ class TcpSyncClient(
             false
         }
     }
+    /**
+     * Send a small file (at most [inlineMaxBytes]) as one UPLOAD_INLINE packet:
+     * [meta length (4 bytes)][JSON metadata][file bytes]. The server verifies
+     * the hash and stores it without an upload session, so the whole file
+     * costs one round trip. Connection errors propagate to the caller.
+     */
+    suspend fun uploadInline(filename: String, hash: String, data: ByteArray): Boolean = withContext(Dispatchers.IO) {
+        val json = JSONObject()
+        json.put("filename", filename)
+        json.put("size", data.size.toLong())
+        json.put("sha256", hash)
+        val meta = json.toString().toByteArray(java.nio.charset.StandardCharsets.UTF_8)
+
+        val payload = ByteBuffer.allocate(4 + meta.size + data.size)
+            .order(ByteOrder.BIG_ENDIAN)
+            .putInt(meta.size)
+            .put(meta)
+            .put(data)
+            .array()
+        val header = com.photosync.android.network.protocol.PacketHeader(
+            version = com.photosync.android.network.protocol.SyncProtocol.VERSION_2.toByte(),
+            type = PacketType.UPLOAD_INLINE,
+            payloadLength = payload.size
+        )
+
+        val response = sendRequest(NetworkPacket(header, payload))
+        val respJson = response?.getJsonPayload()
+        when (response?.header?.type) {
+            PacketType.UPLOAD_RESULT -> {
+                if (respJson?.optString("status") == "SUCCESS") return@withContext true
+                Log.e(TAG, "Inline upload of $filename failed: ${respJson?.optString("message")}")
+            }
+            PacketType.PROTOCOL_ERROR ->
+                Log.e(TAG, "Server returned ERROR for inline upload of $filename: ${respJson?.optString("message")}")
+            null -> Log.e(TAG, "No response to inline upload of $filename")
+            else -> Log.e(TAG, "Invalid response type to inline upload: ${response.header.type}")
+        }
+        false
+    }
+
     suspend fun abortUpload(uploadId: String): Boolean = withContext(Dispatchers.IO) {
         try {
             val json = JSONObject()
             json.put("uploadId", uploadId)
             
-            val payloadBytes = json.toString().toByteArray(java.nio.charset.StandardCharsets.UTF_8)
-            val header = com.photosync.android.network.protocol.PacketHeader(
-                version = com.photosync.android.network.protocol.SyncProtocol.VERSION_2.toByte(), 
-                type = PacketType.UPLOAD_ABORT,
-                payloadLength = payloadBytes.size
-            )
-            val packet = NetworkPacket(header, payloadBytes)
+            val packet = buildControlPacket(PacketType.UPLOAD_ABORT, json)
             
             val response = sendRequest(packet)
             
@@ -0,0 +1,118 @@
+package com.photosync.android.network.protocol
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.charset.StandardCharsets
+import org.json.JSONObject
+
+/**
+ * Protocol V3 binary encoding of the upload control messages (layouts in the
+ * server's ProtocolParser.h). Messages are converted to and from the same
+ * JSONObject shape as V2, so callers only pick the packet version.
+ */
+object BinaryControl {
+    private val ACK_STATUSES = listOf("NEW", "RESUMING", "COMPLETE")
+    private val CHUNK_ACK_STATUSES = listOf("OK")
+    private val RESULT_STATUSES = listOf("SUCCESS", "ERROR", "ABORTED")
+
+    fun hasLayout(type: PacketType) = when (type) {
+        PacketType.UPLOAD_INIT, PacketType.UPLOAD_ACK, PacketType.UPLOAD_CHUNK_ACK,
+        PacketType.UPLOAD_FINISH, PacketType.UPLOAD_RESULT, PacketType.UPLOAD_ABORT -> true
+        else -> false
+    }
+
+    /** Client -> server messages; null for types without a binary layout */
+    fun encode(type: PacketType, json: JSONObject): ByteArray? {
+        val out = java.io.ByteArrayOutputStream()
+        val data = java.io.DataOutputStream(out) // Big-endian
+        when (type) {
+            PacketType.UPLOAD_INIT -> {
+                data.writeByte(if (json.optBoolean("windowed")) 1 else 0)
+                data.writeLong(json.optLong("size"))
+                writeStr8(data, json.optString("hash"))
+                writeStr16(data, json.optString("filename"))
+                writeStr8(data, json.optString("traceId"))
+            }
+            PacketType.UPLOAD_FINISH -> {
+                writeStr8(data, json.optString("uploadId"))
+                writeStr8(data, json.optString("sha256"))
+            }
+            PacketType.UPLOAD_ABORT -> writeStr8(data, json.optString("uploadId"))
+            else -> return null
+        }
+        return out.toByteArray()
+    }
+
+    /** Server -> client messages; null if truncated or unknown */
+    fun decode(type: PacketType, payload: ByteArray): JSONObject? {
+        val buffer = ByteBuffer.wrap(payload).order(ByteOrder.BIG_ENDIAN)
+        return try {
+            val json = JSONObject()
+            when (type) {
+                PacketType.UPLOAD_ACK -> {
+                    json.put("status", ACK_STATUSES[buffer.get().toInt() and 0xFF])
+                    json.put("chunkSize", buffer.int)
+                    json.put("receivedBytes", buffer.long)
+                    val windowBytes = buffer.long
+                    val ackEvery = buffer.short.toInt() and 0xFFFF
+                    val maxConcurrent = buffer.short.toInt() and 0xFFFF
+                    json.put("uploadId", readStr8(buffer))
+                    // Zero means "not granted", as an absent key does in V2
+                    if (windowBytes > 0) json.put("windowBytes", windowBytes)
+                    if (ackEvery > 0) json.put("ackEvery", ackEvery)
+                    if (maxConcurrent > 0) json.put("maxConcurrentUploads", maxConcurrent)
+                }
+                PacketType.UPLOAD_CHUNK_ACK -> {
+                    json.put("status", CHUNK_ACK_STATUSES[buffer.get().toInt() and 0xFF])
+                    json.put("nextExpectedOffset", buffer.long)
+                    json.put("uploadId", readStr8(buffer))
+                }
+                PacketType.UPLOAD_RESULT -> {
+                    json.put("status", RESULT_STATUSES[buffer.get().toInt() and 0xFF])
+                    json.put("uploadId", readStr8(buffer))
+                    json.put("message", readStr16(buffer))
+                }
+                else -> return null
+            }
+            json
+        } catch (e: Exception) {
+            null // BufferUnderflow or an unknown status code
+        }
+    }
+
+    /** The 16 bytes a UUID-formatted upload id encodes, as sent in V3 UPLOAD_CHUNK; null if not a UUID */
+    fun packUploadId(uploadId: String): ByteArray? {
+        if (uploadId.length != 36) return null
+        val hex = uploadId.replace("-", "")
+        if (hex.length != 32) return null
+        return try {
+            ByteArray(16) { i -> hex.substring(i * 2, i * 2 + 2).toInt(16).toByte() }
+        } catch (e: NumberFormatException) {
+            null
+        }
+    }
+
+    private fun writeStr8(data: java.io.DataOutputStream, value: String) {
+        val bytes = value.toByteArray(StandardCharsets.UTF_8)
+        val length = minOf(bytes.size, 0xFF)
+        data.writeByte(length)
+        data.write(bytes, 0, length)
+    }
+
+    private fun writeStr16(data: java.io.DataOutputStream, value: String) {
+        val bytes = value.toByteArray(StandardCharsets.UTF_8)
+        val length = minOf(bytes.size, 0xFFFF)
+        data.writeShort(length)
+        data.write(bytes, 0, length)
+    }
+
+    private fun readStr8(buffer: ByteBuffer) = readBytes(buffer, buffer.get().toInt() and 0xFF)
+
+    private fun readStr16(buffer: ByteBuffer) = readBytes(buffer, buffer.short.toInt() and 0xFFFF)
+
+    private fun readBytes(buffer: ByteBuffer, length: Int): String {
+        val bytes = ByteArray(length)
+        buffer.get(bytes)
+        return String(bytes, StandardCharsets.UTF_8)
+    }
+}
@@ -24,6 +24,7 @@ enum class PacketType(val value: Int) {
     UPLOAD_RESULT(0x14),
     UPLOAD_ABORT(0x15),
     UPLOAD_CHUNK_ACK(0x16),
+    UPLOAD_INLINE(0x17),
     
     UNKNOWN(0xFF);
 
@@ -94,6 +95,9 @@ class NetworkPacket(
     
     fun getJsonPayload(): JSONObject? {
         if (payload == null || payload.isEmpty()) return null
+        if (header.version >= SyncProtocol.VERSION_3 && BinaryControl.hasLayout(header.type)) {
+            return BinaryControl.decode(header.type, payload)
+        }
         return try {
             JSONObject(String(payload, StandardCharsets.UTF_8))
         } catch (e: Exception) {
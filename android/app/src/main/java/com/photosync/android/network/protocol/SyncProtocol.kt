@@ -7,4 +7,5 @@ object SyncProtocol {
     const val MAGIC_NUMBER = 0x5048
     const val VERSION = 1
     const val VERSION_2 = 2
+    const val VERSION_3 = 3 // V2 with binary control messages, negotiated at pairing
 }
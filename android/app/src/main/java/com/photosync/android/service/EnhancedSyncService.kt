@@ -453,6 +453,72 @@ class EnhancedSyncService : Service() {
                                          _syncState.value = SyncState.Syncing
                                     }
 
+                                    // Small files travel as one UPLOAD_INLINE packet: no upload session
+                                    // and a single round trip instead of init/chunk/finish
+                                    if (client.inlineMaxBytes > 0 && item.size <= client.inlineMaxBytes) {
+                                        if (!item.uploadId.isNullOrEmpty() && item.lastKnownOffset == 0L) {
+                                            client.abortUpload(item.uploadId)
+                                        }
+                                        val bytes = contentResolver.openInputStream(item.uri)?.use { it.readBytes() }
+                                            ?: throw java.io.FileNotFoundException(item.name)
+                                        if (bytes.size.toLong() != item.size) {
+                                            mediaRepository.markAsFailed(item.id, "Source file size changed")
+                                        } else if (client.uploadInline(item.name, hash, bytes)) {
+                                            mediaRepository.markAsSynced(item.id, hash, item.size)
+                                        } else {
+                                            mediaRepository.markAsFailed(item.id, "Inline Upload Failed")
+                                        }
+                                        completedCount.incrementAndGet()
+                                        continue
+                                    }
+
+                                    // Multiplexed flow: once the server has advertised that this connection
+                                    // may hold several uploads, claim a batch and interleave them
+                                    if (client.maxConcurrentUploads > 1 && !(!item.uploadId.isNullOrEmpty() && item.lastKnownOffset == 0L)) {
+                                        val first: com.photosync.android.model.MediaItem = item
+                                        val batch = mutableListOf(first to hash)
+                                        while (batch.size < client.maxConcurrentUploads) {
+                                            val next = mediaRepository.claimNextPendingItem() ?: break
+                                            if (!next.uploadId.isNullOrEmpty() && next.lastKnownOffset == 0L) {
+                                                // Explicit restart: abort the old session before re-initialising
+                                                client.abortUpload(next.uploadId)
+                                            }
+                                            val nextHash = if (next.hash.isEmpty()) mediaRepository.calculateHash(next.uri) else next.hash
+                                            batch.add(next to nextHash)
+                                        }
+                                        if (batch.size > 1) {
+                                            val uploads = batch.map { (media, mediaHash) ->
+                                                TcpSyncClient.BatchUpload(media.id, media.name, media.size, mediaHash) {
+                                                    contentResolver.openInputStream(media.uri)
+                                                }
+                                            }
+                                            val unfinished = client.uploadBatch(
+                                                uploads,
+                                                onProgress = { upload, offset ->
+                                                    mediaRepository.updateUploadProgress(upload.key, offset, upload.size)
+                                                },
+                                                onResult = { upload, success, message ->
+                                                    if (success) {
+                                                        mediaRepository.markAsSynced(upload.key, upload.hash, upload.size)
+                                                    } else {
+                                                        mediaRepository.markAsFailed(upload.key, message.ifEmpty { "Upload Failed" })
+                                                    }
+                                                }
+                                            )
+                                            completedCount.addAndGet(batch.size - unfinished.size)
+                                            if (unfinished.isNotEmpty()) {
+                                                // Connection lost: leave them PENDING so they resume later
+                                                unfinished.forEach { upload ->
+                                                    mediaRepository.markAsFailed(upload.key, "Connection lost", SyncStatus.PENDING)
+                                                }
+                                                Log.w(TAG, "Stopping worker $workerId due to network issue")
+                                                break
+                                            }
+                                            continue
+                                        }
+                                        // Nothing else to pair it with; upload it on its own below
+                                    }
+
                                     // V2 / V1 Upload Flow (Copied from previous)
                                     
                                     // Check for Manual Restart Signal
@@ -495,6 +561,18 @@ class EnhancedSyncService : Service() {
                                             var bytesRead: Int
                                             var success = true
                                             
+                                            if (initResult.windowBytes > 0) {
+                                                // Pipelined: server acks cumulatively every few chunks
+                                                while (_syncState.value is SyncState.Paused) delay(1000)
+                                                success = client.sendChunksWindowed(
+                                                    uploadId, currentOffset, item.size, stream,
+                                                    chunkSize, initResult.windowBytes
+                                                ) { acked ->
+                                                    currentOffset = acked
+                                                    mediaRepository.updateUploadProgress(item.id, acked, item.size)
+                                                }
+                                            }
+                                            
                                             while (currentOffset < item.size && success) {
                                                 while (_syncState.value is SyncState.Paused) delay(1000)
                                                 
@@ -511,7 +589,7 @@ class EnhancedSyncService : Service() {
                                             }
                                             
                                             // Verify we actually read the expected amount of data
-                                            if (currentOffset != item.size) {
+                                            if (success && currentOffset != item.size) {
                                                 Log.e(TAG, "Source file truncated: expected ${item.size}, got $currentOffset")
                                                 success = false
                                             }
@@ -146,20 +146,36 @@ export default function MediaViewer({ open, photo, photos, onClose, onNavigate }
                         justifyContent: 'center',
                     }}
                 >
-                    <img
-                        src={photo.fullUrl}
-                        alt={photo.filename}
-                        style={{
-                            maxWidth: '100%',
-                            maxHeight: '90vh',
-                            objectFit: 'contain',
-                            borderRadius: '8px',
-                        }}
-                        onError={(e: any) => {
-                            e.target.style.display = 'none';
-                            e.target.nextSibling.style.display = 'flex';
-                        }}
-                    />
+                    {photo.mimeType?.startsWith('video/') ? (
+                        // Streams from the download endpoint, which supports
+                        // Range requests so the player can seek
+                        <video
+                            key={photo.id}
+                            src={photo.fullUrl}
+                            controls
+                            preload="metadata"
+                            style={{
+                                maxWidth: '100%',
+                                maxHeight: '90vh',
+                                borderRadius: '8px',
+                            }}
+                        />
+                    ) : (
+                        <img
+                            src={photo.previewUrl || photo.fullUrl}
+                            alt={photo.filename}
+                            style={{
+                                maxWidth: '100%',
+                                maxHeight: '90vh',
+                                objectFit: 'contain',
+                                borderRadius: '8px',
+                            }}
+                            onError={(e: any) => {
+                                e.target.style.display = 'none';
+                                e.target.nextSibling.style.display = 'flex';
+                            }}
+                        />
+                    )}
                     <Box
                         sx={{
                             display: 'none',
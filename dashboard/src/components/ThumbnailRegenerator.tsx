@@ -57,7 +57,7 @@ export const ThumbnailRegenerator: React.FC = () => {
                 </Box>
 
                 <Typography variant="body2" color="text.secondary" paragraph>
-                    If you see missing or broken thumbnails in the Media Grid, you can clear the thumbnail cache to force regeneration.
+                    If you see missing or broken thumbnails in the Media Grid, you can queue a rebuild of every thumbnail. Existing thumbnails stay visible while the rebuild runs in the background.
                 </Typography>
 
                 {message && <Alert severity="success" sx={{ mb: 2 }}>{message}</Alert>}
@@ -70,7 +70,7 @@ export const ThumbnailRegenerator: React.FC = () => {
                     onClick={handleRegenerate}
                     disabled={loading}
                 >
-                    {loading ? 'Clearing Cache...' : 'Clear Thumbnail Cache'}
+                    {loading ? 'Queueing...' : 'Rebuild All Thumbnails'}
                 </Button>
             </CardContent>
         </Card>
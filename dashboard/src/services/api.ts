@@ -72,6 +72,7 @@ export interface MediaItem {
     id: number;
     filename: string;
     thumbnailUrl: string;
+    previewUrl: string;
     fullUrl: string;
     mimeType: string;
     size: number;
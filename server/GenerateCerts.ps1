@@ -1,13 +1,23 @@
+param(
+    # ECDSA P-256 keys make handshakes much cheaper than RSA-2048
+    [ValidateSet("ECDSA", "RSA")]
+    [string]$KeyType = "ECDSA"
+)
+
 $opensslAvailable = Get-Command openssl -ErrorAction SilentlyContinue
 
 if ($opensslAvailable) {
-    Write-Host "OpenSSL found. Generating with OpenSSL..."
+    Write-Host "OpenSSL found. Generating $KeyType key with OpenSSL..."
     # Generate Private Key
-    openssl genrsa -out server.key 2048
+    if ($KeyType -eq "RSA") {
+        openssl genrsa -out server.key 2048
+    } else {
+        openssl ecparam -name prime256v1 -genkey -noout -out server.key
+    }
     
     # Generate Certificate
     openssl req -new -key server.key -out server.csr -subj "/C=US/ST=State/L=City/O=PhotoSync/CN=photosync.local"
-    openssl x509 -req -days 365 -in server.csr -signkey server.key -out server.crt
+    openssl x509 -req -days 365 -sha256 -in server.csr -signkey server.key -out server.crt
     
     Write-Host "Certificates generated: server.crt, server.key"
 } else {
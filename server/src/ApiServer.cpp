@@ -1,26 +1,92 @@
 ﻿#include "ApiServer.h"
 #include "AuthenticationManager.h"
+#include "Compression.h"
 #include "ConnectionManager.h"
+#include "HttpUtils.h"
+#include "JsonWriter.h"
 #include "Logger.h"
+#include "MetricsRegistry.h"
 #include "ThumbnailGenerator.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <atomic>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <crow.h>
 #include <filesystem>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <set>
 #include <sstream>
 #include <thread>
 
 using json = nlohmann::json;
 
+// Owns a spooled response body (see ApiServer::deleteAfterSending). Crow
+// writes a static-file body synchronously after the handler returns and
+// replaces the per-request middleware context only on the connection's next
+// request or when the connection is destroyed, so a file owned by the
+// context outlives the whole transfer.
+struct SpoolCleanup {
+  struct context {
+    std::shared_ptr<const std::string> file;
+  };
+
+  void before_handle(crow::request &, crow::response &, context &) {}
+  void after_handle(crow::request &, crow::response &, context &) {}
+};
+
+// Spooled files currently owned by a response
+static std::mutex g_spoolsMutex;
+static std::set<std::string> g_sendingSpools;
+// Names range spools uniquely within this process
+static std::atomic<unsigned> g_rangeSpools{0};
+
 // Global Crow app instance
-static crow::SimpleApp *g_app = nullptr;
+static crow::App<SpoolCleanup> *g_app = nullptr;
 static std::thread *g_apiThread = nullptr;
 
 // Global UI path - detected at runtime
 static std::string g_uiPath;
 
+// JSON bodies below this size are sent as-is; compressing them saves less
+// than the encoding header and CPU cost
+static constexpr size_t JSON_COMPRESS_MIN_BYTES = 1024;
+
+// Build a JSON response, gzip- or deflate-encoding the body when the client
+// accepts it and it is large enough to be worth it. Dynamic bodies use the
+// fastest zlib level; JSON still shrinks several times over at that level.
+static crow::response jsonResponse(const crow::request &req,
+                                   std::string body) {
+  crow::response res;
+  res.set_header("Content-Type", "application/json");
+
+  if (body.size() >= JSON_COMPRESS_MIN_BYTES) {
+    res.set_header("Vary", "Accept-Encoding");
+
+    std::string acceptEncoding = req.get_header_value("Accept-Encoding");
+    std::string encoded;
+    const char *encoding = nullptr;
+    if (HttpUtils::acceptsEncoding(acceptEncoding, "gzip")) {
+      if (Compression::gzip(body, encoded, Compression::FAST_LEVEL))
+        encoding = "gzip";
+    } else if (HttpUtils::acceptsEncoding(acceptEncoding, "deflate")) {
+      if (Compression::deflate(body, encoded, Compression::FAST_LEVEL))
+        encoding = "deflate";
+    }
+
+    if (encoding && encoded.size() < body.size()) {
+      res.set_header("Content-Encoding", encoding);
+      body.swap(encoded);
+    }
+  }
+
+  res.body = std::move(body);
+  return res;
+}
+
 // Detect the correct UI path based on available directories
 static std::string detectUIPath() {
   // Priority order: installed location, dev build (sibling), dev source
@@ -45,8 +111,9 @@ static std::string detectUIPath() {
 }
 
 ApiServer::ApiServer(DatabaseManager &db, ConfigManager &config,
-                     IntegrityScanner *scanner)
-    : db_(db), config_(config), scanner_(scanner), running_(false) {
+                     IntegrityScanner *scanner, ThumbnailQueue *thumbnails)
+    : db_(db), config_(config), scanner_(scanner), thumbnails_(thumbnails),
+      running_(false) {
   startTime_ = std::chrono::system_clock::now();
 }
 
@@ -60,10 +127,11 @@ void ApiServer::start(int port) {
 
   LOG_INFO("Starting API server on port " + std::to_string(port));
 
-  // Detect UI path before setting up routes
+  // Detect UI path and load the bundle before setting up routes
   g_uiPath = detectUIPath();
+  assets_.load(g_uiPath);
 
-  g_app = new crow::SimpleApp();
+  g_app = new crow::App<SpoolCleanup>();
   g_app->loglevel(crow::LogLevel::Warning);
 
   setupRoutes();
@@ -135,6 +203,32 @@ void ApiServer::setupRoutes() {
         return res;
       });
 
+  // GET /api/metrics - Counters and latency histograms, Prometheus format
+  CROW_ROUTE((*g_app), "/api/metrics")
+      .methods("GET"_method)([this](const crow::request &req) {
+        if (!config_.getMetricsPublic() && !validateAuth(req))
+          return crow::response(401);
+        auto res = crow::response(
+            MetricsRegistry::getInstance().renderPrometheus());
+        res.add_header("Content-Type", "text/plain; version=0.0.4");
+        return res;
+      });
+
+  // GET /api/traces - Recent upload spans as Chrome trace-event JSON
+  CROW_ROUTE((*g_app), "/api/traces")
+      .methods("GET"_method)([this](const crow::request &req) {
+        if (!validateAuth(req))
+          return crow::response(401);
+        std::string traceId = req.url_params.get("traceId")
+                                  ? req.url_params.get("traceId")
+                                  : "";
+        int limit = req.url_params.get("limit")
+                        ? std::stoi(req.url_params.get("limit"))
+                        : 0;
+
+        return jsonResponse(req, handleGetTraces(traceId, limit));
+      });
+
   // GET /api/integrity - Integrity Status (Phase 6)
   CROW_ROUTE((*g_app), "/api/integrity")
       .methods("GET"_method)([this](const crow::request &req) {
@@ -216,10 +310,8 @@ void ApiServer::setupRoutes() {
         std::string since =
             req.url_params.get("since") ? req.url_params.get("since") : "";
 
-        auto res = crow::response(
-            handleGetErrors(limit, offset, level, deviceId, since).dump());
-        res.add_header("Content-Type", "application/json");
-        return res;
+        return jsonResponse(
+            req, handleGetErrors(limit, offset, level, deviceId, since));
       });
 
   // GET /api/changes - Incremental Sync Feed
@@ -239,9 +331,7 @@ void ApiServer::setupRoutes() {
                         ? std::stoi(req.url_params.get("limit"))
                         : 50;
 
-        auto res = crow::response(handleGetChanges(cursor, limit));
-        res.add_header("Content-Type", "application/json");
-        return res;
+        return jsonResponse(req, handleGetChanges(cursor, limit));
       });
 
   // DELETE /api/media/<int> - Soft Delete Photo
@@ -270,10 +360,9 @@ void ApiServer::setupRoutes() {
         std::string search =
             req.url_params.get("search") ? req.url_params.get("search") : "";
 
-        auto res =
-            crow::response(handleGetPhotos(page, limit, clientId, search));
+        auto res = jsonResponse(
+            req, handleGetPhotos(page, limit, clientId, search));
         res.add_header("Access-Control-Allow-Origin", "*");
-        res.add_header("Content-Type", "application/json");
         return res;
       });
 
@@ -282,9 +371,7 @@ void ApiServer::setupRoutes() {
       .methods("GET"_method)([this](const crow::request &req) {
         if (!validateAuth(req))
           return crow::response(401);
-        auto res = crow::response(handleGetClients());
-        res.add_header("Content-Type", "application/json");
-        return res;
+        return jsonResponse(req, handleGetClients());
       });
 
   // GET /api/clients/:id - Client details
@@ -320,10 +407,9 @@ void ApiServer::setupRoutes() {
         std::string status =
             req.url_params.get("status") ? req.url_params.get("status") : "";
 
-        auto res =
-            crow::response(handleGetSessions(page, limit, clientId, status));
+        auto res = jsonResponse(
+            req, handleGetSessions(page, limit, clientId, status));
         res.add_header("Access-Control-Allow-Origin", "*");
-        res.add_header("Content-Type", "application/json");
         return res;
       });
 
@@ -452,20 +538,23 @@ void ApiServer::setupRoutes() {
         std::string search =
             req.url_params.get("search") ? req.url_params.get("search") : "";
 
-        auto res = crow::response(handleGetMedia(offset, limit, clientId,
-                                                 startDate, endDate, search));
+        auto res = jsonResponse(req, handleGetMedia(offset, limit, clientId,
+                                                    startDate, endDate,
+                                                    search));
         res.add_header("Access-Control-Allow-Origin", "*");
-        res.add_header("Content-Type", "application/json");
         return res;
       });
 
-  // GET /api/thumbnails/:id - Serve thumbnail
+  // GET /api/thumbnails/:id?size=N - Serve thumbnail or preview rendition
   CROW_ROUTE((*g_app), "/api/thumbnails/<int>")
       .methods("GET"_method)([this](const crow::request &req, int photoId) {
         if (!validateAuth(req))
           return crow::response(401);
+        int size = req.url_params.get("size")
+                       ? std::atoi(req.url_params.get("size"))
+                       : ThumbnailGenerator::DEFAULT_SIZE;
         crow::response res;
-        handleGetThumbnail(res, photoId);
+        handleGetThumbnail(req, res, photoId, size);
         return res;
       });
 
@@ -475,90 +564,47 @@ void ApiServer::setupRoutes() {
         if (!validateAuth(req))
           return crow::response(401);
         crow::response res;
-        handleGetMediaDownload(res, photoId);
+        handleGetMediaDownload(req, res, photoId);
+        return res;
+      });
+
+  // GET /api/export - Download a tar of originals matching the media filters
+  CROW_ROUTE((*g_app), "/api/export")
+      .methods("GET"_method)([this](const crow::request &req) {
+        if (!validateAuth(req))
+          return crow::response(401);
+        int clientId = req.url_params.get("client_id")
+                           ? std::atoi(req.url_params.get("client_id"))
+                           : -1;
+        std::string startDate = req.url_params.get("start_date")
+                                    ? req.url_params.get("start_date")
+                                    : "";
+        std::string endDate = req.url_params.get("end_date")
+                                  ? req.url_params.get("end_date")
+                                  : "";
+        std::string search =
+            req.url_params.get("search") ? req.url_params.get("search") : "";
+        crow::response res;
+        handleGetExport(res, clientId, startDate, endDate, search);
+        if (res.is_static_type()) {
+          deleteAfterSending(req, res.file_info.path);
+        }
         return res;
       });
 
-  // Explicit route for root path
+  // Dashboard bundle, served from the in-memory asset cache
   CROW_ROUTE((*g_app), "/")
-  ([]() {
-    std::string indexPath = g_uiPath + "index.html";
-    std::ifstream file(indexPath, std::ios::binary);
-    if (!file) {
-      LOG_ERROR("Failed to load index.html from: " + indexPath);
-      return crow::response(404, "UI Dashboard not found");
-    }
-    std::string content((std::istreambuf_iterator<char>(file)),
-                        std::istreambuf_iterator<char>());
-    file.close();
-    auto res = crow::response(content);
-    res.add_header("Content-Type", "text/html");
+  ([this](const crow::request &req) {
+    crow::response res;
+    handleGetStaticAsset(req, res, "");
     return res;
   });
 
-  // I need to view the file first to find the function body as regex failed
-  // earlier or I didn't search properly.
-  // Skipping this replace for now.oute for static files - must be last
+  // Catch-all route for static files - must be last
   CROW_ROUTE((*g_app), "/<path>")
-  ([](std::string path) {
-    // Default to index.html for root
-    if (path.empty()) {
-      path = "index.html";
-    }
-
-    // Build file path using detected UI path
-    std::string file_path = g_uiPath + path;
-
-    // Try to open file
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file) {
-      // For SPA routing, serve index.html for non-API, non-assets routes
-      if (path.find("api/") != 0 && path.find("assets/") != 0) {
-        std::string indexPath = g_uiPath + "index.html";
-        std::ifstream indexFile(indexPath, std::ios::binary);
-        if (indexFile) {
-          std::string content((std::istreambuf_iterator<char>(indexFile)),
-                              std::istreambuf_iterator<char>());
-          indexFile.close();
-          auto res = crow::response(content);
-          res.add_header("Content-Type", "text/html");
-          return res;
-        }
-      }
-      LOG_WARN("File not found: " + file_path);
-      return crow::response(404, "Not found");
-    }
-
-    // Read file content
-    std::string content((std::istreambuf_iterator<char>(file)),
-                        std::istreambuf_iterator<char>());
-    file.close();
-
-    // Determine content type based on file extension
-    std::string content_type = "text/html";
-    if (path.find(".css") != std::string::npos) {
-      content_type = "text/css";
-    } else if (path.find(".js") != std::string::npos) {
-      content_type = "application/javascript";
-    } else if (path.find(".json") != std::string::npos) {
-      content_type = "application/json";
-    } else if (path.find(".png") != std::string::npos) {
-      content_type = "image/png";
-    } else if (path.find(".jpg") != std::string::npos ||
-               path.find(".jpeg") != std::string::npos) {
-      content_type = "image/jpeg";
-    } else if (path.find(".svg") != std::string::npos) {
-      content_type = "image/svg+xml";
-    } else if (path.find(".ico") != std::string::npos) {
-      content_type = "image/x-icon";
-    } else if (path.find(".woff") != std::string::npos) {
-      content_type = "font/woff";
-    } else if (path.find(".woff2") != std::string::npos) {
-      content_type = "font/woff2";
-    }
-
-    auto res = crow::response(content);
-    res.add_header("Content-Type", content_type);
+  ([this](const crow::request &req, std::string path) {
+    crow::response res;
+    handleGetStaticAsset(req, res, path);
     return res;
   });
 }
@@ -691,44 +737,40 @@ crow::json::wvalue ApiServer::handleGetIntegrityDetails(const std::string &type,
   return {{"items", itemList}, {"type", type}};
 }
 
-crow::json::wvalue ApiServer::handleGetErrors(int limit, int offset,
-                                              const std::string &level,
-                                              const std::string &deviceId,
-                                              const std::string &since) {
+std::string ApiServer::handleGetErrors(int limit, int offset,
+                                       const std::string &level,
+                                       const std::string &deviceId,
+                                       const std::string &since) {
   try {
     auto errors = db_.getRecentErrors(limit, offset, level, deviceId, since);
-    std::vector<crow::json::wvalue> errorsJson;
 
+    std::string body;
+    body.reserve(errors.size() * 256);
+    JsonWriter w(body);
+    w.beginObject().key("errors").beginArray();
     for (const auto &err : errors) {
-      crow::json::wvalue e;
-      e["id"] = err.id;
-      e["code"] = err.code;
-      e["message"] = err.message;
-      e["traceId"] = err.traceId;
-      e["timestamp"] = err.timestamp;
-      e["severity"] = err.severity;
-      e["deviceId"] = err.deviceId;
-      // Context as JSON object if possible, else string
+      w.beginObject()
+          .field("id", err.id)
+          .field("code", err.code)
+          .field("message", err.message)
+          .field("traceId", err.traceId)
+          .field("timestamp", err.timestamp)
+          .field("severity", err.severity)
+          .field("deviceId", err.deviceId);
+      // Context is stored as a JSON string and passed through as a string
       if (!err.context.empty()) {
-        try {
-          // If context is valid JSON, we might want to parse it?
-          // Crow wvalue doesn't support nested raw generic json easily from
-          // string without parsing. For now just pass as string
-          e["context"] = err.context;
-        } catch (...) {
-          e["context"] = err.context;
-        }
+        w.field("context", err.context);
       } else {
-        e["context"] = nullptr;
+        w.key("context").null();
       }
-
-      errorsJson.push_back(e);
+      w.endObject();
     }
-
-    return {{"errors", errorsJson}};
+    w.endArray().endObject();
+    return body;
   } catch (const std::exception &e) {
     LOG_ERROR("Error in handleGetErrors: " + std::string(e.what()));
-    return {{"error", e.what()}};
+    json error = {{"error", e.what()}};
+    return error.dump();
   }
 }
 
@@ -745,44 +787,27 @@ std::string ApiServer::handleGetPhotos(int page, int limit,
       }
     }
 
-    std::vector<PhotoMetadata> photos = db_.getPhotosWithPagination(
-        offset, limit, clientFilter, "", "", search);
     int total = db_.getFilteredPhotoCount(clientFilter, "", "", search);
 
-    json photosJson = json::array();
-    for (const PhotoMetadata &photo : photos) {
-      json p = {{"id", photo.id},
-                {"filename", photo.filename},
-                {"size", photo.size},
-                {"hash", photo.hash},
-                {"thumbnailUrl", "/api/thumbnails/" + std::to_string(photo.id)},
-                {"url", "/api/media/" + std::to_string(photo.id)},
-                {"takenAt", photo.takenAt},
-                {"receivedAt", photo.receivedAt},
-                {"mimeType", photo.mimeType},
-                {"exif",
-                 {{"cameraMake", photo.cameraMake},
-                  {"cameraModel", photo.cameraModel},
-                  {"exposureTime", photo.exposureTime},
-                  {"fNumber", photo.fNumber},
-                  {"iso", photo.iso},
-                  {"focalLength", photo.focalLength},
-                  {"gps",
-                   {{"lat", photo.gpsLat},
-                    {"lon", photo.gpsLon},
-                    {"alt", photo.gpsAlt}}}}}};
-
-      photosJson.push_back(p);
+    std::string body;
+    body.reserve(256 + std::min(std::max(limit, 0), 1000) * 512);
+    JsonWriter w(body);
+    w.beginObject().key("photos").beginArray();
+    if (db_.writePhotosJson(w, offset, limit, clientFilter, search) < 0) {
+      json error = {{"error", "Failed to fetch photos"}};
+      return error.dump();
     }
-
-    json response = {{"photos", photosJson},
-                     {"pagination",
-                      {{"page", page},
-                       {"limit", limit},
-                       {"total", total},
-                       {"pages", (total + limit - 1) / limit}}}};
-
-    return response.dump();
+    w.endArray();
+
+    w.key("pagination")
+        .beginObject()
+        .field("page", page)
+        .field("limit", limit)
+        .field("total", total)
+        .field("pages", (total + limit - 1) / limit)
+        .endObject();
+    w.endObject();
+    return body;
   } catch (const std::exception &e) {
     LOG_ERROR("Error in handleGetPhotos: " + std::string(e.what()));
     json error = {{"error", e.what()}};
@@ -805,23 +830,19 @@ std::string ApiServer::handleGetClients() {
 
     auto activeConnections = connMgr.getActiveConnections();
 
-    json clientsJson = json::array();
+    std::string body;
+    body.reserve(clients.size() * 256);
+    JsonWriter w(body);
+    w.beginObject().key("clients").beginArray();
 
     for (const auto &client : clients) {
-      bool isOnline = false;
-      json currentSession = nullptr;
+      const ConnectionInfo *syncing = nullptr;
 
-      // Check if client is online
+      // Check if client is syncing
       for (const auto &[sessionId, info] : activeConnections) {
         if (info.deviceId == client.deviceId) {
-          isOnline = true;
-
           if (info.status == "syncing") {
-            currentSession = {
-                {"progress", info.photosUploaded}, {"total", 0}
-                // Total is not currently tracked in ConnectionInfo, would need
-                // protocol update
-            };
+            syncing = &info;
           }
           break;
         }
@@ -830,26 +851,32 @@ std::string ApiServer::handleGetClients() {
       // Phase 6: Get 24h stats
       auto stats = db_.getDeviceStats24h(client.id);
 
-      json clientJson = {
-          {"id", client.id},
-          {"deviceId", client.deviceId},
-          {"name", client.userName.empty() ? client.deviceId : client.userName},
-          {"lastSeen", client.lastSeen},
-          {"photoCount", client.photoCount},
-          {"storageUsed", client.storageUsed},
-          {"isOnline", connMgr.isClientConnected(client.deviceId)},
-          {"uploads24h", stats.uploads24h},
-          {"failures24h", stats.failures24h}};
-
-      if (currentSession != nullptr) {
-        clientJson["currentSession"] = currentSession;
+      w.beginObject()
+          .field("id", client.id)
+          .field("deviceId", client.deviceId)
+          .field("name",
+                 client.userName.empty() ? client.deviceId : client.userName)
+          .field("lastSeen", client.lastSeen)
+          .field("photoCount", client.photoCount)
+          .field("storageUsed", client.storageUsed)
+          .field("isOnline", connMgr.isClientConnected(client.deviceId))
+          .field("uploads24h", stats.uploads24h)
+          .field("failures24h", stats.failures24h);
+
+      if (syncing) {
+        // Total is not currently tracked in ConnectionInfo, would need
+        // protocol update
+        w.key("currentSession")
+            .beginObject()
+            .field("progress", syncing->photosUploaded)
+            .field("total", 0)
+            .endObject();
       }
-
-      clientsJson.push_back(clientJson);
+      w.endObject();
     }
 
-    json response = {{"clients", clientsJson}};
-    return response.dump();
+    w.endArray().endObject();
+    return body;
   } catch (const std::exception &e) {
     LOG_ERROR("Error in handleGetClients: " + std::string(e.what()));
     json error = {{"error", e.what()}};
@@ -884,26 +911,33 @@ std::string ApiServer::handleGetSessions(int page, int limit,
     int total = db_.getCompletedSessionCount(); // This is inaccurate if
                                                 // filtered, but okay for now.
 
-    json sessionsJson = json::array();
+    std::string body;
+    body.reserve(sessions.size() * 192);
+    JsonWriter w(body);
+    w.beginObject().key("sessions").beginArray();
     for (const auto &session : sessions) {
-      sessionsJson.push_back({{"id", session.id},
-                              {"clientId", session.clientId},
-                              {"deviceId", session.deviceId},
-                              {"clientName", session.clientName},
-                              {"startedAt", session.startedAt},
-                              {"endedAt", session.endedAt},
-                              {"photosReceived", session.photosReceived},
-                              {"status", session.status}});
+      w.beginObject()
+          .field("id", session.id)
+          .field("clientId", session.clientId)
+          .field("deviceId", session.deviceId)
+          .field("clientName", session.clientName)
+          .field("startedAt", session.startedAt)
+          .field("endedAt", session.endedAt)
+          .field("photosReceived", session.photosReceived)
+          .field("status", session.status)
+          .endObject();
     }
-
-    json response = {{"sessions", sessionsJson},
-                     {"pagination",
-                      {{"page", page},
-                       {"limit", limit},
-                       {"total", total},
-                       {"pages", (total + limit - 1) / limit}}}};
-
-    return response.dump();
+    w.endArray();
+
+    w.key("pagination")
+        .beginObject()
+        .field("page", page)
+        .field("limit", limit)
+        .field("total", total)
+        .field("pages", (total + limit - 1) / limit)
+        .endObject();
+    w.endObject();
+    return body;
   } catch (const std::exception &e) {
     LOG_ERROR("Error in handleGetSessions: " + std::string(e.what()));
     json error = {{"error", e.what()}};
@@ -953,7 +987,7 @@ std::string ApiServer::handleGetConnections() {
     }
 
     json response = {{"active_connections", activeConnections},
-                     {"total_active", connMgr.getActiveCount()}};
+                     {"total_active", (int)connections.size()}};
 
     return response.dump();
   } catch (const std::exception &e) {
@@ -1264,37 +1298,31 @@ std::string ApiServer::handleGetMedia(int offset, int limit, int clientId,
     if (offset < 0)
       offset = 0;
 
-    // Get photos with pagination
-    auto photos = db_.getPhotosWithPagination(offset, limit, clientId,
-                                              startDate, endDate, searchQuery);
-
     // Get total count for pagination
     int total =
         db_.getFilteredPhotoCount(clientId, startDate, endDate, searchQuery);
 
-    // Build response
-    json items = json::array();
-    for (const auto &photo : photos) {
-      json item = {
-          {"id", photo.id},
-          {"filename", photo.filename},
-          {"thumbnailUrl", "/api/thumbnails/" + std::to_string(photo.id)},
-          {"fullUrl", "/api/media/" + std::to_string(photo.id) + "/download"},
-          {"mimeType", photo.mimeType},
-          {"size", photo.size},
-          {"uploadedAt", photo.receivedAt},
-          {"clientId", photo.clientId}};
-      items.push_back(item);
+    // Build response, streaming rows straight from the query
+    std::string body;
+    body.reserve(256 + limit * 320);
+    JsonWriter w(body);
+    w.beginObject().key("items").beginArray();
+    if (db_.writeMediaItemsJson(w, offset, limit, clientId, startDate, endDate,
+                                searchQuery) < 0) {
+      json error = {{"error", "Failed to fetch media"}};
+      return error.dump();
     }
-
-    json response = {{"items", items},
-                     {"pagination",
-                      {{"offset", offset},
-                       {"limit", limit},
-                       {"total", total},
-                       {"hasMore", (offset + limit) < total}}}};
-
-    return response.dump();
+    w.endArray();
+
+    w.key("pagination")
+        .beginObject()
+        .field("offset", offset)
+        .field("limit", limit)
+        .field("total", total)
+        .field("hasMore", (offset + limit) < total)
+        .endObject();
+    w.endObject();
+    return body;
   } catch (const std::exception &e) {
     LOG_ERROR("Error in handleGetMedia: " + std::string(e.what()));
     json error = {{"error", "Failed to fetch media"}};
@@ -1303,11 +1331,21 @@ std::string ApiServer::handleGetMedia(int offset, int limit, int clientId,
 }
 
 // GET /api/thumbnails/:id - Serve thumbnail image
-void ApiServer::handleGetThumbnail(crow::response &res, int photoId) {
-  LOG_INFO("Handling thumbnail request for " + std::to_string(photoId));
+void ApiServer::handleGetThumbnail(const crow::request &req,
+                                   crow::response &res, int photoId,
+                                   int requestedSize) {
+  LOG_DEBUGF("Handling thumbnail request for {}", photoId);
   try {
-    // Check if thumbnail exists, generate if not
-    if (!ThumbnailGenerator::thumbnailExists(photoId)) {
+    if (!thumbnails_) {
+      res.code = 503;
+      res.write("Thumbnail service unavailable");
+      return;
+    }
+    ThumbnailStore &store = thumbnails_->store();
+    int size = ThumbnailGenerator::selectRenditionSize(requestedSize);
+
+    // Check if the rendition exists, generate if not
+    if (!store.contains(photoId, size)) {
       // Get photo metadata to find original file
       PhotoMetadata photo = db_.getPhotoById(photoId);
       if (photo.id == -1) {
@@ -1317,13 +1355,10 @@ void ApiServer::handleGetThumbnail(crow::response &res, int photoId) {
         return;
       }
 
-      // Ensure thumbnails directory exists
-      ThumbnailGenerator::ensureThumbnailsDirectory();
-
-      // Generate thumbnail
-      std::string thumbnailPath = ThumbnailGenerator::getThumbnailPath(photoId);
-      if (!ThumbnailGenerator::generateThumbnail(photo.originalPath,
-                                                 thumbnailPath)) {
+      // Render on the background pool at VISIBLE priority so the request
+      // thread only waits, instead of decoding the original itself
+      if (!thumbnails_->requestAndWait(photoId, photo.originalPath,
+                                       std::chrono::seconds(15))) {
         LOG_ERROR("Failed to generate thumbnail for photo ID: " +
                   std::to_string(photoId));
         res.code = 500;
@@ -1332,26 +1367,37 @@ void ApiServer::handleGetThumbnail(crow::response &res, int photoId) {
       }
     }
 
-    // Read and serve thumbnail
-    std::string thumbnailPath = ThumbnailGenerator::getThumbnailPath(photoId);
-    std::ifstream file(thumbnailPath, std::ios::binary);
-    if (!file) {
+    // Revalidation only needs the checksum from the index, not the blob
+    uint64_t checksum = 0;
+    if (!store.getChecksum(photoId, size, checksum)) {
       res.code = 404;
       res.write("Thumbnail not found");
       return;
     }
+    res.add_header("Cache-Control", "public, max-age=86400"); // 24 hours
 
-    // Read file contents
-    std::string content((std::istreambuf_iterator<char>(file)),
-                        std::istreambuf_iterator<char>());
-    file.close();
+    std::string etag = HttpUtils::makeETag(checksum);
+    if (HttpUtils::etagMatches(req.get_header_value("If-None-Match"), etag)) {
+      res.add_header("ETag", etag);
+      res.code = 304;
+      LOG_DEBUGF("Thumbnail not modified for {}", photoId);
+      return;
+    }
+
+    // Read the rendition (from the in-memory LRU when hot). The ETag is taken
+    // from the blob actually read, in case it was re-rendered meanwhile.
+    std::string content;
+    if (!store.get(photoId, size, content, &checksum)) {
+      res.code = 404;
+      res.write("Thumbnail not found");
+      return;
+    }
 
-    // Set headers
+    res.add_header("ETag", HttpUtils::makeETag(checksum));
     res.add_header("Content-Type", "image/jpeg");
-    res.add_header("Cache-Control", "public, max-age=86400"); // 24 hours
     res.code = 200;
-    res.write(content);
-    LOG_INFO("Serving thumbnail for " + std::to_string(photoId));
+    res.body = std::move(content);
+    LOG_DEBUGF("Serving thumbnail for {}", photoId);
 
   } catch (const std::exception &e) {
     LOG_ERROR("Error in handleGetThumbnail: " + std::string(e.what()));
@@ -1360,9 +1406,52 @@ void ApiServer::handleGetThumbnail(crow::response &res, int photoId) {
   }
 }
 
+void ApiServer::deleteAfterSending(const crow::request &req,
+                                   const std::string &path) {
+  {
+    std::lock_guard<std::mutex> lock(g_spoolsMutex);
+    g_sendingSpools.insert(path);
+  }
+  g_app->get_context<SpoolCleanup>(req).file =
+      std::shared_ptr<const std::string>(
+          new std::string(path), [](const std::string *file) {
+            std::error_code ec;
+            std::filesystem::remove(*file, ec);
+            {
+              std::lock_guard<std::mutex> lock(g_spoolsMutex);
+              g_sendingSpools.erase(*file);
+            }
+            delete file;
+          });
+}
+
+void ApiServer::removeStaleSpools(const std::string &dir, int maxAgeMinutes) {
+  std::error_code ec;
+  auto now = std::filesystem::file_time_type::clock::now();
+  std::lock_guard<std::mutex> lock(g_spoolsMutex);
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+    if (g_sendingSpools.count(entry.path().string())) {
+      continue;
+    }
+    auto age = std::chrono::duration_cast<std::chrono::minutes>(
+                   now - entry.last_write_time(ec))
+                   .count();
+    if (!ec && age >= maxAgeMinutes) {
+      std::filesystem::remove(entry.path(), ec);
+    }
+  }
+}
+
 // GET /api/media/:id/download - Serve full-size image
-void ApiServer::handleGetMediaDownload(crow::response &res, int photoId) {
-  LOG_INFO("Handling full image request for " + std::to_string(photoId));
+// Whole files are streamed by Crow from disk. Range requests get exactly the
+// bytes asked for: small slices are read into memory, larger ones are copied
+// to a temp file and streamed from there, so memory per request stays
+// bounded for large videos.
+void ApiServer::handleGetMediaDownload(const crow::request &req,
+                                       crow::response &res, int photoId) {
+  // Range spools older than this were left behind by a crash
+  const int RANGE_SPOOL_MAX_AGE_MINUTES = 60;
+
   try {
     // Get photo metadata
     PhotoMetadata photo = db_.getPhotoById(photoId);
@@ -1372,27 +1461,110 @@ void ApiServer::handleGetMediaDownload(crow::response &res, int photoId) {
       return;
     }
 
-    // Read file
-    std::ifstream file(photo.originalPath, std::ios::binary);
-    if (!file) {
+    std::error_code ec;
+    long long fileSize =
+        (long long)std::filesystem::file_size(photo.originalPath, ec);
+    if (ec) {
       LOG_ERROR("Photo file not found: " + photo.originalPath);
       res.code = 404;
       res.write("Photo file not found");
       return;
     }
 
-    // Read file contents
-    std::string content((std::istreambuf_iterator<char>(file)),
-                        std::istreambuf_iterator<char>());
-    file.close();
+    // Validators: the content hash is a natural strong ETag
+    std::string etag = photo.hash.empty()
+                           ? HttpUtils::makeETag((uint64_t)fileSize)
+                           : "\"" + photo.hash + "\"";
+    std::time_t modified = FileManager::getModifiedTime(photo.originalPath);
 
-    // Set headers
-    res.add_header("Content-Type", photo.mimeType);
+    res.add_header("Accept-Ranges", "bytes");
+    res.add_header("ETag", etag);
+    if (modified > 0) {
+      res.add_header("Last-Modified", HttpUtils::formatHttpDate(modified));
+    }
     res.add_header("Cache-Control", "public, max-age=604800"); // 7 days
+
+    if (HttpUtils::etagMatches(req.get_header_value("If-None-Match"), etag)) {
+      res.code = 304;
+      return;
+    }
+
+    // If-Range: only honour the range if the client's copy is current
+    std::string rangeHeader = req.get_header_value("Range");
+    std::string ifRange = req.get_header_value("If-Range");
+    if (!ifRange.empty() && ifRange != etag) {
+      rangeHeader.clear();
+    }
+
+    HttpUtils::ByteRange range;
+    HttpUtils::RangeResult rangeResult =
+        HttpUtils::parseRange(rangeHeader, fileSize, range);
+
+    if (rangeResult == HttpUtils::RangeResult::UNSATISFIABLE) {
+      res.code = 416;
+      res.add_header("Content-Range", "bytes */" + std::to_string(fileSize));
+      return;
+    }
+
+    if (rangeResult == HttpUtils::RangeResult::SATISFIABLE) {
+      std::string fetchDest = req.get_header_value("Sec-Fetch-Dest");
+      HttpUtils::RangeBody body = HttpUtils::planRangeBody(
+          range, fileSize, fetchDest == "video" || fetchDest == "audio");
+      long long length = range.end - range.start + 1;
+      std::string contentRange = "bytes " + std::to_string(range.start) +
+                                 "-" + std::to_string(range.end) + "/" +
+                                 std::to_string(fileSize);
+
+      if (body == HttpUtils::RangeBody::BUFFER) {
+        std::ifstream file(photo.originalPath, std::ios::binary);
+        std::string content((size_t)length, '\0');
+        if (!file || !file.seekg(range.start) ||
+            !file.read(&content[0], length)) {
+          LOG_ERROR("Failed to read range from " + photo.originalPath);
+          res.code = 500;
+          res.write("Failed to read file");
+          return;
+        }
+        res.body = std::move(content);
+      } else {
+        std::string path = photo.originalPath;
+        if (body == HttpUtils::RangeBody::SPOOL) {
+          std::filesystem::path spoolDir =
+              std::filesystem::path(config_.getTempDir()) / "ranges";
+          std::filesystem::create_directories(spoolDir);
+          removeStaleSpools(spoolDir.string(), RANGE_SPOOL_MAX_AGE_MINUTES);
+          path = (spoolDir / (std::to_string(photoId) + "-" +
+                              std::to_string(g_rangeSpools.fetch_add(1)) +
+                              ".part"))
+                     .string();
+          if (!FileManager::copyRange(photo.originalPath, range.start,
+                                      length, path)) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            LOG_ERROR("Failed to spool range from " + photo.originalPath);
+            res.code = 500;
+            res.write("Failed to read file");
+            return;
+          }
+          deleteAfterSending(req, path);
+        }
+        // Sets Content-Length from the file and the code to 200
+        res.set_static_file_info_unsafe(path);
+      }
+
+      res.code = 206;
+      res.set_header("Content-Type", photo.mimeType);
+      res.add_header("Content-Range", contentRange);
+      LOG_DEBUGF("Serving bytes {}-{} of {}", range.start, range.end,
+                 photoId);
+      return;
+    }
+
+    // Whole file: hand the path to Crow, which streams it in chunks
     res.add_header("Content-Disposition",
                    "inline; filename=\"" + photo.filename + "\"");
-    res.code = 200;
-    res.write(content);
+    res.set_static_file_info_unsafe(photo.originalPath);
+    res.set_header("Content-Type", photo.mimeType);
     LOG_INFO("Serving full image for " + std::to_string(photoId));
 
   } catch (const std::exception &e) {
@@ -1533,6 +1705,10 @@ std::string ApiServer::handleDeleteMedia(int photoId) {
     }
 
     if (db_.softDeletePhoto(photoId)) {
+      // Deleted photos are never served again, so their renditions are dead
+      if (thumbnails_) {
+        thumbnails_->store().remove(photoId);
+      }
       json response = {{"success", true}, {"id", photoId}};
       return response.dump();
     } else {
@@ -1565,34 +1741,23 @@ std::string ApiServer::handleGetChanges(const std::string &cursorStr,
     if (limit > 1000)
       limit = 1000;
 
-    auto changes = db_.getChanges(cursor, limit);
-
-    json items = json::array();
+    std::string body;
+    body.reserve(64 + limit * 320);
+    JsonWriter w(body);
     long long nextCursor = cursor;
 
-    for (const auto &change : changes) {
-      json item = {{"id", change.changeId},
-                   {"op", change.op},
-                   {"mediaId", change.mediaId},
-                   {"blobHash", change.blobHash},
-                   {"changedAt", change.changedAt},
-                   {"data",
-                    {{"filename", change.filename},
-                     {"size", change.size},
-                     {"mimeType", change.mimeType},
-                     {"takenAt", change.takenAt},
-                     {"deviceId", change.deviceId}}}};
-      items.push_back(item);
-      if (change.changeId > nextCursor) {
-        nextCursor = change.changeId;
-      }
+    w.beginObject().key("items").beginArray();
+    int count = db_.writeChangesJson(w, cursor, limit, nextCursor);
+    if (count < 0) {
+      json error = {{"error", "Failed to fetch changes"}};
+      return error.dump();
     }
+    w.endArray();
 
-    json response = {{"items", items},
-                     {"nextCursor", nextCursor},
-                     {"hasMore", (int)changes.size() >= limit}};
-
-    return response.dump();
+    w.field("nextCursor", nextCursor)
+        .field("hasMore", count >= limit)
+        .endObject();
+    return body;
 
   } catch (const std::exception &e) {
     LOG_ERROR("Error in handleGetChanges: " + std::string(e.what()));
@@ -1601,6 +1766,26 @@ std::string ApiServer::handleGetChanges(const std::string &cursorStr,
   }
 }
 
+// GET /api/traces?traceId=<id>&limit=N
+// Spans still held by the trace ring, oldest first. Load the response into
+// chrome://tracing or Perfetto to see where an upload spent its time.
+std::string ApiServer::handleGetTraces(const std::string &traceId, int limit) {
+  try {
+    std::vector<TraceSpan> spans = TraceRecorder::getInstance().snapshot(
+        traceId, limit > 0 ? (size_t)limit : 0);
+
+    std::string body;
+    body.reserve(64 + spans.size() * 160);
+    JsonWriter w(body);
+    TraceRecorder::writeChromeTrace(w, spans);
+    return body;
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error in handleGetTraces: " + std::string(e.what()));
+    json error = {{"error", e.what()}};
+    return error.dump();
+  }
+}
+
 crow::json::wvalue ApiServer::handleGetTopFiles() {
   try {
     auto files = db_.getLargestFiles(50);
@@ -1619,4 +1804,53 @@ crow::json::wvalue ApiServer::handleGetTopFiles() {
     LOG_ERROR("Error in handleGetTopFiles: " + std::string(e.what()));
     return {{"error", e.what()}};
   }
-}
\ No newline at end of file
+}
+
+void ApiServer::handleGetStaticAsset(const crow::request &req,
+                                     crow::response &res,
+                                     const std::string &path) {
+  const StaticAssetCache::Asset *asset =
+      assets_.find(path.empty() ? "index.html" : path);
+
+  // For SPA routing, serve index.html for non-API, non-assets routes
+  if (!asset && path.find("api/") != 0 && path.find("assets/") != 0) {
+    asset = assets_.find("index.html");
+  }
+  if (!asset) {
+    if (assets_.size() == 0) {
+      LOG_ERROR("UI Dashboard not loaded from: " + g_uiPath);
+      res.code = 404;
+      res.body = "UI Dashboard not found";
+      return;
+    }
+    LOG_WARN("File not found: " + g_uiPath + path);
+    res.code = 404;
+    res.body = "Not found";
+    return;
+  }
+
+  StaticAssetCache::Variant variant = StaticAssetCache::select(
+      *asset, req.get_header_value("Accept-Encoding"));
+
+  res.set_header("ETag", variant.etag);
+  // Hashed bundle files never change; everything else (index.html) must be
+  // revalidated so a redeploy is picked up
+  res.set_header("Cache-Control", asset->immutable
+                                      ? "public, max-age=31536000, immutable"
+                                      : "no-cache");
+  if (!asset->gzip.empty() || !asset->brotli.empty()) {
+    res.set_header("Vary", "Accept-Encoding");
+  }
+
+  if (HttpUtils::etagMatches(req.get_header_value("If-None-Match"),
+                             variant.etag)) {
+    res.code = 304;
+    return;
+  }
+
+  res.set_header("Content-Type", asset->contentType);
+  if (variant.encoding) {
+    res.set_header("Content-Encoding", variant.encoding);
+  }
+  res.body = *variant.body;
+}
@@ -3,6 +3,8 @@
 #include "ConfigManager.h"
 #include "DatabaseManager.h"
 #include "IntegrityScanner.h" // Added
+#include "StaticAssetCache.h"
+#include "ThumbnailQueue.h"
 #include <chrono>
 #include <crow.h>
 #include <map>
@@ -14,7 +16,8 @@
 class ApiServer {
 public:
   ApiServer(DatabaseManager &db, ConfigManager &config,
-            IntegrityScanner *scanner = nullptr);
+            IntegrityScanner *scanner = nullptr,
+            ThumbnailQueue *thumbnails = nullptr);
   ~ApiServer();
 
   // Start the API server on specified port
@@ -30,6 +33,8 @@ private:
   DatabaseManager &db_;
   ConfigManager &config_;
   IntegrityScanner *scanner_; // Added
+  ThumbnailQueue *thumbnails_;
+  StaticAssetCache assets_;
   bool running_;
   std::chrono::system_clock::time_point startTime_;
 
@@ -73,6 +78,7 @@ private:
 
   // Phase 4: Sync Feed
   std::string handleGetChanges(const std::string &cursorStr, int limit);
+  std::string handleGetTraces(const std::string &traceId, int limit);
 
   // Media grid endpoints
   std::string handleGetMedia(int offset, int limit, int clientId,
@@ -80,18 +86,32 @@ private:
                              const std::string &endDate,
                              const std::string &searchQuery = "");
   std::string handleDeleteMedia(int photoId);
-  void handleGetThumbnail(crow::response &res, int photoId);
-  void handleGetMediaDownload(crow::response &res, int photoId);
+  void handleGetThumbnail(const crow::request &req, crow::response &res,
+                          int photoId, int requestedSize);
+  void handleGetMediaDownload(const crow::request &req, crow::response &res,
+                              int photoId);
+  void handleGetExport(crow::response &res, int clientId,
+                       const std::string &startDate,
+                       const std::string &endDate,
+                       const std::string &searchQuery);
+  void handleGetStaticAsset(const crow::request &req, crow::response &res,
+                            const std::string &path);
+  // Bodies too large for memory (export archives, big byte ranges) are
+  // spooled to a temp file and sent through Crow's static-file path. The
+  // file is deleted once the response has been sent.
+  void deleteAfterSending(const crow::request &req, const std::string &path);
+  // Delete files in dir older than maxAgeMinutes, skipping any still being
+  // sent; catches spools left behind by a crash
+  static void removeStaleSpools(const std::string &dir, int maxAgeMinutes);
   std::string handlePostGenerateToken(const crow::request &req);
   std::string handlePostRegenerateThumbnails(const crow::request &req);
 
   // Phase 6: Ops
   // Phase 6: Ops
   // Updated handleGetErrors signature to match implementation plans
-  crow::json::wvalue handleGetErrors(int limit, int offset,
-                                     const std::string &level,
-                                     const std::string &deviceId,
-                                     const std::string &since);
+  std::string handleGetErrors(int limit, int offset, const std::string &level,
+                              const std::string &deviceId,
+                              const std::string &since);
   crow::json::wvalue handleGetIntegrityStatus();
   crow::json::wvalue handleGetTopFiles();
   crow::json::wvalue handleGetHealth();
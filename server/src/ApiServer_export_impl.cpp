@@ -0,0 +1,187 @@
+#include "ApiServer.h"
+#include "FileManager.h"
+#include "Logger.h"
+#include "TarWriter.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Archives are deleted once sent; any older than this that are not being
+// sent (left by a crash) are removed before a new one is built
+const int EXPORT_MAX_AGE_MINUTES = 60;
+// Metadata rows fetched per keyset page
+const int EXPORT_PAGE_SIZE = 500;
+
+// Keep archive entries inside their client folder
+std::string sanitizeName(const std::string &filename) {
+  std::string name = filename.empty() ? "unnamed" : filename;
+  for (char &c : name) {
+    if (c == '/' || c == '\\' || c == ':') {
+      c = '_';
+    }
+  }
+  if (name == "." || name == "..") {
+    name = "_";
+  }
+  return name;
+}
+
+} // namespace
+
+// GET /api/export - Bulk export as tar
+// Crow has no streamed or chunked body API, only its static-file path, so the
+// archive is spooled to the temp directory through TarWriter's fixed buffer
+// and handed to Crow as a file. Neither step holds more than one buffer in
+// memory. The route hands the file to the SpoolCleanup middleware, which
+// deletes it after the transfer.
+// The archive size is worked out from the file sizes before anything is
+// written: exports over export.max_size_gb get 413, and exports that would
+// not fit in the temp volume's free space get 507, instead of failing after
+// the client has waited for most of the archive to be built.
+void ApiServer::handleGetExport(crow::response &res, int clientId,
+                                const std::string &startDate,
+                                const std::string &endDate,
+                                const std::string &searchQuery) {
+  try {
+    fs::path exportDir = fs::path(config_.getTempDir()) / "exports";
+    fs::create_directories(exportDir);
+    removeStaleSpools(exportDir.string(), EXPORT_MAX_AGE_MINUTES);
+
+    long long archiveSize = TarWriter::TRAILER_SIZE;
+    for (int beforeId = 0;;) {
+      std::vector<PhotoMetadata> page =
+          db_.getPhotosBeforeId(beforeId, EXPORT_PAGE_SIZE, clientId,
+                                startDate, endDate, searchQuery);
+      if (page.empty()) {
+        break;
+      }
+      for (const PhotoMetadata &photo : page) {
+        std::error_code ec;
+        long long size = (long long)fs::file_size(photo.originalPath, ec);
+        if (!ec) {
+          // Sized with the id prefix a duplicate name gets
+          archiveSize += TarWriter::entrySize(
+              "client-" + std::to_string(photo.clientId) + "/" +
+                  std::to_string(photo.id) + "-" +
+                  sanitizeName(photo.filename),
+              size);
+        }
+      }
+      beforeId = page.back().id;
+    }
+
+    long long maxBytes = (long long)config_.getExportMaxGB() * 1024 * 1024 *
+                         1024;
+    if (maxBytes > 0 && archiveSize > maxBytes) {
+      LOG_WARN("Export refused: " + std::to_string(archiveSize) +
+               " bytes is over export.max_size_gb");
+      res.code = 413;
+      res.write("Export would be " +
+                std::to_string(archiveSize / (1024 * 1024)) +
+                " MB, over the " + std::to_string(config_.getExportMaxGB()) +
+                " GB export limit; narrow the date range or client");
+      return;
+    }
+    if (!FileManager::hasFreeSpace(exportDir.string(), archiveSize)) {
+      LOG_WARN("Export refused: not enough free space in " +
+               exportDir.string() + " for " + std::to_string(archiveSize) +
+               " bytes");
+      res.code = 507;
+      res.write("Not enough free disk space on the server to build a " +
+                std::to_string(archiveSize / (1024 * 1024)) + " MB export");
+      return;
+    }
+
+    auto now = std::chrono::system_clock::now();
+    std::time_t nowTime = std::chrono::system_clock::to_time_t(now);
+    std::random_device rd;
+    std::string archiveName = "photosync-export-" +
+                              std::to_string((long long)nowTime) + "-" +
+                              std::to_string(rd() % 100000) + ".tar";
+    fs::path archivePath = exportDir / archiveName;
+
+    std::ofstream out(archivePath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      LOG_ERROR("Export: cannot create " + archivePath.string());
+      res.code = 500;
+      res.write("Failed to create export");
+      return;
+    }
+
+    TarWriter tar(out);
+    std::set<std::string> usedNames;
+    int exported = 0;
+    int skipped = 0;
+    int beforeId = 0;
+
+    while (true) {
+      std::vector<PhotoMetadata> page =
+          db_.getPhotosBeforeId(beforeId, EXPORT_PAGE_SIZE, clientId,
+                                startDate, endDate, searchQuery);
+      if (page.empty()) {
+        break;
+      }
+
+      for (const PhotoMetadata &photo : page) {
+        std::error_code ec;
+        long long size = (long long)fs::file_size(photo.originalPath, ec);
+        if (ec) {
+          LOG_WARN("Export: skipping missing file " + photo.originalPath);
+          skipped++;
+          continue;
+        }
+
+        std::string folder = "client-" + std::to_string(photo.clientId) + "/";
+        std::string entryName = folder + sanitizeName(photo.filename);
+        if (!usedNames.insert(entryName).second) {
+          entryName = folder + std::to_string(photo.id) + "-" +
+                      sanitizeName(photo.filename);
+          usedNames.insert(entryName);
+        }
+
+        if (!tar.addFile(entryName, photo.originalPath, size,
+                         FileManager::getModifiedTime(photo.originalPath))) {
+          LOG_ERROR("Export: failed writing " + entryName);
+          out.close();
+          fs::remove(archivePath, ec);
+          res.code = 500;
+          res.write("Failed to write export");
+          return;
+        }
+        exported++;
+      }
+      beforeId = page.back().id;
+    }
+
+    if (!tar.finish()) {
+      std::error_code ec;
+      out.close();
+      fs::remove(archivePath, ec);
+      res.code = 500;
+      res.write("Failed to write export");
+      return;
+    }
+    out.close();
+
+    LOG_INFO("Export built: " + std::to_string(exported) + " files, " +
+             std::to_string(skipped) + " skipped, " +
+             std::to_string(tar.bytesWritten()) + " bytes");
+
+    res.set_static_file_info_unsafe(archivePath.string());
+    res.set_header("Content-Type", "application/x-tar");
+    res.add_header("Content-Disposition",
+                   "attachment; filename=\"" + archiveName + "\"");
+    res.add_header("X-Export-Count", std::to_string(exported));
+
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error in handleGetExport: " + std::string(e.what()));
+    res.code = 500;
+    res.write("Internal server error");
+  }
+}
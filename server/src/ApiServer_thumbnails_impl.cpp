@@ -1,16 +1,11 @@
 
 #include "ApiServer.h"
 #include "Logger.h"
-#include "ThumbnailGenerator.h"
-#include <filesystem>
 #include <iostream>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
-namespace fs = std::filesystem;
-using json = nlohmann::json;
-
 std::string
 ApiServer::handlePostRegenerateThumbnails(const crow::request &req) {
   try {
@@ -25,47 +20,39 @@ ApiServer::handlePostRegenerateThumbnails(const crow::request &req) {
     auto requestData = json::parse(requestBody);
 
     if (requestData.contains("all") && requestData["all"].get<bool>()) {
-      // Regenerate all logic - for now, we don't have a specific "get all IDs"
-      // exposed easily without massive query. But we can iterate over cache
-      // directory and delete everything strictly speaking, but that doesn't
-      // respect the DB. Better: Iterate all cache files in thumbnails dir and
-      // delete them.
-      try {
-        std::string thumbDir =
-            "./storage/thumbnails"; // Matches ThumbnailGenerator.cpp
-
-        if (fs::exists(thumbDir)) {
-          for (const auto &entry : fs::directory_iterator(thumbDir)) {
-            fs::remove(entry.path());
+      // Queue a rebuild of every live photo. Existing thumbnails keep being
+      // served until their replacement is rendered.
+      if (thumbnails_) {
+        int queued = 0;
+        for (const auto &photo : db_.getAllPhotos()) {
+          if (!photo.deletedAt.empty())
+            continue;
+          if (thumbnails_->enqueue(photo.id, photo.originalPath,
+                                   ThumbnailQueue::Priority::REBUILD, true)) {
+            queued++;
           }
         }
-
-        // Always return success even if directory didn't match, as state is
-        // "cleared"
-        // Always return success even if directory didn't match, as state is
-        // "cleared"
+        LOG_INFO("Queued " + std::to_string(queued) + " thumbnail rebuilds");
         return json({{"success", true},
-                     {"message", "All thumbnails cleared. They will be "
-                                 "regenerated on demand."}})
-            .dump();
-
-      } catch (const std::exception &e) {
-        return json({{"error",
-                      "Failed to clear cache: " + std::string(e.what())}})
+                     {"queued", queued},
+                     {"message", "Queued " + std::to_string(queued) +
+                                     " thumbnails for rebuild."}})
             .dump();
       }
+
+      return json({{"error", "Thumbnail service unavailable"}}).dump();
     }
 
     if (requestData.contains("photoId")) {
       int photoId = requestData["photoId"];
-      std::string path = ThumbnailGenerator::getThumbnailPath(photoId);
-      if (fs::exists(path)) {
-        fs::remove(path);
-      }
       // Trigger generation immediately
       PhotoMetadata photo = db_.getPhotoById(photoId);
       if (photo.id != -1) {
-        if (ThumbnailGenerator::generateThumbnail(photo.originalPath, path)) {
+        if (!thumbnails_) {
+          return json({{"error", "Thumbnail service unavailable"}}).dump();
+        }
+        if (thumbnails_->requestAndWait(photoId, photo.originalPath,
+                                        std::chrono::seconds(30), true)) {
           return json({{"success", true}, {"message", "Thumbnail regenerated"}})
               .dump();
         } else {
@@ -0,0 +1,78 @@
+#include "Compression.h"
+#include <cstdint>
+#include <zlib.h>
+
+#ifdef PHOTOSYNC_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace {
+
+bool zlibCompress(const std::string &input, std::string &output, int level,
+                  int windowBits) {
+  output.clear();
+  z_stream stream{};
+  if (deflateInit2(&stream, level, Z_DEFLATED, windowBits, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+
+  output.resize(deflateBound(&stream, (uLong)input.size()));
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  stream.avail_in = (uInt)input.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+  stream.avail_out = (uInt)output.size();
+
+  int result = ::deflate(&stream, Z_FINISH);
+  output.resize(stream.total_out);
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    output.clear();
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool Compression::gzip(const std::string &input, std::string &output,
+                       int level) {
+  // windowBits 15 + 16 selects the gzip wrapper
+  return zlibCompress(input, output, level, 15 + 16);
+}
+
+bool Compression::deflate(const std::string &input, std::string &output,
+                          int level) {
+  return zlibCompress(input, output, level, 15);
+}
+
+bool Compression::brotli(const std::string &input, std::string &output) {
+  output.clear();
+#ifdef PHOTOSYNC_HAVE_BROTLI
+  size_t encodedSize = BrotliEncoderMaxCompressedSize(input.size());
+  if (encodedSize == 0) {
+    return false;
+  }
+  output.resize(encodedSize);
+  if (!BrotliEncoderCompress(
+          BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC,
+          input.size(), reinterpret_cast<const uint8_t *>(input.data()),
+          &encodedSize, reinterpret_cast<uint8_t *>(&output[0]))) {
+    output.clear();
+    return false;
+  }
+  output.resize(encodedSize);
+  return true;
+#else
+  (void)input;
+  return false;
+#endif
+}
+
+bool Compression::brotliAvailable() {
+#ifdef PHOTOSYNC_HAVE_BROTLI
+  return true;
+#else
+  return false;
+#endif
+}
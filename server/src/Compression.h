@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+// One-shot in-memory encoders for HTTP content codings.
+// Each returns false (and leaves output empty) if the encoder fails or, for
+// brotli, if the server was built without it.
+class Compression {
+public:
+  // zlib levels: 1 is fastest, 9 is smallest
+  static constexpr int FAST_LEVEL = 1;
+  static constexpr int BEST_LEVEL = 9;
+
+  // "gzip" content coding (RFC 1952)
+  static bool gzip(const std::string &input, std::string &output,
+                   int level = BEST_LEVEL);
+
+  // "deflate" content coding, which HTTP defines as the zlib format (RFC 1950)
+  static bool deflate(const std::string &input, std::string &output,
+                      int level = BEST_LEVEL);
+
+  // "br" content coding at maximum quality; meant for precomputed variants
+  static bool brotli(const std::string &input, std::string &output);
+
+  static bool brotliAvailable();
+};
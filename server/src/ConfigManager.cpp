@@ -115,6 +115,16 @@ std::string ConfigManager::getServerName() const {
   return (it != config_.end()) ? it->second : DEFAULT_SERVER_NAME;
 }
 
+int ConfigManager::getLogMaxFileMB() const {
+  auto it = config_.find("logging.max_file_mb");
+  return (it != config_.end()) ? std::stoi(it->second) : 10;
+}
+
+int ConfigManager::getLogMaxFiles() const {
+  auto it = config_.find("logging.max_files");
+  return (it != config_.end()) ? std::stoi(it->second) : 5;
+}
+
 bool ConfigManager::getConsoleOutput() const {
   auto it = config_.find("logging.console_output");
   if (it != config_.end()) {
@@ -194,3 +204,129 @@ int ConfigManager::getDeletedRetentionDays() const {
   auto it = config_.find("retention.deleted_retention_days");
   return (it != config_.end()) ? std::stoi(it->second) : 30;
 }
+
+// Thumbnails
+int ConfigManager::getThumbnailWorkerThreads() const {
+  auto it = config_.find("thumbnails.worker_threads");
+  return (it != config_.end()) ? std::stoi(it->second) : 2;
+}
+
+std::string ConfigManager::getThumbnailsDir() const {
+  auto it = config_.find("thumbnails.dir");
+  return (it != config_.end()) ? it->second : DEFAULT_THUMBNAILS_DIR;
+}
+
+int ConfigManager::getThumbnailSegmentSizeMB() const {
+  auto it = config_.find("thumbnails.segment_size_mb");
+  return (it != config_.end()) ? std::stoi(it->second) : 256;
+}
+
+int ConfigManager::getThumbnailCacheMB() const {
+  auto it = config_.find("thumbnails.cache_mb");
+  return (it != config_.end()) ? std::stoi(it->second) : 64;
+}
+
+bool ConfigManager::getMetricsPublic() const {
+  auto it = config_.find("metrics.public");
+  if (it != config_.end()) {
+    std::string value = it->second;
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return (value == "true" || value == "1" || value == "yes");
+  }
+  return false;
+}
+
+int ConfigManager::getUploadWindowMB() const {
+  auto it = config_.find("upload.window_mb");
+  return (it != config_.end()) ? std::stoi(it->second) : 8;
+}
+
+int ConfigManager::getUploadAckEveryChunks() const {
+  auto it = config_.find("upload.ack_every_chunks");
+  return (it != config_.end()) ? std::stoi(it->second) : 4;
+}
+
+int ConfigManager::getUploadMaxConcurrent() const {
+  auto it = config_.find("upload.max_concurrent");
+  return (it != config_.end()) ? std::stoi(it->second) : 8;
+}
+
+int ConfigManager::getUploadInlineMaxKB() const {
+  auto it = config_.find("upload.inline_max_kb");
+  return (it != config_.end()) ? std::stoi(it->second) : 1024;
+}
+
+std::string ConfigManager::getTlsCertificateFile() const {
+  auto it = config_.find("tls.certificate_file");
+  return (it != config_.end()) ? it->second : "server.crt";
+}
+
+std::string ConfigManager::getTlsPrivateKeyFile() const {
+  auto it = config_.find("tls.private_key_file");
+  return (it != config_.end()) ? it->second : "server.key";
+}
+
+bool ConfigManager::getTlsSessionTickets() const {
+  auto it = config_.find("tls.session_tickets");
+  if (it != config_.end()) {
+    std::string value = it->second;
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return (value == "true" || value == "1" || value == "yes");
+  }
+  return true;
+}
+
+int ConfigManager::getTlsSessionCacheSize() const {
+  auto it = config_.find("tls.session_cache_size");
+  return (it != config_.end()) ? std::stoi(it->second) : 20480;
+}
+
+int ConfigManager::getTlsSessionTimeoutSec() const {
+  auto it = config_.find("tls.session_timeout_sec");
+  return (it != config_.end()) ? std::stoi(it->second) : 86400;
+}
+
+std::string ConfigManager::getTlsMinVersion() const {
+  auto it = config_.find("tls.min_version");
+  return (it != config_.end()) ? it->second : "1.2";
+}
+
+std::string ConfigManager::getTlsCipherPreference() const {
+  auto it = config_.find("tls.cipher_preference");
+  return (it != config_.end()) ? it->second : "auto";
+}
+
+bool ConfigManager::getTlsKernelReceive() const {
+  auto it = config_.find("tls.kernel_receive");
+  if (it != config_.end()) {
+    std::string value = it->second;
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return (value == "true" || value == "1" || value == "yes");
+  }
+  return false;
+}
+
+int ConfigManager::getBandwidthGlobalMBps() const {
+  auto it = config_.find("bandwidth.global_mb_per_sec");
+  return (it != config_.end()) ? std::stoi(it->second) : 0;
+}
+
+int ConfigManager::getBandwidthDeviceMBps() const {
+  auto it = config_.find("bandwidth.device_mb_per_sec");
+  return (it != config_.end()) ? std::stoi(it->second) : 0;
+}
+
+int ConfigManager::getBandwidthSmallUploadMB() const {
+  auto it = config_.find("bandwidth.small_upload_mb");
+  return (it != config_.end()) ? std::stoi(it->second) : 16;
+}
+
+int ConfigManager::getBandwidthSmallUploadWeight() const {
+  auto it = config_.find("bandwidth.small_upload_weight");
+  return (it != config_.end()) ? std::stoi(it->second) : 4;
+}
+
+int ConfigManager::getExportMaxGB() const {
+  auto it = config_.find("export.max_size_gb");
+  return (it != config_.end()) ? std::stoi(it->second) : 0;
+}
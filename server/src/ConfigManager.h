@@ -21,6 +21,8 @@ public:
   std::string getLogFile() const;
   std::string getServerName() const;
   bool getConsoleOutput() const;
+  int getLogMaxFileMB() const;
+  int getLogMaxFiles() const;
 
   // Authentication settings
   int getSessionTimeoutSeconds() const;
@@ -40,6 +42,40 @@ public:
   int getIntegrityOrphanSampleSize() const;
   int getDeletedRetentionDays() const;
 
+  // Thumbnails
+  int getThumbnailWorkerThreads() const;
+  std::string getThumbnailsDir() const;
+  int getThumbnailSegmentSizeMB() const;
+  int getThumbnailCacheMB() const;
+
+  // Metrics
+  bool getMetricsPublic() const;
+
+  // Uploads (protocol V2)
+  int getUploadWindowMB() const;
+  int getUploadAckEveryChunks() const;
+  int getUploadMaxConcurrent() const;
+  int getUploadInlineMaxKB() const;
+
+  // TLS (upload listener)
+  std::string getTlsCertificateFile() const;
+  std::string getTlsPrivateKeyFile() const;
+  bool getTlsSessionTickets() const;
+  int getTlsSessionCacheSize() const;
+  int getTlsSessionTimeoutSec() const;
+  std::string getTlsMinVersion() const;
+  std::string getTlsCipherPreference() const;
+  bool getTlsKernelReceive() const;
+
+  // Upload bandwidth sharing between devices
+  int getBandwidthGlobalMBps() const;
+  int getBandwidthDeviceMBps() const;
+  int getBandwidthSmallUploadMB() const;
+  int getBandwidthSmallUploadWeight() const;
+
+  // Export settings
+  int getExportMaxGB() const;
+
 private:
   ConfigManager() = default;
   ConfigManager(const ConfigManager &) = delete;
@@ -56,6 +92,7 @@ private:
   const int DEFAULT_TIMEOUT = 300;
   const std::string DEFAULT_PHOTOS_DIR = "./storage/photos";
   const std::string DEFAULT_TEMP_DIR = "./storage/temp";
+  const std::string DEFAULT_THUMBNAILS_DIR = "./storage/thumbnails";
   const int DEFAULT_MAX_STORAGE_GB = 100;
   const std::string DEFAULT_DB_PATH = "./photosync.db";
   const std::string DEFAULT_LOG_LEVEL = "INFO";
@@ -1,77 +1,130 @@
 #include "ConnectionManager.h"
 
-ConnectionManager &ConnectionManager::getInstance() {
-  static ConnectionManager instance;
-  return instance;
+long long ConnectionStats::nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
 }
 
-void ConnectionManager::addConnection(int sessionId,
-                                      const std::string &deviceId,
-                                      const std::string &ipAddress,
-                                      const std::string &userName) {
-  std::lock_guard<std::mutex> lock(mutex_);
+const char *ConnectionStats::statusName(int status) {
+  switch (status) {
+  case SYNCING:
+    return "syncing";
+  case IDLE:
+    return "idle";
+  default:
+    return "handshake";
+  }
+}
 
+ConnectionInfo ConnectionStats::snapshot() const {
   ConnectionInfo info;
   info.sessionId = sessionId;
   info.deviceId = deviceId;
   info.userName = userName;
   info.ipAddress = ipAddress;
-  info.connectedAt = std::chrono::system_clock::now();
-  info.status = "handshake";
-  info.photosUploaded = 0;
-  info.bytesTransferred = 0;
-  info.lastActivity = std::chrono::system_clock::now();
+  info.connectedAt = connectedAt;
+  info.status = statusName(status.load(std::memory_order_relaxed));
+  info.photosUploaded = photosUploaded.load(std::memory_order_relaxed);
+  info.bytesTransferred = bytesTransferred.load(std::memory_order_relaxed);
+  info.lastActivity = std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::milliseconds(
+              lastActivityMs.load(std::memory_order_relaxed))));
+  return info;
+}
 
-  connections_[sessionId] = info;
+ConnectionManager &ConnectionManager::getInstance() {
+  static ConnectionManager instance;
+  return instance;
+}
+
+ConnectionManager::ConnectionManager()
+    : registry_(std::make_shared<const Registry>()) {}
+
+std::shared_ptr<const ConnectionManager::Registry>
+ConnectionManager::snapshot() const {
+  return std::atomic_load(&registry_);
+}
+
+std::shared_ptr<ConnectionStats> ConnectionManager::find(int sessionId) const {
+  auto registry = snapshot();
+  auto it = registry->find(sessionId);
+  return it != registry->end() ? it->second : nullptr;
+}
+
+std::shared_ptr<ConnectionStats>
+ConnectionManager::addConnection(int sessionId, const std::string &deviceId,
+                                 const std::string &ipAddress,
+                                 const std::string &userName) {
+  auto stats = std::make_shared<ConnectionStats>();
+  stats->sessionId = sessionId;
+  stats->deviceId = deviceId;
+  stats->userName = userName;
+  stats->ipAddress = ipAddress;
+  stats->connectedAt = std::chrono::system_clock::now();
+  stats->touch();
+
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  auto next = std::make_shared<Registry>(*std::atomic_load(&registry_));
+  (*next)[sessionId] = stats;
+  std::atomic_store(&registry_, std::shared_ptr<const Registry>(next));
+  return stats;
 }
 
 void ConnectionManager::removeConnection(int sessionId) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  connections_.erase(sessionId);
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  auto current = std::atomic_load(&registry_);
+  if (current->find(sessionId) == current->end()) {
+    return;
+  }
+  auto next = std::make_shared<Registry>(*current);
+  next->erase(sessionId);
+  std::atomic_store(&registry_, std::shared_ptr<const Registry>(next));
 }
 
 void ConnectionManager::updateStatus(int sessionId, const std::string &status) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto it = connections_.find(sessionId);
-  if (it != connections_.end()) {
-    it->second.status = status;
-    it->second.lastActivity = std::chrono::system_clock::now();
+  if (auto stats = find(sessionId)) {
+    if (status == "syncing") {
+      stats->setStatus(ConnectionStats::SYNCING);
+    } else if (status == "idle") {
+      stats->setStatus(ConnectionStats::IDLE);
+    } else {
+      stats->setStatus(ConnectionStats::HANDSHAKE);
+    }
   }
 }
 
 void ConnectionManager::updateProgress(int sessionId, int photosUploaded,
                                        long long bytesTransferred) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto it = connections_.find(sessionId);
-  if (it != connections_.end()) {
-    it->second.photosUploaded = photosUploaded;
-    it->second.bytesTransferred = bytesTransferred;
-    it->second.lastActivity = std::chrono::system_clock::now();
+  if (auto stats = find(sessionId)) {
+    stats->photosUploaded.store(photosUploaded, std::memory_order_relaxed);
+    stats->bytesTransferred.store(bytesTransferred, std::memory_order_relaxed);
+    stats->touch();
   }
 }
 
 void ConnectionManager::updateActivity(int sessionId) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto it = connections_.find(sessionId);
-  if (it != connections_.end()) {
-    it->second.lastActivity = std::chrono::system_clock::now();
+  if (auto stats = find(sessionId)) {
+    stats->touch();
   }
 }
 
 std::map<int, ConnectionInfo> ConnectionManager::getActiveConnections() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return connections_;
+  std::map<int, ConnectionInfo> connections;
+  for (const auto &[sessionId, stats] : *snapshot()) {
+    connections.emplace(sessionId, stats->snapshot());
+  }
+  return connections;
 }
 
 int ConnectionManager::getActiveCount() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return static_cast<int>(connections_.size());
+  return static_cast<int>(snapshot()->size());
 }
 
 bool ConnectionManager::isClientConnected(const std::string &deviceId) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  for (const auto &pair : connections_) {
-    if (pair.second.deviceId == deviceId) {
+  for (const auto &pair : *snapshot()) {
+    if (pair.second->deviceId == deviceId) {
       return true;
     }
   }
@@ -79,19 +132,34 @@ bool ConnectionManager::isClientConnected(const std::string &deviceId) {
 }
 
 std::vector<int> ConnectionManager::cleanStaleConnections(int timeoutSeconds) {
-  std::lock_guard<std::mutex> lock(mutex_);
   std::vector<int> removedSessions;
-  auto now = std::chrono::system_clock::now();
+  long long cutoff = ConnectionStats::nowMs() - timeoutSeconds * 1000LL;
+  auto isStale = [cutoff](const std::shared_ptr<ConnectionStats> &stats) {
+    return stats->lastActivityMs.load(std::memory_order_relaxed) < cutoff;
+  };
+
+  // Scan without the write lock first; most calls find nothing to remove
+  bool anyStale = false;
+  for (const auto &pair : *snapshot()) {
+    if (isStale(pair.second)) {
+      anyStale = true;
+      break;
+    }
+  }
+  if (!anyStale) {
+    return removedSessions;
+  }
 
-  for (auto it = connections_.begin(); it != connections_.end();) {
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(
-        now - it->second.lastActivity);
-    if (duration.count() > timeoutSeconds) {
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  auto next = std::make_shared<Registry>(*std::atomic_load(&registry_));
+  for (auto it = next->begin(); it != next->end();) {
+    if (isStale(it->second)) {
       removedSessions.push_back(it->first);
-      it = connections_.erase(it);
+      it = next->erase(it);
     } else {
       ++it;
     }
   }
+  std::atomic_store(&registry_, std::shared_ptr<const Registry>(next));
   return removedSessions;
 }
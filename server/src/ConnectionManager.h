@@ -1,11 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
 
+// Point-in-time copy of a connection, as returned to the REST handlers
 struct ConnectionInfo {
   int sessionId;
   std::string deviceId;
@@ -18,29 +21,85 @@ struct ConnectionInfo {
   std::chrono::system_clock::time_point lastActivity;
 };
 
+// Live telemetry of one connection. The owning Session holds a handle and
+// bumps the counters directly with relaxed atomics, so the upload path never
+// takes a lock; readers may see counters from slightly different instants.
+struct ConnectionStats {
+  enum Status : int { HANDSHAKE = 0, SYNCING = 1, IDLE = 2 };
+
+  // Fixed at registration
+  int sessionId = 0;
+  std::string deviceId;
+  std::string userName;
+  std::string ipAddress;
+  std::chrono::system_clock::time_point connectedAt;
+
+  std::atomic<int> status{HANDSHAKE};
+  std::atomic<int> photosUploaded{0};
+  std::atomic<long long> bytesTransferred{0};
+  std::atomic<long long> lastActivityMs{0}; // system_clock, ms since epoch
+
+  void addBytes(long long bytes) {
+    bytesTransferred.fetch_add(bytes, std::memory_order_relaxed);
+    touch();
+  }
+  void addPhoto() {
+    photosUploaded.fetch_add(1, std::memory_order_relaxed);
+    touch();
+  }
+  void setStatus(Status value) {
+    status.store(value, std::memory_order_relaxed);
+    touch();
+  }
+  void touch() {
+    lastActivityMs.store(nowMs(), std::memory_order_relaxed);
+  }
+
+  ConnectionInfo snapshot() const;
+
+  static long long nowMs();
+  static const char *statusName(int status);
+};
+
+// Registry of live connections. Registration and removal (rare) copy the
+// map and publish it atomically; readers grab the current map without
+// blocking writers or each other.
 class ConnectionManager {
 public:
+  using Registry = std::map<int, std::shared_ptr<ConnectionStats>>;
+
   static ConnectionManager &getInstance();
 
-  void addConnection(int sessionId, const std::string &deviceId,
-                     const std::string &ipAddress, const std::string &userName);
+  // Returns the handle the session updates for the rest of its life
+  std::shared_ptr<ConnectionStats> addConnection(int sessionId,
+                                                 const std::string &deviceId,
+                                                 const std::string &ipAddress,
+                                                 const std::string &userName);
   void removeConnection(int sessionId);
+
+  // Lookup-by-id variants for callers without a handle
   void updateStatus(int sessionId, const std::string &status);
   void updateProgress(int sessionId, int photosUploaded,
                       long long bytesTransferred);
   void updateActivity(int sessionId);
 
+  // Current registry; never blocks and stays valid while held
+  std::shared_ptr<const Registry> snapshot() const;
+
   std::map<int, ConnectionInfo> getActiveConnections();
   int getActiveCount();
   bool isClientConnected(const std::string &deviceId);
   std::vector<int> cleanStaleConnections(int timeoutSeconds);
 
 private:
-  ConnectionManager() = default;
+  ConnectionManager();
   ~ConnectionManager() = default;
   ConnectionManager(const ConnectionManager &) = delete;
   ConnectionManager &operator=(const ConnectionManager &) = delete;
 
-  std::map<int, ConnectionInfo> connections_;
-  std::mutex mutex_;
+  std::shared_ptr<ConnectionStats> find(int sessionId) const;
+
+  // Read with std::atomic_load, replaced with std::atomic_store
+  std::shared_ptr<const Registry> registry_;
+  std::mutex writeMutex_; // Serializes copy-and-publish updates
 };
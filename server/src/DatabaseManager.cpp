@@ -1,6 +1,7 @@
 #include "DatabaseManager.h"
 #include "AuthenticationManager.h"
 #include "Logger.h"
+#include "MetricsRegistry.h"
 #include <chrono>
 #include <cmath>
 #include <ctime>
@@ -690,6 +691,11 @@ void DatabaseManager::updateSessionPhotoCount(int sessionId, int photoCount) {
 
 bool DatabaseManager::insertPhoto(int clientId, const PhotoMetadata &photo,
                                   const std::string &filePath) {
+  static Histogram &insertLatency = MetricsRegistry::getInstance().histogram(
+      "photosync_db_seconds", "SQLite statement latency by operation",
+      {{"op", "insert_photo"}});
+  ScopedTimer timer(insertLatency);
+
   // Check if photo already exists
   if (photoExists(photo.hash)) {
     LOG_DEBUG("Photo already exists: " + photo.hash);
@@ -782,6 +788,25 @@ bool DatabaseManager::photoExists(const std::string &hash) {
   return exists;
 }
 
+int DatabaseManager::getPhotoIdByHash(const std::string &hash) {
+  sqlite3_stmt *stmt;
+  const char *sql = "SELECT id FROM metadata WHERE hash = ? LIMIT 1";
+
+  if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    return -1;
+  }
+
+  sqlite3_bind_text(stmt, 1, hash.c_str(), -1, SQLITE_TRANSIENT);
+
+  int photoId = -1;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    photoId = sqlite3_column_int(stmt, 0);
+  }
+
+  sqlite3_finalize(stmt);
+  return photoId;
+}
+
 int DatabaseManager::getPhotoCount(int clientId) {
   sqlite3_stmt *stmt;
   const char *sql = "SELECT COUNT(*) FROM metadata WHERE client_id = ?";
@@ -1555,6 +1580,90 @@ std::vector<PhotoMetadata> DatabaseManager::getPhotosWithPagination(
   return photos;
 }
 
+std::vector<PhotoMetadata> DatabaseManager::getPhotosBeforeId(
+    int beforeId, int limit, int clientId, const std::string &startDate,
+    const std::string &endDate, const std::string &searchQuery) {
+
+  std::vector<PhotoMetadata> photos;
+
+  std::string sql = R"(
+    SELECT id, filename, hash, size, original_path, client_id, received_at, taken_at
+    FROM metadata
+    WHERE deleted_at IS NULL
+  )";
+  if (beforeId > 0)
+    sql += " AND id < ?";
+  if (clientId >= 0)
+    sql += " AND client_id = ?";
+  if (!startDate.empty())
+    sql += " AND received_at >= ?";
+  if (!endDate.empty())
+    sql += " AND received_at <= ?";
+  if (!searchQuery.empty())
+    sql += " AND filename LIKE ?";
+  sql += " ORDER BY id DESC LIMIT ?";
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    LOG_ERROR("Failed to prepare getPhotosBeforeId statement: " +
+              std::string(sqlite3_errmsg(db_)));
+    return photos;
+  }
+
+  int index = 1;
+  if (beforeId > 0)
+    sqlite3_bind_int(stmt, index++, beforeId);
+  if (clientId >= 0)
+    sqlite3_bind_int(stmt, index++, clientId);
+  if (!startDate.empty())
+    sqlite3_bind_text(stmt, index++, startDate.c_str(), -1, SQLITE_TRANSIENT);
+  if (!endDate.empty())
+    sqlite3_bind_text(stmt, index++, endDate.c_str(), -1, SQLITE_TRANSIENT);
+  std::string likeQuery = "%" + searchQuery + "%";
+  if (!searchQuery.empty())
+    sqlite3_bind_text(stmt, index++, likeQuery.c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_int(stmt, index++, limit);
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    PhotoMetadata photo;
+    photo.id = sqlite3_column_int(stmt, 0);
+
+    const char *filename =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+    if (filename)
+      photo.filename = filename;
+
+    const char *hash =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+    if (hash)
+      photo.hash = hash;
+
+    photo.size = sqlite3_column_int64(stmt, 3);
+
+    const char *originalPath =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4));
+    if (originalPath && *originalPath)
+      photo.originalPath = originalPath;
+    else
+      photo.originalPath = "./storage/photos/" + photo.filename; // Fallback
+
+    photo.clientId = sqlite3_column_int(stmt, 5);
+
+    const char *receivedAt =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6));
+    photo.receivedAt = receivedAt ? receivedAt : "";
+
+    const char *takenAt =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 7));
+    photo.takenAt = takenAt ? takenAt : "";
+
+    photos.push_back(photo);
+  }
+
+  sqlite3_finalize(stmt);
+  return photos;
+}
+
 int DatabaseManager::getFilteredPhotoCount(int clientId,
                                            const std::string &startDate,
                                            const std::string &endDate,
@@ -2347,6 +2456,11 @@ UploadSession DatabaseManager::getUploadSessionByHash(
 
 bool DatabaseManager::updateSessionReceivedBytes(const std::string &uploadId,
                                                  long long receivedBytes) {
+  static Histogram &updateLatency = MetricsRegistry::getInstance().histogram(
+      "photosync_db_seconds", "SQLite statement latency by operation",
+      {{"op", "update_upload_progress"}});
+  ScopedTimer timer(updateLatency);
+
   sqlite3_stmt *stmt;
   // Also extend expiry on activity? Protocol v2 says refresh on chunk.
   // We'll just update bytes for now to be fast.
@@ -2429,8 +2543,10 @@ std::vector<std::string> DatabaseManager::getExpiredUploadSessionIds() {
 std::vector<PhotoMetadata> DatabaseManager::getAllPhotos() {
   std::vector<PhotoMetadata> photos;
   sqlite3_stmt *stmt;
-  // Select only necessary fields for integrity check + deleted_at
-  const char *sql = "SELECT id, filename, hash, size, deleted_at FROM metadata";
+  // Select only necessary fields for integrity check + deleted_at, plus the
+  // original path for thumbnail rebuilds
+  const char *sql = "SELECT id, filename, hash, size, deleted_at, "
+                    "original_path FROM metadata";
 
   if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
     LOG_ERROR("Failed to prepare getAllPhotos: " +
@@ -2450,6 +2566,13 @@ std::vector<PhotoMetadata> DatabaseManager::getAllPhotos() {
         reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4));
     photo.deletedAt = deleted ? deleted : "";
 
+    const char *originalPath =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 5));
+    if (originalPath && originalPath[0] != '\0')
+      photo.originalPath = originalPath;
+    else
+      photo.originalPath = "./storage/photos/" + photo.filename; // Fallback
+
     photos.push_back(photo);
   }
 
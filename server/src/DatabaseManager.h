@@ -6,6 +6,8 @@
 #include <string>
 #include <vector>
 
+class JsonWriter;
+
 struct PhotoMetadata {
   int id = -1;
   std::string filename;
@@ -134,6 +136,7 @@ public:
   bool insertPhoto(int clientId, const PhotoMetadata &photo,
                    const std::string &filePath = "");
   bool photoExists(const std::string &hash);
+  int getPhotoIdByHash(const std::string &hash); // -1 if not found
   int getPhotoCount(int clientId);
   std::vector<std::string>
   batchCheckHashes(const std::vector<std::string> &hashes);
@@ -144,7 +147,26 @@ public:
                           const std::string &startDate = "",
                           const std::string &endDate = "",
                           const std::string &searchQuery = "");
+  // Keyset-paginated walk (id DESC) for bulk export: returns up to `limit`
+  // live photos with id < beforeId (beforeId <= 0 starts from the newest)
+  std::vector<PhotoMetadata>
+  getPhotosBeforeId(int beforeId, int limit, int clientId = -1,
+                    const std::string &startDate = "",
+                    const std::string &endDate = "",
+                    const std::string &searchQuery = "");
   PhotoMetadata getPhotoById(int photoId);
+
+  // Row-streaming serializers for the list endpoints. Each writes one JSON
+  // object per row straight from the sqlite3 columns into an array the
+  // caller has already opened, and returns the row count (-1 on error).
+  int writeMediaItemsJson(JsonWriter &writer, int offset, int limit,
+                          int clientId = -1, const std::string &startDate = "",
+                          const std::string &endDate = "",
+                          const std::string &searchQuery = "");
+  int writePhotosJson(JsonWriter &writer, int offset, int limit,
+                      int clientId = -1, const std::string &searchQuery = "");
+  int writeChangesJson(JsonWriter &writer, long long sinceId, int limit,
+                       long long &lastChangeId);
   int getFilteredPhotoCount(int clientId = -1,
                             const std::string &startDate = "",
                             const std::string &endDate = "",
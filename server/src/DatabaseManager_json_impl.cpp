@@ -0,0 +1,218 @@
+#include "DatabaseManager.h"
+#include "JsonWriter.h"
+#include "Logger.h"
+
+// Direct SQLite -> JSON serialization for the list endpoints. Text columns
+// are copied from sqlite's buffer into the response once, with no
+// PhotoMetadata or nlohmann::json in between.
+
+namespace {
+
+// NULL text columns are written as "" to match the struct-based endpoints
+void writeText(JsonWriter &writer, sqlite3_stmt *stmt, int column) {
+  const char *text =
+      reinterpret_cast<const char *>(sqlite3_column_text(stmt, column));
+  if (!text) {
+    writer.value("", 0);
+    return;
+  }
+  writer.value(text, (size_t)sqlite3_column_bytes(stmt, column));
+}
+
+// Shared WHERE clause of the media grid queries; binds are positional
+std::string photoFilterSql(int clientId, const std::string &startDate,
+                           const std::string &endDate,
+                           const std::string &searchQuery) {
+  std::string sql = " WHERE deleted_at IS NULL";
+  if (clientId >= 0)
+    sql += " AND client_id = ?";
+  if (!startDate.empty())
+    sql += " AND received_at >= ?";
+  if (!endDate.empty())
+    sql += " AND received_at <= ?";
+  if (!searchQuery.empty())
+    sql += " AND filename LIKE ?";
+  return sql;
+}
+
+int bindPhotoFilter(sqlite3_stmt *stmt, int clientId,
+                    const std::string &startDate, const std::string &endDate,
+                    const std::string &searchQuery) {
+  int index = 1;
+  if (clientId >= 0)
+    sqlite3_bind_int(stmt, index++, clientId);
+  if (!startDate.empty())
+    sqlite3_bind_text(stmt, index++, startDate.c_str(), -1, SQLITE_TRANSIENT);
+  if (!endDate.empty())
+    sqlite3_bind_text(stmt, index++, endDate.c_str(), -1, SQLITE_TRANSIENT);
+  if (!searchQuery.empty()) {
+    std::string likeQuery = "%" + searchQuery + "%";
+    sqlite3_bind_text(stmt, index++, likeQuery.c_str(), -1, SQLITE_TRANSIENT);
+  }
+  return index;
+}
+
+} // namespace
+
+int DatabaseManager::writeMediaItemsJson(JsonWriter &writer, int offset,
+                                         int limit, int clientId,
+                                         const std::string &startDate,
+                                         const std::string &endDate,
+                                         const std::string &searchQuery) {
+  std::string sql =
+      "SELECT id, filename, COALESCE(mime_type, 'image/jpeg'), size, "
+      "received_at, client_id FROM metadata" +
+      photoFilterSql(clientId, startDate, endDate, searchQuery) +
+      " ORDER BY id DESC LIMIT ? OFFSET ?";
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    LOG_ERROR("Failed to prepare writeMediaItemsJson statement: " +
+              std::string(sqlite3_errmsg(db_)));
+    return -1;
+  }
+
+  int index = bindPhotoFilter(stmt, clientId, startDate, endDate, searchQuery);
+  sqlite3_bind_int(stmt, index++, limit);
+  sqlite3_bind_int(stmt, index++, offset);
+
+  int rows = 0;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    long long id = sqlite3_column_int64(stmt, 0);
+    writer.beginObject().field("id", id);
+    writer.key("filename");
+    writeText(writer, stmt, 1);
+    writer.key("thumbnailUrl").urlValue("/api/thumbnails/", id);
+    writer.key("previewUrl").urlValue("/api/thumbnails/", id, "?size=2048");
+    writer.key("fullUrl").urlValue("/api/media/", id, "/download");
+    writer.key("mimeType");
+    writeText(writer, stmt, 2);
+    writer.field("size", (long long)sqlite3_column_int64(stmt, 3));
+    writer.key("uploadedAt");
+    writeText(writer, stmt, 4);
+    writer.field("clientId", sqlite3_column_int(stmt, 5));
+    writer.endObject();
+    rows++;
+  }
+
+  sqlite3_finalize(stmt);
+  return rows;
+}
+
+int DatabaseManager::writePhotosJson(JsonWriter &writer, int offset, int limit,
+                                     int clientId,
+                                     const std::string &searchQuery) {
+  std::string sql =
+      "SELECT id, filename, size, hash, taken_at, received_at, "
+      "COALESCE(mime_type, 'image/jpeg'), camera_make, camera_model, "
+      "exposure_time, f_number, iso, focal_length, gps_lat, gps_lon, gps_alt "
+      "FROM metadata" +
+      photoFilterSql(clientId, "", "", searchQuery) +
+      " ORDER BY id DESC LIMIT ? OFFSET ?";
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    LOG_ERROR("Failed to prepare writePhotosJson statement: " +
+              std::string(sqlite3_errmsg(db_)));
+    return -1;
+  }
+
+  int index = bindPhotoFilter(stmt, clientId, "", "", searchQuery);
+  sqlite3_bind_int(stmt, index++, limit);
+  sqlite3_bind_int(stmt, index++, offset);
+
+  int rows = 0;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    long long id = sqlite3_column_int64(stmt, 0);
+    writer.beginObject().field("id", id);
+    writer.key("filename");
+    writeText(writer, stmt, 1);
+    writer.field("size", (long long)sqlite3_column_int64(stmt, 2));
+    writer.key("hash");
+    writeText(writer, stmt, 3);
+    writer.key("thumbnailUrl").urlValue("/api/thumbnails/", id);
+    writer.key("url").urlValue("/api/media/", id);
+    writer.key("takenAt");
+    writeText(writer, stmt, 4);
+    writer.key("receivedAt");
+    writeText(writer, stmt, 5);
+    writer.key("mimeType");
+    writeText(writer, stmt, 6);
+
+    writer.key("exif").beginObject();
+    writer.key("cameraMake");
+    writeText(writer, stmt, 7);
+    writer.key("cameraModel");
+    writeText(writer, stmt, 8);
+    writer.field("exposureTime", sqlite3_column_double(stmt, 9))
+        .field("fNumber", sqlite3_column_double(stmt, 10))
+        .field("iso", sqlite3_column_int(stmt, 11))
+        .field("focalLength", sqlite3_column_double(stmt, 12));
+    writer.key("gps")
+        .beginObject()
+        .field("lat", sqlite3_column_double(stmt, 13))
+        .field("lon", sqlite3_column_double(stmt, 14))
+        .field("alt", sqlite3_column_double(stmt, 15))
+        .endObject();
+    writer.endObject().endObject();
+    rows++;
+  }
+
+  sqlite3_finalize(stmt);
+  return rows;
+}
+
+int DatabaseManager::writeChangesJson(JsonWriter &writer, long long sinceId,
+                                      int limit, long long &lastChangeId) {
+  const char *sql = R"(
+        SELECT change_id, op, media_id, blob_hash, changed_at,
+               filename, size, mime_type, taken_at, device_id
+        FROM change_log
+        WHERE change_id > ?
+        ORDER BY change_id ASC
+        LIMIT ?
+    )";
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    LOG_ERROR("Failed to prepare writeChangesJson: " +
+              std::string(sqlite3_errmsg(db_)));
+    return -1;
+  }
+
+  sqlite3_bind_int64(stmt, 1, sinceId);
+  sqlite3_bind_int(stmt, 2, limit);
+
+  int rows = 0;
+  lastChangeId = sinceId;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    long long changeId = sqlite3_column_int64(stmt, 0);
+    writer.beginObject().field("id", changeId);
+    writer.key("op");
+    writeText(writer, stmt, 1);
+    writer.field("mediaId", sqlite3_column_int(stmt, 2));
+    writer.key("blobHash");
+    writeText(writer, stmt, 3);
+    writer.key("changedAt");
+    writeText(writer, stmt, 4);
+
+    writer.key("data").beginObject();
+    writer.key("filename");
+    writeText(writer, stmt, 5);
+    writer.field("size", (long long)sqlite3_column_int64(stmt, 6));
+    writer.key("mimeType");
+    writeText(writer, stmt, 7);
+    writer.key("takenAt");
+    writeText(writer, stmt, 8);
+    writer.key("deviceId");
+    writeText(writer, stmt, 9);
+    writer.endObject().endObject();
+
+    if (changeId > lastChangeId)
+      lastChangeId = changeId;
+    rows++;
+  }
+
+  sqlite3_finalize(stmt);
+  return rows;
+}
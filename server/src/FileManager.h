@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <ctime>
 #include <filesystem>
 #include <mutex>
 #include <string>
@@ -50,6 +51,9 @@ public:
 
   // Check physical disk space
   bool checkDiskSpace(long long requiredBytes);
+  // Whether the volume holding dir can take requiredBytes and keep the same
+  // reserve checkDiskSpace keeps
+  static bool hasFreeSpace(const std::string &dir, long long requiredBytes);
 
   // Get current storage usage
   long long getTotalStorageUsed();
@@ -57,6 +61,7 @@ public:
   // Calculate SHA-256 hash of file
   static std::string calculateSHA256(const std::string &filePath);
   static std::string calculateSHA256(const std::vector<char> &data);
+  static std::string calculateSHA256(const char *data, size_t length);
 
   // Delete photo file
   bool deletePhoto(const std::string &hash);
@@ -73,6 +78,11 @@ public:
   bool appendChunk(const std::string &uploadId, const std::vector<char> &data);
   bool finalizeFile(const std::string &uploadId, const std::string &finalPath);
   long long getFileSize(const std::string &path); // For resume reconciliation
+  static std::time_t getModifiedTime(const std::string &path); // 0 on error
+  // Copy length bytes at offset of source into a new file at target,
+  // through a fixed-size buffer
+  static bool copyRange(const std::string &source, long long offset,
+                        long long length, const std::string &target);
   std::string generatePhotoPath(const PhotoMetadata &metadata);
 
   // Phase 3: Integrity
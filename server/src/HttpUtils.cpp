@@ -0,0 +1,183 @@
+#include "HttpUtils.h"
+#include <cctype>
+#include <cstdio>
+
+std::string HttpUtils::makeETag(uint64_t hash) {
+  char buffer[24];
+  std::snprintf(buffer, sizeof(buffer), "\"%016llx\"",
+                (unsigned long long)hash);
+  return buffer;
+}
+
+bool HttpUtils::etagMatches(const std::string &ifNoneMatch,
+                            const std::string &etag) {
+  size_t pos = 0;
+  while (pos < ifNoneMatch.size()) {
+    size_t end = ifNoneMatch.find(',', pos);
+    if (end == std::string::npos) {
+      end = ifNoneMatch.size();
+    }
+
+    size_t first = ifNoneMatch.find_first_not_of(" \t", pos);
+    size_t last = ifNoneMatch.find_last_not_of(" \t", end - 1);
+    if (first != std::string::npos && first < end && last >= first) {
+      std::string candidate = ifNoneMatch.substr(first, last - first + 1);
+      if (candidate == "*") {
+        return true;
+      }
+      // If-None-Match uses weak comparison
+      if (candidate.compare(0, 2, "W/") == 0) {
+        candidate = candidate.substr(2);
+      }
+      if (candidate == etag) {
+        return true;
+      }
+    }
+    pos = end + 1;
+  }
+  return false;
+}
+
+bool HttpUtils::acceptsEncoding(const std::string &acceptEncoding,
+                                const std::string &coding) {
+  auto lower = [](std::string text) {
+    for (char &c : text) {
+      c = (char)std::tolower(static_cast<unsigned char>(c));
+    }
+    return text;
+  };
+  auto trim = [](const std::string &text) {
+    size_t first = text.find_first_not_of(" \t");
+    if (first == std::string::npos) {
+      return std::string();
+    }
+    size_t last = text.find_last_not_of(" \t");
+    return text.substr(first, last - first + 1);
+  };
+
+  bool wildcard = false;
+  size_t pos = 0;
+  while (pos <= acceptEncoding.size()) {
+    size_t end = acceptEncoding.find(',', pos);
+    if (end == std::string::npos) {
+      end = acceptEncoding.size();
+    }
+    std::string item = acceptEncoding.substr(pos, end - pos);
+    pos = end + 1;
+
+    std::string token = item;
+    bool rejected = false;
+    size_t semi = item.find(';');
+    if (semi != std::string::npos) {
+      token = item.substr(0, semi);
+      std::string param = lower(trim(item.substr(semi + 1)));
+      if (param.compare(0, 2, "q=") == 0) {
+        // q=0, q=0.0, q=0.00 ... all mean "not acceptable"
+        std::string q = param.substr(2);
+        rejected = !q.empty() && q.find_first_not_of("0.") == std::string::npos;
+      }
+    }
+
+    token = lower(trim(token));
+    if (token == coding) {
+      return !rejected;
+    }
+    if (token == "*" && !rejected) {
+      wildcard = true;
+    }
+  }
+  return wildcard;
+}
+
+HttpUtils::RangeBody HttpUtils::planRangeBody(ByteRange &range,
+                                              long long size,
+                                              bool mediaElement) {
+  if (range.start == 0 && range.end == size - 1) {
+    return RangeBody::WHOLE_FILE;
+  }
+  if (range.end - range.start + 1 <= MAX_BUFFERED_RANGE_BYTES) {
+    return RangeBody::BUFFER;
+  }
+  if (mediaElement) {
+    range.end = range.start + MAX_BUFFERED_RANGE_BYTES - 1;
+    return RangeBody::BUFFER;
+  }
+  return RangeBody::SPOOL;
+}
+
+HttpUtils::RangeResult HttpUtils::parseRange(const std::string &header,
+                                             long long size,
+                                             ByteRange &range) {
+  const std::string prefix = "bytes=";
+  if (header.compare(0, prefix.size(), prefix) != 0 ||
+      header.find(',') != std::string::npos) {
+    return RangeResult::NONE;
+  }
+
+  std::string spec = header.substr(prefix.size());
+  size_t dash = spec.find('-');
+  if (dash == std::string::npos) {
+    return RangeResult::NONE;
+  }
+  std::string first = spec.substr(0, dash);
+  std::string last = spec.substr(dash + 1);
+
+  auto parseNumber = [](const std::string &text, long long &value) {
+    if (text.empty() || text.size() > 18) {
+      return false;
+    }
+    value = 0;
+    for (char c : text) {
+      if (!std::isdigit(static_cast<unsigned char>(c))) {
+        return false;
+      }
+      value = value * 10 + (c - '0');
+    }
+    return true;
+  };
+
+  long long start = 0, end = 0;
+  if (first.empty()) {
+    // Suffix range: the last N bytes
+    long long suffix = 0;
+    if (!parseNumber(last, suffix)) {
+      return RangeResult::NONE;
+    }
+    if (suffix == 0 || size == 0) {
+      return RangeResult::UNSATISFIABLE;
+    }
+    start = suffix >= size ? 0 : size - suffix;
+    end = size - 1;
+  } else {
+    if (!parseNumber(first, start)) {
+      return RangeResult::NONE;
+    }
+    if (last.empty()) {
+      end = size - 1;
+    } else if (!parseNumber(last, end) || end < start) {
+      return RangeResult::NONE;
+    }
+    if (start >= size) {
+      return RangeResult::UNSATISFIABLE;
+    }
+    if (end >= size) {
+      end = size - 1;
+    }
+  }
+
+  range.start = start;
+  range.end = end;
+  return RangeResult::SATISFIABLE;
+}
+
+std::string HttpUtils::formatHttpDate(std::time_t time) {
+  std::tm tm{};
+#ifdef _WIN32
+  gmtime_s(&tm, &time);
+#else
+  gmtime_r(&time, &tm);
+#endif
+  char buffer[64];
+  std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  return buffer;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+// Helpers for HTTP caching and range headers shared by the REST handlers
+class HttpUtils {
+public:
+  // Inclusive byte range, as in "Content-Range: bytes start-end/total"
+  struct ByteRange {
+    long long start = 0;
+    long long end = 0;
+  };
+
+  enum class RangeResult {
+    NONE,         // No usable Range header: serve the whole entity
+    SATISFIABLE,  // range holds the requested bytes
+    UNSATISFIABLE // Answer 416
+  };
+
+  // How the body of a 206 response is produced
+  enum class RangeBody {
+    BUFFER,     // Read into memory (at most MAX_BUFFERED_RANGE_BYTES)
+    WHOLE_FILE, // The range covers the file: send the file itself
+    SPOOL       // Copy the slice to a temp file and send that
+  };
+
+  // Largest range body held in memory
+  static constexpr long long MAX_BUFFERED_RANGE_BYTES = 1024 * 1024;
+
+  // Strong ETag ("<16 hex digits>") for a 64-bit content hash
+  static std::string makeETag(uint64_t hash);
+
+  // True if an If-None-Match header value matches the ETag. Handles "*",
+  // comma-separated lists and weak (W/) validators.
+  static bool etagMatches(const std::string &ifNoneMatch,
+                          const std::string &etag);
+
+  // True if an Accept-Encoding header allows the content coding, e.g. "br"
+  // or "gzip". Honors "*" and rejects codings listed with q=0.
+  static bool acceptsEncoding(const std::string &acceptEncoding,
+                              const std::string &coding);
+
+  // Parse a single "bytes=" range against an entity of the given size.
+  // Multiple ranges and malformed headers are ignored (RangeResult::NONE).
+  static RangeResult parseRange(const std::string &header, long long size,
+                                ByteRange &range);
+
+  // Pick how to send a satisfiable range of an entity of the given size.
+  // Requests from a browser's media element are shortened to the buffer
+  // limit, since media stacks fetch the rest with follow-up ranges; every
+  // other client gets exactly the range it asked for, because download
+  // managers and "curl -C -" take a short 206 as the end of the file.
+  static RangeBody planRangeBody(ByteRange &range, long long size,
+                                 bool mediaElement);
+
+  // RFC 7231 IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+  static std::string formatHttpDate(std::time_t time);
+};
@@ -0,0 +1,165 @@
+#include "JsonWriter.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+JsonWriter::JsonWriter(std::string &out) : out_(out) {}
+
+void JsonWriter::separate() {
+  if (afterKey_) {
+    afterKey_ = false;
+    return;
+  }
+  if (!hasItems_.empty()) {
+    if (hasItems_.back()) {
+      out_ += ',';
+    }
+    hasItems_.back() = true;
+  }
+}
+
+JsonWriter &JsonWriter::beginObject() {
+  separate();
+  out_ += '{';
+  hasItems_.push_back(false);
+  return *this;
+}
+
+JsonWriter &JsonWriter::endObject() {
+  out_ += '}';
+  hasItems_.pop_back();
+  return *this;
+}
+
+JsonWriter &JsonWriter::beginArray() {
+  separate();
+  out_ += '[';
+  hasItems_.push_back(false);
+  return *this;
+}
+
+JsonWriter &JsonWriter::endArray() {
+  out_ += ']';
+  hasItems_.pop_back();
+  return *this;
+}
+
+JsonWriter &JsonWriter::key(const char *name) {
+  separate();
+  out_ += '"';
+  appendEscaped(out_, name, std::strlen(name));
+  out_ += "\":";
+  afterKey_ = true;
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(const std::string &text) {
+  return value(text.data(), text.size());
+}
+
+JsonWriter &JsonWriter::value(const char *text) {
+  if (!text) {
+    return null();
+  }
+  return value(text, std::strlen(text));
+}
+
+JsonWriter &JsonWriter::value(const char *text, size_t length) {
+  separate();
+  out_ += '"';
+  appendEscaped(out_, text, length);
+  out_ += '"';
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(double number) {
+  if (!std::isfinite(number)) {
+    return null();
+  }
+  separate();
+  // Shortest representation that round-trips, like nlohmann::json::dump()
+  char buffer[32];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+  out_.append(buffer, result.ptr);
+  if (std::memchr(buffer, '.', result.ptr - buffer) == nullptr &&
+      std::memchr(buffer, 'e', result.ptr - buffer) == nullptr) {
+    out_ += ".0";
+  }
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(bool flag) {
+  separate();
+  out_ += flag ? "true" : "false";
+  return *this;
+}
+
+JsonWriter &JsonWriter::null() {
+  separate();
+  out_ += "null";
+  return *this;
+}
+
+JsonWriter &JsonWriter::urlValue(const char *prefix, long long id,
+                                 const char *suffix) {
+  separate();
+  out_ += '"';
+  out_ += prefix;
+  char buffer[24];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), id);
+  out_.append(buffer, result.ptr);
+  out_ += suffix;
+  out_ += '"';
+  return *this;
+}
+
+JsonWriter &JsonWriter::raw(const std::string &json) {
+  separate();
+  out_ += json;
+  return *this;
+}
+
+void JsonWriter::appendEscaped(std::string &out, const char *text,
+                               size_t length) {
+  static const char hex[] = "0123456789abcdef";
+
+  // Copy runs of plain characters in one append
+  size_t runStart = 0;
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+
+    out.append(text + runStart, i - runStart);
+    runStart = i + 1;
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    case '\b':
+      out += "\\b";
+      break;
+    case '\f':
+      out += "\\f";
+      break;
+    default: {
+      char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+      out.append(escaped, sizeof(escaped));
+    }
+    }
+  }
+  out.append(text + runStart, length - runStart);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <charconv>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Streaming JSON serializer that appends straight into a string buffer.
+// Used by the list endpoints instead of building an nlohmann::json DOM per
+// row and dumping it. Commas are inserted automatically; callers only have
+// to balance begin/end calls.
+//
+//   JsonWriter w(buffer);
+//   w.beginObject();
+//   w.key("items").beginArray();
+//   ...
+//   w.endArray();
+//   w.endObject();
+class JsonWriter {
+public:
+  explicit JsonWriter(std::string &out);
+
+  JsonWriter &beginObject();
+  JsonWriter &endObject();
+  JsonWriter &beginArray();
+  JsonWriter &endArray();
+
+  // Object member name; must be followed by exactly one value
+  JsonWriter &key(const char *name);
+
+  JsonWriter &value(const std::string &text);
+  JsonWriter &value(const char *text);
+  JsonWriter &value(const char *text, size_t length);
+  template <typename T,
+            typename std::enable_if<std::is_integral<T>::value &&
+                                        !std::is_same<T, bool>::value,
+                                    int>::type = 0>
+  JsonWriter &value(T number) {
+    separate();
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+    out_.append(buffer, result.ptr);
+    return *this;
+  }
+  JsonWriter &value(double number); // NaN and infinities become null
+  JsonWriter &value(bool flag);
+  JsonWriter &null();
+
+  // String value "<prefix><id><suffix>" built in place, for resource URLs.
+  // prefix and suffix are written unescaped and must be plain ASCII.
+  JsonWriter &urlValue(const char *prefix, long long id,
+                       const char *suffix = "");
+
+  // Append an already-serialized JSON value verbatim
+  JsonWriter &raw(const std::string &json);
+
+  // key(name).value(v) in one call
+  template <typename T> JsonWriter &field(const char *name, const T &v) {
+    return key(name).value(v);
+  }
+
+  static void appendEscaped(std::string &out, const char *text, size_t length);
+
+private:
+  void separate();
+
+  std::string &out_;
+  std::vector<bool> hasItems_; // One flag per open container
+  bool afterKey_ = false;
+};
@@ -0,0 +1,50 @@
+#include "LogRing.h"
+#include <cstdint>
+
+LogRing::LogRing(size_t capacity) {
+  size_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  slots_ = std::make_unique<Slot[]>(size);
+  mask_ = size - 1;
+  for (size_t i = 0; i < size; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool LogRing::tryPush(std::string &&line) {
+  size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot &slot = slots_[pos & mask_];
+    size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+    if (diff == 0) {
+      // Slot is free for this lap; claim it
+      if (enqueuePos_.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+        slot.line = std::move(line);
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      // The consumer has not released this slot from the previous lap
+      return false;
+    } else {
+      pos = enqueuePos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool LogRing::tryPop(std::string &line) {
+  Slot &slot = slots_[dequeuePos_ & mask_];
+  size_t sequence = slot.sequence.load(std::memory_order_acquire);
+  if ((intptr_t)sequence - (intptr_t)(dequeuePos_ + 1) < 0) {
+    return false;
+  }
+  line = std::move(slot.line);
+  slot.line.clear();
+  slot.sequence.store(dequeuePos_ + mask_ + 1, std::memory_order_release);
+  dequeuePos_++;
+  return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Bounded lock-free multi-producer / single-consumer queue of formatted log
+// lines (Vyukov's sequence-numbered ring). Producers claim a slot with one
+// CAS and never block; a full ring makes tryPush fail so the caller can
+// choose between dropping and waiting.
+class LogRing {
+public:
+  // capacity is rounded up to a power of two
+  explicit LogRing(size_t capacity);
+
+  bool tryPush(std::string &&line);
+
+  // Consumer side; must only be called from one thread at a time
+  bool tryPop(std::string &line);
+
+  size_t capacity() const { return mask_ + 1; }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence{0};
+    std::string line;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  alignas(64) std::atomic<size_t> enqueuePos_{0};
+  alignas(64) size_t dequeuePos_ = 0;
+};
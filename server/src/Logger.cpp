@@ -1,60 +1,86 @@
 #include "Logger.h"
 #include <chrono>
-#include <iomanip>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
 #include <iostream>
-#include <sstream>
 
 // Undefine Windows macros that conflict with our enums
 #ifdef ERROR
 #undef ERROR
 #endif
 
+namespace fs = std::filesystem;
+
+// How long the writer sleeps when idle before re-checking the ring. Producers
+// only signal when the writer is idle, so this bounds a missed wakeup.
+static constexpr auto WRITER_POLL_INTERVAL = std::chrono::milliseconds(50);
+
 Logger &Logger::getInstance() {
   static Logger instance;
   return instance;
 }
 
 void Logger::init(const std::string &logFile, LogLevel level,
-                  bool consoleOutput) {
+                  bool consoleOutput, uint64_t maxFileBytes, int maxFiles,
+                  size_t queueSize) {
+  shutdown();
+
   std::lock_guard<std::mutex> lock(mutex_);
-  minLevel_ = level;
+  minLevel_.store(level);
   consoleOutput_ = consoleOutput;
+  maxFileBytes_ = maxFileBytes;
+  maxFiles_ = maxFiles;
+  logPath_ = logFile;
 
+  if (logFile_.is_open()) {
+    logFile_.close();
+  }
+  fileBytes_ = 0;
   if (!logFile.empty()) {
     logFile_.open(logFile, std::ios::app);
     if (!logFile_.is_open()) {
       std::cerr << "Failed to open log file: " << logFile << std::endl;
     }
+    std::error_code ec;
+    fileBytes_ = fs::exists(logFile, ec) ? fs::file_size(logFile, ec) : 0;
+  }
+
+  if (!ring_ || ring_->capacity() < queueSize) {
+    ring_ = std::make_unique<LogRing>(queueSize);
   }
+  running_.store(true);
+  writer_ = std::thread(&Logger::writerLoop, this);
 }
 
 Logger::~Logger() {
+  shutdown();
   if (logFile_.is_open()) {
     logFile_.close();
   }
 }
 
-void Logger::log(LogLevel level, const std::string &message) {
-  if (level < minLevel_) {
+void Logger::shutdown() {
+  if (!running_.exchange(false)) {
     return;
   }
-
-  std::lock_guard<std::mutex> lock(mutex_);
-
-  std::string timestamp = getCurrentTimestamp();
-  std::string levelStr = levelToString(level);
-  std::string logMessage = "[" + timestamp + "] [" + levelStr + "] " + message;
-
-  if (consoleOutput_) {
-    std::cout << logMessage << std::endl;
+  wake_.notify_one();
+  if (writer_.joinable()) {
+    writer_.join();
   }
 
-  if (logFile_.is_open()) {
-    logFile_ << logMessage << std::endl;
-    logFile_.flush();
+  // Lines pushed while the writer was exiting; the ring itself is kept so a
+  // producer that raced the shutdown never touches freed memory
+  std::string line;
+  while (ring_->tryPop(line)) {
+    writeSync(line);
   }
 }
 
+void Logger::log(LogLevel level, const std::string &message) {
+  logWithTrace(level, "", message);
+}
+
 void Logger::debug(const std::string &message) {
   log(LogLevel::L_DEBUG, message);
 }
@@ -73,9 +99,21 @@ void Logger::error(const std::string &message) {
 
 void Logger::fatal(const std::string &message) {
   log(LogLevel::L_FATAL, message);
+  flush();
 }
 
-std::string Logger::levelToString(LogLevel level) {
+const char *Logger::appendUntilPlaceholder(std::string &out,
+                                           const char *fmt) {
+  const char *placeholder = std::strstr(fmt, "{}");
+  if (!placeholder) {
+    out += fmt;
+    return nullptr;
+  }
+  out.append(fmt, placeholder);
+  return placeholder + 2;
+}
+
+const char *Logger::levelToString(LogLevel level) {
   switch (level) {
   case LogLevel::L_DEBUG:
     return "DEBUG";
@@ -94,38 +132,188 @@ std::string Logger::levelToString(LogLevel level) {
 
 std::string Logger::getCurrentTimestamp() {
   auto now = std::chrono::system_clock::now();
-  auto time = std::chrono::system_clock::to_time_t(now);
-  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                now.time_since_epoch()) %
-            1000;
+  std::time_t time = std::chrono::system_clock::to_time_t(now);
+  int ms = (int)(std::chrono::duration_cast<std::chrono::milliseconds>(
+                     now.time_since_epoch())
+                     .count() %
+                 1000);
 
-  std::stringstream ss;
-  ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
-  ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-  return ss.str();
+  std::tm tm{};
+#ifdef _WIN32
+  localtime_s(&tm, &time);
+#else
+  localtime_r(&time, &tm);
+#endif
+  char buffer[32];
+  size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+  std::snprintf(buffer + length, sizeof(buffer) - length, ".%03d", ms);
+  return buffer;
 }
 
 void Logger::logWithTrace(LogLevel level, const std::string &traceId,
                           const std::string &message) {
-  if (level < minLevel_) {
+  if (level < minLevel_.load(std::memory_order_relaxed)) {
     return;
   }
 
-  std::lock_guard<std::mutex> lock(mutex_);
+  std::string line;
+  line.reserve(40 + traceId.size() + message.size());
+  line += '[';
+  line += getCurrentTimestamp();
+  line += "] [";
+  line += levelToString(level);
+  line += ']';
+  if (!traceId.empty()) {
+    line += " [";
+    line += traceId;
+    line += ']';
+  }
+  line += ' ';
+  line += message;
+  line += '\n';
 
-  std::string timestamp = getCurrentTimestamp();
-  std::string levelStr = levelToString(level);
-  std::string tracePart = traceId.empty() ? "" : " [" + traceId + "]";
+  enqueue(level, std::move(line));
+}
 
-  std::string logMessage =
-      "[" + timestamp + "] [" + levelStr + "]" + tracePart + " " + message;
+void Logger::enqueue(LogLevel level, std::string &&line) {
+  if (!running_.load(std::memory_order_acquire)) {
+    writeSync(line);
+    return;
+  }
 
-  if (consoleOutput_) {
-    std::cout << logMessage << std::endl;
+  if (!ring_->tryPush(std::move(line))) {
+    if (level < LogLevel::L_ERROR) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    // Errors are worth a short stall: wait for the writer to make room
+    wake_.notify_one();
+    while (!ring_->tryPush(std::move(line))) {
+      if (!running_.load(std::memory_order_acquire)) {
+        writeSync(line);
+        return;
+      }
+      std::this_thread::yield();
+    }
   }
 
+  enqueued_.fetch_add(1, std::memory_order_release);
+  if (writerIdle_.load(std::memory_order_acquire)) {
+    wake_.notify_one();
+  }
+}
+
+void Logger::writeSync(const std::string &line) {
+  writeBatch(line);
+}
+
+void Logger::flush() {
+  if (!running_.load(std::memory_order_acquire)) {
+    return;
+  }
+  uint64_t target = enqueued_.load(std::memory_order_acquire);
+  wake_.notify_one();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  drained_.wait_for(lock, std::chrono::seconds(5), [this, target] {
+    return written_.load(std::memory_order_acquire) >= target ||
+           !running_.load(std::memory_order_acquire);
+  });
+}
+
+void Logger::writerLoop() {
+  std::string batch;
+  std::string line;
+  uint64_t reportedDrops = 0;
+
+  for (;;) {
+    bool stopping = !running_.load(std::memory_order_acquire);
+
+    uint64_t count = 0;
+    while (ring_->tryPop(line)) {
+      batch += line;
+      count++;
+      // Keep batches bounded so the console and file see steady progress
+      if (batch.size() >= 256 * 1024) {
+        break;
+      }
+    }
+
+    uint64_t drops = dropped_.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+      batch += "[" + getCurrentTimestamp() + "] [WARN ] Logger dropped " +
+               std::to_string(drops - reportedDrops) +
+               " messages (queue full)\n";
+      reportedDrops = drops;
+    }
+
+    if (!batch.empty()) {
+      writeBatch(batch);
+      batch.clear();
+    }
+    if (count > 0) {
+      written_.fetch_add(count, std::memory_order_release);
+      std::lock_guard<std::mutex> lock(mutex_);
+      drained_.notify_all();
+      continue;
+    }
+
+    if (stopping) {
+      break;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    writerIdle_.store(true, std::memory_order_release);
+    wake_.wait_for(lock, WRITER_POLL_INTERVAL);
+    writerIdle_.store(false, std::memory_order_release);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  drained_.notify_all();
+}
+
+void Logger::writeBatch(const std::string &batch) {
+  // Shared with the synchronous path, which a producer can take while the
+  // writer is still draining its last batch during shutdown
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (consoleOutput_) {
+    std::cout.write(batch.data(), (std::streamsize)batch.size());
+    std::cout.flush();
+  }
   if (logFile_.is_open()) {
-    logFile_ << logMessage << std::endl;
+    rotateIfNeeded(batch.size());
+    logFile_.write(batch.data(), (std::streamsize)batch.size());
     logFile_.flush();
+    fileBytes_ += batch.size();
+  }
+}
+
+void Logger::rotateIfNeeded(size_t incomingBytes) {
+  if (maxFileBytes_ == 0 || fileBytes_ == 0 ||
+      fileBytes_ + incomingBytes <= maxFileBytes_) {
+    return;
+  }
+
+  logFile_.close();
+  std::error_code ec;
+  if (maxFiles_ > 0) {
+    // server.log.(N-1) -> server.log.N, ..., server.log -> server.log.1
+    fs::remove(logPath_ + "." + std::to_string(maxFiles_), ec);
+    for (int i = maxFiles_ - 1; i >= 1; --i) {
+      std::string from = logPath_ + "." + std::to_string(i);
+      if (fs::exists(from, ec)) {
+        fs::rename(from, logPath_ + "." + std::to_string(i + 1), ec);
+      }
+    }
+    fs::rename(logPath_, logPath_ + ".1", ec);
+  } else {
+    fs::remove(logPath_, ec);
+  }
+
+  logFile_.open(logPath_, std::ios::out | std::ios::trunc);
+  fileBytes_ = 0;
+  if (!logFile_.is_open()) {
+    std::cerr << "Failed to reopen log file after rotation: " << logPath_
+              << std::endl;
   }
 }
@@ -1,9 +1,18 @@
 #pragma once
 
+#include "LogRing.h"
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 
 // Undefine Windows macros that conflict with our enum
 #ifdef ERROR
@@ -12,13 +21,57 @@
 
 enum class LogLevel { L_DEBUG, L_INFO, L_WARN, L_ERROR, L_FATAL };
 
+// Lowest level compiled into the binary (0 = DEBUG ... 4 = FATAL). LOG_*
+// statements below it become dead code, message construction included.
+// CMake raises it to INFO for Release builds.
+#ifndef PHOTOSYNC_MIN_LOG_LEVEL
+#define PHOTOSYNC_MIN_LOG_LEVEL 0
+#endif
+
+// Asynchronous logger. Callers format the line and push it onto a lock-free
+// ring; a background thread writes batches to the console and the log file,
+// flushing once per batch and rotating the file by size. When the ring is
+// full, DEBUG..WARN lines are dropped (and counted) while ERROR and FATAL
+// wait for space. Before init() - e.g. in unit tests - lines are written
+// synchronously.
 class Logger {
 public:
+  static constexpr size_t DEFAULT_QUEUE_SIZE = 8192;
+  static constexpr uint64_t DEFAULT_MAX_FILE_BYTES = 10ULL * 1024 * 1024;
+  static constexpr int DEFAULT_MAX_FILES = 5;
+
   static Logger &getInstance();
 
-  void init(const std::string &logFile, LogLevel level, bool consoleOutput);
+  // maxFiles counts rotated files kept next to the live one (log.1 .. log.N)
+  void init(const std::string &logFile, LogLevel level, bool consoleOutput,
+            uint64_t maxFileBytes = DEFAULT_MAX_FILE_BYTES,
+            int maxFiles = DEFAULT_MAX_FILES,
+            size_t queueSize = DEFAULT_QUEUE_SIZE);
+
   void log(LogLevel level, const std::string &message);
 
+  // True when a line at this level would be written. The LOG_* macros check
+  // this before evaluating their message expression.
+  bool isEnabled(LogLevel level) const {
+    return level >= minLevel_.load(std::memory_order_relaxed);
+  }
+  void setLevel(LogLevel level) { minLevel_.store(level); }
+
+  static constexpr bool compiledIn(LogLevel level) {
+    return static_cast<int>(level) >= PHOTOSYNC_MIN_LOG_LEVEL;
+  }
+
+  // Replace each "{}" in fmt with the next argument. Arguments may be
+  // strings, integers, floating point values, bools or enums; surplus
+  // placeholders are kept verbatim and surplus arguments are ignored.
+  template <typename... Args>
+  static std::string format(const char *fmt, const Args &...args) {
+    std::string out;
+    out.reserve(std::strlen(fmt) + 16 * sizeof...(Args));
+    formatInto(out, fmt, args...);
+    return out;
+  }
+
   void debug(const std::string &message);
   void info(const std::string &message);
   void warn(const std::string &message);
@@ -29,6 +82,16 @@ public:
   void logWithTrace(LogLevel level, const std::string &traceId,
                     const std::string &message);
 
+  // Block until every line logged before the call has been written
+  void flush();
+
+  // Drain the queue and stop the writer thread (idempotent)
+  void shutdown();
+
+  uint64_t getDroppedCount() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
 private:
   Logger() = default;
   ~Logger();
@@ -36,18 +99,94 @@ private:
   Logger(const Logger &) = delete;
   Logger &operator=(const Logger &) = delete;
 
-  std::string levelToString(LogLevel level);
-  std::string getCurrentTimestamp();
+  static const char *levelToString(LogLevel level);
+
+  // Append fmt up to the next "{}" and return the text after it, or append
+  // all of fmt and return nullptr when there is no placeholder left
+  static const char *appendUntilPlaceholder(std::string &out, const char *fmt);
+
+  static void formatInto(std::string &out, const char *fmt) {
+    out += fmt;
+  }
+  template <typename T, typename... Rest>
+  static void formatInto(std::string &out, const char *fmt, const T &arg,
+                         const Rest &...rest) {
+    const char *next = appendUntilPlaceholder(out, fmt);
+    if (!next)
+      return;
+    appendArg(out, arg);
+    formatInto(out, next, rest...);
+  }
+
+  template <typename T> static void appendArg(std::string &out, const T &arg) {
+    if constexpr (std::is_same<T, bool>::value) {
+      out += arg ? "true" : "false";
+    } else if constexpr (std::is_enum<T>::value) {
+      appendArg(out, static_cast<typename std::underlying_type<T>::type>(arg));
+    } else if constexpr (std::is_integral<T>::value ||
+                         std::is_floating_point<T>::value) {
+      char buffer[32];
+      auto result = std::to_chars(buffer, buffer + sizeof(buffer), arg);
+      out.append(buffer, result.ptr);
+    } else if constexpr (std::is_pointer<T>::value) {
+      out += arg ? std::string_view(arg) : std::string_view("(null)");
+    } else {
+      out += std::string_view(arg);
+    }
+  }
+  static std::string getCurrentTimestamp();
+
+  void enqueue(LogLevel level, std::string &&line);
+  void writeSync(const std::string &line);
+  void writerLoop();
+  void writeBatch(const std::string &batch);
+  void rotateIfNeeded(size_t incomingBytes);
 
+  // Written by init() before the writer starts, read-only afterwards
+  std::string logPath_;
   std::ofstream logFile_;
-  LogLevel minLevel_ = LogLevel::L_INFO;
+  std::atomic<LogLevel> minLevel_{LogLevel::L_INFO};
   bool consoleOutput_ = true;
-  std::mutex mutex_;
+  uint64_t maxFileBytes_ = DEFAULT_MAX_FILE_BYTES;
+  int maxFiles_ = DEFAULT_MAX_FILES;
+  uint64_t fileBytes_ = 0;
+
+  std::unique_ptr<LogRing> ring_;
+  std::thread writer_;
+  std::atomic<bool> running_{false};
+  std::atomic<bool> writerIdle_{false};
+  std::atomic<uint64_t> enqueued_{0};
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> dropped_{0};
+
+  std::mutex mutex_; // Console/file output, init/shutdown and wakeups
+  std::condition_variable wake_;
+  std::condition_variable drained_;
 };
 
-// Convenience macros
-#define LOG_DEBUG(msg) Logger::getInstance().debug(msg)
-#define LOG_INFO(msg) Logger::getInstance().info(msg)
-#define LOG_WARN(msg) Logger::getInstance().warn(msg)
-#define LOG_ERROR(msg) Logger::getInstance().error(msg)
-#define LOG_FATAL(msg) Logger::getInstance().fatal(msg)
+// Convenience macros. The message expression is only evaluated when the
+// level is both compiled in and enabled at runtime, so building it costs
+// nothing on a disabled level.
+#define PHOTOSYNC_LOG(level, msg)                                              \
+  do {                                                                         \
+    if (Logger::compiledIn(level) && Logger::getInstance().isEnabled(level))  \
+      Logger::getInstance().log(level, msg);                                   \
+  } while (0)
+
+#define LOG_DEBUG(msg) PHOTOSYNC_LOG(LogLevel::L_DEBUG, msg)
+#define LOG_INFO(msg) PHOTOSYNC_LOG(LogLevel::L_INFO, msg)
+#define LOG_WARN(msg) PHOTOSYNC_LOG(LogLevel::L_WARN, msg)
+#define LOG_ERROR(msg) PHOTOSYNC_LOG(LogLevel::L_ERROR, msg)
+// FATAL goes through fatal() so the line is flushed before the process exits.
+#define LOG_FATAL(msg)                                                         \
+  do {                                                                         \
+    if (Logger::compiledIn(LogLevel::L_FATAL) &&                               \
+        Logger::getInstance().isEnabled(LogLevel::L_FATAL))                    \
+      Logger::getInstance().fatal(msg);                                        \
+  } while (0)
+
+// Format-style variants: LOG_DEBUGF("Sent {} bytes to {}", n, ip)
+#define LOG_DEBUGF(...) LOG_DEBUG(Logger::format(__VA_ARGS__))
+#define LOG_INFOF(...) LOG_INFO(Logger::format(__VA_ARGS__))
+#define LOG_WARNF(...) LOG_WARN(Logger::format(__VA_ARGS__))
+#define LOG_ERRORF(...) LOG_ERROR(Logger::format(__VA_ARGS__))
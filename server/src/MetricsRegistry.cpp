@@ -0,0 +1,155 @@
+#include "MetricsRegistry.h"
+#include <cstdio>
+#include <sstream>
+
+void Histogram::observeMicros(uint64_t micros) {
+  // Bounds are inclusive, so bucket by micros - 1: below SUB_BUCKETS that is
+  // the bucket itself, above it the top bits pick power and sub-bucket
+  uint64_t value = micros > 0 ? micros - 1 : 0;
+  int bucket;
+  if (value < (uint64_t)SUB_BUCKETS) {
+    bucket = (int)value;
+  } else if (value >= (1ULL << MAX_POWER)) {
+    bucket = BUCKETS; // Overflow
+  } else {
+    int power = SUB_BUCKET_BITS;
+    while (value >> (power + 1))
+      power++;
+    int sub = (int)(value >> (power - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    bucket = SUB_BUCKETS * (power - SUB_BUCKET_BITS + 1) + sub;
+  }
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(micros, std::memory_order_relaxed);
+}
+
+std::array<uint64_t, Histogram::BUCKETS + 1> Histogram::bucketCounts() const {
+  std::array<uint64_t, BUCKETS + 1> counts;
+  for (int i = 0; i <= BUCKETS; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  return counts;
+}
+
+uint64_t Histogram::bucketUpperMicros(int bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return (uint64_t)bucket + 1;
+  }
+  int power = SUB_BUCKET_BITS + bucket / SUB_BUCKETS - 1;
+  int sub = bucket % SUB_BUCKETS;
+  return (1ULL << power) + ((uint64_t)(sub + 1) << (power - SUB_BUCKET_BITS));
+}
+
+MetricsRegistry &MetricsRegistry::getInstance() {
+  static MetricsRegistry instance;
+  return instance;
+}
+
+std::string MetricsRegistry::formatLabels(const Labels &labels) {
+  if (labels.empty()) {
+    return "";
+  }
+  std::string out = "{";
+  for (size_t i = 0; i < labels.size(); ++i) {
+    if (i > 0) {
+      out += ',';
+    }
+    out += labels[i].first;
+    out += "=\"";
+    for (char c : labels[i].second) {
+      if (c == '\\' || c == '"') {
+        out += '\\';
+        out += c;
+      } else if (c == '\n') {
+        out += "\\n";
+      } else {
+        out += c;
+      }
+    }
+    out += '"';
+  }
+  out += '}';
+  return out;
+}
+
+MetricsRegistry::Family &MetricsRegistry::family(const std::string &name,
+                                                 Type type,
+                                                 const std::string &help) {
+  auto it = families_.find(name);
+  if (it == families_.end()) {
+    it = families_.emplace(name, Family{type, help, {}, {}}).first;
+  }
+  return it->second;
+}
+
+Counter &MetricsRegistry::counter(const std::string &name,
+                                  const std::string &help,
+                                  const Labels &labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &slot = family(name, Type::COUNTER, help).counters[formatLabels(labels)];
+  if (!slot) {
+    slot = std::make_unique<Counter>();
+  }
+  return *slot;
+}
+
+Histogram &MetricsRegistry::histogram(const std::string &name,
+                                      const std::string &help,
+                                      const Labels &labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &slot =
+      family(name, Type::HISTOGRAM, help).histograms[formatLabels(labels)];
+  if (!slot) {
+    slot = std::make_unique<Histogram>();
+  }
+  return *slot;
+}
+
+std::string MetricsRegistry::renderPrometheus() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ostringstream out;
+  char number[32];
+
+  // Label set with an extra le="..." appended for histogram buckets
+  auto withLe = [](const std::string &labels, const char *le) {
+    std::string extra = std::string("le=\"") + le + "\"";
+    if (labels.empty()) {
+      return "{" + extra + "}";
+    }
+    return labels.substr(0, labels.size() - 1) + "," + extra + "}";
+  };
+
+  for (const auto &[name, fam] : families_) {
+    out << "# HELP " << name << " " << fam.help << "\n";
+    if (fam.type == Type::COUNTER) {
+      out << "# TYPE " << name << " counter\n";
+      for (const auto &[labels, counter] : fam.counters) {
+        out << name << labels << " " << counter->value() << "\n";
+      }
+      continue;
+    }
+
+    out << "# TYPE " << name << " histogram\n";
+    for (const auto &[labels, histogram] : fam.histograms) {
+      auto counts = histogram->bucketCounts();
+      uint64_t cumulative = 0;
+      for (int i = 0; i < Histogram::BUCKETS; ++i) {
+        cumulative += counts[i];
+        // Bounds are whole microseconds under 100s, so 8 digits are exact
+        std::snprintf(number, sizeof(number), "%.8g",
+                      Histogram::bucketUpperSeconds(i));
+        out << name << "_bucket" << withLe(labels, number) << " "
+            << cumulative << "\n";
+      }
+      cumulative += counts[Histogram::BUCKETS];
+      out << name << "_bucket" << withLe(labels, "+Inf") << " " << cumulative
+          << "\n";
+      std::snprintf(number, sizeof(number), "%.6f",
+                    (double)histogram->sumMicros() / 1e6);
+      out << name << "_sum" << labels << " " << number << "\n";
+      // _count matches the +Inf bucket even if observations race the render
+      out << name << "_count" << labels << " " << cumulative << "\n";
+    }
+  }
+  return out.str();
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Monotonic event/byte counter. Increments are a single relaxed atomic add.
+class Counter {
+public:
+  void inc(uint64_t amount = 1) {
+    value_.fetch_add(amount, std::memory_order_relaxed);
+  }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> value_{0};
+};
+
+// Latency histogram from 1us to ~67s with log-linear (HDR-style) buckets:
+// up to SUB_BUCKETS us there is one bucket per microsecond, and above that
+// each power of two is split into SUB_BUCKETS equal-width buckets, so a bucket
+// bound is at most 12.5% above any value in it. Recording is a short shift
+// loop plus three relaxed atomic adds (bucket, count, sum).
+class Histogram {
+public:
+  static constexpr int SUB_BUCKET_BITS = 3;
+  static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS; // Per power of two
+  static constexpr int MAX_POWER = 26; // Largest bound is 2^26us
+  static constexpr int BUCKETS =
+      SUB_BUCKETS * (MAX_POWER - SUB_BUCKET_BITS + 1);
+
+  void observeMicros(uint64_t micros);
+  void observe(std::chrono::steady_clock::duration elapsed) {
+    auto micros =
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+    observeMicros((uint64_t)micros.count());
+  }
+
+  // Non-cumulative count per bucket; the extra last slot is overflow (+Inf)
+  std::array<uint64_t, BUCKETS + 1> bucketCounts() const;
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t sumMicros() const { return sum_.load(std::memory_order_relaxed); }
+
+  static uint64_t bucketUpperMicros(int bucket);
+  static double bucketUpperSeconds(int bucket) {
+    return (double)bucketUpperMicros(bucket) / 1e6;
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKETS + 1> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+};
+
+// Records the lifetime of the scope into a histogram
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Histogram &histogram)
+      : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    histogram_.observe(std::chrono::steady_clock::now() - start_);
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  Histogram &histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Process-wide registry of counters and histograms, rendered in the
+// Prometheus text exposition format at /api/metrics.
+// Lookups take a mutex and are meant to happen once per call site (function
+// static) or once per session; the returned references stay valid for the
+// life of the process, so the hot path only touches atomics.
+class MetricsRegistry {
+public:
+  using Labels = std::vector<std::pair<std::string, std::string>>;
+
+  static MetricsRegistry &getInstance();
+
+  Counter &counter(const std::string &name, const std::string &help,
+                   const Labels &labels = {});
+  Histogram &histogram(const std::string &name, const std::string &help,
+                       const Labels &labels = {});
+
+  std::string renderPrometheus() const;
+
+private:
+  MetricsRegistry() = default;
+  MetricsRegistry(const MetricsRegistry &) = delete;
+  MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+
+  enum class Type { COUNTER, HISTOGRAM };
+
+  struct Family {
+    Type type;
+    std::string help;
+    // Keyed by the rendered label set, e.g. {device="abc"}
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+  };
+
+  static std::string formatLabels(const Labels &labels);
+  Family &family(const std::string &name, Type type, const std::string &help);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Family> families_;
+};
@@ -16,11 +16,18 @@ static uint32_t fromNetworkOrder(uint32_t val) { return ntohl(val); }
 
 std::vector<char> ProtocolParser::serializePacket(const Packet &packet) {
   std::vector<char> buffer;
+  appendPacket(packet, buffer);
+  return buffer;
+}
+
+void ProtocolParser::appendPacket(const Packet &packet,
+                                  std::vector<char> &out) {
+  size_t start = out.size();
   size_t totalSize = sizeof(uint16_t) + sizeof(uint8_t) + sizeof(uint8_t) +
                      sizeof(uint32_t) + packet.payload.size();
-  buffer.resize(totalSize);
+  out.resize(start + totalSize);
 
-  char *ptr = buffer.data();
+  char *ptr = out.data() + start;
 
   // manually pack to avoid struct padding implementation differences
   uint16_t magic = htons(packet.header.magic);
@@ -41,8 +48,6 @@ std::vector<char> ProtocolParser::serializePacket(const Packet &packet) {
   if (!packet.payload.empty()) {
     std::memcpy(ptr, packet.payload.data(), packet.payload.size());
   }
-
-  return buffer;
 }
 
 Packet
@@ -77,7 +82,8 @@ ProtocolParser::deserializePacketHeader(const std::vector<char> &headerData) {
     throw std::runtime_error("Invalid Protocol Magic");
   }
   if (packet.header.version != PROTOCOL_VERSION &&
-      packet.header.version != PROTOCOL_VERSION_2) {
+      packet.header.version != PROTOCOL_VERSION_2 &&
+      packet.header.version != PROTOCOL_VERSION_3) {
     throw std::runtime_error("Unsupported Protocol Version");
   }
 
@@ -107,12 +113,18 @@ Packet ProtocolParser::createDiscoveryPacket(int port,
 }
 
 Packet ProtocolParser::createPairingResponse(int sessionId, bool success,
-                                             const std::string &msg) {
+                                             const std::string &msg,
+                                             long long inlineMaxBytes,
+                                             int protocolVersion) {
   json j;
   j["sessionId"] = sessionId;
   j["success"] = success;
   if (!msg.empty())
     j["message"] = msg;
+  if (inlineMaxBytes > 0)
+    j["inlineMaxBytes"] = inlineMaxBytes;
+  if (protocolVersion > 0)
+    j["protocolVersion"] = protocolVersion;
   return createJsonPacket(PacketType::PAIRING_RESPONSE, j);
 }
 
@@ -178,12 +190,32 @@ static Packet createJsonPacketV2(PacketTypeV2 type, const json &j) {
 Packet ProtocolParser::createUploadAckPacket(const std::string &uploadId,
                                              int chunkSize,
                                              long long receivedBytes,
-                                             const std::string &status) {
+                                             const std::string &status,
+                                             long long windowBytes,
+                                             int ackEvery) {
+  UploadAckPayload ack;
+  ack.uploadId = uploadId;
+  ack.chunkSize = chunkSize;
+  ack.receivedBytes = receivedBytes;
+  ack.status = status;
+  ack.windowBytes = windowBytes;
+  ack.ackEvery = ackEvery;
+  return createUploadAckPacket(ack);
+}
+
+Packet ProtocolParser::createUploadAckPacket(const UploadAckPayload &ack) {
   json j;
-  j["uploadId"] = uploadId;
-  j["chunkSize"] = chunkSize;
-  j["receivedBytes"] = receivedBytes;
-  j["status"] = status;
+  j["uploadId"] = ack.uploadId;
+  j["chunkSize"] = ack.chunkSize;
+  j["receivedBytes"] = ack.receivedBytes;
+  j["status"] = ack.status;
+  if (ack.windowBytes > 0) {
+    j["windowBytes"] = ack.windowBytes;
+    j["ackEvery"] = ack.ackEvery;
+  }
+  if (ack.maxConcurrentUploads > 0) {
+    j["maxConcurrentUploads"] = ack.maxConcurrentUploads;
+  }
   return createJsonPacketV2(PacketTypeV2::UPLOAD_ACK, j);
 }
 
@@ -206,3 +238,57 @@ Packet ProtocolParser::createUploadResultPacket(const std::string &uploadId,
   j["message"] = message;
   return createJsonPacketV2(PacketTypeV2::UPLOAD_RESULT, j);
 }
+
+Packet ProtocolParser::createUploadInlinePacket(
+    const UploadInlinePayload &upload) {
+  json j;
+  j["filename"] = upload.filename;
+  j["size"] = upload.size;
+  j["sha256"] = upload.sha256;
+  if (!upload.traceId.empty())
+    j["traceId"] = upload.traceId;
+  std::string meta = j.dump();
+
+  Packet p;
+  p.header.magic = PROTOCOL_MAGIC;
+  p.header.version = PROTOCOL_VERSION_2;
+  p.header.type =
+      static_cast<PacketType>(static_cast<uint8_t>(PacketTypeV2::UPLOAD_INLINE));
+
+  uint32_t metaLength = toNetworkOrder((uint32_t)meta.size());
+  p.payload.resize(sizeof(metaLength) + meta.size() + upload.dataLength);
+  char *ptr = p.payload.data();
+  std::memcpy(ptr, &metaLength, sizeof(metaLength));
+  std::memcpy(ptr + sizeof(metaLength), meta.data(), meta.size());
+  if (upload.dataLength > 0)
+    std::memcpy(ptr + sizeof(metaLength) + meta.size(), upload.data,
+                upload.dataLength);
+  p.header.payloadLength = (uint32_t)p.payload.size();
+  return p;
+}
+
+bool ProtocolParser::parseUploadInline(const std::vector<char> &payload,
+                                       UploadInlinePayload &out) {
+  uint32_t metaLength = 0;
+  if (payload.size() < sizeof(metaLength))
+    return false;
+  std::memcpy(&metaLength, payload.data(), sizeof(metaLength));
+  metaLength = fromNetworkOrder(metaLength);
+  if (metaLength > payload.size() - sizeof(metaLength))
+    return false;
+
+  const char *meta = payload.data() + sizeof(metaLength);
+  json j = json::parse(meta, meta + metaLength, nullptr, false);
+  if (j.is_discarded() || !j.is_object())
+    return false;
+
+  out.filename = j.value("filename", "");
+  out.size = j.value("size", -1LL);
+  out.sha256 = j.value("sha256", "");
+  out.traceId = j.value("traceId", "");
+  out.data = meta + metaLength;
+  out.dataLength = payload.size() - sizeof(metaLength) - metaLength;
+
+  return !out.filename.empty() && !out.sha256.empty() &&
+         out.size == (long long)out.dataLength;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DatabaseManager.h"
+#include <array>
 #include <cstdint>
 #include <nlohmann/json.hpp>
 #include <string>
@@ -53,11 +54,14 @@ enum class ErrorCode : int {
   FILE_EXISTS = 401,
   HASH_MISMATCH = 409,
   // Phase 2 Errors
-  INVALID_OFFSET = 416
+  INVALID_OFFSET = 416,
+  TOO_MANY_UPLOADS = 429,
+  SERVER_BUSY = 503 // Connection limit reached; reconnect later
 };
 
 // Phase 2: Protocol V2
 const uint8_t PROTOCOL_VERSION_2 = 2;
+const int UPLOAD_CHUNK_SIZE = 1024 * 1024; // Chunk size hint sent in UPLOAD_ACK
 
 enum class PacketTypeV2 : uint8_t {
   UPLOAD_INIT = 0x10,     // Client -> Server: Start/Resume request
@@ -66,39 +70,51 @@ enum class PacketTypeV2 : uint8_t {
   UPLOAD_FINISH = 0x13,   // Client -> Server: Commit request
   UPLOAD_RESULT = 0x14,   // Server -> Client: Final result
   UPLOAD_ABORT = 0x15,    // Bidirectional: Cancel
-  UPLOAD_CHUNK_ACK = 0x16 // Server -> Client: Chunk success/flow control
+  UPLOAD_CHUNK_ACK = 0x16, // Server -> Client: Chunk success/flow control
+  UPLOAD_INLINE = 0x17     // Client -> Server: Whole small file in one packet
 };
 
 struct UploadInitPayload {
   std::string filename;
-  long long size;
+  long long size = 0;
   std::string hash;
   std::string traceId;
+  bool windowed = false; // Client can pipeline chunks (see UploadAckPayload)
 };
 
 struct UploadAckPayload {
   std::string uploadId;
-  int chunkSize;
-  long long receivedBytes;
+  int chunkSize = UPLOAD_CHUNK_SIZE;
+  long long receivedBytes = 0;
   std::string status; // "RESUMING", "NEW", "COMPLETE"
+  // Windowed mode, only present when the client sent "windowed": true in
+  // UPLOAD_INIT: the client may keep windowBytes unacknowledged and the
+  // server sends one cumulative UPLOAD_CHUNK_ACK per ackEvery chunks (and
+  // one when the file is complete). An offset gap is answered with a single
+  // INVALID_OFFSET error; later chunks are dropped until the client resumes.
+  long long windowBytes = 0;
+  int ackEvery = 0;
+  // Uploads a client may keep open at once on this connection, interleaving
+  // their chunks; UPLOAD_INIT beyond it fails with TOO_MANY_UPLOADS. 0 = omit.
+  int maxConcurrentUploads = 0;
 };
 
-struct UploadChunkHeader { // Explicit binary header for 0x12
-  char uploadId[36]; // UUID string (36 bytes) OR 16 bytes raw? Spec says 16
-                     // bytes raw. But DB uses string. Let's stick to string for
-                     // simplicity across layers? Spec says: [UploadID (16
-                     // bytes)] [Offset (8 bytes)] [DataLength (4 bytes)] I MUST
-                     // FOLLOW SPEC. 16 BYTES RAW. Wait, DB
-                     // generateUploadSession uses 32 hex chars (string). UUID
-                     // is 16 bytes. I'll implementation needs to convert hex
-                     // string to 16 bytes. For now let's persist the struct
-                     // definition. Actually, TcpListener will handle binary
-                     // parsing.
+// Upload ids are UUID-formatted text (8-4-4-4-12 lowercase hex); V3 chunk
+// headers carry the 16 bytes that text encodes
+using RawUploadId = std::array<uint8_t, 16>;
+
+// UPLOAD_CHUNK (0x12) payload: [UploadID] [Offset (8 bytes, BE)] [data].
+// V2 sends the 36-character text id, V3 the 16 raw bytes.
+struct UploadChunkHeader {
+  RawUploadId uploadId{};
+  long long offset = 0;
+  const char *data = nullptr; // Points into the parsed packet's payload
+  size_t dataLength = 0;
 };
 
 struct UploadChunkAckPayload {
   std::string uploadId;
-  long long nextExpectedOffset;
+  long long nextExpectedOffset = 0;
   std::string status;
 };
 
@@ -107,36 +123,89 @@ struct UploadFinishPayload {
   std::string sha256;
 };
 
+// UPLOAD_INLINE (0x17) payload: [MetaLength (4 bytes, BE)] [JSON metadata]
+// [file bytes]. The metadata is {"filename","size","sha256","traceId"?}. The
+// server verifies and stores the file in one step, without an upload
+// session, and answers with UPLOAD_RESULT whose uploadId is the sha256.
+// Only files up to the inlineMaxBytes advertised in PAIRING_RESPONSE may be
+// sent this way.
+struct UploadInlinePayload {
+  std::string filename;
+  long long size = 0;
+  std::string sha256;
+  std::string traceId;
+  const char *data = nullptr; // Points into the parsed packet's payload
+  size_t dataLength = 0;
+};
+
 struct UploadResultPayload {
   std::string uploadId;
   std::string status;
   std::string message;
 };
 
+// Protocol V3: the V2 packet types, but the control messages carry compact
+// fixed-layout binary payloads instead of JSON. A client opts in by sending
+// "maxVersion": 3 in PAIRING_REQUEST; PAIRING_RESPONSE carries the
+// "protocolVersion" the server will answer with. Integers are big-endian;
+// str8/str16 are strings with a 1/2-byte length prefix. Status strings travel
+// as one-byte codes, in the order listed. Decoders ignore trailing bytes so
+// fields can be appended later.
+//   UPLOAD_INIT      flags u8 (bit 0 windowed), size i64, hash str8,
+//                    filename str16, traceId str8
+//   UPLOAD_ACK       status u8 (NEW, RESUMING, COMPLETE), chunkSize u32,
+//                    receivedBytes i64, windowBytes i64, ackEvery u16,
+//                    maxConcurrentUploads u16, uploadId str8
+//   UPLOAD_CHUNK_ACK status u8 (OK), nextExpectedOffset i64, uploadId str8
+//   UPLOAD_FINISH    uploadId str8, sha256 str8
+//   UPLOAD_RESULT    status u8 (SUCCESS, ERROR, ABORTED), uploadId str8,
+//                    message str16
+//   UPLOAD_ABORT     uploadId str8
+// UPLOAD_CHUNK carries the raw 16-byte upload id (see UploadChunkHeader);
+// UPLOAD_INLINE keeps its V2 layout and errors stay JSON PROTOCOL_ERROR
+// packets.
+const uint8_t PROTOCOL_VERSION_3 = 3;
+
 class ProtocolParser {
 public:
   // Serialization
   static std::vector<char> serializePacket(const Packet &packet);
+  // Serialize onto the end of out, e.g. a connection's outbound buffer
+  static void appendPacket(const Packet &packet, std::vector<char> &out);
   static Packet deserializePacketHeader(const std::vector<char> &headerData);
 
   // High-level Packet Creators
   static Packet createDiscoveryPacket(int port, const std::string &name);
+  // inlineMaxBytes > 0 advertises UPLOAD_INLINE for files up to that size;
+  // protocolVersion > 0 tells the client which control encoding to use
   static Packet createPairingResponse(int sessionId, bool success,
-                                      const std::string &msg = "");
+                                      const std::string &msg = "",
+                                      long long inlineMaxBytes = 0,
+                                      int protocolVersion = 0);
   static Packet createHeartbeatPacket();
   static Packet createTransferReadyPacket(long long offset);
   static Packet createTransferCompletePacket(const std::string &fileHash);
 
   // Phase 2 Factories
+  static Packet createUploadAckPacket(const UploadAckPayload &ack);
+  // windowBytes > 0 grants windowed mode (see UploadAckPayload)
   static Packet createUploadAckPacket(const std::string &uploadId,
                                       int chunkSize, long long receivedBytes,
-                                      const std::string &status);
+                                      const std::string &status,
+                                      long long windowBytes = 0,
+                                      int ackEvery = 0);
   static Packet createUploadChunkAckPacket(const std::string &uploadId,
                                            long long nextExpectedOffset,
                                            const std::string &status);
   static Packet createUploadResultPacket(const std::string &uploadId,
                                          const std::string &status,
                                          const std::string &message);
+  static Packet createUploadInlinePacket(const UploadInlinePayload &upload);
+
+  // Split an UPLOAD_INLINE payload; false if it is malformed or the body
+  // length does not match the declared size
+  static bool parseUploadInline(const std::vector<char> &payload,
+                                UploadInlinePayload &out);
 
   // Deprecated: verify where this is used and migrate to ErrorCode version
   static Packet createErrorPacket(const std::string &message,
@@ -145,6 +214,60 @@ public:
   // JSON Helper
   static json parsePayload(const Packet &packet);
 
+  // Client control messages in either encoding, chosen by the header
+  // version (V2 JSON or V3 binary). Throw if the payload is malformed.
+  static UploadInitPayload parseUploadInit(const Packet &packet);
+  static UploadFinishPayload parseUploadFinish(const Packet &packet);
+  static std::string parseUploadAbort(const Packet &packet);
+
+  // Split an UPLOAD_CHUNK payload of either version without allocating; a V2
+  // text id is packed into its raw form. False if the header is short or the
+  // id is not UUID-formatted.
+  static bool parseUploadChunk(const std::vector<char> &payload,
+                               uint8_t version, UploadChunkHeader &out);
+
+  // Between the text and raw forms of an upload id; packing fails on
+  // anything but 36-character UUID text
+  static bool packUploadId(const char *text, size_t length, RawUploadId &raw);
+  static bool packUploadId(const std::string &text, RawUploadId &raw) {
+    return packUploadId(text.data(), text.size(), raw);
+  }
+  static std::string unpackUploadId(const RawUploadId &raw);
+
+  // V3 binary control messages (layouts above). Encoders append a complete
+  // packet, header included, to out with no JSON or intermediate Packet;
+  // decoders read the payload in place and return false if it is truncated
+  // or carries an unknown status code.
+  static void appendUploadInit(const UploadInitPayload &init,
+                               std::vector<char> &out);
+  static void appendUploadAck(const UploadAckPayload &ack,
+                              std::vector<char> &out);
+  static void appendUploadChunkAck(const std::string &uploadId,
+                                   long long nextExpectedOffset,
+                                   const std::string &status,
+                                   std::vector<char> &out);
+  static void appendUploadFinish(const UploadFinishPayload &finish,
+                                 std::vector<char> &out);
+  static void appendUploadResult(const std::string &uploadId,
+                                 const std::string &status,
+                                 const std::string &message,
+                                 std::vector<char> &out);
+  static void appendUploadAbort(const std::string &uploadId,
+                                std::vector<char> &out);
+
+  static bool decodeUploadInit(const char *data, size_t length,
+                               UploadInitPayload &out);
+  static bool decodeUploadAck(const char *data, size_t length,
+                              UploadAckPayload &out);
+  static bool decodeUploadChunkAck(const char *data, size_t length,
+                                   UploadChunkAckPayload &out);
+  static bool decodeUploadFinish(const char *data, size_t length,
+                                 UploadFinishPayload &out);
+  static bool decodeUploadResult(const char *data, size_t length,
+                                 UploadResultPayload &out);
+  static bool decodeUploadAbort(const char *data, size_t length,
+                                std::string &uploadId);
+
   // Helper to get raw bytes for network sending
   static std::vector<char> pack(const Packet &packet) {
     return serializePacket(packet);
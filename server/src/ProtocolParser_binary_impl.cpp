@@ -0,0 +1,383 @@
+#include "ProtocolParser.h"
+#include <cstring>
+#include <stdexcept>
+
+// Protocol V3 binary control messages (layouts in ProtocolParser.h) and the
+// version-dispatching parsers used by Session. Encoding sizes the packet up
+// front and writes it into the caller's buffer in place, so a chunk ack costs
+// no allocation once the connection's outbound buffer has warmed up.
+
+namespace {
+
+constexpr size_t HEADER_SIZE = 8; // magic u16, version u8, type u8, length u32
+
+const char *const ACK_STATUSES[] = {"NEW", "RESUMING", "COMPLETE"};
+const char *const CHUNK_ACK_STATUSES[] = {"OK"};
+const char *const RESULT_STATUSES[] = {"SUCCESS", "ERROR", "ABORTED"};
+
+template <size_t N>
+uint8_t statusCode(const char *const (&names)[N], const std::string &status) {
+  for (size_t i = 0; i < N; ++i) {
+    if (status == names[i])
+      return (uint8_t)i;
+  }
+  return 0xFF; // Rejected by the decoder
+}
+
+template <size_t N>
+bool statusName(const char *const (&names)[N], uint8_t code,
+                std::string &status) {
+  if (code >= N)
+    return false;
+  status.assign(names[code]);
+  return true;
+}
+
+// Strings longer than their length prefix allows are cut short
+size_t len8(const std::string &s) { return std::min<size_t>(s.size(), 0xFF); }
+size_t len16(const std::string &s) {
+  return std::min<size_t>(s.size(), 0xFFFF);
+}
+
+// Writes one packet into space reserved at the end of out
+class Writer {
+public:
+  Writer(std::vector<char> &out, PacketTypeV2 type, size_t payloadLength) {
+    size_t start = out.size();
+    out.resize(start + HEADER_SIZE + payloadLength);
+    ptr_ = out.data() + start;
+    u16(PROTOCOL_MAGIC);
+    u8(PROTOCOL_VERSION_3);
+    u8(static_cast<uint8_t>(type));
+    u32((uint32_t)payloadLength);
+  }
+
+  void u8(uint8_t v) { *ptr_++ = (char)v; }
+  void u16(uint16_t v) {
+    u8((uint8_t)(v >> 8));
+    u8((uint8_t)v);
+  }
+  void u32(uint32_t v) {
+    u16((uint16_t)(v >> 16));
+    u16((uint16_t)v);
+  }
+  void i64(long long v) {
+    u32((uint32_t)((uint64_t)v >> 32));
+    u32((uint32_t)v);
+  }
+  void str8(const std::string &s) {
+    u8((uint8_t)len8(s));
+    bytes(s.data(), len8(s));
+  }
+  void str16(const std::string &s) {
+    u16((uint16_t)len16(s));
+    bytes(s.data(), len16(s));
+  }
+
+private:
+  void bytes(const char *data, size_t length) {
+    std::memcpy(ptr_, data, length);
+    ptr_ += length;
+  }
+
+  char *ptr_;
+};
+
+// Bounds-checked reads; after the first overrun every read yields zero and
+// ok() stays false
+class Reader {
+public:
+  Reader(const char *data, size_t length) : ptr_(data), end_(data + length) {}
+
+  bool ok() const { return ok_; }
+
+  uint8_t u8() {
+    if (!need(1))
+      return 0;
+    return (uint8_t)*ptr_++;
+  }
+  uint16_t u16() {
+    uint16_t hi = u8();
+    return (uint16_t)((hi << 8) | u8());
+  }
+  uint32_t u32() {
+    uint32_t hi = u16();
+    return (hi << 16) | u16();
+  }
+  long long i64() {
+    uint64_t hi = u32();
+    return (long long)((hi << 32) | u32());
+  }
+  void str8(std::string &s) { bytes(u8(), s); }
+  void str16(std::string &s) { bytes(u16(), s); }
+
+private:
+  bool need(size_t n) {
+    if (ok_ && (size_t)(end_ - ptr_) >= n)
+      return true;
+    ok_ = false;
+    return false;
+  }
+  void bytes(size_t length, std::string &s) {
+    if (!need(length)) {
+      s.clear();
+      return;
+    }
+    s.assign(ptr_, length);
+    ptr_ += length;
+  }
+
+  const char *ptr_;
+  const char *end_;
+  bool ok_ = true;
+};
+
+bool isBinary(const Packet &packet) {
+  return packet.header.version >= PROTOCOL_VERSION_3;
+}
+
+} // namespace
+
+// Encoders
+
+void ProtocolParser::appendUploadInit(const UploadInitPayload &init,
+                                      std::vector<char> &out) {
+  Writer w(out, PacketTypeV2::UPLOAD_INIT,
+           1 + 8 + 1 + len8(init.hash) + 2 + len16(init.filename) + 1 +
+               len8(init.traceId));
+  w.u8(init.windowed ? 1 : 0);
+  w.i64(init.size);
+  w.str8(init.hash);
+  w.str16(init.filename);
+  w.str8(init.traceId);
+}
+
+void ProtocolParser::appendUploadAck(const UploadAckPayload &ack,
+                                     std::vector<char> &out) {
+  Writer w(out, PacketTypeV2::UPLOAD_ACK,
+           1 + 4 + 8 + 8 + 2 + 2 + 1 + len8(ack.uploadId));
+  w.u8(statusCode(ACK_STATUSES, ack.status));
+  w.u32((uint32_t)ack.chunkSize);
+  w.i64(ack.receivedBytes);
+  w.i64(ack.windowBytes);
+  w.u16((uint16_t)ack.ackEvery);
+  w.u16((uint16_t)ack.maxConcurrentUploads);
+  w.str8(ack.uploadId);
+}
+
+void ProtocolParser::appendUploadChunkAck(const std::string &uploadId,
+                                          long long nextExpectedOffset,
+                                          const std::string &status,
+                                          std::vector<char> &out) {
+  Writer w(out, PacketTypeV2::UPLOAD_CHUNK_ACK, 1 + 8 + 1 + len8(uploadId));
+  w.u8(statusCode(CHUNK_ACK_STATUSES, status));
+  w.i64(nextExpectedOffset);
+  w.str8(uploadId);
+}
+
+void ProtocolParser::appendUploadFinish(const UploadFinishPayload &finish,
+                                        std::vector<char> &out) {
+  Writer w(out, PacketTypeV2::UPLOAD_FINISH,
+           1 + len8(finish.uploadId) + 1 + len8(finish.sha256));
+  w.str8(finish.uploadId);
+  w.str8(finish.sha256);
+}
+
+void ProtocolParser::appendUploadResult(const std::string &uploadId,
+                                        const std::string &status,
+                                        const std::string &message,
+                                        std::vector<char> &out) {
+  Writer w(out, PacketTypeV2::UPLOAD_RESULT,
+           1 + 1 + len8(uploadId) + 2 + len16(message));
+  w.u8(statusCode(RESULT_STATUSES, status));
+  w.str8(uploadId);
+  w.str16(message);
+}
+
+void ProtocolParser::appendUploadAbort(const std::string &uploadId,
+                                       std::vector<char> &out) {
+  Writer w(out, PacketTypeV2::UPLOAD_ABORT, 1 + len8(uploadId));
+  w.str8(uploadId);
+}
+
+// Decoders
+
+bool ProtocolParser::decodeUploadInit(const char *data, size_t length,
+                                      UploadInitPayload &out) {
+  Reader r(data, length);
+  out.windowed = (r.u8() & 0x01) != 0;
+  out.size = r.i64();
+  r.str8(out.hash);
+  r.str16(out.filename);
+  r.str8(out.traceId);
+  return r.ok();
+}
+
+bool ProtocolParser::decodeUploadAck(const char *data, size_t length,
+                                     UploadAckPayload &out) {
+  Reader r(data, length);
+  uint8_t status = r.u8();
+  out.chunkSize = (int)r.u32();
+  out.receivedBytes = r.i64();
+  out.windowBytes = r.i64();
+  out.ackEvery = r.u16();
+  out.maxConcurrentUploads = r.u16();
+  r.str8(out.uploadId);
+  return r.ok() && statusName(ACK_STATUSES, status, out.status);
+}
+
+bool ProtocolParser::decodeUploadChunkAck(const char *data, size_t length,
+                                          UploadChunkAckPayload &out) {
+  Reader r(data, length);
+  uint8_t status = r.u8();
+  out.nextExpectedOffset = r.i64();
+  r.str8(out.uploadId);
+  return r.ok() && statusName(CHUNK_ACK_STATUSES, status, out.status);
+}
+
+bool ProtocolParser::decodeUploadFinish(const char *data, size_t length,
+                                        UploadFinishPayload &out) {
+  Reader r(data, length);
+  r.str8(out.uploadId);
+  r.str8(out.sha256);
+  return r.ok();
+}
+
+bool ProtocolParser::decodeUploadResult(const char *data, size_t length,
+                                        UploadResultPayload &out) {
+  Reader r(data, length);
+  uint8_t status = r.u8();
+  r.str8(out.uploadId);
+  r.str16(out.message);
+  return r.ok() && statusName(RESULT_STATUSES, status, out.status);
+}
+
+bool ProtocolParser::decodeUploadAbort(const char *data, size_t length,
+                                       std::string &uploadId) {
+  Reader r(data, length);
+  r.str8(uploadId);
+  return r.ok();
+}
+
+// Upload ids and chunk headers
+
+namespace {
+
+constexpr size_t UUID_TEXT_SIZE = 36;
+
+bool isDashPosition(size_t i) { return i == 8 || i == 13 || i == 18 || i == 23; }
+
+int hexValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+} // namespace
+
+bool ProtocolParser::packUploadId(const char *text, size_t length,
+                                  RawUploadId &raw) {
+  if (length != UUID_TEXT_SIZE)
+    return false;
+  size_t nibble = 0;
+  for (size_t i = 0; i < UUID_TEXT_SIZE; ++i) {
+    if (isDashPosition(i)) {
+      if (text[i] != '-')
+        return false;
+      continue;
+    }
+    int value = hexValue(text[i]);
+    if (value < 0)
+      return false;
+    if (nibble % 2 == 0)
+      raw[nibble / 2] = (uint8_t)(value << 4);
+    else
+      raw[nibble / 2] |= (uint8_t)value;
+    ++nibble;
+  }
+  return true;
+}
+
+std::string ProtocolParser::unpackUploadId(const RawUploadId &raw) {
+  static const char digits[] = "0123456789abcdef";
+  std::string text(UUID_TEXT_SIZE, '-');
+  size_t nibble = 0;
+  for (size_t i = 0; i < UUID_TEXT_SIZE; ++i) {
+    if (isDashPosition(i))
+      continue;
+    uint8_t byte = raw[nibble / 2];
+    text[i] = digits[nibble % 2 == 0 ? byte >> 4 : byte & 0x0F];
+    ++nibble;
+  }
+  return text;
+}
+
+bool ProtocolParser::parseUploadChunk(const std::vector<char> &payload,
+                                      uint8_t version,
+                                      UploadChunkHeader &out) {
+  size_t idSize = version >= PROTOCOL_VERSION_3 ? out.uploadId.size()
+                                                : UUID_TEXT_SIZE;
+  if (payload.size() < idSize + 8)
+    return false;
+
+  if (version >= PROTOCOL_VERSION_3) {
+    std::memcpy(out.uploadId.data(), payload.data(), idSize);
+  } else if (!packUploadId(payload.data(), idSize, out.uploadId)) {
+    return false;
+  }
+
+  Reader r(payload.data() + idSize, 8);
+  out.offset = r.i64();
+  out.data = payload.data() + idSize + 8;
+  out.dataLength = payload.size() - idSize - 8;
+  return true;
+}
+
+// Version-dispatching parsers
+
+UploadInitPayload ProtocolParser::parseUploadInit(const Packet &packet) {
+  UploadInitPayload init;
+  if (isBinary(packet)) {
+    if (!decodeUploadInit(packet.payload.data(), packet.payload.size(), init))
+      throw std::runtime_error("Malformed UPLOAD_INIT");
+    return init;
+  }
+
+  json j = parsePayload(packet);
+  init.filename = j.at("filename").get<std::string>();
+  init.size = j.at("size").get<long long>();
+  init.hash = j.at("hash").get<std::string>();
+  init.traceId = j.value("traceId", "");
+  init.windowed = j.value("windowed", false);
+  return init;
+}
+
+UploadFinishPayload ProtocolParser::parseUploadFinish(const Packet &packet) {
+  UploadFinishPayload finish;
+  if (isBinary(packet)) {
+    if (!decodeUploadFinish(packet.payload.data(), packet.payload.size(),
+                            finish))
+      throw std::runtime_error("Malformed UPLOAD_FINISH");
+    return finish;
+  }
+
+  json j = parsePayload(packet);
+  finish.uploadId = j.at("uploadId").get<std::string>();
+  finish.sha256 = j.at("sha256").get<std::string>();
+  return finish;
+}
+
+std::string ProtocolParser::parseUploadAbort(const Packet &packet) {
+  std::string uploadId;
+  if (isBinary(packet)) {
+    if (!decodeUploadAbort(packet.payload.data(), packet.payload.size(),
+                           uploadId))
+      throw std::runtime_error("Malformed UPLOAD_ABORT");
+    return uploadId;
+  }
+  return parsePayload(packet).at("uploadId").get<std::string>();
+}
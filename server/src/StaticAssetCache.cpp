@@ -0,0 +1,159 @@
+#include "StaticAssetCache.h"
+#include "Compression.h"
+#include "FileManager.h"
+#include "HttpUtils.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+bool StaticAssetCache::load(const std::string &rootDir) {
+  assets_.clear();
+  totalBytes_ = 0;
+
+  std::error_code ec;
+  if (!fs::is_directory(rootDir, ec)) {
+    LOG_ERROR("UI directory not found: " + rootDir);
+    return false;
+  }
+
+  fs::recursive_directory_iterator it(rootDir, ec), end;
+  for (; !ec && it != end; it.increment(ec)) {
+    const fs::path &path = it->path();
+    std::string name = path.filename().string();
+
+    // The dev-source fallback points at the dashboard checkout itself
+    if (it->is_directory() && (name == "node_modules" || name[0] == '.')) {
+      it.disable_recursion_pending();
+      continue;
+    }
+    if (!it->is_regular_file()) {
+      continue;
+    }
+    if (it->file_size() > MAX_FILE_BYTES) {
+      LOG_WARN("Skipping oversized UI file: " + path.string());
+      continue;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      LOG_WARN("Failed to read UI file: " + path.string());
+      continue;
+    }
+
+    std::string key = path.lexically_relative(rootDir).generic_string();
+
+    Asset asset;
+    asset.identity.assign(std::istreambuf_iterator<char>(file),
+                          std::istreambuf_iterator<char>());
+    asset.contentType = contentTypeFor(key);
+    // Vite emits content-hashed file names under assets/
+    asset.immutable = key.compare(0, 7, "assets/") == 0;
+
+    std::string hash = FileManager::calculateSHA256(
+        std::vector<char>(asset.identity.begin(), asset.identity.end()));
+    asset.etag = "\"" + hash.substr(0, 16) + "\"";
+
+    if (asset.identity.size() >= MIN_COMPRESS_BYTES &&
+        isCompressible(asset.contentType)) {
+      if (!Compression::gzip(asset.identity, asset.gzip) ||
+          asset.gzip.size() >= asset.identity.size()) {
+        asset.gzip.clear();
+      }
+      if (!Compression::brotli(asset.identity, asset.brotli) ||
+          asset.brotli.size() >= asset.identity.size()) {
+        asset.brotli.clear();
+      }
+    }
+
+    totalBytes_ +=
+        asset.identity.size() + asset.gzip.size() + asset.brotli.size();
+    assets_[key] = std::move(asset);
+  }
+
+  if (ec) {
+    LOG_ERROR("Failed to scan UI directory " + rootDir + ": " + ec.message());
+    return false;
+  }
+
+  LOG_INFO("Loaded " + std::to_string(assets_.size()) + " UI assets (" +
+           std::to_string(totalBytes_ / 1024) + " KB) from " + rootDir);
+  return true;
+}
+
+const StaticAssetCache::Asset *
+StaticAssetCache::find(const std::string &path) const {
+  auto it = assets_.find(path);
+  return it != assets_.end() ? &it->second : nullptr;
+}
+
+StaticAssetCache::Variant
+StaticAssetCache::select(const Asset &asset,
+                         const std::string &acceptEncoding) {
+  Variant variant;
+  variant.body = &asset.identity;
+  variant.etag = asset.etag;
+
+  // Each encoding gets its own ETag so caches never mix representations
+  auto withSuffix = [&asset](const char *suffix) {
+    std::string etag = asset.etag;
+    etag.insert(etag.size() - 1, suffix);
+    return etag;
+  };
+
+  if (!asset.brotli.empty() &&
+      HttpUtils::acceptsEncoding(acceptEncoding, "br")) {
+    variant.body = &asset.brotli;
+    variant.encoding = "br";
+    variant.etag = withSuffix("-br");
+  } else if (!asset.gzip.empty() &&
+             HttpUtils::acceptsEncoding(acceptEncoding, "gzip")) {
+    variant.body = &asset.gzip;
+    variant.encoding = "gzip";
+    variant.etag = withSuffix("-gz");
+  }
+  return variant;
+}
+
+std::string StaticAssetCache::contentTypeFor(const std::string &path) {
+  static const std::unordered_map<std::string, std::string> types = {
+      {".html", "text/html; charset=utf-8"},
+      {".css", "text/css; charset=utf-8"},
+      {".js", "application/javascript; charset=utf-8"},
+      {".mjs", "application/javascript; charset=utf-8"},
+      {".json", "application/json"},
+      {".map", "application/json"},
+      {".txt", "text/plain; charset=utf-8"},
+      {".svg", "image/svg+xml"},
+      {".png", "image/png"},
+      {".jpg", "image/jpeg"},
+      {".jpeg", "image/jpeg"},
+      {".gif", "image/gif"},
+      {".webp", "image/webp"},
+      {".ico", "image/x-icon"},
+      {".woff", "font/woff"},
+      {".woff2", "font/woff2"},
+      {".ttf", "font/ttf"},
+      {".wasm", "application/wasm"},
+  };
+
+  std::string ext = fs::path(path).extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  auto it = types.find(ext);
+  return it != types.end() ? it->second : "application/octet-stream";
+}
+
+bool StaticAssetCache::isCompressible(const std::string &contentType) {
+  return contentType.compare(0, 5, "text/") == 0 ||
+         contentType.find("javascript") != std::string::npos ||
+         contentType.find("json") != std::string::npos ||
+         contentType.find("svg") != std::string::npos ||
+         contentType.find("wasm") != std::string::npos ||
+         contentType == "font/ttf";
+}
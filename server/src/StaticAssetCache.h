@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+// Immutable in-memory copy of the dashboard bundle.
+// Every file under the UI directory is read once at startup together with
+// precompressed gzip (and, when built with brotli, br) variants, so serving a
+// static request is a map lookup with no disk I/O or per-request compression.
+class StaticAssetCache {
+public:
+  // Files larger than this are skipped (the bundle is a few MB at most)
+  static constexpr size_t MAX_FILE_BYTES = 16 * 1024 * 1024;
+  // Below this, compression does not pay for the extra header
+  static constexpr size_t MIN_COMPRESS_BYTES = 256;
+
+  struct Asset {
+    std::string contentType;
+    std::string identity;
+    std::string gzip;   // Empty if not compressible or not smaller
+    std::string brotli; // Empty if unavailable, not compressible or not smaller
+    std::string etag;   // Strong ETag of the identity body
+    bool immutable = false; // Content-hashed name, safe to cache forever
+  };
+
+  // A negotiated representation of an asset
+  struct Variant {
+    const std::string *body = nullptr;
+    const char *encoding = nullptr; // nullptr for identity
+    std::string etag;
+  };
+
+  // Replace the contents with every file under rootDir. Keys are relative
+  // paths with forward slashes, e.g. "assets/index-3f2a9c1b.js".
+  bool load(const std::string &rootDir);
+
+  // nullptr if the path is not part of the bundle
+  const Asset *find(const std::string &path) const;
+
+  // Pick the smallest representation the client accepts
+  static Variant select(const Asset &asset, const std::string &acceptEncoding);
+
+  size_t size() const { return assets_.size(); }
+  size_t totalBytes() const { return totalBytes_; }
+
+  static std::string contentTypeFor(const std::string &path);
+  static bool isCompressible(const std::string &contentType);
+
+private:
+  std::unordered_map<std::string, Asset> assets_;
+  size_t totalBytes_ = 0;
+};
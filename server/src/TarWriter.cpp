@@ -0,0 +1,148 @@
+#include "TarWriter.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const size_t BLOCK_SIZE = 512;
+
+// Octal field, NUL-terminated, right-aligned with leading zeros. Values too
+// large for the field use the GNU base-256 encoding.
+void putNumber(char *field, size_t width, unsigned long long value) {
+  unsigned long long limit = 1ULL << (3 * (width - 1));
+  if (value < limit) {
+    std::snprintf(field, width, "%0*llo", (int)(width - 1), value);
+    return;
+  }
+  std::memset(field, 0, width);
+  field[0] = (char)0x80;
+  for (size_t i = width - 1; i > 0 && value > 0; --i) {
+    field[i] = (char)(value & 0xFF);
+    value >>= 8;
+  }
+}
+
+} // namespace
+
+long long TarWriter::entrySize(const std::string &name, long long size) {
+  const long long block = (long long)BLOCK_SIZE;
+  auto padded = [block](long long n) { return (n + block - 1) / block * block; };
+  long long total = block + padded(size);
+  if (name.size() > 100) {
+    // Assume no prefix split, so a long-name entry is needed
+    total += block + padded((long long)name.size() + 1);
+  }
+  return total;
+}
+
+TarWriter::TarWriter(std::ostream &out) : out_(out), buffer_(BUFFER_SIZE) {}
+
+bool TarWriter::write(const char *data, size_t length) {
+  out_.write(data, length);
+  if (!out_) {
+    return false;
+  }
+  bytesWritten_ += length;
+  return true;
+}
+
+bool TarWriter::writePadding(long long size) {
+  size_t remainder = (size_t)(size % BLOCK_SIZE);
+  if (remainder == 0) {
+    return true;
+  }
+  char zeros[BLOCK_SIZE] = {0};
+  return write(zeros, BLOCK_SIZE - remainder);
+}
+
+bool TarWriter::writeHeader(const std::string &name, long long size,
+                            std::time_t mtime, char type) {
+  char header[BLOCK_SIZE];
+  std::memset(header, 0, sizeof(header));
+
+  // name[100] | mode[8] | uid[8] | gid[8] | size[12] | mtime[12] |
+  // chksum[8] | typeflag | linkname[100] | magic[6] | version[2] | ...
+  // prefix[155] at offset 345
+  if (name.size() <= 100) {
+    std::memcpy(header, name.data(), name.size());
+  } else {
+    // Split into prefix/name at a '/' if both halves fit
+    size_t split = name.rfind('/', 155);
+    if (split == std::string::npos || name.size() - split - 1 > 100 ||
+        split == 0) {
+      return false; // Caller emits a long-name entry first
+    }
+    std::memcpy(header + 345, name.data(), split);
+    std::memcpy(header, name.data() + split + 1, name.size() - split - 1);
+  }
+
+  putNumber(header + 100, 8, 0644);
+  putNumber(header + 108, 8, 0);
+  putNumber(header + 116, 8, 0);
+  putNumber(header + 124, 12, (unsigned long long)size);
+  putNumber(header + 136, 12, (unsigned long long)(mtime > 0 ? mtime : 0));
+  header[156] = type;
+  std::memcpy(header + 257, "ustar", 6);
+  std::memcpy(header + 263, "00", 2);
+
+  // Checksum is computed with the checksum field set to spaces
+  std::memset(header + 148, ' ', 8);
+  unsigned int checksum = 0;
+  for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+    checksum += (unsigned char)header[i];
+  }
+  std::snprintf(header + 148, 8, "%06o", checksum);
+  header[155] = ' ';
+
+  return write(header, BLOCK_SIZE);
+}
+
+bool TarWriter::addFile(const std::string &name, const std::string &sourcePath,
+                        long long size, std::time_t mtime) {
+  std::ifstream in(sourcePath, std::ios::binary);
+  if (!in) {
+    LOG_ERROR("Export: cannot open " + sourcePath);
+    return false;
+  }
+
+  if (!writeHeader(name, size, mtime, '0')) {
+    // GNU long name: a pseudo-entry whose data is the full name
+    std::string longName = name + '\0';
+    if (!writeHeader("././@LongLink", (long long)longName.size(), 0, 'L') ||
+        !write(longName.data(), longName.size()) ||
+        !writePadding((long long)longName.size()) ||
+        !writeHeader(name.substr(0, 100), size, mtime, '0')) {
+      return false;
+    }
+  }
+
+  long long remaining = size;
+  while (remaining > 0) {
+    size_t chunk = (size_t)std::min<long long>(remaining, buffer_.size());
+    in.read(buffer_.data(), chunk);
+    size_t got = (size_t)in.gcount();
+    if (got < chunk) {
+      // File shrank underneath us: keep the archive well-formed
+      LOG_WARN("Export: " + sourcePath + " is shorter than expected");
+      std::memset(buffer_.data() + got, 0, chunk - got);
+    }
+    if (!write(buffer_.data(), chunk)) {
+      return false;
+    }
+    remaining -= chunk;
+  }
+
+  return writePadding(size);
+}
+
+bool TarWriter::finish() {
+  char zeros[BLOCK_SIZE * 2] = {0};
+  if (!write(zeros, sizeof(zeros))) {
+    return false;
+  }
+  out_.flush();
+  return (bool)out_;
+}
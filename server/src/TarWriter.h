@@ -0,0 +1,41 @@
+#pragma once
+
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Minimal POSIX ustar writer for bulk exports.
+// File contents are copied from disk through one fixed-size buffer, so
+// memory use does not depend on the size of the files being archived.
+// Names longer than ustar allows are written with a GNU long-name entry.
+class TarWriter {
+public:
+  static const size_t BUFFER_SIZE = 64 * 1024;
+  // Bytes finish() writes
+  static const long long TRAILER_SIZE = 1024;
+
+  // Upper bound on the bytes addFile writes for one entry
+  static long long entrySize(const std::string &name, long long size);
+
+  explicit TarWriter(std::ostream &out);
+
+  // Append a regular file, copying `size` bytes from sourcePath
+  bool addFile(const std::string &name, const std::string &sourcePath,
+               long long size, std::time_t mtime);
+
+  // Write the end-of-archive marker (two zero blocks)
+  bool finish();
+
+  long long bytesWritten() const { return bytesWritten_; }
+
+private:
+  bool writeHeader(const std::string &name, long long size,
+                   std::time_t mtime, char type);
+  bool writePadding(long long size);
+  bool write(const char *data, size_t length);
+
+  std::ostream &out_;
+  std::vector<char> buffer_;
+  long long bytesWritten_ = 0;
+};
@@ -3,7 +3,12 @@
 #include "ConfigManager.h"
 #include "ConnectionManager.h"
 #include "Logger.h"
+#include "MetricsRegistry.h"
+#include "TlsContext.h"
+#include "TraceRecorder.h"
 #include "exif.h"
+#include <algorithm>
+#include <array>
 #include <boost/bind/bind.hpp>
 #include <filesystem>
 #include <fstream>
@@ -12,25 +17,12 @@
 namespace fs = std::filesystem;
 using boost::asio::ip::tcp;
 
-// Helper: 64-bit Network to Host
-long long fromNetworkOrder(long long value) {
-  // Detect endianness or just use a standard swap
-  // Simple check: Network is Big Endian.
-  // If Host is Little Endian (x86), swap.
-  const int num = 1;
-  if (*(char *)&num == 1) { // Little Endian
-    unsigned long long x = value;
-    x = ((x & 0x00000000000000FFULL) << 56) |
-        ((x & 0x000000000000FF00ULL) << 40) |
-        ((x & 0x0000000000FF0000ULL) << 24) |
-        ((x & 0x00000000FF000000ULL) << 8) |
-        ((x & 0x000000FF00000000ULL) >> 8) |
-        ((x & 0x0000FF0000000000ULL) >> 24) |
-        ((x & 0x00FF000000000000ULL) >> 40) |
-        ((x & 0xFF00000000000000ULL) >> 56);
-    return (long long)x;
-  }
-  return value;
+// Latency of a Session packet handler; the legacy and resumable upload paths
+// share a label per stage
+static Histogram &handlerLatency(const char *handler) {
+  return MetricsRegistry::getInstance().histogram(
+      "photosync_session_handler_seconds",
+      "Time spent in Session packet handlers", {{"handler", handler}});
 }
 
 #ifdef ERROR
@@ -43,8 +35,10 @@ long long fromNetworkOrder(long long value) {
 // --- Session ---
 
 Session::Session(boost::asio::ssl::stream<tcp::socket> socket,
-                 DatabaseManager &db, FileManager &fileManager)
-    : socket_(std::move(socket)), db_(db), fileManager_(fileManager) {
+                 DatabaseManager &db, FileManager &fileManager,
+                 ThumbnailQueue *thumbnails, UploadScheduler *scheduler)
+    : socket_(std::move(socket)), db_(db), fileManager_(fileManager),
+      thumbnails_(thumbnails), scheduler_(scheduler) {
   headerBuffer_.resize(8); // Fixed header size
   try {
     std::string clientIp =
@@ -58,10 +52,13 @@ Session::Session(boost::asio::ssl::stream<tcp::socket> socket,
 }
 
 void Session::log(const std::string &message, LogLevel level) {
+  if (!Logger::compiledIn(level))
+    return;
   Logger::getInstance().logWithTrace(level, currentTraceId_, message);
 }
 
 Session::~Session() {
+  TlsContext::keepResumable(socket_.native_handle());
   if (sessionId_ != -1) {
     ConnectionManager::getInstance().removeConnection(sessionId_);
     LOG_INFO("Client disconnected (Session: " + std::to_string(sessionId_) +
@@ -74,21 +71,37 @@ Session::~Session() {
 
 void Session::start() {
   auto self(shared_from_this());
-  socket_.async_handshake(boost::asio::ssl::stream_base::server,
-                          [this, self](const boost::system::error_code &error) {
-                            if (!error) {
-                              doReadHeader();
-                            } else {
-                              LOG_ERROR("SSL Handshake failed: " +
-                                        error.message());
-                            }
-                          });
+  auto started = std::chrono::steady_clock::now();
+  socket_.async_handshake(
+      boost::asio::ssl::stream_base::server,
+      [this, self, started](const boost::system::error_code &error) {
+        if (!error) {
+          TlsContext::recordHandshake(socket_.native_handle(),
+                                      std::chrono::steady_clock::now() -
+                                          started);
+          kernelReceive_ = TlsContext::enableKernelReceive(
+              socket_.native_handle(), socket_.next_layer().native_handle());
+          doReadHeader();
+        } else {
+          TlsContext::recordHandshakeFailure();
+          LOG_ERROR("SSL Handshake failed: " + error.message());
+        }
+      });
+}
+
+template <typename Handler>
+void Session::asyncReadExactly(boost::asio::mutable_buffer buffer,
+                               Handler handler) {
+  if (kernelReceive_)
+    boost::asio::async_read(socket_.next_layer(), buffer, std::move(handler));
+  else
+    boost::asio::async_read(socket_, buffer, std::move(handler));
 }
 
 void Session::doReadHeader() {
   auto self(shared_from_this());
-  boost::asio::async_read(
-      socket_, boost::asio::buffer(headerBuffer_),
+  asyncReadExactly(
+      boost::asio::buffer(headerBuffer_),
       [this, self](boost::system::error_code ec, std::size_t /*length*/) {
         if (!ec) {
           try {
@@ -121,34 +134,77 @@ void Session::doReadPayload(PacketHeader header) {
   auto self(shared_from_this());
   payloadBuffer_.resize(header.payloadLength);
 
-  boost::asio::async_read(socket_, boost::asio::buffer(payloadBuffer_),
-                          [this, self, header](boost::system::error_code ec,
-                                               std::size_t /*length*/) {
-                            if (!ec) {
-                              Packet packet;
-                              packet.header = header;
-                              packet.payload = payloadBuffer_;
-                              handlePacket(packet);
-                            }
-                          });
+  asyncReadExactly(boost::asio::buffer(payloadBuffer_),
+                   [this, self, header](boost::system::error_code ec,
+                                        std::size_t /*length*/) {
+                     if (!ec) {
+                       Packet packet;
+                       packet.header = header;
+                       packet.payload = std::move(payloadBuffer_);
+                       handlePacket(std::move(packet));
+                     }
+                   });
+}
+
+bool Session::carriesFileData(const PacketHeader &header) {
+  if (header.version == PROTOCOL_VERSION)
+    return header.type == PacketType::FILE_CHUNK;
+  auto type = static_cast<PacketTypeV2>(static_cast<uint8_t>(header.type));
+  return type == PacketTypeV2::UPLOAD_CHUNK ||
+         type == PacketTypeV2::UPLOAD_INLINE;
 }
 
-void Session::handlePacket(const Packet &packet) {
-  // Re-queue read immediately or process
+double Session::schedulingWeight(const Packet &packet) {
+  if (packet.header.version == PROTOCOL_VERSION)
+    return scheduler_->weightFor(currentFileSize_);
+  if (static_cast<PacketTypeV2>(static_cast<uint8_t>(packet.header.type)) ==
+      PacketTypeV2::UPLOAD_INLINE)
+    return scheduler_->weightFor(0); // Inline files are small by definition
+
+  UploadChunkHeader chunk;
+  if (ProtocolParser::parseUploadChunk(packet.payload, packet.header.version,
+                                       chunk)) {
+    auto it = uploads_.find(chunk.uploadId);
+    if (it != uploads_.end())
+      return scheduler_->weightFor(it->second.fileSize);
+  }
+  return 1; // Unknown upload; the handler will reject or resume it
+}
 
+void Session::handlePacket(Packet packet) {
+  // Nothing more is read from this connection until file data has had its
+  // turn, so a throttled device is slowed down by TCP flow control
+  if (scheduler_ && clientId_ != -1 && carriesFileData(packet.header)) {
+    auto self(shared_from_this());
+    auto pending = std::make_shared<Packet>(std::move(packet));
+    double weight = schedulingWeight(*pending);
+    scheduler_->submit(deviceId_, pending->payload.size(), weight,
+                       [this, self, pending]() {
+                         dispatchPacket(*pending);
+                         doReadHeader();
+                       });
+    return;
+  }
+
+  dispatchPacket(packet);
+  doReadHeader();
+}
+
+void Session::dispatchPacket(const Packet &packet) {
   try {
     // Dispatch based on version
     if (packet.header.version == PROTOCOL_VERSION) {
       switch (packet.header.type) {
       case PacketType::HEARTBEAT: {
         try {
-          std::string clientIp =
-              socket_.lowest_layer().remote_endpoint().address().to_string();
-          LOG_INFO("Heartbeat received from " + clientIp);
+          // Arguments are only evaluated when DEBUG is enabled
+          LOG_DEBUGF(
+              "Heartbeat received from {}",
+              socket_.lowest_layer().remote_endpoint().address().to_string());
           if (clientId_ != -1)
             db_.updateClientLastSeen(clientId_);
-          if (sessionId_ != -1)
-            ConnectionManager::getInstance().updateActivity(sessionId_);
+          if (stats_)
+            stats_->touch();
         } catch (...) {
         }
       } break;
@@ -168,21 +224,26 @@ void Session::handlePacket(const Packet &packet) {
         LOG_WARN("Unknown V1 packet type");
         break;
       }
-    } else if (packet.header.version == PROTOCOL_VERSION_2) {
+    } else if (packet.header.version == PROTOCOL_VERSION_2 ||
+               packet.header.version == PROTOCOL_VERSION_3) {
+      // Same packet types; V3 only changes the control payload encoding
       PacketTypeV2 type =
           static_cast<PacketTypeV2>(static_cast<uint8_t>(packet.header.type));
       switch (type) {
       case PacketTypeV2::UPLOAD_INIT:
-        handleUploadInit(ProtocolParser::parsePayload(packet));
+        handleUploadInit(ProtocolParser::parseUploadInit(packet));
         break;
       case PacketTypeV2::UPLOAD_CHUNK:
         handleUploadChunk(packet.payload, packet.header);
         break;
       case PacketTypeV2::UPLOAD_FINISH:
-        handleUploadFinish(ProtocolParser::parsePayload(packet));
+        handleUploadFinish(ProtocolParser::parseUploadFinish(packet));
         break;
       case PacketTypeV2::UPLOAD_ABORT:
-        handleUploadAbort(ProtocolParser::parsePayload(packet));
+        handleUploadAbort(ProtocolParser::parseUploadAbort(packet));
+        break;
+      case PacketTypeV2::UPLOAD_INLINE:
+        handleUploadInline(packet.payload);
         break;
       default:
         LOG_WARN("Unknown V2 packet type");
@@ -194,22 +255,47 @@ void Session::handlePacket(const Packet &packet) {
     sendPacket(ProtocolParser::createErrorPacket("Processing error",
                                                  ErrorCode::PROTOCOL_ERROR));
   }
+}
 
-  // Continue loop
-  doReadHeader();
+template <typename Append> void Session::queueOutbound(Append append) {
+  if (writeFailed_)
+    return;
+  append(outPending_);
+  if (!writeInFlight_)
+    doWrite();
 }
 
 void Session::sendPacket(const Packet &packet) {
+  queueOutbound([&](std::vector<char> &out) {
+    ProtocolParser::appendPacket(packet, out);
+  });
+}
+
+void Session::doWrite() {
+  // Buffers that grew for a large response are not kept around
+  static constexpr size_t MAX_RETAINED_BYTES = 256 * 1024;
+
   auto self(shared_from_this());
-  std::vector<char> data = ProtocolParser::pack(packet);
+  outWriting_.swap(outPending_);
+  outPending_.clear();
+  if (outPending_.capacity() > MAX_RETAINED_BYTES)
+    outPending_.shrink_to_fit();
+  writeInFlight_ = true;
 
-  auto dataPtr = std::make_shared<std::vector<char>>(std::move(data));
+  // One contiguous buffer so a batch of acks becomes a single TLS record
   boost::asio::async_write(
-      socket_, boost::asio::buffer(*dataPtr),
-      [this, self, dataPtr](boost::system::error_code ec, std::size_t /*len*/) {
+      socket_, boost::asio::buffer(outWriting_),
+      [this, self](boost::system::error_code ec, std::size_t /*len*/) {
+        writeInFlight_ = false;
+        outWriting_.clear();
         if (ec) {
           LOG_ERROR("Write error: " + ec.message());
+          writeFailed_ = true;
+          outPending_.clear();
+          return;
         }
+        if (!outPending_.empty())
+          doWrite();
       });
 }
 
@@ -217,6 +303,10 @@ void Session::handlePairingRequest(const json &payload) {
   std::string deviceId = payload.value("deviceId", "");
   std::string token = payload.value("token", "");
   std::string userName = payload.value("userName", "");
+  // Clients that understand binary control messages say so up front
+  controlVersion_ = payload.value("maxVersion", 2) >= PROTOCOL_VERSION_3
+                        ? PROTOCOL_VERSION_3
+                        : PROTOCOL_VERSION_2;
 
   if (deviceId.empty()) {
     sendPacket(
@@ -254,19 +344,30 @@ void Session::handlePairingRequest(const json &payload) {
     int newSessionId = db_.createSession(clientId_);
     if (newSessionId > 0) {
       sessionId_ = newSessionId;
-      sendPacket(
-          ProtocolParser::createPairingResponse(sessionId_, true, "Connected"));
+      sendPacket(ProtocolParser::createPairingResponse(
+          sessionId_, true, "Connected",
+          (long long)ConfigManager::getInstance().getUploadInlineMaxKB() * 1024,
+          controlVersion_));
       LOG_INFO("Session started: " + std::to_string(sessionId_));
 
       // Register with ConnectionManager
       try {
-        ConnectionManager::getInstance().addConnection(
+        deviceId_ = deviceId;
+        stats_ = ConnectionManager::getInstance().addConnection(
             sessionId_, deviceId,
             socket_.lowest_layer().remote_endpoint().address().to_string(),
             userName);
       } catch (...) {
         // ignore endpoint error
       }
+
+      auto &metrics = MetricsRegistry::getInstance();
+      bytesMetric_ = &metrics.counter("photosync_upload_bytes_total",
+                                      "Upload payload bytes received",
+                                      {{"device", deviceId}});
+      photosMetric_ = &metrics.counter("photosync_photos_stored_total",
+                                       "Uploads stored as new photos",
+                                       {{"device", deviceId}});
     } else {
       sendPacket(
           ProtocolParser::createPairingResponse(-1, false, "Session Failed"));
@@ -278,6 +379,8 @@ void Session::handlePairingRequest(const json &payload) {
 } // End handlePairingRequest
 
 void Session::handleMetadata(const json &payload) {
+  static Histogram &latency = handlerLatency("init");
+  ScopedTimer timer(latency);
   std::string filename = payload.value("filename", "");
   long long size = payload.value("size", 0LL);
   std::string hash = payload.value("hash", "");
@@ -290,6 +393,9 @@ void Session::handleMetadata(const json &payload) {
             // Better to reset or generate one if missing?
             // For now, let's assume client sends it or we leave empty.
   }
+  ScopedSpan span(SpanPhase::INIT, currentTraceId_.empty() ? hash
+                                                           : currentTraceId_,
+                  (uint64_t)std::max(size, 0LL));
 
   log("Received metadata for: " + filename + " (" + std::to_string(size) +
       " bytes)");
@@ -315,7 +421,8 @@ void Session::handleMetadata(const json &payload) {
     // Check disk space (Simple check, 100MB buffer?)
     // TODO: Implement proper disk check in Task 4
     sendPacket(ProtocolParser::createTransferReadyPacket(0));
-    ConnectionManager::getInstance().updateStatus(sessionId_, "syncing");
+    if (stats_)
+      stats_->setStatus(ConnectionStats::SYNCING);
     log("Upload started: " + filename);
   } else {
     log("Failed to prepare upload for " + filename, LogLevel::L_ERROR);
@@ -325,14 +432,18 @@ void Session::handleMetadata(const json &payload) {
 }
 
 void Session::handleFileChunk(const std::vector<char> &data) {
+  static Histogram &latency = handlerLatency("chunk");
+  ScopedTimer timer(latency);
   if (currentTempPath_.empty())
     return;
 
+  ScopedSpan span(SpanPhase::CHUNK, uploadTraceId(), data.size());
   if (fileManager_.writeChunk(currentTempPath_, data, currentFileReceived_)) {
     currentFileReceived_ += data.size();
-    sessionBytes_ += data.size();
-    ConnectionManager::getInstance().updateProgress(sessionId_, sessionPhotos_,
-                                                    sessionBytes_);
+    if (stats_)
+      stats_->addBytes((long long)data.size());
+    if (bytesMetric_)
+      bytesMetric_->inc(data.size());
     // Ack? No, usually stream optimization.
   } else {
     log("Write failed for " + currentTempPath_, LogLevel::L_ERROR);
@@ -342,18 +453,29 @@ void Session::handleFileChunk(const std::vector<char> &data) {
 }
 
 void Session::handleTransferComplete(const json &payload) {
+  static Histogram &latency = handlerLatency("finish");
+  ScopedTimer timer(latency);
   // Finalize
   PhotoMetadata meta;
   meta.filename = currentFileName_;
   meta.size = currentFileSize_;
   meta.hash = currentFileHash_; // Verify?
 
+  const std::string traceId = uploadTraceId();
   std::string finalPath;
-  if (fileManager_.finalizeUpload(currentTempPath_, meta, finalPath)) {
+  bool finalized;
+  {
+    ScopedSpan span(SpanPhase::FINALIZE, traceId,
+                    (uint64_t)std::max(currentFileSize_, 0LL));
+    finalized = fileManager_.finalizeUpload(currentTempPath_, meta, finalPath);
+  }
+
+  if (finalized) {
     log("Photo saved: " + finalPath);
 
     // EXIF Extraction
     try {
+      ScopedSpan span(SpanPhase::EXIF, traceId);
       std::ifstream file(finalPath, std::ios::binary);
       if (file) {
         std::vector<unsigned char> fileBuffer(
@@ -382,7 +504,18 @@ void Session::handleTransferComplete(const json &payload) {
     }
 
     // Update DB with metadata
-    db_.insertPhoto(clientId_, meta, finalPath);
+    bool inserted;
+    {
+      ScopedSpan span(SpanPhase::DB_INSERT, traceId);
+      inserted = db_.insertPhoto(clientId_, meta, finalPath);
+    }
+    if (inserted) {
+      queueThumbnail(meta.hash, finalPath, traceId);
+      if (stats_)
+        stats_->addPhoto();
+      if (photosMetric_)
+        photosMetric_->inc();
+    }
     db_.updateClientLastSeen(clientId_);
   } else {
     log("Finalization failed", LogLevel::L_ERROR);
@@ -393,42 +526,176 @@ void Session::handleTransferComplete(const json &payload) {
   currentTempPath_.clear();
 }
 
+void Session::queueThumbnail(const std::string &hash, const std::string &path,
+                             const std::string &traceId) {
+  if (!thumbnails_) {
+    return;
+  }
+  int photoId = db_.getPhotoIdByHash(hash);
+  if (photoId != -1) {
+    thumbnails_->enqueue(photoId, path, ThumbnailQueue::Priority::INGEST,
+                         false, traceId);
+  }
+}
+
 // --- TcpListener ---
 
 TcpListener::TcpListener(boost::asio::io_context &io_context,
                          boost::asio::ssl::context &context, int port,
-                         DatabaseManager &db, FileManager &fileManager)
+                         DatabaseManager &db, FileManager &fileManager,
+                         ThumbnailQueue *thumbnails)
     : acceptor_(io_context, tcp::endpoint(tcp::v4(), port)), context_(context),
-      db_(db), fileManager_(fileManager) {
+      db_(db), fileManager_(fileManager), thumbnails_(thumbnails),
+      scheduler_(io_context,
+                 UploadScheduler::fromConfig(ConfigManager::getInstance())),
+      maxConnections_(ConfigManager::getInstance().getMaxConnections()) {
   doAccept();
 }
 
+size_t TcpListener::openSessions() {
+  sessions_.erase(std::remove_if(sessions_.begin(), sessions_.end(),
+                                 [](const std::weak_ptr<Session> &session) {
+                                   return session.expired();
+                                 }),
+                  sessions_.end());
+  return sessions_.size();
+}
+
 void TcpListener::doAccept() {
   acceptor_.async_accept(
       [this](boost::system::error_code ec, tcp::socket socket) {
         if (!ec) {
           boost::asio::ssl::stream<tcp::socket> ssl_stream(std::move(socket),
                                                            context_);
-          std::make_shared<Session>(std::move(ssl_stream), db_, fileManager_)
-              ->start();
+          if (maxConnections_ > 0 &&
+              openSessions() >= (size_t)maxConnections_) {
+            rejectBusy(std::move(ssl_stream));
+          } else {
+            auto session = std::make_shared<Session>(
+                std::move(ssl_stream), db_, fileManager_, thumbnails_,
+                &scheduler_);
+            // Only a limit needs the list; an expired entry would still pin
+            // the Session's make_shared allocation
+            if (maxConnections_ > 0)
+              sessions_.push_back(session);
+            session->start();
+          }
         }
 
         doAccept();
       });
 }
 
+// Read and discard whatever a rejected client still sends until it hangs
+// up, then close. Closing with unread data would make the kernel answer with
+// a reset, which can destroy the SERVER_BUSY error before it is read.
+static void
+drainAndClose(std::shared_ptr<boost::asio::ssl::stream<tcp::socket>> client,
+              std::shared_ptr<boost::asio::steady_timer> deadline) {
+  auto buffer = std::make_shared<std::array<char, 1024>>();
+  client->next_layer().async_read_some(
+      boost::asio::buffer(*buffer),
+      [client, deadline, buffer](boost::system::error_code ec, std::size_t) {
+        if (!ec) {
+          drainAndClose(client, deadline);
+          return;
+        }
+        deadline->cancel();
+        boost::system::error_code ignored;
+        client->lowest_layer().close(ignored);
+      });
+}
+
+void TcpListener::rejectBusy(boost::asio::ssl::stream<tcp::socket> stream) {
+  // Upper bound on the whole exchange; closing the socket ends any step
+  // still waiting on the client
+  static constexpr auto REJECT_TIMEOUT = std::chrono::seconds(5);
+  static Counter &rejected = MetricsRegistry::getInstance().counter(
+      "photosync_connections_rejected_total",
+      "Upload connections turned away at network.max_connections");
+  rejected.inc();
+  LOG_WARN("Connection limit reached; rejecting client");
+
+  // The handshake is still done so the client reads a SERVER_BUSY error
+  // rather than a reset it would retry immediately
+  auto client = std::make_shared<boost::asio::ssl::stream<tcp::socket>>(
+      std::move(stream));
+  boost::system::error_code ignored;
+  // The small error record must not wait behind unacked session tickets
+  client->lowest_layer().set_option(tcp::no_delay(true), ignored);
+
+  auto deadline = std::make_shared<boost::asio::steady_timer>(
+      client->get_executor(), REJECT_TIMEOUT);
+  deadline->async_wait([client](const boost::system::error_code &ec) {
+    if (ec)
+      return; // Cancelled once the client hung up
+    boost::system::error_code ignored;
+    client->lowest_layer().close(ignored);
+  });
+
+  client->async_handshake(
+      boost::asio::ssl::stream_base::server,
+      [client, deadline](const boost::system::error_code &error) {
+        if (error) {
+          deadline->cancel();
+          return;
+        }
+        auto reply = std::make_shared<std::vector<char>>();
+        ProtocolParser::appendPacket(
+            ProtocolParser::createErrorPacket("Server busy, try again later",
+                                              ErrorCode::SERVER_BUSY),
+            *reply);
+        boost::asio::async_write(
+            *client, boost::asio::buffer(*reply),
+            [client, deadline, reply](boost::system::error_code ec,
+                                      std::size_t) {
+              if (ec) {
+                drainAndClose(client, deadline);
+                return;
+              }
+              // close_notify; the client's pending request makes this end
+              // with an error rather than its close_notify, either way the
+              // rest is drained
+              client->async_shutdown(
+                  [client, deadline](const boost::system::error_code &) {
+                    drainAndClose(client, deadline);
+                  });
+            });
+      });
+}
+
 // Phase 2: Resumable Upload Handlers
 
-void Session::handleUploadInit(const json &payload) {
+std::string Session::uploadTraceId() const {
+  // Legacy clients may omit the trace id; fall back to the content hash
+  return currentTraceId_.empty() ? currentFileHash_ : currentTraceId_;
+}
+
+void Session::handleUploadInit(const UploadInitPayload &init) {
+  static Histogram &latency = handlerLatency("init");
+  ScopedTimer timer(latency);
   if (clientId_ == -1) {
     sendPacket(ProtocolParser::createErrorPacket("Unauthorized",
                                                  ErrorCode::AUTH_REQUIRED));
     return;
   }
 
-  std::string filename = payload["filename"];
-  long long fileSize = payload["size"];
-  std::string fileHash = payload["hash"];
+  const std::string &filename = init.filename;
+  long long fileSize = init.size;
+  const std::string &fileHash = init.hash;
+  // The upload id doubles as the trace id of every span of this upload
+  ScopedSpan span(SpanPhase::INIT, "", (uint64_t)std::max(fileSize, 0LL));
+
+  // Only INITs that open another upload count against the limit
+  auto rejectIfAtLimit = [&]() {
+    if ((int)uploads_.size() <
+        ConfigManager::getInstance().getUploadMaxConcurrent())
+      return false;
+    span.cancel();
+    sendPacket(ProtocolParser::createErrorPacket("Too Many Uploads",
+                                                 ErrorCode::TOO_MANY_UPLOADS));
+    return true;
+  };
 
   // 0. Pre-emptive Deduplication Check
   // If we already have the file, we can skip the transfer entirely.
@@ -441,10 +708,10 @@ void Session::handleUploadInit(const json &payload) {
       // Mark session as fully received so handleUploadFinish doesn't complain
       // about size mismatch
       db_.updateSessionReceivedBytes(uploadId, fileSize);
+      span.setTraceId(uploadId);
 
       log("Deduplication: File exists, skipping upload for " + filename);
-      sendPacket(ProtocolParser::createUploadAckPacket(uploadId, 1024 * 1024,
-                                                       fileSize, "RESUMING"));
+      sendUploadAck(init.windowed, uploadId, fileSize, "RESUMING");
       return;
     }
   }
@@ -454,28 +721,44 @@ void Session::handleUploadInit(const json &payload) {
       db_.getUploadSessionByHash(clientId_, fileHash, fileSize);
 
   if (!session.uploadId.empty()) {
-    // Found session, reconcile with filesystem
-    long long actualBytes = fileManager_.getFileSize(
-        fileManager_.getUploadTempPath(session.uploadId));
-
-    if (actualBytes != session.receivedBytes) {
-      log("Reconciling session bytes from " +
-          std::to_string(session.receivedBytes) + " to " +
-          std::to_string(actualBytes));
-      // Trust filesystem
-      db_.updateSessionReceivedBytes(session.uploadId, actualBytes);
-      session.receivedBytes = actualBytes;
+    span.setTraceId(session.uploadId);
+    if (ActiveUpload *active = findUpload(session.uploadId)) {
+      // Already open on this connection; memory is ahead of the DB
+      active->stream.flush();
+      session.receivedBytes = active->stream.size();
+    } else {
+      if (rejectIfAtLimit())
+        return;
+      // Found session, reconcile with filesystem
+      long long actualBytes = fileManager_.getFileSize(
+          fileManager_.getUploadTempPath(session.uploadId));
+
+      if (actualBytes != session.receivedBytes) {
+        log("Reconciling session bytes from " +
+            std::to_string(session.receivedBytes) + " to " +
+            std::to_string(actualBytes));
+        // Trust filesystem
+        db_.updateSessionReceivedBytes(session.uploadId, actualBytes);
+        session.receivedBytes = actualBytes;
+      }
+
+      if (!openUpload(session.uploadId, fileSize, session.receivedBytes)) {
+        sendPacket(ProtocolParser::createErrorPacket("File Error",
+                                                     ErrorCode::FILE_ERROR));
+        return;
+      }
     }
 
     log("Resuming upload session: " + session.uploadId + " at offset " +
         std::to_string(session.receivedBytes));
-    sendPacket(ProtocolParser::createUploadAckPacket(
-        session.uploadId, 1024 * 1024, session.receivedBytes,
-        "RESUMING")); // 1MB chunk hint
+    sendUploadAck(init.windowed, session.uploadId, session.receivedBytes,
+                  "RESUMING");
     return;
   }
 
   // 2. Create new session
+  if (rejectIfAtLimit())
+    return;
   // Check disk space
   if (!fileManager_.hasSpaceAvailable(fileSize)) {
     sendPacket(
@@ -491,86 +774,241 @@ void Session::handleUploadInit(const json &payload) {
     return;
   }
 
+  span.setTraceId(uploadId);
+  if (!openUpload(uploadId, fileSize, 0)) {
+    sendPacket(
+        ProtocolParser::createErrorPacket("File Error", ErrorCode::FILE_ERROR));
+    return;
+  }
   log("Created new upload session: " + uploadId);
-  sendPacket(
-      ProtocolParser::createUploadAckPacket(uploadId, 1024 * 1024, 0, "NEW"));
+  sendUploadAck(init.windowed, uploadId, 0, "NEW");
+}
+
+Session::ActiveUpload *Session::openUpload(const std::string &uploadId,
+                                           long long fileSize,
+                                           long long receivedBytes) {
+  RawUploadId key;
+  if (!ProtocolParser::packUploadId(uploadId, key))
+    return nullptr;
+
+  ActiveUpload &upload = uploads_[key];
+  if (!upload.stream.open(fileManager_.getUploadTempPath(uploadId),
+                          receivedBytes)) {
+    uploads_.erase(key);
+    return nullptr;
+  }
+  upload.uploadId = uploadId;
+  upload.fileSize = fileSize;
+  upload.persistedBytes = receivedBytes;
+  return &upload;
+}
+
+Session::ActiveUpload *Session::findUpload(const std::string &uploadId) {
+  RawUploadId key;
+  if (!ProtocolParser::packUploadId(uploadId, key))
+    return nullptr;
+  auto it = uploads_.find(key);
+  return it != uploads_.end() ? &it->second : nullptr;
+}
+
+void Session::closeUpload(const std::string &uploadId) {
+  RawUploadId key;
+  if (ProtocolParser::packUploadId(uploadId, key))
+    uploads_.erase(key);
+}
+
+void Session::sendUploadAck(bool windowed, const std::string &uploadId,
+                            long long receivedBytes,
+                            const std::string &status) {
+  ConfigManager &config = ConfigManager::getInstance();
+  UploadAckPayload ack;
+  ack.uploadId = uploadId;
+  ack.receivedBytes = receivedBytes;
+  ack.status = status;
+  ack.maxConcurrentUploads = config.getUploadMaxConcurrent();
+
+  long long windowBytes = (long long)config.getUploadWindowMB() * 1024 * 1024;
+  if (windowed && windowBytes > 0) {
+    // Ack at least twice per window so a full window can never stall waiting
+    // for an ack the server is still holding back
+    int maxAckEvery =
+        std::max(1, (int)(windowBytes / (2LL * UPLOAD_CHUNK_SIZE)));
+    ack.windowBytes = windowBytes;
+    ack.ackEvery =
+        std::clamp(config.getUploadAckEveryChunks(), 1, maxAckEvery);
+  }
+
+  if (ActiveUpload *active = findUpload(uploadId)) {
+    active->windowed = ack.windowBytes > 0;
+    active->ackEvery = std::max(ack.ackEvery, 1);
+    active->unacked = 0;
+    active->gapReported = false;
+  }
+  if (controlVersion_ < PROTOCOL_VERSION_3) {
+    sendPacket(ProtocolParser::createUploadAckPacket(ack));
+    return;
+  }
+  queueOutbound([&](std::vector<char> &out) {
+    ProtocolParser::appendUploadAck(ack, out);
+  });
+}
+
+void Session::sendUploadChunkAck(const std::string &uploadId,
+                                 long long nextExpectedOffset,
+                                 const std::string &status) {
+  if (controlVersion_ < PROTOCOL_VERSION_3) {
+    sendPacket(ProtocolParser::createUploadChunkAckPacket(
+        uploadId, nextExpectedOffset, status));
+    return;
+  }
+  queueOutbound([&](std::vector<char> &out) {
+    ProtocolParser::appendUploadChunkAck(uploadId, nextExpectedOffset, status,
+                                         out);
+  });
+}
+
+void Session::sendUploadResult(const std::string &uploadId,
+                               const std::string &status,
+                               const std::string &message) {
+  if (controlVersion_ < PROTOCOL_VERSION_3) {
+    sendPacket(
+        ProtocolParser::createUploadResultPacket(uploadId, status, message));
+    return;
+  }
+  queueOutbound([&](std::vector<char> &out) {
+    ProtocolParser::appendUploadResult(uploadId, status, message, out);
+  });
 }
 
 void Session::handleUploadChunk(const std::vector<char> &data,
                                 const PacketHeader &header) {
-  if (data.size() < 44) { // 36 + 8
+  static Histogram &latency = handlerLatency("chunk");
+  ScopedTimer timer(latency);
+  UploadChunkHeader chunk;
+  if (!ProtocolParser::parseUploadChunk(data, header.version, chunk)) {
     sendPacket(ProtocolParser::createErrorPacket("Invalid Chunk Header",
                                                  ErrorCode::INVALID_PAYLOAD));
     return;
   }
 
-  std::string uploadId(data.data(), 36);
-  long long offset = 0;
-  // memcpy needed for alignment safety
-  std::memcpy(&offset, data.data() + 36, sizeof(long long));
-  offset = fromNetworkOrder(offset); // Wait, assume Network Order (Big Endian)
-                                     // wrapper exists or use manual swap
+  long long offset = chunk.offset;
+  const char *chunkData = chunk.data;
+  size_t chunkLen = chunk.dataLength;
+  ScopedSpan span(SpanPhase::CHUNK, "", chunkLen);
+
+  auto it = uploads_.find(chunk.uploadId);
+  if (it == uploads_.end()) {
+    // Not opened by UPLOAD_INIT on this connection
+    std::string uploadId = ProtocolParser::unpackUploadId(chunk.uploadId);
+    span.setTraceId(uploadId);
+    UploadSession session = db_.getUploadSession(uploadId);
+    if (session.uploadId.empty()) {
+      sendPacket(ProtocolParser::createErrorPacket("Session Not Found",
+                                                   ErrorCode::SESSION_EXPIRED));
+      return;
+    }
 
-  const char *chunkData = data.data() + 44;
-  size_t chunkLen = data.size() - 44;
+    if (session.clientId != clientId_) {
+      sendPacket(ProtocolParser::createErrorPacket("Unauthorized Session",
+                                                   ErrorCode::AUTH_FAILED));
+      return;
+    }
 
-  UploadSession session = db_.getUploadSession(uploadId);
-  if (session.uploadId.empty()) {
-    sendPacket(ProtocolParser::createErrorPacket("Session Not Found",
-                                                 ErrorCode::SESSION_EXPIRED));
-    return;
-  }
+    if ((int)uploads_.size() >=
+        ConfigManager::getInstance().getUploadMaxConcurrent()) {
+      sendPacket(ProtocolParser::createErrorPacket(
+          "Too Many Uploads", ErrorCode::TOO_MANY_UPLOADS));
+      return;
+    }
 
-  if (session.clientId != clientId_) {
-    sendPacket(ProtocolParser::createErrorPacket("Unauthorized Session",
-                                                 ErrorCode::AUTH_FAILED));
-    return;
+    long long onDisk =
+        fileManager_.getFileSize(fileManager_.getUploadTempPath(uploadId));
+    if (!openUpload(uploadId, session.fileSize, onDisk)) {
+      sendPacket(ProtocolParser::createErrorPacket("Write Failed",
+                                                   ErrorCode::FILE_ERROR));
+      return;
+    }
+    it = uploads_.find(chunk.uploadId);
   }
 
-  if (offset < session.receivedBytes) {
+  ActiveUpload &upload = it->second;
+  const std::string &uploadId = upload.uploadId;
+  span.setTraceId(uploadId);
+  long long receivedBytes = upload.stream.size();
+
+  if (offset < receivedBytes) {
     log("Ignoring duplicate chunk for " + uploadId + " offset " +
         std::to_string(offset));
-    sendPacket(ProtocolParser::createUploadChunkAckPacket(
-        uploadId, session.receivedBytes, "OK"));
+    upload.stream.flush();
+    sendUploadChunkAck(uploadId, receivedBytes, "OK");
     return;
   }
 
-  if (offset > session.receivedBytes) {
+  if (offset > receivedBytes) {
+    // Chunks already in flight behind a gap are dropped without another
+    // error so the client sees exactly one INVALID_OFFSET per gap
+    if (upload.windowed) {
+      if (upload.gapReported)
+        return;
+      upload.gapReported = true;
+    }
     log("Offset gap for " + uploadId + ". Expected " +
-        std::to_string(session.receivedBytes) + " got " +
-        std::to_string(offset));
+        std::to_string(receivedBytes) + " got " + std::to_string(offset));
     sendPacket(ProtocolParser::createErrorPacket("Invalid Offset",
                                                  ErrorCode::INVALID_OFFSET));
     return;
   }
 
-  std::vector<char> chunk(chunkData, chunkData + chunkLen);
-  if (!fileManager_.appendChunk(uploadId, chunk)) {
+  if (!upload.stream.append(chunkData, chunkLen)) {
     sendPacket(ProtocolParser::createErrorPacket("Write Failed",
                                                  ErrorCode::FILE_ERROR));
     return;
   }
 
-  long long newTotal = session.receivedBytes + chunkLen;
+  if (stats_)
+    stats_->addBytes((long long)chunkLen);
+  if (bytesMetric_)
+    bytesMetric_->inc(chunkLen);
+
+  long long newTotal = upload.stream.size();
+  upload.gapReported = false;
+  if (upload.windowed) {
+    // Cumulative ack every ackEvery chunks, and always for the last one
+    if (++upload.unacked < upload.ackEvery && newTotal < upload.fileSize)
+      return;
+    upload.unacked = 0;
+  }
+
+  // Acknowledged bytes are flushed and recorded for resume
+  upload.stream.flush();
   db_.updateSessionReceivedBytes(uploadId, newTotal);
-  sendPacket(
-      ProtocolParser::createUploadChunkAckPacket(uploadId, newTotal, "OK"));
+  upload.persistedBytes = newTotal;
+  sendUploadChunkAck(uploadId, newTotal, "OK");
 }
 
-void Session::handleUploadFinish(const json &payload) {
-  std::string uploadId = payload["uploadId"];
-  std::string sha256 = payload["sha256"];
+void Session::handleUploadFinish(const UploadFinishPayload &finish) {
+  static Histogram &latency = handlerLatency("finish");
+  ScopedTimer timer(latency);
+  const std::string &uploadId = finish.uploadId;
+  const std::string &sha256 = finish.sha256;
 
   UploadSession session = db_.getUploadSession(uploadId);
   if (session.uploadId.empty() || session.clientId != clientId_) {
+    closeUpload(uploadId);
     sendPacket(ProtocolParser::createErrorPacket("Invalid Session",
                                                  ErrorCode::SESSION_EXPIRED));
     return;
   }
 
+  ActiveUpload *active = findUpload(uploadId);
+  if (active) {
+    session.receivedBytes = active->stream.size();
+    if (session.receivedBytes != active->persistedBytes)
+      db_.updateSessionReceivedBytes(uploadId, session.receivedBytes);
+  }
+
   if (session.receivedBytes != session.fileSize) {
-    sendPacket(ProtocolParser::createUploadResultPacket(uploadId, "ERROR",
-                                                        "Incomplete Upload"));
+    sendUploadResult(uploadId, "ERROR", "Incomplete Upload");
     return;
   }
 
@@ -581,6 +1019,7 @@ void Session::handleUploadFinish(const json &payload) {
   if (fileManager_.photoExists(session.fileHash)) {
     // Deduplication: File exists, retain session for forensics but delete temp
     // file
+    closeUpload(uploadId);
     db_.completeUploadSession(uploadId);
     fs::remove(fileManager_.getUploadTempPath(uploadId));
 
@@ -591,20 +1030,29 @@ void Session::handleUploadFinish(const json &payload) {
     metadata.receivedAt = db_.getCurrentTimestamp();
     db_.insertPhoto(clientId_, metadata);
 
-    sendPacket(ProtocolParser::createUploadResultPacket(uploadId, "SUCCESS",
-                                                        "File Exists"));
+    sendUploadResult(uploadId, "SUCCESS", "File Exists");
     return;
   }
 
   std::string tempPath = fileManager_.getUploadTempPath(uploadId);
 
-  // Handle 0-byte files that never had chunks appended
-  if (session.fileSize == 0 && !fs::exists(tempPath)) {
-    std::ofstream outfile(tempPath, std::ios::binary);
-    outfile.close();
+  std::string computedHash;
+  {
+    ScopedSpan span(SpanPhase::HASH, uploadId, (uint64_t)session.fileSize);
+    if (active) {
+      // Hashed while streaming; closing the file also makes it safe to move
+      computedHash = active->stream.finish();
+      closeUpload(uploadId);
+    } else {
+      // Handle 0-byte files that never had chunks appended
+      if (session.fileSize == 0 && !fs::exists(tempPath)) {
+        std::ofstream outfile(tempPath, std::ios::binary);
+        outfile.close();
+      }
+      computedHash = FileManager::calculateSHA256(tempPath);
+    }
   }
 
-  std::string computedHash = FileManager::calculateSHA256(tempPath);
   if (computedHash != sha256) {
     log("Hash mismatch for " + uploadId + ". Expected " + sha256 + " got " +
         computedHash);
@@ -613,9 +1061,13 @@ void Session::handleUploadFinish(const json &payload) {
     return;
   }
 
-  if (!fileManager_.finalizeFile(uploadId, finalPath)) {
-    sendPacket(ProtocolParser::createUploadResultPacket(uploadId, "ERROR",
-                                                        "Finalization Failed"));
+  bool finalized;
+  {
+    ScopedSpan span(SpanPhase::FINALIZE, uploadId, (uint64_t)session.fileSize);
+    finalized = fileManager_.finalizeFile(uploadId, finalPath);
+  }
+  if (!finalized) {
+    sendUploadResult(uploadId, "ERROR", "Finalization Failed");
     return;
   }
 
@@ -624,15 +1076,25 @@ void Session::handleUploadFinish(const json &payload) {
   metadata.size = session.fileSize;
   metadata.hash = session.fileHash;
   metadata.receivedAt = db_.getCurrentTimestamp();
-  db_.insertPhoto(clientId_, metadata);
+  bool inserted;
+  {
+    ScopedSpan span(SpanPhase::DB_INSERT, uploadId);
+    inserted = db_.insertPhoto(clientId_, metadata, finalPath);
+  }
+  if (inserted) {
+    queueThumbnail(metadata.hash, finalPath, uploadId);
+    if (stats_)
+      stats_->addPhoto();
+    if (photosMetric_)
+      photosMetric_->inc();
+  }
   db_.completeUploadSession(uploadId);
 
-  sendPacket(ProtocolParser::createUploadResultPacket(uploadId, "SUCCESS",
-                                                      "Upload Complete"));
+  sendUploadResult(uploadId, "SUCCESS", "Upload Complete");
 }
 
-void Session::handleUploadAbort(const json &payload) {
-  std::string uploadId = payload["uploadId"];
+void Session::handleUploadAbort(const std::string &uploadId) {
+  closeUpload(uploadId);
   // Verify ownership
   UploadSession session = db_.getUploadSession(uploadId);
   if (session.clientId == clientId_) {
@@ -640,12 +1102,101 @@ void Session::handleUploadAbort(const json &payload) {
     fs::remove(fileManager_.getUploadTempPath(uploadId));
 
     // Ack the abort so client knows it's safe to retry
-    sendPacket(ProtocolParser::createUploadResultPacket(uploadId, "ABORTED",
-                                                        "Session Aborted"));
+    sendUploadResult(uploadId, "ABORTED", "Session Aborted");
   } else {
     // Even if not found or unauthorized, send error/ack to unblock client?
     // If session not found, it's effectively aborted.
-    sendPacket(ProtocolParser::createUploadResultPacket(uploadId, "ABORTED",
-                                                        "Session Not Found"));
+    sendUploadResult(uploadId, "ABORTED", "Session Not Found");
+  }
+}
+
+void Session::handleUploadInline(const std::vector<char> &data) {
+  static Histogram &latency = handlerLatency("inline");
+  ScopedTimer timer(latency);
+  if (clientId_ == -1) {
+    sendPacket(ProtocolParser::createErrorPacket("Unauthorized",
+                                                 ErrorCode::AUTH_REQUIRED));
+    return;
+  }
+
+  UploadInlinePayload upload;
+  if (!ProtocolParser::parseUploadInline(data, upload)) {
+    sendPacket(ProtocolParser::createErrorPacket("Invalid Inline Upload",
+                                                 ErrorCode::INVALID_PAYLOAD));
+    return;
+  }
+
+  long long maxBytes =
+      (long long)ConfigManager::getInstance().getUploadInlineMaxKB() * 1024;
+  if (upload.size > maxBytes) {
+    sendUploadResult(upload.sha256, "ERROR", "Too Large For Inline Upload");
+    return;
+  }
+
+  std::string traceId =
+      upload.traceId.empty() ? upload.sha256 : upload.traceId;
+  if (stats_)
+    stats_->addBytes((long long)upload.dataLength);
+  if (bytesMetric_)
+    bytesMetric_->inc(upload.dataLength);
+
+  // The body is already in memory: verify it before anything touches disk
+  std::string computedHash;
+  {
+    ScopedSpan span(SpanPhase::HASH, traceId, (uint64_t)upload.dataLength);
+    computedHash = FileManager::calculateSHA256(upload.data, upload.dataLength);
+  }
+  if (computedHash != upload.sha256) {
+    log("Hash mismatch for inline upload " + upload.filename + ". Expected " +
+        upload.sha256 + " got " + computedHash);
+    sendPacket(ProtocolParser::createErrorPacket("Hash Mismatch",
+                                                 ErrorCode::HASH_MISMATCH));
+    return;
+  }
+
+  PhotoMetadata metadata;
+  metadata.filename = upload.filename;
+  metadata.size = upload.size;
+  metadata.hash = upload.sha256;
+  metadata.receivedAt = db_.getCurrentTimestamp();
+
+  if (fileManager_.photoExists(upload.sha256)) {
+    db_.insertPhoto(clientId_, metadata);
+    sendUploadResult(upload.sha256, "SUCCESS", "File Exists");
+    return;
+  }
+
+  // No upload session: write the temp file once and move it into place
+  std::string tempId = "inline-" + upload.sha256;
+  std::string extension = fs::path(upload.filename).extension().string();
+  std::string finalPath = fileManager_.getPhotoPath(upload.sha256, extension);
+  bool finalized;
+  {
+    ScopedSpan span(SpanPhase::FINALIZE, traceId, (uint64_t)upload.dataLength);
+    std::ofstream out(fileManager_.getUploadTempPath(tempId),
+                      std::ios::binary | std::ios::trunc);
+    out.write(upload.data, (std::streamsize)upload.dataLength);
+    out.close();
+    finalized = out && fileManager_.finalizeFile(tempId, finalPath);
+  }
+  if (!finalized) {
+    fs::remove(fileManager_.getUploadTempPath(tempId));
+    sendUploadResult(upload.sha256, "ERROR", "Finalization Failed");
+    return;
   }
+
+  bool inserted;
+  {
+    ScopedSpan span(SpanPhase::DB_INSERT, traceId);
+    inserted = db_.insertPhoto(clientId_, metadata, finalPath);
+  }
+  if (inserted) {
+    queueThumbnail(metadata.hash, finalPath, traceId);
+    if (stats_)
+      stats_->addPhoto();
+    if (photosMetric_)
+      photosMetric_->inc();
+  }
+
+  sendUploadResult(upload.sha256, "SUCCESS", "Upload Complete");
 }
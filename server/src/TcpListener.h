@@ -1,11 +1,17 @@
 #pragma once
 
+#include "ConnectionManager.h"
 #include "DatabaseManager.h"
 #include "FileManager.h"
 #include "Logger.h"
+#include "MetricsRegistry.h"
 #include "ProtocolParser.h"
+#include "ThumbnailQueue.h"
+#include "UploadScheduler.h"
+#include "UploadStream.h"
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -15,15 +21,31 @@ using boost::asio::ip::tcp;
 class Session : public std::enable_shared_from_this<Session> {
 public:
   Session(boost::asio::ssl::stream<tcp::socket> socket, DatabaseManager &db,
-          FileManager &fileManager);
+          FileManager &fileManager, ThumbnailQueue *thumbnails = nullptr,
+          UploadScheduler *scheduler = nullptr);
   ~Session();
   void start();
 
 private:
   void doReadHeader();
   void doReadPayload(PacketHeader header);
-  void handlePacket(const Packet &packet);
+  // async_read from the TLS stream, or straight from the TCP socket once
+  // the kernel decrypts received records
+  template <typename Handler>
+  void asyncReadExactly(boost::asio::mutable_buffer buffer, Handler handler);
+  // File data goes through the upload scheduler first; everything else is
+  // dispatched at once. Reading resumes after the packet is handled.
+  void handlePacket(Packet packet);
+  void dispatchPacket(const Packet &packet);
+  static bool carriesFileData(const PacketHeader &header);
+  double schedulingWeight(const Packet &packet);
+  // Queue a packet for sending. Packets queued while a write is in flight
+  // are coalesced and go out together in the next write.
   void sendPacket(const Packet &packet);
+  // Run append(outPending_) and start a write if none is in flight; does
+  // nothing once a write has failed
+  template <typename Append> void queueOutbound(Append append);
+  void doWrite();
 
   // Command Handlers
   void handleDiscovery(const json &payload);
@@ -33,23 +55,52 @@ private:
   void handleTransferComplete(const json &payload);
 
   // Phase 2: Resumable Upload Handlers
-  void handleUploadInit(const json &payload);
+  void handleUploadInit(const UploadInitPayload &init);
   void handleUploadChunk(const std::vector<char> &data,
                          const PacketHeader &header);
-  void handleUploadFinish(const json &payload);
-  void handleUploadAbort(const json &payload);
+  void handleUploadFinish(const UploadFinishPayload &finish);
+  void handleUploadAbort(const std::string &uploadId);
+  void handleUploadInline(const std::vector<char> &data);
+  // Send UPLOAD_ACK, granting windowed mode if the client asked for it
+  void sendUploadAck(bool windowed, const std::string &uploadId,
+                     long long receivedBytes, const std::string &status);
+  // Control replies in the encoding negotiated at pairing (V2 JSON or V3
+  // binary, the latter encoded straight into the outbound buffer)
+  void sendUploadChunkAck(const std::string &uploadId,
+                          long long nextExpectedOffset,
+                          const std::string &status);
+  void sendUploadResult(const std::string &uploadId, const std::string &status,
+                        const std::string &message);
+
+  // Hand a newly stored photo to the background thumbnail renderer
+  void queueThumbnail(const std::string &hash, const std::string &path,
+                      const std::string &traceId);
+  // Trace id for spans of the current legacy (METADATA) upload
+  std::string uploadTraceId() const;
 
   boost::asio::ssl::stream<tcp::socket> socket_;
+  bool kernelReceive_ = false; // kTLS decrypts reads; writes stay on OpenSSL
   DatabaseManager &db_;
   FileManager &fileManager_;
+  ThumbnailQueue *thumbnails_;
+  UploadScheduler *scheduler_;
 
   // Buffers
   std::vector<char> headerBuffer_;
   std::vector<char> payloadBuffer_;
+  // Outbound double buffer: handlers append to outPending_ while at most one
+  // async_write drains outWriting_, so writes never overlap on the stream
+  std::vector<char> outPending_;
+  std::vector<char> outWriting_;
+  bool writeInFlight_ = false;
+  bool writeFailed_ = false;
 
   // State
   int clientId_ = -1;
   int sessionId_ = -1;
+  std::string deviceId_; // Bandwidth is shared out per device
+  // Encoding of outbound upload control messages, negotiated at pairing
+  uint8_t controlVersion_ = PROTOCOL_VERSION_2;
 
   // Current Transfer State
   std::string currentTraceId_;
@@ -59,9 +110,34 @@ private:
   std::string currentTempPath_;
   std::string currentFileHash_;
 
-  // Session Stats
-  int sessionPhotos_ = 0;
-  long long sessionBytes_ = 0;
+  // V2 uploads in flight on this connection, by raw upload id. Chunks of
+  // different uploads may interleave; each keeps its temp file open and is
+  // hashed as it arrives, so UPLOAD_FINISH needs no second read. A chunk
+  // resolves to its upload with no string allocation or DB query.
+  struct ActiveUpload {
+    std::string uploadId; // Text form, for the DB, acks and trace spans
+    UploadStream stream;
+    long long fileSize = 0;
+    long long persistedBytes = 0; // receivedBytes last written to the DB
+    // Windowed acks negotiated in UPLOAD_INIT (see UploadAckPayload)
+    bool windowed = false;
+    int ackEvery = 1;
+    int unacked = 0; // Chunks accepted since the last cumulative ack
+    bool gapReported = false;
+  };
+  std::map<RawUploadId, ActiveUpload> uploads_;
+  // Open the temp file of an upload at receivedBytes; nullptr on I/O error
+  // or an upload id that is not UUID-formatted
+  ActiveUpload *openUpload(const std::string &uploadId, long long fileSize,
+                           long long receivedBytes);
+  ActiveUpload *findUpload(const std::string &uploadId);
+  void closeUpload(const std::string &uploadId);
+
+  // Live telemetry, shared with ConnectionManager once paired
+  std::shared_ptr<ConnectionStats> stats_;
+  // Per-device counters, resolved once at pairing
+  Counter *bytesMetric_ = nullptr;
+  Counter *photosMetric_ = nullptr;
 
   // Helper
   void log(const std::string &message, LogLevel level = LogLevel::L_INFO);
@@ -71,13 +147,27 @@ class TcpListener {
 public:
   TcpListener(boost::asio::io_context &io_context,
               boost::asio::ssl::context &context, int port, DatabaseManager &db,
-              FileManager &fileManager);
+              FileManager &fileManager, ThumbnailQueue *thumbnails = nullptr);
+
+  // Bound port; useful when constructed with port 0
+  unsigned short port() const { return acceptor_.local_endpoint().port(); }
+  // Entries in the connection-limit list, including ended sessions not yet
+  // forgotten. Always 0 without a limit.
+  size_t trackedSessions() const { return sessions_.size(); }
 
 private:
   void doAccept();
+  // Sessions still alive; forgets the ones that have ended
+  size_t openSessions();
+  // Finish the handshake, send SERVER_BUSY and close
+  static void rejectBusy(boost::asio::ssl::stream<tcp::socket> stream);
 
   tcp::acceptor acceptor_;
   boost::asio::ssl::context &context_;
   DatabaseManager &db_;
   FileManager &fileManager_;
+  ThumbnailQueue *thumbnails_;
+  UploadScheduler scheduler_;
+  int maxConnections_; // 0 = unlimited
+  std::vector<std::weak_ptr<Session>> sessions_;
 };
@@ -0,0 +1,79 @@
+#include "ThumbnailCache.h"
+
+ThumbnailCache::ThumbnailCache(uint64_t budgetBytes)
+    : budgetBytes_(budgetBytes) {}
+
+uint64_t ThumbnailCache::makeKey(int photoId, int size) {
+  return ((uint64_t)(uint32_t)photoId << 32) | (uint32_t)size;
+}
+
+std::shared_ptr<const std::string>
+ThumbnailCache::get(int photoId, int size, uint64_t checksum) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = map_.find(makeKey(photoId, size));
+  if (it == map_.end() || it->second->checksum != checksum) {
+    misses_++;
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  hits_++;
+  return it->second->data;
+}
+
+void ThumbnailCache::put(int photoId, int size, uint64_t checksum,
+                         std::shared_ptr<const std::string> data) {
+  if (!data || data->size() > budgetBytes_) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t key = makeKey(photoId, size);
+  auto it = map_.find(key);
+  if (it != map_.end()) {
+    bytes_ -= it->second->data->size();
+    lru_.erase(it->second);
+    map_.erase(it);
+  }
+
+  lru_.push_front(Node{key, checksum, std::move(data)});
+  map_[key] = lru_.begin();
+  bytes_ += lru_.front().data->size();
+  evictLocked();
+}
+
+void ThumbnailCache::erase(int photoId, int size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = map_.find(makeKey(photoId, size));
+  if (it == map_.end()) {
+    return;
+  }
+  bytes_ -= it->second->data->size();
+  lru_.erase(it->second);
+  map_.erase(it);
+}
+
+void ThumbnailCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lru_.clear();
+  map_.clear();
+  bytes_ = 0;
+}
+
+void ThumbnailCache::evictLocked() {
+  while (bytes_ > budgetBytes_ && !lru_.empty()) {
+    const Node &victim = lru_.back();
+    bytes_ -= victim.data->size();
+    map_.erase(victim.key);
+    lru_.pop_back();
+  }
+}
+
+ThumbnailCache::Stats ThumbnailCache::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats;
+  stats.entries = map_.size();
+  stats.bytes = bytes_;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  return stats;
+}
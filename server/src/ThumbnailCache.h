@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Byte-budgeted LRU of encoded thumbnails, keyed by (photoId, size).
+// Each entry remembers the checksum of the blob it holds so a lookup can
+// reject a stale copy after the rendition was re-rendered.
+class ThumbnailCache {
+public:
+  struct Stats {
+    size_t entries = 0;
+    uint64_t bytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+  };
+
+  explicit ThumbnailCache(uint64_t budgetBytes);
+
+  // Returns the cached blob if present and its checksum matches
+  std::shared_ptr<const std::string> get(int photoId, int size,
+                                         uint64_t checksum);
+
+  void put(int photoId, int size, uint64_t checksum,
+           std::shared_ptr<const std::string> data);
+
+  void erase(int photoId, int size);
+  void clear();
+
+  Stats getStats() const;
+
+private:
+  struct Node {
+    uint64_t key;
+    uint64_t checksum;
+    std::shared_ptr<const std::string> data;
+  };
+
+  static uint64_t makeKey(int photoId, int size);
+  void evictLocked();
+
+  uint64_t budgetBytes_;
+  uint64_t bytes_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+
+  mutable std::mutex mutex_;
+  std::list<Node> lru_; // Front is most recently used
+  std::unordered_map<uint64_t, std::list<Node>::iterator> map_;
+};
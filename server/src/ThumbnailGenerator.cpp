@@ -1,7 +1,13 @@
 #include "ThumbnailGenerator.h"
 #include "Logger.h"
-#include <filesystem>
+#include "MetricsRegistry.h"
+#include "ThumbnailStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <vector>
 
 // Define STB_IMAGE implementation
 #define STB_IMAGE_IMPLEMENTATION
@@ -13,53 +19,303 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "external/stb_image_write.h"
 
-const std::string ThumbnailGenerator::THUMBNAILS_DIR = "./storage/thumbnails";
+#ifdef PHOTOSYNC_HAVE_LIBJPEG
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+#endif
+
+namespace {
+
+// Decoded pixels plus the allocator that owns them (stb or malloc)
+struct DecodedImage {
+  unsigned char *pixels = nullptr;
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  bool fromStb = false;
+
+  void release() {
+    if (!pixels)
+      return;
+    if (fromStb)
+      stbi_image_free(pixels);
+    else
+      free(pixels);
+    pixels = nullptr;
+  }
+};
+
+// Thumbnail size that fits maxWidth x maxHeight, keeping aspect ratio
+void fitDimensions(int width, int height, int maxWidth, int maxHeight,
+                   int &outWidth, int &outHeight) {
+  if (width > height) {
+    outWidth = maxWidth;
+    outHeight = (int)((float)height / width * maxWidth);
+  } else {
+    outHeight = maxHeight;
+    outWidth = (int)((float)width / height * maxHeight);
+  }
+  if (outWidth < 1)
+    outWidth = 1;
+  if (outHeight < 1)
+    outHeight = 1;
+}
+
+void appendToString(void *context, void *data, int size) {
+  static_cast<std::string *>(context)->append(static_cast<char *>(data), size);
+}
+
+bool isJpegFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  unsigned char magic[3] = {0, 0, 0};
+  file.read(reinterpret_cast<char *>(magic), 3);
+  return file.gcount() == 3 && magic[0] == 0xFF && magic[1] == 0xD8 &&
+         magic[2] == 0xFF;
+}
+
+uint16_t readU16(const unsigned char *p, bool intel) {
+  return intel ? (uint16_t)(p[0] | (p[1] << 8))
+               : (uint16_t)((p[0] << 8) | p[1]);
+}
+
+uint32_t readU32(const unsigned char *p, bool intel) {
+  return intel ? (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                     ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24)
+               : ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                     ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// Decode the JPEG thumbnail embedded in EXIF IFD1, if any. Only the APP1
+// segment at the head of the file is read, never the full image.
+bool decodeExifThumbnail(const std::string &path, DecodedImage &out) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+
+  // APP1 must come right after SOI (optionally after APP0/JFIF)
+  std::vector<unsigned char> head(4 + 65536 + 4 + 65536);
+  file.read(reinterpret_cast<char *>(head.data()), head.size());
+  size_t len = static_cast<size_t>(file.gcount());
+  if (len < 4 || head[0] != 0xFF || head[1] != 0xD8)
+    return false;
+
+  size_t pos = 2;
+  while (pos + 4 <= len && head[pos] == 0xFF) {
+    unsigned char marker = head[pos + 1];
+    size_t segLen = (head[pos + 2] << 8) | head[pos + 3];
+    if (marker == 0xE1) {
+      const unsigned char *seg = head.data() + pos + 4;
+      size_t segSize = segLen >= 2 ? segLen - 2 : 0;
+      if (pos + 4 + segSize > len || segSize < 14 ||
+          std::memcmp(seg, "Exif\0\0", 6) != 0)
+        return false;
+
+      const unsigned char *tiff = seg + 6;
+      size_t tiffLen = segSize - 6;
+      bool intel = tiff[0] == 'I';
+      // Offsets are widened before any arithmetic so a crafted value near
+      // 4 GiB can't wrap past the bounds checks
+      size_t ifd0 = readU32(tiff + 4, intel);
+      if (ifd0 + 2 > tiffLen)
+        return false;
+      uint16_t count0 = readU16(tiff + ifd0, intel);
+      size_t next = ifd0 + 2 + (size_t)count0 * 12;
+      if (next + 4 > tiffLen)
+        return false;
+      size_t ifd1 = readU32(tiff + next, intel);
+      if (ifd1 == 0 || ifd1 + 2 > tiffLen)
+        return false;
+
+      uint16_t count1 = readU16(tiff + ifd1, intel);
+      uint32_t thumbOffset = 0, thumbLength = 0;
+      for (uint16_t i = 0; i < count1; ++i) {
+        size_t entry = ifd1 + 2 + (size_t)i * 12;
+        if (entry + 12 > tiffLen)
+          return false;
+        uint16_t tag = readU16(tiff + entry, intel);
+        if (tag == 0x0201)
+          thumbOffset = readU32(tiff + entry + 8, intel);
+        else if (tag == 0x0202)
+          thumbLength = readU32(tiff + entry + 8, intel);
+      }
+      if (thumbLength == 0 || (size_t)thumbOffset + thumbLength > tiffLen)
+        return false;
+
+      out.pixels = stbi_load_from_memory(tiff + thumbOffset, (int)thumbLength,
+                                         &out.width, &out.height,
+                                         &out.channels, 0);
+      out.fromStb = true;
+      return out.pixels != nullptr;
+    }
+    if (marker == 0xDA || marker == 0xD9)
+      break; // Start of scan: no EXIF
+    pos += 2 + segLen;
+  }
+  return false;
+}
+
+#ifdef PHOTOSYNC_HAVE_LIBJPEG
+struct JpegErrorManager {
+  jpeg_error_mgr pub;
+  jmp_buf jumpBuffer;
+};
+
+void jpegErrorExit(j_common_ptr cinfo) {
+  auto *err = reinterpret_cast<JpegErrorManager *>(cinfo->err);
+  longjmp(err->jumpBuffer, 1);
+}
+
+// Decode with libjpeg, scaling by 1/2, 1/4 or 1/8 in the DCT domain so the
+// result is the smallest image still at least minWidth x minHeight. Only
+// plain C state lives across setjmp; pixels is volatile because it changes
+// after setjmp and is freed on the error path.
+bool decodeJpegScaled(const char *path, int minWidth, int minHeight,
+                      DecodedImage &out) {
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return false;
+
+  jpeg_decompress_struct cinfo;
+  JpegErrorManager jerr;
+  unsigned char *volatile pixels = nullptr;
+
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = jpegErrorExit;
+  if (setjmp(jerr.jumpBuffer)) {
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+    free(pixels);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_stdio_src(&cinfo, file);
+  jpeg_read_header(&cinfo, TRUE);
+
+  if (cinfo.jpeg_color_space == JCS_CMYK ||
+      cinfo.jpeg_color_space == JCS_YCCK) {
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+    return false; // Leave unusual colour spaces to the generic path
+  }
+
+  unsigned int denom = 8;
+  while (denom > 1 &&
+         ((int)((cinfo.image_width + denom - 1) / denom) < minWidth ||
+          (int)((cinfo.image_height + denom - 1) / denom) < minHeight)) {
+    denom /= 2;
+  }
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = denom;
+  cinfo.out_color_space =
+      cinfo.jpeg_color_space == JCS_GRAYSCALE ? JCS_GRAYSCALE : JCS_RGB;
+  cinfo.dct_method = JDCT_IFAST;
+
+  jpeg_start_decompress(&cinfo);
+
+  size_t stride = (size_t)cinfo.output_width * cinfo.output_components;
+  pixels = (unsigned char *)malloc(stride * cinfo.output_height);
+  if (!pixels) {
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+    return false;
+  }
+
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = pixels + (size_t)cinfo.output_scanline * stride;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+
+  // Handed over only once libjpeg can no longer jump to the error path
+  jpeg_finish_decompress(&cinfo);
+  out.pixels = pixels;
+  out.width = (int)cinfo.output_width;
+  out.height = (int)cinfo.output_height;
+  out.channels = cinfo.output_components;
+  out.fromStb = false;
+
+  jpeg_destroy_decompress(&cinfo);
+  fclose(file);
+  return true;
+}
+#endif
+
+// Load the cheapest source image that still covers the target size:
+// EXIF thumbnail, then DCT-scaled JPEG decode, then a full stb decode.
+bool loadSourceImage(const std::string &inputPath, int maxWidth,
+                     int maxHeight, DecodedImage &out) {
+  int width = 0, height = 0, comp = 0;
+  if (!stbi_info(inputPath.c_str(), &width, &height, &comp)) {
+    return false;
+  }
+
+  int thumbWidth, thumbHeight;
+  fitDimensions(width, height, maxWidth, maxHeight, thumbWidth, thumbHeight);
+
+  if (isJpegFile(inputPath)) {
+    DecodedImage embedded;
+    if (decodeExifThumbnail(inputPath, embedded)) {
+      // Only usable if it is big enough and has the same shape (some
+      // cameras letterbox the embedded preview)
+      float srcAspect = (float)width / height;
+      float embAspect = (float)embedded.width / embedded.height;
+      if (embedded.width >= thumbWidth && embedded.height >= thumbHeight &&
+          std::abs(srcAspect - embAspect) < 0.02f * srcAspect) {
+        out = embedded;
+        return true;
+      }
+      embedded.release();
+    }
+
+#ifdef PHOTOSYNC_HAVE_LIBJPEG
+    if (decodeJpegScaled(inputPath.c_str(), thumbWidth, thumbHeight, out)) {
+      return true;
+    }
+#endif
+  }
+
+  out.pixels =
+      stbi_load(inputPath.c_str(), &out.width, &out.height, &out.channels, 0);
+  out.fromStb = true;
+  return out.pixels != nullptr;
+}
+
+} // namespace
 
 bool ThumbnailGenerator::generateThumbnail(const std::string &inputPath,
                                            const std::string &outputPath,
                                            int maxWidth, int maxHeight) {
-  // Load the image
-  int width, height, channels;
-  unsigned char *imageData =
-      stbi_load(inputPath.c_str(), &width, &height, &channels, 0);
-
-  if (!imageData) {
+  // Load the image (downscaled at decode time where the format allows)
+  DecodedImage image;
+  if (!loadSourceImage(inputPath, maxWidth, maxHeight, image)) {
     LOG_ERROR("Failed to load image: " + inputPath);
     return false;
   }
+  int width = image.width;
+  int height = image.height;
+  int channels = image.channels;
 
   // Calculate thumbnail dimensions while maintaining aspect ratio
   int thumbWidth, thumbHeight;
-  if (width > height) {
-    thumbWidth = maxWidth;
-    thumbHeight = (int)((float)height / width * maxWidth);
-  } else {
-    thumbHeight = maxHeight;
-    thumbWidth = (int)((float)width / height * maxHeight);
-  }
-
-  // Ensure dimensions are at least 1
-  if (thumbWidth < 1)
-    thumbWidth = 1;
-  if (thumbHeight < 1)
-    thumbHeight = 1;
+  fitDimensions(width, height, maxWidth, maxHeight, thumbWidth, thumbHeight);
 
   // Allocate memory for thumbnail
   unsigned char *thumbnailData =
       (unsigned char *)malloc(thumbWidth * thumbHeight * channels);
   if (!thumbnailData) {
     LOG_ERROR("Failed to allocate memory for thumbnail");
-    stbi_image_free(imageData);
+    image.release();
     return false;
   }
 
   // Resize the image
-  if (!stbir_resize_uint8_linear(imageData, width, height, 0, thumbnailData,
-                                 thumbWidth, thumbHeight, 0,
+  if (!stbir_resize_uint8_linear(image.pixels, width, height, 0,
+                                 thumbnailData, thumbWidth, thumbHeight, 0,
                                  (stbir_pixel_layout)channels)) {
     LOG_ERROR("Failed to resize image: " + inputPath);
     free(thumbnailData);
-    stbi_image_free(imageData);
+    image.release();
     return false;
   }
 
@@ -69,38 +325,121 @@ bool ThumbnailGenerator::generateThumbnail(const std::string &inputPath,
 
   // Clean up
   free(thumbnailData);
-  stbi_image_free(imageData);
+  image.release();
 
   if (!result) {
     LOG_ERROR("Failed to write thumbnail: " + outputPath);
     return false;
   }
 
-  LOG_DEBUG("Generated thumbnail: " + outputPath + " (" +
-            std::to_string(thumbWidth) + "x" + std::to_string(thumbHeight) +
-            ")");
+  LOG_DEBUGF("Generated thumbnail: {} ({}x{} from {}x{})", outputPath,
+             thumbWidth, thumbHeight, width, height);
   return true;
 }
 
-std::string ThumbnailGenerator::getThumbnailPath(int photoId) {
-  return THUMBNAILS_DIR + "/" + std::to_string(photoId) + ".jpg";
+bool ThumbnailGenerator::generateRenditions(const std::string &inputPath,
+                                            int photoId, ThumbnailStore &store,
+                                            bool force) {
+  static Histogram &renderLatency = MetricsRegistry::getInstance().histogram(
+      "photosync_thumbnail_render_seconds",
+      "Time to decode a photo and render its missing renditions");
+  ScopedTimer timer(renderLatency);
+
+  // Sizes still to render, largest first so each one can be resized from the
+  // previous (already smaller) buffer instead of the full decode
+  std::vector<int> sizes;
+  for (int size : renditionSizes()) {
+    if (force || !store.contains(photoId, size)) {
+      sizes.push_back(size);
+    }
+  }
+  if (sizes.empty()) {
+    return true;
+  }
+  std::sort(sizes.rbegin(), sizes.rend());
+
+  DecodedImage image;
+  if (!loadSourceImage(inputPath, sizes.front(), sizes.front(), image)) {
+    LOG_ERROR("Failed to load image: " + inputPath);
+    return false;
+  }
+
+  const unsigned char *source = image.pixels;
+  int sourceWidth = image.width;
+  int sourceHeight = image.height;
+  int channels = image.channels;
+  std::vector<unsigned char> previous;
+  std::vector<unsigned char> current;
+  bool success = true;
+
+  for (int size : sizes) {
+    int width, height;
+    fitDimensions(image.width, image.height, size, size, width, height);
+    // Never upscale: a small original is stored at its own size
+    if (width > image.width || height > image.height) {
+      width = image.width;
+      height = image.height;
+    }
+
+    current.resize((size_t)width * height * channels);
+    if (!stbir_resize_uint8_linear(source, sourceWidth, sourceHeight, 0,
+                                   current.data(), width, height, 0,
+                                   (stbir_pixel_layout)channels)) {
+      LOG_ERROR("Failed to resize image: " + inputPath);
+      success = false;
+      break;
+    }
+
+    // Encode in memory and append to the packed store; readers keep getting
+    // the previous rendition until the new record is indexed
+    std::string encoded;
+    if (!stbi_write_jpg_to_func(appendToString, &encoded, width, height,
+                                channels, current.data(), 85) ||
+        !store.put(photoId, size, encoded)) {
+      LOG_ERROR("Failed to store thumbnail " + std::to_string(photoId) + "/" +
+                std::to_string(size));
+      success = false;
+      break;
+    }
+
+    previous.swap(current);
+    source = previous.data();
+    sourceWidth = width;
+    sourceHeight = height;
+  }
+
+  image.release();
+
+  if (success) {
+    LOG_DEBUGF("Generated {} rendition(s) for photo {}", sizes.size(),
+               photoId);
+  }
+  return success;
 }
 
-bool ThumbnailGenerator::thumbnailExists(int photoId) {
-  std::string path = getThumbnailPath(photoId);
-  return std::filesystem::exists(path);
+const std::vector<int> &ThumbnailGenerator::renditionSizes() {
+  static const std::vector<int> sizes = {128, DEFAULT_SIZE, 1024, 2048};
+  return sizes;
 }
 
-bool ThumbnailGenerator::ensureThumbnailsDirectory() {
-  try {
-    if (!std::filesystem::exists(THUMBNAILS_DIR)) {
-      std::filesystem::create_directories(THUMBNAILS_DIR);
-      LOG_INFO("Created thumbnails directory: " + THUMBNAILS_DIR);
+int ThumbnailGenerator::selectRenditionSize(int requested) {
+  if (requested <= 0) {
+    return DEFAULT_SIZE;
+  }
+  for (int size : renditionSizes()) {
+    if (size >= requested) {
+      return size;
+    }
+  }
+  return renditionSizes().back();
+}
+
+bool ThumbnailGenerator::renditionsExist(const ThumbnailStore &store,
+                                         int photoId) {
+  for (int size : renditionSizes()) {
+    if (!store.contains(photoId, size)) {
+      return false;
     }
-    return true;
-  } catch (const std::exception &e) {
-    LOG_ERROR("Failed to create thumbnails directory: " +
-              std::string(e.what()));
-    return false;
   }
+  return true;
 }
@@ -1,24 +1,32 @@
 #pragma once
 
 #include <string>
+#include <vector>
+
+class ThumbnailStore;
 
 class ThumbnailGenerator {
 public:
+  // Longest edge of the rendition served when no size is requested
+  static constexpr int DEFAULT_SIZE = 300;
+
   // Generate a thumbnail for the given image
   // Returns true on success, false on failure
   static bool generateThumbnail(const std::string &inputPath,
                                 const std::string &outputPath,
                                 int maxWidth = 300, int maxHeight = 300);
 
-  // Get the thumbnail path for a given photo ID
-  static std::string getThumbnailPath(int photoId);
+  // Generate every rendition size for a photo from a single decode and put
+  // them in the store. Existing renditions are kept unless force is set.
+  static bool generateRenditions(const std::string &inputPath, int photoId,
+                                 ThumbnailStore &store, bool force = false);
 
-  // Check if a thumbnail exists for a given photo ID
-  static bool thumbnailExists(int photoId);
+  // Rendition sizes (longest edge, ascending) kept for every photo
+  static const std::vector<int> &renditionSizes();
 
-  // Ensure the thumbnails directory exists
-  static bool ensureThumbnailsDirectory();
+  // Smallest rendition at least as large as the requested size
+  static int selectRenditionSize(int requested);
 
-private:
-  static const std::string THUMBNAILS_DIR;
+  // Check that every rendition size is in the store
+  static bool renditionsExist(const ThumbnailStore &store, int photoId);
 };
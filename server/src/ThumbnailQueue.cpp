@@ -0,0 +1,151 @@
+#include "ThumbnailQueue.h"
+#include "Logger.h"
+#include "ThumbnailGenerator.h"
+#include "TraceRecorder.h"
+
+ThumbnailQueue::ThumbnailQueue(ThumbnailStore &store)
+    : store_(store), running_(false) {}
+
+ThumbnailQueue::~ThumbnailQueue() { stop(); }
+
+void ThumbnailQueue::start(const Config &config) {
+  if (running_) {
+    return;
+  }
+  config_ = config;
+  if (config_.workerThreads < 1) {
+    config_.workerThreads = 1;
+  }
+
+  running_ = true;
+  for (int i = 0; i < config_.workerThreads; ++i) {
+    workers_.emplace_back(&ThumbnailQueue::workerLoop, this);
+  }
+  LOG_INFO("Thumbnail queue started with " +
+           std::to_string(config_.workerThreads) + " worker(s)");
+}
+
+void ThumbnailQueue::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+      return;
+    }
+    running_ = false;
+  }
+  workCv_.notify_all();
+  doneCv_.notify_all();
+  for (auto &worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  workers_.clear();
+}
+
+bool ThumbnailQueue::enqueue(int photoId, const std::string &sourcePath,
+                             Priority priority, bool force,
+                             const std::string &traceId) {
+  if (photoId < 0 || sourcePath.empty()) {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+      return false;
+    }
+
+    auto it = pending_.find(photoId);
+    if (it != pending_.end()) {
+      Job &job = it->second;
+      job.force = job.force || force;
+      if (job.traceId.empty())
+        job.traceId = traceId;
+      if (static_cast<int>(priority) < static_cast<int>(job.priority)) {
+        // Promote: re-key the job so it moves ahead in the order
+        order_.erase({static_cast<int>(job.priority), job.seq, photoId});
+        job.priority = priority;
+        job.seq = nextSeq_++;
+        order_.insert({static_cast<int>(job.priority), job.seq, photoId});
+      }
+      return true;
+    }
+
+    Job job{sourcePath, priority, force, nextSeq_++, traceId};
+    order_.insert({static_cast<int>(priority), job.seq, photoId});
+    pending_.emplace(photoId, std::move(job));
+  }
+
+  workCv_.notify_one();
+  return true;
+}
+
+bool ThumbnailQueue::requestAndWait(int photoId, const std::string &sourcePath,
+                                    std::chrono::milliseconds timeout,
+                                    bool force) {
+  if (!enqueue(photoId, sourcePath, Priority::VISIBLE, force)) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  bool finished = doneCv_.wait_for(lock, timeout, [this, photoId]() {
+    return !running_ || (pending_.count(photoId) == 0 &&
+                         inFlight_.count(photoId) == 0);
+  });
+  lock.unlock();
+
+  return finished && ThumbnailGenerator::renditionsExist(store_, photoId);
+}
+
+size_t ThumbnailQueue::pendingCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_.size() + inFlight_.size();
+}
+
+void ThumbnailQueue::workerLoop() {
+  while (true) {
+    int photoId;
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      workCv_.wait(lock, [this]() { return !running_ || !order_.empty(); });
+      if (!running_) {
+        return;
+      }
+
+      auto first = order_.begin();
+      photoId = std::get<2>(*first);
+      order_.erase(first);
+
+      auto it = pending_.find(photoId);
+      job = std::move(it->second);
+      pending_.erase(it);
+      inFlight_.insert(photoId);
+    }
+
+    try {
+      runJob(photoId, job);
+    } catch (const std::exception &e) {
+      LOG_ERROR("Thumbnail job failed for photo " + std::to_string(photoId) +
+                ": " + std::string(e.what()));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      inFlight_.erase(photoId);
+    }
+    doneCv_.notify_all();
+  }
+}
+
+void ThumbnailQueue::runJob(int photoId, const Job &job) {
+  // All rendition sizes come out of one decode; without force only the
+  // missing ones are rendered. A rebuild keeps serving the old renditions
+  // until the new ones are appended to the store.
+  ScopedSpan span(SpanPhase::THUMBNAIL, job.traceId, (uint64_t)photoId);
+  if (job.traceId.empty())
+    span.cancel();
+  ThumbnailGenerator::generateRenditions(job.sourcePath, photoId, store_,
+                                         job.force);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ThumbnailStore.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// Background thumbnail job queue.
+// Photos are enqueued when an upload is finalized (INGEST), when the
+// dashboard asks for a thumbnail that is not rendered yet (VISIBLE), or when
+// an admin requests a rebuild (REBUILD). A bounded pool of worker threads
+// renders them so decoding never happens on a Crow request thread.
+class ThumbnailQueue {
+public:
+  // Lower value runs first
+  enum class Priority : int { VISIBLE = 0, INGEST = 1, REBUILD = 2 };
+
+  struct Config {
+    int workerThreads = 2;
+  };
+
+  explicit ThumbnailQueue(ThumbnailStore &store);
+  ~ThumbnailQueue();
+
+  void start(const Config &config);
+  void stop();
+
+  // Queue a photo for rendering. If the photo is already queued, its priority
+  // is raised when the new one is higher. With force=false only missing
+  // renditions are rendered; force=true re-renders all of them in place.
+  // A non-empty traceId records the render as a THUMBNAIL span of that trace.
+  bool enqueue(int photoId, const std::string &sourcePath, Priority priority,
+               bool force = false, const std::string &traceId = "");
+
+  // Queue at VISIBLE priority and block until the job has run or the timeout
+  // elapses. Returns true if every rendition is available afterwards.
+  bool requestAndWait(int photoId, const std::string &sourcePath,
+                      std::chrono::milliseconds timeout, bool force = false);
+
+  size_t pendingCount() const;
+
+  // Store the rendered thumbnails are written to and served from
+  ThumbnailStore &store() { return store_; }
+
+private:
+  struct Job {
+    std::string sourcePath;
+    Priority priority;
+    bool force;
+    uint64_t seq;
+    std::string traceId;
+  };
+
+  // (priority, seq, photoId) - ordered so begin() is the next job to run
+  using OrderKey = std::tuple<int, uint64_t, int>;
+
+  void workerLoop();
+  void runJob(int photoId, const Job &job);
+
+  ThumbnailStore &store_;
+  Config config_;
+  std::atomic<bool> running_;
+  std::vector<std::thread> workers_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable workCv_;
+  std::condition_variable doneCv_;
+  std::map<int, Job> pending_;
+  std::set<OrderKey> order_;
+  std::set<int> inFlight_;
+  uint64_t nextSeq_ = 0;
+};
@@ -0,0 +1,703 @@
+#include "ThumbnailStore.h"
+#include "Logger.h"
+#include "ThumbnailGenerator.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <regex>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Record layout (little-endian):
+//   magic u32 | photoId u32 | size u32 | flags u32 | length u32 | checksum u64
+// followed by `length` bytes of encoded image data.
+const uint32_t RECORD_MAGIC = 0x42485450; // "PTHB"
+const uint32_t FLAG_TOMBSTONE = 0x1;
+const size_t HEADER_SIZE = 28;
+
+struct RecordHeader {
+  uint32_t magic;
+  int32_t photoId;
+  int32_t size;
+  uint32_t flags;
+  uint32_t length;
+  uint64_t checksum;
+};
+
+void putLE(unsigned char *p, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    p[i] = (unsigned char)((value >> (8 * i)) & 0xFF);
+  }
+}
+
+uint64_t getLE(const unsigned char *p, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i) {
+    value |= (uint64_t)p[i] << (8 * i);
+  }
+  return value;
+}
+
+void encodeHeader(const RecordHeader &h, unsigned char *out) {
+  putLE(out, h.magic, 4);
+  putLE(out + 4, (uint32_t)h.photoId, 4);
+  putLE(out + 8, (uint32_t)h.size, 4);
+  putLE(out + 12, h.flags, 4);
+  putLE(out + 16, h.length, 4);
+  putLE(out + 20, h.checksum, 8);
+}
+
+RecordHeader decodeHeader(const unsigned char *in) {
+  RecordHeader h;
+  h.magic = (uint32_t)getLE(in, 4);
+  h.photoId = (int32_t)(uint32_t)getLE(in + 4, 4);
+  h.size = (int32_t)(uint32_t)getLE(in + 8, 4);
+  h.flags = (uint32_t)getLE(in + 12, 4);
+  h.length = (uint32_t)getLE(in + 16, 4);
+  h.checksum = getLE(in + 20, 8);
+  return h;
+}
+
+// FNV-1a, enough to catch torn or corrupted records
+uint64_t checksum(const char *data, size_t length) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+} // namespace
+
+// Positional file I/O (pread/pwrite), so readers never share a file offset
+// and can run without holding the store lock
+class SegmentFile {
+public:
+  static std::shared_ptr<SegmentFile> open(const std::string &path) {
+    auto file = std::make_shared<SegmentFile>();
+#ifdef _WIN32
+    // FILE_SHARE_DELETE lets compaction remove a segment that a reader still
+    // has open
+    file->handle_ = CreateFileA(
+        path.c_str(), GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file->handle_ == INVALID_HANDLE_VALUE) {
+      return nullptr;
+    }
+#else
+    file->fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (file->fd_ < 0) {
+      return nullptr;
+    }
+#endif
+    return file;
+  }
+
+  ~SegmentFile() {
+#ifdef _WIN32
+    if (handle_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(handle_);
+    }
+#else
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+#endif
+  }
+
+  bool readAt(uint64_t offset, void *buffer, size_t length) const {
+    char *out = static_cast<char *>(buffer);
+    while (length > 0) {
+#ifdef _WIN32
+      OVERLAPPED ov = {};
+      ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+      ov.OffsetHigh = (DWORD)(offset >> 32);
+      DWORD chunk = (DWORD)std::min<size_t>(length, 1 << 30);
+      DWORD got = 0;
+      if (!ReadFile(handle_, out, chunk, &got, &ov) || got == 0) {
+        return false;
+      }
+#else
+      ssize_t got = ::pread(fd_, out, length, (off_t)offset);
+      if (got <= 0) {
+        return false;
+      }
+#endif
+      out += got;
+      offset += got;
+      length -= got;
+    }
+    return true;
+  }
+
+  bool writeAt(uint64_t offset, const void *buffer, size_t length) {
+    const char *in = static_cast<const char *>(buffer);
+    while (length > 0) {
+#ifdef _WIN32
+      OVERLAPPED ov = {};
+      ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+      ov.OffsetHigh = (DWORD)(offset >> 32);
+      DWORD chunk = (DWORD)std::min<size_t>(length, 1 << 30);
+      DWORD put = 0;
+      if (!WriteFile(handle_, in, chunk, &put, &ov) || put == 0) {
+        return false;
+      }
+#else
+      ssize_t put = ::pwrite(fd_, in, length, (off_t)offset);
+      if (put <= 0) {
+        return false;
+      }
+#endif
+      in += put;
+      offset += put;
+      length -= put;
+    }
+    return true;
+  }
+
+  bool truncate(uint64_t size) {
+#ifdef _WIN32
+    LARGE_INTEGER pos;
+    pos.QuadPart = (LONGLONG)size;
+    return SetFilePointerEx(handle_, pos, NULL, FILE_BEGIN) &&
+           SetEndOfFile(handle_);
+#else
+    return ::ftruncate(fd_, (off_t)size) == 0;
+#endif
+  }
+
+  uint64_t size() const {
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    return GetFileSizeEx(handle_, &size) ? (uint64_t)size.QuadPart : 0;
+#else
+    struct stat st;
+    return ::fstat(fd_, &st) == 0 ? (uint64_t)st.st_size : 0;
+#endif
+  }
+
+private:
+#ifdef _WIN32
+  HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+  int fd_ = -1;
+#endif
+};
+
+ThumbnailStore::ThumbnailStore(const std::string &directory,
+                               uint64_t maxSegmentBytes, uint64_t cacheBytes)
+    : directory_(directory), maxSegmentBytes_(maxSegmentBytes),
+      cache_(cacheBytes) {}
+
+ThumbnailStore::~ThumbnailStore() { close(); }
+
+uint64_t ThumbnailStore::makeKey(int photoId, int size) {
+  return ((uint64_t)(uint32_t)photoId << 32) | (uint32_t)size;
+}
+
+std::string ThumbnailStore::segmentPath(uint32_t id) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "seg-%06u.pack", id);
+  return (fs::path(directory_) / name).string();
+}
+
+bool ThumbnailStore::open() {
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (open_) {
+      return true;
+    }
+
+    try {
+      fs::create_directories(directory_);
+    } catch (const std::exception &e) {
+      LOG_ERROR("Failed to create thumbnail store directory: " +
+                std::string(e.what()));
+      return false;
+    }
+
+    // Segments are replayed in id order so later records win
+    std::vector<uint32_t> ids;
+    std::regex segmentName(R"(seg-(\d+)\.pack)");
+    for (const auto &entry : fs::directory_iterator(directory_)) {
+      std::smatch match;
+      std::string name = entry.path().filename().string();
+      if (std::regex_match(name, match, segmentName)) {
+        ids.push_back((uint32_t)std::stoul(match[1].str()));
+      }
+    }
+    std::sort(ids.begin(), ids.end());
+
+    for (uint32_t id : ids) {
+      Segment segment;
+      segment.id = id;
+      segment.path = segmentPath(id);
+      segment.file = SegmentFile::open(segment.path);
+      if (!segment.file) {
+        LOG_ERROR("Failed to open thumbnail segment: " + segment.path);
+        return false;
+      }
+      segments_[id] = segment;
+      if (!scanSegment(segments_[id])) {
+        return false;
+      }
+      activeSegment_ = id;
+    }
+
+    if (segments_.empty() && !openNewSegment()) {
+      return false;
+    }
+    open_ = true;
+
+    LOG_INFO("Thumbnail store opened: " + std::to_string(index_.size()) +
+             " renditions in " + std::to_string(segments_.size()) +
+             " segment(s)");
+  }
+
+  importLegacyFiles();
+  return true;
+}
+
+void ThumbnailStore::close() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  index_.clear();
+  segments_.clear();
+  cache_.clear();
+  activeSegment_ = 0;
+  open_ = false;
+}
+
+bool ThumbnailStore::scanSegment(Segment &segment) {
+  uint64_t fileSize = segment.file->size();
+  uint64_t offset = 0;
+  unsigned char buffer[HEADER_SIZE];
+
+  while (offset + HEADER_SIZE <= fileSize) {
+    if (!segment.file->readAt(offset, buffer, HEADER_SIZE)) {
+      break;
+    }
+    RecordHeader header = decodeHeader(buffer);
+    if (header.magic != RECORD_MAGIC ||
+        offset + HEADER_SIZE + header.length > fileSize) {
+      break;
+    }
+
+    Entry entry{segment.id, offset, header.length, header.checksum};
+    applyRecord(makeKey(header.photoId, header.size),
+                (header.flags & FLAG_TOMBSTONE) != 0, entry,
+                HEADER_SIZE + header.length);
+    offset += HEADER_SIZE + header.length;
+  }
+
+  // A torn write at the tail (crash mid-append) is cut off
+  if (offset != fileSize) {
+    LOG_WARN("Truncating thumbnail segment " + segment.path + " from " +
+             std::to_string(fileSize) + " to " + std::to_string(offset) +
+             " bytes");
+    if (!segment.file->truncate(offset)) {
+      LOG_ERROR("Failed to truncate thumbnail segment: " + segment.path);
+      return false;
+    }
+  }
+  segment.size = offset;
+  return true;
+}
+
+bool ThumbnailStore::openNewSegment() {
+  uint32_t id = segments_.empty() ? 1 : segments_.rbegin()->first + 1;
+  Segment segment;
+  segment.id = id;
+  segment.path = segmentPath(id);
+  segment.file = SegmentFile::open(segment.path);
+  if (!segment.file) {
+    LOG_ERROR("Failed to create thumbnail segment: " + segment.path);
+    return false;
+  }
+  segment.file->truncate(0);
+  segments_[id] = segment;
+  activeSegment_ = id;
+  return true;
+}
+
+void ThumbnailStore::applyRecord(uint64_t key, bool tombstone,
+                                 const Entry &entry, uint64_t recordBytes) {
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    auto old = segments_.find(it->second.segmentId);
+    if (old != segments_.end()) {
+      old->second.liveBytes -= HEADER_SIZE + it->second.length;
+    }
+  }
+
+  // Tombstones count as live: they must survive until no older segment can
+  // still hold the record they delete
+  segments_[entry.segmentId].liveBytes += recordBytes;
+
+  if (tombstone) {
+    if (it != index_.end()) {
+      index_.erase(it);
+    }
+  } else {
+    index_[key] = entry;
+  }
+}
+
+bool ThumbnailStore::appendRecord(int photoId, int size, bool tombstone,
+                                  const std::string &data, Entry *written) {
+  uint64_t recordBytes = HEADER_SIZE + data.size();
+  Segment *active = &segments_[activeSegment_];
+  if (active->size > 0 && active->size + recordBytes > maxSegmentBytes_) {
+    if (!openNewSegment()) {
+      return false;
+    }
+    active = &segments_[activeSegment_];
+  }
+
+  RecordHeader header{RECORD_MAGIC,
+                      photoId,
+                      size,
+                      tombstone ? FLAG_TOMBSTONE : 0,
+                      (uint32_t)data.size(),
+                      checksum(data.data(), data.size())};
+
+  // One write per record so a crash leaves at most a short tail
+  std::string record(HEADER_SIZE, '\0');
+  encodeHeader(header, reinterpret_cast<unsigned char *>(&record[0]));
+  record += data;
+  if (!active->file->writeAt(active->size, record.data(), record.size())) {
+    LOG_ERROR("Failed to append to thumbnail segment: " + active->path);
+    // Drop whatever part of the record made it to disk
+    active->file->truncate(active->size);
+    return false;
+  }
+
+  Entry entry{active->id, active->size, header.length, header.checksum};
+  active->size += recordBytes;
+  applyRecord(makeKey(photoId, size), tombstone, entry, recordBytes);
+  if (written) {
+    *written = entry;
+  }
+  return true;
+}
+
+bool ThumbnailStore::put(int photoId, int size, const std::string &data) {
+  bool rolledOver = false;
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (!open_) {
+      return false;
+    }
+
+    uint32_t before = activeSegment_;
+    if (!appendRecord(photoId, size, false, data, nullptr)) {
+      return false;
+    }
+    cache_.erase(photoId, size);
+    rolledOver = activeSegment_ != before && !compacting_;
+  }
+
+  // Rolling over to a new segment is the natural point to reclaim space
+  if (rolledOver) {
+    compact(0.5);
+  }
+  return true;
+}
+
+bool ThumbnailStore::get(int photoId, int size, std::string &data,
+                         uint64_t *checksumOut) const {
+  Entry entry;
+  std::shared_ptr<SegmentFile> file;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = index_.find(makeKey(photoId, size));
+    if (it == index_.end()) {
+      return false;
+    }
+    entry = it->second;
+    auto segment = segments_.find(entry.segmentId);
+    if (segment == segments_.end()) {
+      return false;
+    }
+    // Holding the file keeps it readable even if compaction drops the
+    // segment meanwhile
+    file = segment->second.file;
+  }
+  if (checksumOut) {
+    *checksumOut = entry.checksum;
+  }
+
+  if (auto cached = cache_.get(photoId, size, entry.checksum)) {
+    data = *cached;
+    return true;
+  }
+
+  auto blob = std::make_shared<std::string>(entry.length, '\0');
+  if (entry.length > 0 &&
+      !file->readAt(entry.offset + HEADER_SIZE, &(*blob)[0], entry.length)) {
+    LOG_ERROR("Failed to read thumbnail " + std::to_string(photoId) + "/" +
+              std::to_string(size));
+    return false;
+  }
+  if (checksum(blob->data(), blob->size()) != entry.checksum) {
+    LOG_WARN("Checksum mismatch for thumbnail " + std::to_string(photoId) +
+             "/" + std::to_string(size));
+    return false;
+  }
+
+  data = *blob;
+  cache_.put(photoId, size, entry.checksum, std::move(blob));
+  return true;
+}
+
+bool ThumbnailStore::contains(int photoId, int size) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return index_.count(makeKey(photoId, size)) > 0;
+}
+
+bool ThumbnailStore::getChecksum(int photoId, int size,
+                                 uint64_t &checksum) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto it = index_.find(makeKey(photoId, size));
+  if (it == index_.end()) {
+    return false;
+  }
+  checksum = it->second.checksum;
+  return true;
+}
+
+bool ThumbnailStore::remove(int photoId) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  if (!open_) {
+    return false;
+  }
+
+  std::vector<int> sizes;
+  for (const auto &item : index_) {
+    if ((int32_t)(uint32_t)(item.first >> 32) == photoId) {
+      sizes.push_back((int32_t)(uint32_t)(item.first & 0xFFFFFFFF));
+    }
+  }
+  for (int size : sizes) {
+    if (!appendRecord(photoId, size, true, std::string(), nullptr)) {
+      return false;
+    }
+    cache_.erase(photoId, size);
+  }
+  return true;
+}
+
+bool ThumbnailStore::compact(double maxLiveRatio) {
+  std::vector<uint32_t> candidates;
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (!open_) {
+      return false;
+    }
+    if (compacting_) {
+      return true;
+    }
+    for (const auto &item : segments_) {
+      const Segment &segment = item.second;
+      if (segment.id != activeSegment_ &&
+          segment.liveBytes < maxLiveRatio * segment.size) {
+        candidates.push_back(segment.id);
+      }
+    }
+    if (candidates.empty()) {
+      return true;
+    }
+    compacting_ = true;
+  }
+
+  bool success = true;
+  for (uint32_t id : candidates) {
+    if (!compactSegment(id)) {
+      success = false;
+      break;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  compacting_ = false;
+  return success;
+}
+
+bool ThumbnailStore::compactSegment(uint32_t segmentId) {
+  // Sealed segments are never appended to, so the file and its size can be
+  // read without the lock; each record is re-checked against the index under
+  // the lock before it is copied, since a put or remove may have superseded
+  // it in the meantime
+  std::shared_ptr<SegmentFile> file;
+  std::string path;
+  uint64_t size = 0;
+  uint64_t reclaimed = 0;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = segments_.find(segmentId);
+    if (it == segments_.end()) {
+      return true;
+    }
+    file = it->second.file;
+    path = it->second.path;
+    size = it->second.size;
+    reclaimed = size - it->second.liveBytes;
+  }
+
+  // Copy live records forward into the active segment
+  uint64_t offset = 0;
+  unsigned char buffer[HEADER_SIZE];
+  std::string data;
+  while (offset < size) {
+    if (!file->readAt(offset, buffer, HEADER_SIZE)) {
+      LOG_ERROR("Failed to read thumbnail segment: " + path);
+      return false;
+    }
+    RecordHeader header = decodeHeader(buffer);
+    uint64_t key = makeKey(header.photoId, header.size);
+    uint64_t recordOffset = offset;
+    offset += HEADER_SIZE + header.length;
+
+    if (header.flags & FLAG_TOMBSTONE) {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      auto segment = segments_.find(segmentId);
+      if (segment == segments_.end()) {
+        return false;
+      }
+      // Still needed only if an older segment may hold the deleted record
+      // and nothing newer has replaced it
+      bool oldest = segments_.begin()->first == segmentId;
+      if (!oldest && index_.count(key) == 0) {
+        if (!appendRecord(header.photoId, header.size, true, std::string(),
+                          nullptr)) {
+          return false;
+        }
+      }
+      segment->second.liveBytes -= HEADER_SIZE;
+      continue;
+    }
+
+    auto isLive = [&] {
+      auto it = index_.find(key);
+      return it != index_.end() && it->second.segmentId == segmentId &&
+             it->second.offset == recordOffset;
+    };
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      if (!isLive()) {
+        continue;
+      }
+    }
+
+    data.resize(header.length);
+    if (header.length > 0 &&
+        !file->readAt(recordOffset + HEADER_SIZE, &data[0], header.length)) {
+      LOG_ERROR("Failed to read thumbnail segment: " + path);
+      return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (!open_) {
+      return false;
+    }
+    if (isLive() &&
+        !appendRecord(header.photoId, header.size, false, data, nullptr)) {
+      return false;
+    }
+  }
+
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (segments_.erase(segmentId) == 0) {
+      return false;
+    }
+  }
+  std::error_code ec;
+  fs::remove(path, ec);
+  if (ec) {
+    LOG_WARN("Failed to delete compacted segment " + path + ": " +
+             ec.message());
+  }
+  LOG_INFO("Compacted thumbnail segment " + path + ", reclaimed " +
+           std::to_string(reclaimed) + " bytes");
+  return true;
+}
+
+void ThumbnailStore::importLegacyFiles() {
+  // Older versions wrote one file per rendition into the same directory
+  std::regex legacyName(R"((\d+)(?:_(\d+))?\.jpg)");
+  std::vector<fs::path> files;
+  try {
+    for (const auto &entry : fs::directory_iterator(directory_)) {
+      files.push_back(entry.path());
+    }
+  } catch (const std::exception &e) {
+    LOG_ERROR("Failed to list thumbnail directory: " + std::string(e.what()));
+    return;
+  }
+
+  int imported = 0;
+  for (const auto &path : files) {
+    std::string name = path.filename().string();
+    std::error_code ec;
+    if (path.extension() == ".tmp") {
+      fs::remove(path, ec);
+      continue;
+    }
+
+    std::smatch match;
+    if (!std::regex_match(name, match, legacyName)) {
+      continue;
+    }
+    int photoId = std::stoi(match[1].str());
+    int size = match[2].matched ? std::stoi(match[2].str())
+                                : ThumbnailGenerator::DEFAULT_SIZE;
+
+    std::ifstream file(path, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+    file.close();
+    if (!content.empty() && put(photoId, size, content)) {
+      fs::remove(path, ec);
+      imported++;
+    }
+  }
+
+  if (imported > 0) {
+    LOG_INFO("Imported " + std::to_string(imported) +
+             " legacy thumbnail files into the packed store");
+  }
+}
+
+ThumbnailStore::Stats ThumbnailStore::getStats() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  Stats stats;
+  stats.entries = index_.size();
+  stats.segments = segments_.size();
+  for (const auto &item : segments_) {
+    stats.totalBytes += item.second.size;
+    stats.liveBytes += item.second.liveBytes;
+  }
+  return stats;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "ThumbnailCache.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+class SegmentFile;
+
+// Append-only packed store for encoded thumbnails.
+// Renditions are appended to large segment files (seg-NNNNNN.pack) instead of
+// one file per photo. An in-memory index maps (photoId, size) to the record's
+// location and is rebuilt by scanning the segments on open. Overwrites and
+// removals leave dead records behind; segments that are mostly dead are
+// compacted when the active segment rolls over. Hot renditions are served
+// from an in-memory LRU in front of the segments.
+class ThumbnailStore {
+public:
+  static constexpr uint64_t DEFAULT_SEGMENT_BYTES = 256ULL * 1024 * 1024;
+  static constexpr uint64_t DEFAULT_CACHE_BYTES = 64ULL * 1024 * 1024;
+
+  struct Stats {
+    size_t entries = 0;
+    size_t segments = 0;
+    uint64_t totalBytes = 0;
+    uint64_t liveBytes = 0;
+  };
+
+  explicit ThumbnailStore(const std::string &directory,
+                          uint64_t maxSegmentBytes = DEFAULT_SEGMENT_BYTES,
+                          uint64_t cacheBytes = DEFAULT_CACHE_BYTES);
+  ~ThumbnailStore();
+
+  // Create the directory if needed, scan existing segments and import any
+  // loose <id>.jpg / <id>_<size>.jpg files left by older versions
+  bool open();
+  void close();
+
+  // Store (or replace) the encoded rendition of a photo
+  bool put(int photoId, int size, const std::string &data);
+
+  // Read a rendition. Returns false if it is missing or fails its checksum.
+  bool get(int photoId, int size, std::string &data,
+           uint64_t *checksum = nullptr) const;
+
+  bool contains(int photoId, int size) const;
+
+  // Content checksum of a stored rendition, from the index alone (no I/O)
+  bool getChecksum(int photoId, int size, uint64_t &checksum) const;
+
+  // Drop every rendition of a photo
+  bool remove(int photoId);
+
+  // Rewrite sealed segments whose live data is below maxLiveRatio of their
+  // size into the active segment and delete them. Segment reads happen
+  // outside the lock; only the appends and index updates take it.
+  bool compact(double maxLiveRatio = 0.5);
+
+  Stats getStats() const;
+  ThumbnailCache::Stats getCacheStats() const { return cache_.getStats(); }
+
+private:
+  struct Segment {
+    uint32_t id = 0;
+    std::string path;
+    std::shared_ptr<SegmentFile> file;
+    uint64_t size = 0;
+    uint64_t liveBytes = 0;
+  };
+
+  struct Entry {
+    uint32_t segmentId;
+    uint64_t offset; // Start of the record header
+    uint32_t length; // Payload length
+    uint64_t checksum;
+  };
+
+  static uint64_t makeKey(int photoId, int size);
+
+  std::string segmentPath(uint32_t id) const;
+  bool scanSegment(Segment &segment);
+  bool openNewSegment();
+  bool appendRecord(int photoId, int size, bool tombstone,
+                    const std::string &data, Entry *written);
+  void applyRecord(uint64_t key, bool tombstone, const Entry &entry,
+                   uint64_t recordBytes);
+  bool compactSegment(uint32_t segmentId);
+  void importLegacyFiles();
+
+  std::string directory_;
+  uint64_t maxSegmentBytes_;
+  bool open_ = false;
+  bool compacting_ = false; // At most one compaction at a time
+
+  mutable std::shared_mutex mutex_;
+  std::map<uint32_t, Segment> segments_;
+  std::unordered_map<uint64_t, Entry> index_;
+  uint32_t activeSegment_ = 0;
+
+  mutable ThumbnailCache cache_;
+};
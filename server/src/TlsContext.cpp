@@ -0,0 +1,407 @@
+#include "TlsContext.h"
+#include "ConfigManager.h"
+#include "Logger.h"
+#include "MetricsRegistry.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <openssl/hmac.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/tls.h>)
+#define PHOTOSYNC_HAVE_KTLS 1
+#include <cerrno>
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
+namespace {
+
+// Cache entries are only reused by contexts with the same id
+const unsigned char SESSION_ID_CONTEXT[] = "photosync-upload";
+
+// X25519 is the cheapest key agreement; P-256 for clients without it
+const char *GROUPS = "X25519:P-256";
+
+// TLS 1.3 suites, in server preference order
+const char *TLS13_AES_FIRST = "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:"
+                              "TLS_CHACHA20_POLY1305_SHA256";
+const char *TLS13_CHACHA_FIRST = "TLS_CHACHA20_POLY1305_SHA256:"
+                                 "TLS_AES_128_GCM_SHA256:"
+                                 "TLS_AES_256_GCM_SHA384";
+
+// TLS 1.2: forward-secret AEAD suites only, for ECDSA and RSA certificates
+const char *TLS12_AES_FIRST =
+    "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+    "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:"
+    "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305";
+const char *TLS12_CHACHA_FIRST =
+    "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:"
+    "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+    "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384";
+
+// Secret the client encrypts application data with, captured during the
+// handshake and wiped once the receive keys are installed
+struct TrafficSecret {
+  unsigned char bytes[EVP_MAX_MD_SIZE];
+  size_t length = 0;
+};
+
+void freeTrafficSecret(void * /*parent*/, void *ptr, CRYPTO_EX_DATA * /*ad*/,
+                       int /*index*/, long /*argl*/, void * /*argp*/) {
+  auto *secret = static_cast<TrafficSecret *>(ptr);
+  if (secret) {
+    OPENSSL_cleanse(secret, sizeof(*secret));
+    delete secret;
+  }
+}
+
+int trafficSecretIndex() {
+  static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr,
+                                          freeTrafficSecret);
+  return index;
+}
+
+// Keylog callback; only installed when kernel receive is enabled
+void captureTrafficSecret(const SSL *ssl, const char *line) {
+  static const char LABEL[] = "CLIENT_TRAFFIC_SECRET_0 ";
+  if (std::strncmp(line, LABEL, sizeof(LABEL) - 1) != 0)
+    return;
+  const char *hex = std::strrchr(line, ' ') + 1;
+  size_t hexLength = std::strlen(hex);
+  if (hexLength % 2 != 0 || hexLength / 2 > EVP_MAX_MD_SIZE)
+    return;
+
+  auto *secret = new TrafficSecret;
+  secret->length = hexLength / 2;
+  for (size_t i = 0; i < secret->length; ++i) {
+    int high = OPENSSL_hexchar2int((unsigned char)hex[2 * i]);
+    int low = OPENSSL_hexchar2int((unsigned char)hex[2 * i + 1]);
+    if (high < 0 || low < 0) {
+      freeTrafficSecret(nullptr, secret, nullptr, 0, 0, nullptr);
+      return;
+    }
+    secret->bytes[i] = (unsigned char)((high << 4) | low);
+  }
+
+  SSL *owner = const_cast<SSL *>(ssl);
+  freeTrafficSecret(nullptr, SSL_get_ex_data(owner, trafficSecretIndex()),
+                    nullptr, 0, 0, nullptr);
+  SSL_set_ex_data(owner, trafficSecretIndex(), secret);
+}
+
+#ifdef PHOTOSYNC_HAVE_KTLS
+
+// HKDF-Expand-Label(secret, label, "", length) from RFC 8446 section 7.1,
+// for outputs no longer than one hash block
+bool expandLabel(const EVP_MD *md, const TrafficSecret &secret,
+                 const char *label, unsigned char *out, size_t length) {
+  static const char PREFIX[] = "tls13 ";
+  size_t labelLength = sizeof(PREFIX) - 1 + std::strlen(label);
+  unsigned char info[32];
+  size_t n = 0;
+  info[n++] = (unsigned char)(length >> 8);
+  info[n++] = (unsigned char)length;
+  info[n++] = (unsigned char)labelLength;
+  std::memcpy(info + n, PREFIX, sizeof(PREFIX) - 1);
+  n += sizeof(PREFIX) - 1;
+  std::memcpy(info + n, label, std::strlen(label));
+  n += std::strlen(label);
+  info[n++] = 0; // Empty context
+  info[n++] = 1; // First (and only) HKDF block
+
+  unsigned char block[EVP_MAX_MD_SIZE];
+  unsigned int blockLength = 0;
+  bool ok = HMAC(md, secret.bytes, (int)secret.length, info, n, block,
+                 &blockLength) != nullptr &&
+            blockLength >= length;
+  if (ok)
+    std::memcpy(out, block, length);
+  OPENSSL_cleanse(block, sizeof(block));
+  return ok;
+}
+
+// Fill in the kernel's crypto_info for the negotiated suite. The first
+// record after the handshake has sequence number 0.
+template <typename Info>
+void fillCryptoInfo(Info &info, unsigned short cipherType,
+                    const unsigned char *key, const unsigned char *iv) {
+  info.info.version = TLS_1_3_VERSION;
+  info.info.cipher_type = cipherType;
+  std::memcpy(info.key, key, sizeof(info.key));
+  // The 12-byte TLS 1.3 IV is split into salt and iv (AES-GCM) or is all iv
+  // (ChaCha20-Poly1305, which has an empty salt)
+  std::memcpy(info.salt, iv, sizeof(info.salt));
+  std::memcpy(info.iv, iv + sizeof(info.salt), sizeof(info.iv));
+  std::memset(info.rec_seq, 0, sizeof(info.rec_seq));
+}
+
+bool installReceiveKeys(SSL *ssl, int fd, const TrafficSecret &secret) {
+  if (SSL_version(ssl) != TLS1_3_VERSION)
+    return false;
+  // Records OpenSSL has already taken off the socket can't be handed over
+  if (SSL_has_pending(ssl) || BIO_ctrl_pending(SSL_get_rbio(ssl)) > 0)
+    return false;
+
+  const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+  const EVP_MD *md = SSL_CIPHER_get_handshake_digest(cipher);
+  union {
+    tls12_crypto_info_aes_gcm_128 aes128;
+    tls12_crypto_info_aes_gcm_256 aes256;
+    tls12_crypto_info_chacha20_poly1305 chacha;
+  } info;
+  std::memset(&info, 0, sizeof(info));
+  size_t infoLength = 0;
+  size_t keyLength = 0;
+  switch (SSL_CIPHER_get_protocol_id(cipher)) {
+  case 0x1301: // TLS_AES_128_GCM_SHA256
+    keyLength = sizeof(info.aes128.key);
+    infoLength = sizeof(info.aes128);
+    break;
+  case 0x1302: // TLS_AES_256_GCM_SHA384
+    keyLength = sizeof(info.aes256.key);
+    infoLength = sizeof(info.aes256);
+    break;
+  case 0x1303: // TLS_CHACHA20_POLY1305_SHA256
+    keyLength = sizeof(info.chacha.key);
+    infoLength = sizeof(info.chacha);
+    break;
+  default:
+    return false;
+  }
+
+  unsigned char key[32];
+  unsigned char iv[12];
+  bool ok = md && expandLabel(md, secret, "key", key, keyLength) &&
+            expandLabel(md, secret, "iv", iv, sizeof(iv));
+  if (ok) {
+    switch (SSL_CIPHER_get_protocol_id(cipher)) {
+    case 0x1301:
+      fillCryptoInfo(info.aes128, TLS_CIPHER_AES_GCM_128, key, iv);
+      break;
+    case 0x1302:
+      fillCryptoInfo(info.aes256, TLS_CIPHER_AES_GCM_256, key, iv);
+      break;
+    default:
+      fillCryptoInfo(info.chacha, TLS_CIPHER_CHACHA20_POLY1305, key, iv);
+      break;
+    }
+  }
+  OPENSSL_cleanse(key, sizeof(key));
+  OPENSSL_cleanse(iv, sizeof(iv));
+
+  if (ok && setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+    static std::atomic<bool> warned{false};
+    if (!warned.exchange(true)) {
+      LOG_WARN("kTLS unavailable (" + std::string(std::strerror(errno)) +
+               "); decrypting uploads in user space. Load the tls kernel "
+               "module to enable it.");
+    }
+    ok = false;
+  }
+  // With the ULP attached but no keys, the socket still behaves as plain TCP
+  if (ok && setsockopt(fd, SOL_TLS, TLS_RX, &info, infoLength) != 0) {
+    LOG_WARN("kTLS receive setup failed: " + std::string(std::strerror(errno)));
+    ok = false;
+  }
+  OPENSSL_cleanse(&info, sizeof(info));
+  return ok;
+}
+
+#endif // PHOTOSYNC_HAVE_KTLS
+
+} // namespace
+
+TlsContext::Options TlsContext::fromConfig(const ConfigManager &config) {
+  Options options;
+  options.certificateChainFile = config.getTlsCertificateFile();
+  options.privateKeyFile = config.getTlsPrivateKeyFile();
+  options.sessionTickets = config.getTlsSessionTickets();
+  options.sessionCacheSize = config.getTlsSessionCacheSize();
+  options.sessionTimeoutSeconds = config.getTlsSessionTimeoutSec();
+  options.tls13Only = config.getTlsMinVersion() == "1.3";
+  options.cipherPreference =
+      parseCipherPreference(config.getTlsCipherPreference());
+  options.kernelReceive = config.getTlsKernelReceive();
+  return options;
+}
+
+TlsContext::CipherPreference
+TlsContext::parseCipherPreference(const std::string &value) {
+  std::string lower = value;
+  std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+  if (lower == "aesgcm" || lower == "aes-gcm" || lower == "aes")
+    return CipherPreference::AES_GCM;
+  if (lower == "chacha20" || lower == "chacha")
+    return CipherPreference::CHACHA20;
+  return CipherPreference::AUTO;
+}
+
+const char *TlsContext::cipherPreferenceName(CipherPreference preference) {
+  switch (preference) {
+  case CipherPreference::AES_GCM:
+    return "aesgcm";
+  case CipherPreference::CHACHA20:
+    return "chacha20";
+  default:
+    return "auto";
+  }
+}
+
+TlsContext::CipherPreference TlsContext::resolve(CipherPreference preference) {
+  if (preference != CipherPreference::AUTO)
+    return preference;
+  return hasAesHardware() ? CipherPreference::AES_GCM
+                          : CipherPreference::CHACHA20;
+}
+
+bool TlsContext::hasAesHardware() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 25)) != 0;
+#elif defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  return (ecx & bit_AES) != 0;
+#elif defined(__aarch64__) && defined(__linux__)
+  return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#elif defined(__aarch64__) && defined(__APPLE__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TlsContext::configure(boost::asio::ssl::context &context,
+                           const Options &options) {
+  context.set_options(boost::asio::ssl::context::default_workarounds |
+                      boost::asio::ssl::context::no_sslv2 |
+                      boost::asio::ssl::context::single_dh_use);
+  context.use_certificate_chain_file(options.certificateChainFile);
+  context.use_private_key_file(options.privateKeyFile,
+                               boost::asio::ssl::context::pem);
+
+  SSL_CTX *ctx = context.native_handle();
+  SSL_CTX_set_min_proto_version(ctx, options.tls13Only ? TLS1_3_VERSION
+                                                       : TLS1_2_VERSION);
+  SSL_CTX_set_max_proto_version(ctx, 0);
+  SSL_CTX_set1_groups_list(ctx, GROUPS);
+
+  // The cost of bulk encryption is ours, so our order wins over the client's
+  bool aesFirst =
+      resolve(options.cipherPreference) == CipherPreference::AES_GCM;
+  SSL_CTX_set_ciphersuites(ctx,
+                           aesFirst ? TLS13_AES_FIRST : TLS13_CHACHA_FIRST);
+  SSL_CTX_set_cipher_list(ctx,
+                          aesFirst ? TLS12_AES_FIRST : TLS12_CHACHA_FIRST);
+  SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
+
+  SSL_CTX_set_session_id_context(ctx, SESSION_ID_CONTEXT,
+                                 sizeof(SESSION_ID_CONTEXT) - 1);
+  SSL_CTX_set_timeout(ctx, options.sessionTimeoutSeconds);
+
+  if (options.sessionCacheSize > 0) {
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, options.sessionCacheSize);
+  } else {
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  }
+
+  // Tickets carry the session to the client, so resumption also works once
+  // a session has been evicted from the cache
+  if (options.sessionTickets)
+    SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+  else
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+
+  // The receive keys for kTLS are derived from the client's traffic secret,
+  // which OpenSSL only exposes through the key log
+  SSL_CTX_set_keylog_callback(ctx, options.kernelReceive ? captureTrafficSecret
+                                                         : nullptr);
+}
+
+bool TlsContext::enableKernelReceive(
+    SSL *ssl, boost::asio::ip::tcp::socket::native_handle_type fd) {
+  // configure() installs the key log callback only when offload is on
+  if (SSL_CTX_get_keylog_callback(SSL_get_SSL_CTX(ssl)) !=
+      captureTrafficSecret)
+    return false;
+
+  // No secret means the session isn't TLS 1.3; it stays on OpenSSL
+  bool enabled = false;
+  auto *secret =
+      static_cast<TrafficSecret *>(SSL_get_ex_data(ssl, trafficSecretIndex()));
+  if (secret) {
+#ifdef PHOTOSYNC_HAVE_KTLS
+    enabled = installReceiveKeys(ssl, fd, *secret);
+#else
+    (void)fd;
+#endif
+    SSL_set_ex_data(ssl, trafficSecretIndex(), nullptr);
+    freeTrafficSecret(nullptr, secret, nullptr, 0, 0, nullptr);
+  }
+
+  static const char *HELP =
+      "Upload connections by where received records are decrypted";
+  static Counter &kernel = MetricsRegistry::getInstance().counter(
+      "photosync_tls_receive_offload_total", HELP, {{"mode", "kernel"}});
+  static Counter &userspace = MetricsRegistry::getInstance().counter(
+      "photosync_tls_receive_offload_total", HELP, {{"mode", "userspace"}});
+  (enabled ? kernel : userspace).inc();
+  return enabled;
+}
+
+void TlsContext::recordHandshake(SSL *ssl,
+                                 std::chrono::steady_clock::duration elapsed) {
+  static const char *HELP = "Completed TLS handshakes on the upload port";
+  static const char *LATENCY_HELP = "TLS handshake time on the upload port";
+  auto &metrics = MetricsRegistry::getInstance();
+  static Counter &full =
+      metrics.counter("photosync_tls_handshakes_total", HELP,
+                      {{"mode", "full"}});
+  static Counter &resumed =
+      metrics.counter("photosync_tls_handshakes_total", HELP,
+                      {{"mode", "resumed"}});
+  static Histogram &fullLatency = metrics.histogram(
+      "photosync_tls_handshake_seconds", LATENCY_HELP, {{"mode", "full"}});
+  static Histogram &resumedLatency = metrics.histogram(
+      "photosync_tls_handshake_seconds", LATENCY_HELP, {{"mode", "resumed"}});
+
+  if (SSL_session_reused(ssl)) {
+    resumed.inc();
+    resumedLatency.observe(elapsed);
+  } else {
+    full.inc();
+    fullLatency.observe(elapsed);
+  }
+}
+
+void TlsContext::keepResumable(SSL *ssl) {
+  if (!SSL_is_init_finished(ssl))
+    return;
+  // A quiet shutdown only sets the shutdown flags; nothing is sent
+  SSL_set_quiet_shutdown(ssl, 1);
+  SSL_shutdown(ssl);
+}
+
+void TlsContext::recordHandshakeFailure() {
+  static Counter &failed = MetricsRegistry::getInstance().counter(
+      "photosync_tls_handshake_failures_total",
+      "TLS handshakes on the upload port that did not complete");
+  failed.inc();
+}
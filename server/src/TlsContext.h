@@ -0,0 +1,83 @@
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl.hpp>
+#include <chrono>
+#include <string>
+
+class ConfigManager;
+
+// TLS setup of the upload listener. Phones drop and re-establish their
+// connection constantly, so sessions are resumable: the server keeps a
+// session cache and issues session tickets, and a returning client skips the
+// certificate exchange and key agreement. Handshakes are counted by kind at
+// /api/metrics so the resumption hit rate is visible.
+//
+// Handshakes and bulk encryption are kept cheap for low-power hosts: ECDHE
+// with X25519 first, AEAD suites only, and the server's suite order decides
+// between AES-GCM (fast with AES instructions) and ChaCha20-Poly1305 (fast
+// without them). ECDSA P-256 certificates work alongside RSA ones and sign
+// much faster.
+//
+// On Linux, decryption of received records can be handed to the kernel
+// (kTLS) once a TLS 1.3 handshake is done, so upload bytes come off the
+// socket as plaintext. Connections that can't be offloaded stay on OpenSSL.
+class TlsContext {
+public:
+  enum class CipherPreference {
+    AUTO,    // AES_GCM if the CPU has AES instructions, else CHACHA20
+    AES_GCM,
+    CHACHA20
+  };
+
+  struct Options {
+    std::string certificateChainFile = "server.crt";
+    std::string privateKeyFile = "server.key";
+    bool sessionTickets = true;
+    long sessionCacheSize = 20480;      // Cached sessions; 0 disables it
+    long sessionTimeoutSeconds = 86400; // Lifetime of sessions and tickets
+    bool tls13Only = false;             // Otherwise TLS 1.2 is accepted too
+    CipherPreference cipherPreference = CipherPreference::AUTO;
+    bool kernelReceive = false; // Offer kTLS receive offload (Linux)
+  };
+
+  // Options from the [tls] section of server.conf
+  static Options fromConfig(const ConfigManager &config);
+
+  // Load the certificate chain and key, restrict protocol versions and
+  // suites and enable session resumption. Throws boost::system::system_error
+  // if either file can't be used.
+  static void configure(boost::asio::ssl::context &context,
+                        const Options &options);
+
+  // "auto", "aesgcm" or "chacha20"; anything else is AUTO
+  static CipherPreference parseCipherPreference(const std::string &value);
+  static const char *cipherPreferenceName(CipherPreference preference);
+
+  // AUTO resolved against the CPU this process runs on
+  static CipherPreference resolve(CipherPreference preference);
+
+  // AES-NI on x86, the crypto extension on ARMv8
+  static bool hasAesHardware();
+
+  // Install the client's traffic keys on the socket so the kernel decrypts
+  // everything received from now on; the caller then reads plaintext from
+  // the TCP socket and keeps writing through OpenSSL. Returns false and
+  // leaves the connection untouched if offload is off, the session isn't
+  // TLS 1.3, OpenSSL already holds received records, or the kernel lacks
+  // kTLS. Call right after the handshake, before anything is read.
+  static bool
+  enableKernelReceive(SSL *ssl,
+                      boost::asio::ip::tcp::socket::native_handle_type fd);
+
+  // Count a completed server handshake as full or resumed
+  static void recordHandshake(SSL *ssl,
+                              std::chrono::steady_clock::duration elapsed);
+  static void recordHandshakeFailure();
+
+  // Call before a connection is freed. OpenSSL evicts the session of any
+  // connection that ends without a close_notify, which is how phones
+  // usually leave; a completed handshake is marked as cleanly closed so its
+  // cache entry survives for the reconnect.
+  static void keepResumable(SSL *ssl);
+};
@@ -0,0 +1,38 @@
+#include "TokenBucket.h"
+#include <algorithm>
+
+TokenBucket::TokenBucket(double rate, double burst, Clock::time_point now)
+    : rate_(rate), burst_(std::max(burst, rate)), tokens_(burst_),
+      updated_(now) {}
+
+void TokenBucket::refill(Clock::time_point now) {
+  if (now <= updated_)
+    return;
+  double elapsed = std::chrono::duration<double>(now - updated_).count();
+  tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+  updated_ = now;
+}
+
+TokenBucket::Clock::duration TokenBucket::waitTime(size_t bytes,
+                                                   Clock::time_point now) {
+  if (unlimited())
+    return Clock::duration::zero();
+  refill(now);
+  double missing = std::min((double)bytes, burst_) - tokens_;
+  if (missing <= 0)
+    return Clock::duration::zero();
+  return std::chrono::ceil<Clock::duration>(
+      std::chrono::duration<double>(missing / rate_));
+}
+
+void TokenBucket::consume(size_t bytes, Clock::time_point now) {
+  if (unlimited())
+    return;
+  refill(now);
+  tokens_ -= (double)bytes;
+}
+
+double TokenBucket::tokens(Clock::time_point now) {
+  refill(now);
+  return tokens_;
+}
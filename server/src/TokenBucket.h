@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+// Byte-rate limiter. Tokens refill at rate bytes per second up to burst; a
+// request is admitted once the bucket holds min(bytes, burst) tokens and may
+// drive it negative, so requests larger than the burst still get through at
+// the configured average rate. A rate of 0 means unlimited. Not thread-safe.
+class TokenBucket {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit TokenBucket(double rate = 0, double burst = 0,
+                       Clock::time_point now = Clock::now());
+
+  bool unlimited() const { return rate_ <= 0; }
+
+  // How long until bytes may be taken; zero if they may be taken now
+  Clock::duration waitTime(size_t bytes, Clock::time_point now);
+
+  // Take bytes, whether or not they were available
+  void consume(size_t bytes, Clock::time_point now);
+
+  double tokens(Clock::time_point now);
+
+private:
+  void refill(Clock::time_point now);
+
+  double rate_;
+  double burst_;
+  double tokens_;
+  Clock::time_point updated_;
+};
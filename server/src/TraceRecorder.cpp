@@ -0,0 +1,157 @@
+#include "TraceRecorder.h"
+#include "JsonWriter.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+namespace {
+
+size_t roundUpPow2(size_t n) {
+  size_t p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+// Name of the phase-specific value in the exported args, or nullptr
+const char *valueName(SpanPhase phase) {
+  switch (phase) {
+  case SpanPhase::INIT:
+    return "size";
+  case SpanPhase::CHUNK:
+  case SpanPhase::HASH:
+  case SpanPhase::FINALIZE:
+    return "bytes";
+  case SpanPhase::THUMBNAIL:
+    return "photoId";
+  default:
+    return nullptr;
+  }
+}
+
+} // namespace
+
+TraceRecorder &TraceRecorder::getInstance() {
+  static TraceRecorder instance;
+  return instance;
+}
+
+TraceRecorder::TraceRecorder(size_t capacity)
+    : epoch_(std::chrono::steady_clock::now()),
+      slots_(new Slot[roundUpPow2(std::max<size_t>(capacity, 2))]),
+      mask_(roundUpPow2(std::max<size_t>(capacity, 2)) - 1) {}
+
+uint32_t TraceRecorder::currentThreadId() {
+  thread_local uint32_t id =
+      (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+  return id;
+}
+
+const char *TraceRecorder::phaseName(SpanPhase phase) {
+  switch (phase) {
+  case SpanPhase::INIT:
+    return "init";
+  case SpanPhase::CHUNK:
+    return "chunk";
+  case SpanPhase::HASH:
+    return "hash";
+  case SpanPhase::FINALIZE:
+    return "finalize";
+  case SpanPhase::EXIF:
+    return "exif";
+  case SpanPhase::DB_INSERT:
+    return "db_insert";
+  case SpanPhase::THUMBNAIL:
+    return "thumbnail";
+  }
+  return "unknown";
+}
+
+void TraceRecorder::record(SpanPhase phase, std::string_view traceId,
+                           std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end,
+                           uint64_t value) {
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+
+  uint64_t n = head_.fetch_add(1, std::memory_order_relaxed);
+  Slot &slot = slots_[n & mask_];
+
+  slot.sequence.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.startNs =
+      start > epoch_ ? (uint64_t)duration_cast<nanoseconds>(start - epoch_)
+                           .count()
+                     : 0;
+  slot.durationNs =
+      end > start ? (uint64_t)duration_cast<nanoseconds>(end - start).count()
+                  : 0;
+  slot.value = value;
+  slot.threadId = currentThreadId();
+  slot.phase = phase;
+  size_t length = std::min(traceId.size(), MAX_TRACE_ID);
+  std::memcpy(slot.traceId, traceId.data(), length);
+  slot.traceIdLength = (uint8_t)length;
+
+  slot.sequence.store(2 * n + 2, std::memory_order_release);
+}
+
+std::vector<TraceSpan> TraceRecorder::snapshot(const std::string &traceId,
+                                               size_t limit) const {
+  uint64_t head = head_.load(std::memory_order_acquire);
+  uint64_t oldest = head > capacity() ? head - capacity() : 0;
+  if (limit == 0)
+    limit = capacity();
+
+  // Walk newest to oldest so the limit keeps the most recent spans
+  std::vector<TraceSpan> spans;
+  for (uint64_t n = head; n > oldest && spans.size() < limit; --n) {
+    const Slot &slot = slots_[(n - 1) & mask_];
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * (n - 1) + 2)
+      continue; // Still being written, or already overwritten
+
+    TraceSpan span;
+    span.phase = slot.phase;
+    span.traceId.assign(slot.traceId, slot.traceIdLength);
+    span.startMicros = slot.startNs / 1000;
+    span.durationMicros = slot.durationNs / 1000;
+    span.value = slot.value;
+    span.threadId = slot.threadId;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+      continue; // Overwritten while copying
+
+    if (!traceId.empty() && span.traceId != traceId)
+      continue;
+    spans.push_back(std::move(span));
+  }
+
+  std::reverse(spans.begin(), spans.end());
+  return spans;
+}
+
+void TraceRecorder::writeChromeTrace(JsonWriter &w,
+                                     const std::vector<TraceSpan> &spans) {
+  w.beginObject().key("traceEvents").beginArray();
+  for (const TraceSpan &span : spans) {
+    w.beginObject()
+        .field("name", phaseName(span.phase))
+        .field("cat", "upload")
+        .field("ph", "X")
+        .field("ts", span.startMicros)
+        .field("dur", span.durationMicros)
+        .field("pid", 1)
+        .field("tid", span.threadId);
+
+    w.key("args").beginObject().field("traceId", span.traceId);
+    const char *name = valueName(span.phase);
+    if (name && span.value != 0)
+      w.field(name, span.value);
+    w.endObject().endObject();
+  }
+  w.endArray().field("displayTimeUnit", "ms").endObject();
+}
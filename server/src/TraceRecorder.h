@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JsonWriter;
+
+// Upload lifecycle phases a span can cover
+enum class SpanPhase : uint8_t {
+  INIT,
+  CHUNK,
+  HASH,
+  FINALIZE,
+  EXIF,
+  DB_INSERT,
+  THUMBNAIL
+};
+
+// A finished span as copied out of the ring
+struct TraceSpan {
+  SpanPhase phase = SpanPhase::INIT;
+  std::string traceId;
+  uint64_t startMicros = 0; // Steady clock, relative to the recorder epoch
+  uint64_t durationMicros = 0;
+  uint64_t value = 0; // Bytes, or photo id for THUMBNAIL; 0 when unused
+  uint32_t threadId = 0;
+};
+
+// Fixed-size ring of upload spans, exported as Chrome trace-event JSON at
+// /api/traces. Records are plain structs with the trace id inlined, so
+// recording never allocates: a writer claims a slot with one atomic add and
+// publishes it through a per-slot sequence number. Once the ring is full the
+// oldest spans are overwritten; readers skip any slot that changes while it
+// is being copied.
+class TraceRecorder {
+public:
+  static constexpr size_t DEFAULT_CAPACITY = 16384;
+  static constexpr size_t MAX_TRACE_ID = 40; // Longer ids are truncated
+
+  static TraceRecorder &getInstance();
+
+  // capacity is rounded up to a power of two
+  explicit TraceRecorder(size_t capacity = DEFAULT_CAPACITY);
+
+  TraceRecorder(const TraceRecorder &) = delete;
+  TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+  void record(SpanPhase phase, std::string_view traceId,
+              std::chrono::steady_clock::time_point start,
+              std::chrono::steady_clock::time_point end, uint64_t value = 0);
+
+  // Up to limit of the most recent spans (0 = all retained), oldest first.
+  // With a non-empty traceId only spans of that trace are returned.
+  std::vector<TraceSpan> snapshot(const std::string &traceId = "",
+                                  size_t limit = 0) const;
+
+  // {"traceEvents":[...],"displayTimeUnit":"ms"} with one complete ("X")
+  // event per span
+  static void writeChromeTrace(JsonWriter &w,
+                               const std::vector<TraceSpan> &spans);
+
+  static const char *phaseName(SpanPhase phase);
+
+  size_t capacity() const { return mask_ + 1; }
+  uint64_t recordedCount() const {
+    return head_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> sequence{0}; // 2n+1 while writing, 2n+2 when done
+    uint64_t startNs = 0;
+    uint64_t durationNs = 0;
+    uint64_t value = 0;
+    uint32_t threadId = 0;
+    SpanPhase phase = SpanPhase::INIT;
+    uint8_t traceIdLength = 0;
+    char traceId[MAX_TRACE_ID];
+  };
+
+  static uint32_t currentThreadId();
+
+  std::chrono::steady_clock::time_point epoch_;
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  std::atomic<uint64_t> head_{0};
+};
+
+// Records the lifetime of the scope as one span. The trace id and value can
+// be filled in once they are known (e.g. after the upload id is assigned);
+// cancel() drops the span. The trace id is kept inline, so a span never
+// allocates either.
+class ScopedSpan {
+public:
+  ScopedSpan(SpanPhase phase, std::string_view traceId, uint64_t value = 0,
+             TraceRecorder &recorder = TraceRecorder::getInstance())
+      : recorder_(recorder), phase_(phase), value_(value),
+        start_(std::chrono::steady_clock::now()) {
+    setTraceId(traceId);
+  }
+  ~ScopedSpan() {
+    if (active_) {
+      recorder_.record(phase_, std::string_view(traceId_, traceIdLength_),
+                       start_, std::chrono::steady_clock::now(), value_);
+    }
+  }
+
+  ScopedSpan(const ScopedSpan &) = delete;
+  ScopedSpan &operator=(const ScopedSpan &) = delete;
+
+  void setTraceId(std::string_view traceId) {
+    traceIdLength_ = traceId.copy(traceId_, TraceRecorder::MAX_TRACE_ID);
+  }
+  void setValue(uint64_t value) { value_ = value; }
+  void cancel() { active_ = false; }
+
+private:
+  TraceRecorder &recorder_;
+  SpanPhase phase_;
+  char traceId_[TraceRecorder::MAX_TRACE_ID];
+  size_t traceIdLength_ = 0;
+  uint64_t value_;
+  std::chrono::steady_clock::time_point start_;
+  bool active_ = true;
+};
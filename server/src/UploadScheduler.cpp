@@ -0,0 +1,130 @@
+#include "UploadScheduler.h"
+#include "ConfigManager.h"
+#include "MetricsRegistry.h"
+#include <algorithm>
+#include <boost/asio/post.hpp>
+
+namespace {
+
+Histogram &scheduleDelay() {
+  static Histogram &delay = MetricsRegistry::getInstance().histogram(
+      "photosync_upload_schedule_delay_seconds",
+      "Time upload data waited for bandwidth before being processed");
+  return delay;
+}
+
+} // namespace
+
+UploadScheduler::Options
+UploadScheduler::fromConfig(const ConfigManager &config) {
+  Options options;
+  options.globalBytesPerSecond =
+      (double)config.getBandwidthGlobalMBps() * 1024 * 1024;
+  options.deviceBytesPerSecond =
+      (double)config.getBandwidthDeviceMBps() * 1024 * 1024;
+  options.smallUploadBytes =
+      (long long)config.getBandwidthSmallUploadMB() * 1024 * 1024;
+  options.smallUploadWeight = config.getBandwidthSmallUploadWeight();
+  return options;
+}
+
+UploadScheduler::UploadScheduler(boost::asio::io_context &io,
+                                 const Options &options)
+    : io_(io), options_(options),
+      global_(options.globalBytesPerSecond, options.globalBytesPerSecond),
+      timer_(io) {}
+
+double UploadScheduler::weightFor(long long fileSize) const {
+  if (fileSize <= options_.smallUploadBytes && options_.smallUploadWeight > 0)
+    return options_.smallUploadWeight;
+  return 1;
+}
+
+UploadScheduler::Flow &UploadScheduler::flow(const std::string &device,
+                                             Clock::time_point now) {
+  auto it = flows_.find(device);
+  if (it == flows_.end()) {
+    Flow added;
+    added.bucket = TokenBucket(options_.deviceBytesPerSecond,
+                               options_.deviceBytesPerSecond, now);
+    it = flows_.emplace(device, std::move(added)).first;
+  }
+  return it->second;
+}
+
+void UploadScheduler::submit(const std::string &device, size_t bytes,
+                             double weight, std::function<void()> handler) {
+  auto now = Clock::now();
+  Flow &f = flow(device, now);
+  double start = std::max(virtualTime_, f.lastFinish);
+  f.lastFinish = start + (double)bytes / (weight > 0 ? weight : 1);
+
+  bool admitted = queued_ == 0 &&
+                  f.bucket.waitTime(bytes, now) == Clock::duration::zero() &&
+                  global_.waitTime(bytes, now) == Clock::duration::zero();
+  if (admitted) {
+    f.bucket.consume(bytes, now);
+    global_.consume(bytes, now);
+    virtualTime_ = start;
+    handler();
+    return;
+  }
+
+  // Other devices' work may be runnable even while this one waits
+  f.queue.push_back(Request{bytes, start, now, std::move(handler)});
+  ++queued_;
+  pump();
+}
+
+void UploadScheduler::pump() {
+  auto now = Clock::now();
+  auto wait = Clock::duration::max();
+
+  while (queued_ > 0) {
+    // Among devices whose own bucket allows their next request, the one
+    // with the smallest start tag goes first
+    Flow *next = nullptr;
+    for (auto &entry : flows_) {
+      Flow &f = entry.second;
+      if (f.queue.empty())
+        continue;
+      auto deviceWait = f.bucket.waitTime(f.queue.front().bytes, now);
+      if (deviceWait > Clock::duration::zero()) {
+        wait = std::min(wait, deviceWait);
+        continue;
+      }
+      if (!next || f.queue.front().start < next->queue.front().start)
+        next = &f;
+    }
+    if (!next)
+      break;
+
+    Request &request = next->queue.front();
+    auto globalWait = global_.waitTime(request.bytes, now);
+    if (globalWait > Clock::duration::zero()) {
+      wait = std::min(wait, globalWait);
+      break;
+    }
+
+    next->bucket.consume(request.bytes, now);
+    global_.consume(request.bytes, now);
+    virtualTime_ = request.start;
+    scheduleDelay().observe(now - request.submitted);
+    boost::asio::post(io_, std::move(request.handler));
+    next->queue.pop_front();
+    --queued_;
+  }
+
+  // Wake up when the earliest waiting request can go. Re-arming cancels
+  // the previous wait, whose handler then does nothing.
+  if (queued_ > 0 && (!timerArmed_ || now + wait < timer_.expiry())) {
+    timerArmed_ = true;
+    timer_.expires_after(wait);
+    timer_.async_wait([this](const boost::system::error_code &ec) {
+      if (ec == boost::asio::error::operation_aborted)
+        return; // Re-armed, or the scheduler is going away
+      timerArmed_ = false;
+      pump();
+    });
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "TokenBucket.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+
+class ConfigManager;
+
+// Shares upload bandwidth between devices. A Session submits every packet
+// that carries file data before processing it and reads nothing more until
+// it has run, so a throttled device is held back by TCP flow control instead
+// of being buffered here. Work is admitted through a per-device and a global
+// token bucket. When devices compete, start-time fair queueing runs the
+// device that has had the least weighted service first; chunks of small
+// uploads weigh more, so a phone syncing a few photos is not stuck behind
+// another phone's video backup. Used from the io_context thread only.
+class UploadScheduler {
+public:
+  using Clock = TokenBucket::Clock;
+
+  struct Options {
+    double globalBytesPerSecond = 0; // 0 = unlimited
+    double deviceBytesPerSecond = 0; // Each device; 0 = unlimited
+    long long smallUploadBytes = 16LL * 1024 * 1024;
+    double smallUploadWeight = 4; // Relative to 1 for larger uploads
+  };
+
+  // Options from the [bandwidth] section of server.conf
+  static Options fromConfig(const ConfigManager &config);
+
+  UploadScheduler(boost::asio::io_context &io, const Options &options);
+
+  UploadScheduler(const UploadScheduler &) = delete;
+  UploadScheduler &operator=(const UploadScheduler &) = delete;
+
+  // Weight of data belonging to an upload of fileSize bytes
+  double weightFor(long long fileSize) const;
+
+  // Run handler once bytes of the device's data may be processed. It runs
+  // inline if nothing is queued and both buckets have the tokens; otherwise
+  // it is posted to the io_context when its turn comes. Work of one device
+  // runs in submission order.
+  void submit(const std::string &device, size_t bytes, double weight,
+              std::function<void()> handler);
+
+  size_t queued() const { return queued_; }
+
+private:
+  struct Request {
+    size_t bytes;
+    double start; // Virtual start tag
+    Clock::time_point submitted;
+    std::function<void()> handler;
+  };
+
+  struct Flow {
+    TokenBucket bucket;
+    double lastFinish = 0; // Virtual finish tag of the last request
+    std::deque<Request> queue;
+  };
+
+  Flow &flow(const std::string &device, Clock::time_point now);
+  // Run every request whose turn it is; arm the timer for the rest
+  void pump();
+
+  boost::asio::io_context &io_;
+  Options options_;
+  TokenBucket global_;
+  std::map<std::string, Flow> flows_;
+  double virtualTime_ = 0; // Start tag of the request dispatched last
+  size_t queued_ = 0;
+  boost::asio::steady_timer timer_;
+  bool timerArmed_ = false;
+};
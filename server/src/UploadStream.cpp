@@ -0,0 +1,89 @@
+#include "UploadStream.h"
+#include "Logger.h"
+#include "MetricsRegistry.h"
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+bool UploadStream::open(const std::string &path, long long offset) {
+  close();
+  SHA256_Init(&sha_);
+  size_ = 0;
+
+  if (offset > 0) {
+    std::ifstream existing(path, std::ios::binary);
+    char buffer[64 * 1024];
+    while (size_ < offset && existing) {
+      std::streamsize want =
+          (std::streamsize)std::min<long long>(sizeof(buffer), offset - size_);
+      existing.read(buffer, want);
+      SHA256_Update(&sha_, buffer, (size_t)existing.gcount());
+      size_ += existing.gcount();
+    }
+    if (size_ != offset) {
+      LOG_ERROR("Upload temp file shorter than resume offset: " + path);
+      return false;
+    }
+  }
+
+  // Drop anything past the offset so the file matches the hash
+  std::ios::openmode mode = std::ios::binary | std::ios::out;
+  if (offset > 0) {
+    std::error_code ec;
+    std::filesystem::resize_file(path, (uintmax_t)offset, ec);
+    mode |= std::ios::in;
+  } else {
+    mode |= std::ios::trunc;
+  }
+  file_.open(path, mode);
+  if (!file_) {
+    LOG_ERROR("Failed to open upload temp file: " + path);
+    return false;
+  }
+  file_.seekp(offset);
+  return true;
+}
+
+bool UploadStream::append(const char *data, size_t length) {
+  static Histogram &writeLatency = MetricsRegistry::getInstance().histogram(
+      "photosync_file_write_seconds", "Time to write one upload chunk");
+  ScopedTimer timer(writeLatency);
+
+  if (!file_.is_open())
+    return false;
+  file_.write(data, (std::streamsize)length);
+  if (!file_) {
+    LOG_ERROR("Failed to write upload chunk");
+    return false;
+  }
+  SHA256_Update(&sha_, data, length);
+  size_ += (long long)length;
+  return true;
+}
+
+bool UploadStream::flush() {
+  if (!file_.is_open())
+    return false;
+  file_.flush();
+  return (bool)file_;
+}
+
+std::string UploadStream::finish() {
+  close();
+
+  unsigned char hash[SHA256_DIGEST_LENGTH];
+  SHA256_Final(hash, &sha_);
+
+  std::stringstream ss;
+  for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+    ss << std::hex << std::setw(2) << std::setfill('0')
+       << static_cast<int>(hash[i]);
+  }
+  return ss.str();
+}
+
+void UploadStream::close() {
+  if (file_.is_open())
+    file_.close();
+}
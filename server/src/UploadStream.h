@@ -0,0 +1,34 @@
+#pragma once
+
+#include <fstream>
+#include <openssl/sha.h>
+#include <string>
+
+// Open temp file of one in-flight V2 upload plus a running SHA-256 of its
+// contents. Chunks are appended as they arrive and hashed on the way
+// through, so finishing the upload needs no second pass over the file.
+class UploadStream {
+public:
+  // Open path for appending at offset (the bytes already on disk). When
+  // resuming, the existing prefix is hashed once so the digest still covers
+  // the whole file; a file shorter than offset fails.
+  bool open(const std::string &path, long long offset);
+
+  bool append(const char *data, size_t length);
+
+  // Push buffered data to the OS, e.g. before acknowledging it
+  bool flush();
+
+  // Close the file and return the hex digest of everything appended
+  std::string finish();
+
+  void close();
+
+  bool isOpen() const { return file_.is_open(); }
+  long long size() const { return size_; }
+
+private:
+  std::ofstream file_;
+  SHA256_CTX sha_;
+  long long size_ = 0;
+};
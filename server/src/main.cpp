@@ -5,6 +5,8 @@
 #include "IntegrityScanner.h"
 #include "Logger.h"
 #include "TcpListener.h"
+#include "ThumbnailQueue.h"
+#include "TlsContext.h"
 #include "UdpBroadcaster.h"
 #include <atomic>
 #include <boost/asio.hpp>
@@ -44,30 +46,26 @@ int main(int argc, char *argv[]) {
   // Initialize Config
   ConfigManager &config = ConfigManager::getInstance();
 
-  // Initialize SSL Context
-  boost::asio::ssl::context ssl_context(boost::asio::ssl::context::tlsv12);
-  try {
-    ssl_context.set_options(boost::asio::ssl::context::default_workarounds |
-                            boost::asio::ssl::context::no_sslv2 |
-                            boost::asio::ssl::context::single_dh_use);
-    ssl_context.use_certificate_chain_file("server.crt");
-    ssl_context.use_private_key_file("server.key",
-                                     boost::asio::ssl::context::pem);
-  } catch (const std::exception &e) {
-    LOG_ERROR("Failed to load SSL certificates: " + std::string(e.what()));
-    std::cerr << "CRITICAL: Failed to load SSL certificates (server.crt, "
-                 "server.key). "
-                 "Run generate_cert.py first."
-              << std::endl;
-    return 1;
-  }
-
   // Load configuration
   if (!config.loadFromFile(configFile)) {
     std::cerr << "Warning: Could not load config file '" << configFile
               << "', using defaults" << std::endl;
   }
 
+  // Initialize SSL Context (certificate paths and resumption from [tls])
+  boost::asio::ssl::context ssl_context(boost::asio::ssl::context::tls_server);
+  TlsContext::Options tlsOptions = TlsContext::fromConfig(config);
+  try {
+    TlsContext::configure(ssl_context, tlsOptions);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Failed to load SSL certificates: " + std::string(e.what()));
+    std::cerr << "CRITICAL: Failed to load SSL certificates ("
+              << tlsOptions.certificateChainFile << ", "
+              << tlsOptions.privateKeyFile << "). "
+              << "Run generate_cert.py first." << std::endl;
+    return 1;
+  }
+
   // Initialize logger
   LogLevel logLevel = LogLevel::L_INFO;
   std::string logLevelStr = config.getLogLevel();
@@ -78,11 +76,18 @@ int main(int argc, char *argv[]) {
   else if (logLevelStr == "ERROR")
     logLevel = LogLevel::L_ERROR;
 
-  Logger::getInstance().init(config.getLogFile(), logLevel,
-                             config.getConsoleOutput());
+  Logger::getInstance().init(
+      config.getLogFile(), logLevel, config.getConsoleOutput(),
+      (uint64_t)config.getLogMaxFileMB() * 1024 * 1024,
+      config.getLogMaxFiles());
 
   LOG_INFO("=== PhotoSync Server Starting ===");
   LOG_INFO("Configuration loaded from: " + configFile);
+  LOG_INFOF("TLS: minimum version {}, {} suites preferred{}",
+            tlsOptions.tls13Only ? "1.3" : "1.2",
+            TlsContext::cipherPreferenceName(
+                TlsContext::resolve(tlsOptions.cipherPreference)),
+            TlsContext::hasAesHardware() ? "" : " (no AES instructions)");
 
   // Initialize database
   DatabaseManager db;
@@ -115,8 +120,24 @@ int main(int argc, char *argv[]) {
     // Initialize Integrity Scanner (Phase 3) - Created early for API access
     IntegrityScanner integrityScanner(db, fileManager);
 
+    // Packed thumbnail store, filled by the background renderer below
+    ThumbnailStore thumbnailStore(
+        config.getThumbnailsDir(),
+        (uint64_t)config.getThumbnailSegmentSizeMB() * 1024 * 1024,
+        (uint64_t)config.getThumbnailCacheMB() * 1024 * 1024);
+    if (!thumbnailStore.open()) {
+      LOG_FATAL("Failed to open thumbnail store");
+      return 1;
+    }
+
+    // Background thumbnail rendering, fed by uploads and the dashboard
+    ThumbnailQueue thumbnailQueue(thumbnailStore);
+    ThumbnailQueue::Config thumbnailConfig;
+    thumbnailConfig.workerThreads = config.getThumbnailWorkerThreads();
+    thumbnailQueue.start(thumbnailConfig);
+
     // Start REST API server for UI
-    ApiServer apiServer(db, config, &integrityScanner);
+    ApiServer apiServer(db, config, &integrityScanner, &thumbnailQueue);
     g_apiServer = &apiServer;
     apiServer.start(50506); // API on port 50506
 
@@ -129,7 +150,7 @@ int main(int argc, char *argv[]) {
     try {
       int tcpPort = config.getPort(); // Default 50505
       TcpListener tcpListener(io_context, ssl_context, tcpPort, db,
-                              fileManager);
+                              fileManager, &thumbnailQueue);
       LOG_INFO("TCP Sync Server listening on port " + std::to_string(tcpPort));
 
       // Start UDP Broadcaster for service discovery
@@ -241,6 +262,7 @@ int main(int argc, char *argv[]) {
 
     // Stop API server
     apiServer.stop();
+    thumbnailQueue.stop();
 
   } catch (const std::exception &e) {
     LOG_FATAL("Exception: " + std::string(e.what()));
@@ -258,6 +280,7 @@ int main(int argc, char *argv[]) {
 
   db.close();
   LOG_INFO("=== PhotoSync Server Shutdown Complete ===");
+  Logger::getInstance().shutdown();
 
   return 0;
 }
@@ -0,0 +1,152 @@
+"""Server CPU cost of receiving uploads, in CPU seconds per GB.
+
+Uploads one large file over the V2 resumable protocol and samples the
+server process's user + system CPU time from /proc before and after. Run it
+once with [tls] kernel_receive = false and once with it set to true to see
+what kTLS saves; the photosync_tls_receive_offload_total metric shows
+whether the connection was actually offloaded.
+
+    python bench_upload_cpu.py --pid $(pgrep PhotoSyncServer) --size-mb 2048
+
+Linux only (reads /proc/<pid>/stat). Each run stores a new random file on
+the server.
+"""
+import argparse
+import hashlib
+import json
+import os
+import socket
+import ssl
+import struct
+import time
+
+PROTOCOL_VERSION_1 = 0x01
+PROTOCOL_VERSION_2 = 0x02
+PACKET_PAIRING_REQUEST = 0x02
+PACKET_PAIRING_RESPONSE = 0x03
+PACKET_UPLOAD_INIT = 0x10
+PACKET_UPLOAD_ACK = 0x11
+PACKET_UPLOAD_CHUNK = 0x12
+PACKET_UPLOAD_FINISH = 0x13
+PACKET_UPLOAD_RESULT = 0x14
+PACKET_UPLOAD_CHUNK_ACK = 0x16
+
+
+def create_packet(packet_type, payload_bytes, version=PROTOCOL_VERSION_2):
+    # Header: Magic(2) + Version(1) + Type(1) + PayloadLen(4)
+    header = struct.pack('>2sBB I', b'PH', version, packet_type, len(payload_bytes))
+    return header + payload_bytes
+
+
+def read_exactly(conn, length):
+    data = b''
+    while len(data) < length:
+        part = conn.recv(length - len(data))
+        if not part:
+            raise ConnectionError("server closed the connection")
+        data += part
+    return data
+
+
+def read_packet(conn):
+    magic, version, ptype, length = struct.unpack('>2sBB I', read_exactly(conn, 8))
+    return ptype, read_exactly(conn, length)
+
+
+def server_cpu_seconds(pid):
+    with open(f"/proc/{pid}/stat") as f:
+        # The command name may contain spaces; fields after it are fixed
+        fields = f.read().rsplit(')', 1)[1].split()
+    ticks = int(fields[11]) + int(fields[12])  # utime + stime
+    return ticks / os.sysconf('SC_CLK_TCK')
+
+
+def connect(host, port, tls12):
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+    context.check_hostname = False
+    context.verify_mode = ssl.CERT_NONE
+    if tls12:
+        context.maximum_version = ssl.TLSVersion.TLSv1_2
+    conn = context.wrap_socket(socket.create_connection((host, port)), server_hostname=host)
+    print(f"Connected with {conn.version()} / {conn.cipher()[0]}")
+    return conn
+
+
+def pair(conn):
+    payload = json.dumps({"deviceId": "bench-upload-cpu", "deviceName": "Benchmark"}).encode()
+    conn.sendall(create_packet(PACKET_PAIRING_REQUEST, payload, PROTOCOL_VERSION_1))
+    ptype, payload = read_packet(conn)
+    if ptype != PACKET_PAIRING_RESPONSE or not json.loads(payload).get('success'):
+        raise RuntimeError(f"pairing failed: {payload}")
+
+
+def upload(conn, size_bytes):
+    # One random block, prefixed per run so the server never deduplicates
+    block = os.urandom(1024 * 1024)
+    run_prefix = os.urandom(16)
+    sha = hashlib.sha256()
+
+    def data_at(offset, length):
+        data = (block * (length // len(block) + 2))[offset % len(block):][:length]
+        if offset == 0:
+            data = run_prefix + data[len(run_prefix):]
+        return data
+
+    for offset in range(0, size_bytes, len(block)):
+        sha.update(data_at(offset, min(len(block), size_bytes - offset)))
+    file_hash = sha.hexdigest()
+
+    init = {"filename": f"bench-{file_hash[:8]}.bin", "size": size_bytes, "hash": file_hash}
+    conn.sendall(create_packet(PACKET_UPLOAD_INIT, json.dumps(init).encode()))
+    ptype, payload = read_packet(conn)
+    if ptype != PACKET_UPLOAD_ACK:
+        raise RuntimeError(f"expected UPLOAD_ACK, got {ptype}: {payload}")
+    ack = json.loads(payload)
+    upload_id = ack['uploadId']
+    chunk_size = ack.get('chunkSize', len(block))
+
+    offset = 0
+    while offset < size_bytes:
+        chunk = data_at(offset, min(chunk_size, size_bytes - offset))
+        conn.sendall(create_packet(PACKET_UPLOAD_CHUNK,
+                                   upload_id.encode('ascii') + struct.pack('>Q', offset) + chunk))
+        ptype, payload = read_packet(conn)
+        if ptype != PACKET_UPLOAD_CHUNK_ACK:
+            raise RuntimeError(f"expected UPLOAD_CHUNK_ACK, got {ptype}: {payload}")
+        offset += len(chunk)
+
+    finish = {"uploadId": upload_id, "sha256": file_hash}
+    conn.sendall(create_packet(PACKET_UPLOAD_FINISH, json.dumps(finish).encode()))
+    ptype, payload = read_packet(conn)
+    if ptype != PACKET_UPLOAD_RESULT:
+        raise RuntimeError(f"expected UPLOAD_RESULT, got {ptype}: {payload}")
+    print(f"UPLOAD_RESULT: {json.loads(payload)}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=50505)
+    parser.add_argument("--pid", type=int, required=True, help="PhotoSyncServer process id")
+    parser.add_argument("--size-mb", type=int, default=1024)
+    parser.add_argument("--tls12", action="store_true", help="Cap the client at TLS 1.2")
+    args = parser.parse_args()
+
+    conn = connect(args.host, args.port, args.tls12)
+    pair(conn)
+
+    size_bytes = args.size_mb * 1024 * 1024
+    cpu_before = server_cpu_seconds(args.pid)
+    started = time.monotonic()
+    upload(conn, size_bytes)
+    elapsed = time.monotonic() - started
+    cpu = server_cpu_seconds(args.pid) - cpu_before
+    conn.close()
+
+    gigabytes = size_bytes / (1024 ** 3)
+    print(f"Received {args.size_mb} MB in {elapsed:.1f} s ({args.size_mb / elapsed:.0f} MB/s)")
+    print(f"Server CPU: {cpu:.2f} s total, {cpu / gigabytes:.2f} s per GB")
+
+
+if __name__ == "__main__":
+    main()
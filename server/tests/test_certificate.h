@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <string>
+
+// Self-signed P-256 certificate for "localhost", valid for an hour, for
+// tests that need a real TLS server
+inline void writeSelfSignedCertificate(const std::string &certificateFile,
+                                       const std::string &privateKeyFile) {
+  EVP_PKEY *key = nullptr;
+  EVP_PKEY_CTX *keyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+  ASSERT_EQ(EVP_PKEY_keygen_init(keyCtx), 1);
+  EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyCtx, NID_X9_62_prime256v1);
+  ASSERT_EQ(EVP_PKEY_keygen(keyCtx, &key), 1);
+  EVP_PKEY_CTX_free(keyCtx);
+
+  X509 *cert = X509_new();
+  ASSERT_EQ(X509_set_version(cert, 2), 1);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME *name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                             (const unsigned char *)"localhost", -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  ASSERT_GT(X509_sign(cert, key, EVP_sha256()), 0);
+
+  FILE *f = std::fopen(certificateFile.c_str(), "wb");
+  PEM_write_X509(f, cert);
+  std::fclose(f);
+  f = std::fopen(privateKeyFile.c_str(), "wb");
+  PEM_write_PrivateKey(f, key, nullptr, nullptr, 0, nullptr, nullptr);
+  std::fclose(f);
+
+  X509_free(cert);
+  EVP_PKEY_free(key);
+}
@@ -0,0 +1,63 @@
+#include "Compression.h"
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+namespace {
+
+std::string inflateAll(const std::string &input, int windowBits) {
+  z_stream stream{};
+  if (inflateInit2(&stream, windowBits) != Z_OK)
+    return "";
+  std::string output(1024 * 1024, '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  stream.avail_in = (uInt)input.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+  stream.avail_out = (uInt)output.size();
+  int result = inflate(&stream, Z_FINISH);
+  output.resize(stream.total_out);
+  inflateEnd(&stream);
+  return result == Z_STREAM_END ? output : "";
+}
+
+std::string sampleJson() {
+  std::string text = "[";
+  for (int i = 0; i < 500; ++i)
+    text += "{\"id\":" + std::to_string(i) + ",\"filename\":\"IMG_" +
+            std::to_string(i) + ".jpg\"},";
+  text.back() = ']';
+  return text;
+}
+
+} // namespace
+
+TEST(CompressionTest, GzipRoundTrip) {
+  std::string input = sampleJson();
+  std::string encoded;
+  ASSERT_TRUE(Compression::gzip(input, encoded, Compression::FAST_LEVEL));
+  EXPECT_LT(encoded.size(), input.size() / 3);
+  ASSERT_GE(encoded.size(), 2u);
+  EXPECT_EQ((unsigned char)encoded[0], 0x1f);
+  EXPECT_EQ((unsigned char)encoded[1], 0x8b);
+  EXPECT_EQ(inflateAll(encoded, 15 + 16), input);
+}
+
+TEST(CompressionTest, DeflateUsesZlibFormat) {
+  std::string input = sampleJson();
+  std::string encoded;
+  ASSERT_TRUE(Compression::deflate(input, encoded));
+  EXPECT_EQ(inflateAll(encoded, 15), input);
+
+  std::string empty;
+  ASSERT_TRUE(Compression::gzip("", empty));
+  EXPECT_EQ(inflateAll(empty, 15 + 16), "");
+}
+
+TEST(CompressionTest, BrotliMatchesBuild) {
+  std::string encoded;
+  bool ok = Compression::brotli(sampleJson(), encoded);
+  EXPECT_EQ(ok, Compression::brotliAvailable());
+  if (ok)
+    EXPECT_LT(encoded.size(), sampleJson().size() / 3);
+  else
+    EXPECT_TRUE(encoded.empty());
+}
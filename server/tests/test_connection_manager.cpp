@@ -0,0 +1,85 @@
+#include "ConnectionManager.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+// ConnectionManager is a process-wide singleton; tests use session ids no
+// real session would get and remove them again
+
+TEST(ConnectionManagerTest, HandleUpdatesAreVisibleInSnapshots) {
+  auto &mgr = ConnectionManager::getInstance();
+  auto stats = mgr.addConnection(900001, "device-telemetry", "10.0.0.2", "Ann");
+  ASSERT_NE(stats, nullptr);
+
+  stats->setStatus(ConnectionStats::SYNCING);
+  stats->addBytes(1000);
+  stats->addBytes(24);
+  stats->addPhoto();
+
+  auto connections = mgr.getActiveConnections();
+  ASSERT_EQ(connections.count(900001), 1u);
+  const ConnectionInfo &info = connections[900001];
+  EXPECT_EQ(info.deviceId, "device-telemetry");
+  EXPECT_EQ(info.userName, "Ann");
+  EXPECT_EQ(info.status, "syncing");
+  EXPECT_EQ(info.bytesTransferred, 1024);
+  EXPECT_EQ(info.photosUploaded, 1);
+  EXPECT_TRUE(mgr.isClientConnected("device-telemetry"));
+
+  // Lookup-by-id updates reach the same counters
+  mgr.updateProgress(900001, 5, 2048);
+  EXPECT_EQ(stats->bytesTransferred.load(), 2048);
+  EXPECT_EQ(stats->photosUploaded.load(), 5);
+
+  mgr.removeConnection(900001);
+  EXPECT_FALSE(mgr.isClientConnected("device-telemetry"));
+  // The session keeps its handle after removal
+  stats->addBytes(1);
+  EXPECT_EQ(stats->bytesTransferred.load(), 2049);
+}
+
+TEST(ConnectionManagerTest, SnapshotIsStableAcrossRemoval) {
+  auto &mgr = ConnectionManager::getInstance();
+  mgr.addConnection(900002, "device-snapshot", "10.0.0.3", "");
+
+  auto before = mgr.snapshot();
+  mgr.removeConnection(900002);
+  auto after = mgr.snapshot();
+
+  EXPECT_EQ(before->count(900002), 1u);
+  EXPECT_EQ(after->count(900002), 0u);
+}
+
+TEST(ConnectionManagerTest, StaleConnectionsAreRemoved) {
+  auto &mgr = ConnectionManager::getInstance();
+  auto stale = mgr.addConnection(900003, "device-stale", "10.0.0.4", "");
+  auto fresh = mgr.addConnection(900004, "device-fresh", "10.0.0.5", "");
+  stale->lastActivityMs.store(ConnectionStats::nowMs() - 120 * 1000);
+
+  std::vector<int> removed = mgr.cleanStaleConnections(45);
+  EXPECT_EQ(removed, std::vector<int>{900003});
+  EXPECT_FALSE(mgr.isClientConnected("device-stale"));
+  EXPECT_TRUE(mgr.isClientConnected("device-fresh"));
+  mgr.removeConnection(900004);
+}
+
+TEST(ConnectionManagerTest, ConcurrentWritersAndReaders) {
+  auto &mgr = ConnectionManager::getInstance();
+  auto stats = mgr.addConnection(900005, "device-concurrent", "10.0.0.6", "");
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&stats] {
+      for (int i = 0; i < 10000; ++i)
+        stats->addBytes(1);
+    });
+  }
+  threads.emplace_back([&mgr] {
+    for (int i = 0; i < 1000; ++i)
+      mgr.getActiveConnections();
+  });
+  for (auto &thread : threads)
+    thread.join();
+
+  EXPECT_EQ(mgr.getActiveConnections()[900005].bytesTransferred, 40000);
+  mgr.removeConnection(900005);
+}
@@ -1,6 +1,8 @@
 #include "DatabaseManager.h"
+#include "JsonWriter.h"
 #include <filesystem>
 #include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
 
 
 // Test fixture for database core feature tests
@@ -134,3 +136,90 @@ TEST_F(DatabaseCoreTest, FilteredPhotoCount) {
   int countAll = db.getFilteredPhotoCount(clientId);
   EXPECT_EQ(countAll, 3);
 }
+
+TEST_F(DatabaseCoreTest, KeysetPhotoWalk) {
+  int clientA = db.getOrCreateClient("device_walk_a", "Walk A");
+  int clientB = db.getOrCreateClient("device_walk_b", "Walk B");
+
+  for (int i = 0; i < 5; ++i) {
+    PhotoMetadata p;
+    p.filename = "walk_" + std::to_string(i) + ".jpg";
+    p.hash = "walk_hash_" + std::to_string(i);
+    p.size = 10;
+    ASSERT_TRUE(db.insertPhoto(i % 2 == 0 ? clientA : clientB, p));
+  }
+
+  // Page through everything two rows at a time, newest first
+  std::vector<int> ids;
+  int beforeId = 0;
+  while (true) {
+    auto page = db.getPhotosBeforeId(beforeId, 2);
+    if (page.empty())
+      break;
+    for (const auto &p : page)
+      ids.push_back(p.id);
+    beforeId = page.back().id;
+  }
+  ASSERT_EQ(ids.size(), 5u);
+  for (size_t i = 1; i < ids.size(); ++i)
+    EXPECT_GT(ids[i - 1], ids[i]);
+
+  // Client filter keeps the owning client on each row
+  auto onlyA = db.getPhotosBeforeId(0, 10, clientA);
+  ASSERT_EQ(onlyA.size(), 3u);
+  for (const auto &p : onlyA)
+    EXPECT_EQ(p.clientId, clientA);
+
+  auto search = db.getPhotosBeforeId(0, 10, -1, "", "", "walk_3");
+  ASSERT_EQ(search.size(), 1u);
+  EXPECT_EQ(search[0].filename, "walk_3.jpg");
+}
+
+TEST_F(DatabaseCoreTest, StreamsMediaRowsAsJson) {
+  int clientId = db.getOrCreateClient("device_json", "Json");
+  for (int i = 0; i < 3; ++i) {
+    PhotoMetadata p;
+    p.filename = "json \"" + std::to_string(i) + "\".jpg";
+    p.hash = "json_hash_" + std::to_string(i);
+    p.size = 100 + i;
+    ASSERT_TRUE(db.insertPhoto(clientId, p));
+  }
+
+  std::string out;
+  JsonWriter w(out);
+  w.beginArray();
+  ASSERT_EQ(db.writeMediaItemsJson(w, 0, 2, clientId), 2);
+  w.endArray();
+
+  auto items = nlohmann::json::parse(out);
+  ASSERT_EQ(items.size(), 2u);
+  int newestId = items[0]["id"];
+  EXPECT_GT(newestId, items[1]["id"].get<int>());
+  EXPECT_EQ(items[0]["filename"], "json \"2\".jpg");
+  EXPECT_EQ(items[0]["size"], 102);
+  EXPECT_EQ(items[0]["clientId"], clientId);
+  EXPECT_EQ(items[0]["mimeType"], "image/jpeg");
+  EXPECT_EQ(items[0]["thumbnailUrl"],
+            "/api/thumbnails/" + std::to_string(newestId));
+  EXPECT_EQ(items[0]["fullUrl"],
+            "/api/media/" + std::to_string(newestId) + "/download");
+  EXPECT_FALSE(items[0]["uploadedAt"].get<std::string>().empty());
+
+  // Search is bound, not spliced into the SQL
+  out.clear();
+  JsonWriter search(out);
+  search.beginArray();
+  EXPECT_EQ(db.writeMediaItemsJson(search, 0, 10, -1, "", "", "' OR 1=1 --"),
+            0);
+  search.endArray();
+  EXPECT_EQ(out, "[]");
+
+  out.clear();
+  JsonWriter photos(out);
+  photos.beginArray();
+  ASSERT_EQ(db.writePhotosJson(photos, 1, 10, clientId), 2);
+  photos.endArray();
+  auto photoItems = nlohmann::json::parse(out);
+  EXPECT_EQ(photoItems[0]["exif"]["gps"]["lat"], 0.0);
+  EXPECT_EQ(photoItems[0]["hash"], "json_hash_1");
+}
@@ -0,0 +1,143 @@
+#include "FileManager.h"
+#include "HttpUtils.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+
+TEST(HttpUtilsTest, ETagMatching) {
+  std::string etag = HttpUtils::makeETag(0x1234);
+  EXPECT_EQ(etag, "\"0000000000001234\"");
+
+  EXPECT_TRUE(HttpUtils::etagMatches(etag, etag));
+  EXPECT_TRUE(HttpUtils::etagMatches("*", etag));
+  EXPECT_TRUE(HttpUtils::etagMatches("W/" + etag, etag));
+  EXPECT_TRUE(HttpUtils::etagMatches("\"other\", " + etag, etag));
+  EXPECT_FALSE(HttpUtils::etagMatches("", etag));
+  EXPECT_FALSE(HttpUtils::etagMatches("\"other\"", etag));
+}
+
+TEST(HttpUtilsTest, ParsesSingleByteRanges) {
+  HttpUtils::ByteRange range;
+  using R = HttpUtils::RangeResult;
+
+  ASSERT_EQ(HttpUtils::parseRange("bytes=0-499", 1000, range), R::SATISFIABLE);
+  EXPECT_EQ(range.start, 0);
+  EXPECT_EQ(range.end, 499);
+
+  // Open-ended and past-the-end ranges are clamped to the entity
+  ASSERT_EQ(HttpUtils::parseRange("bytes=900-", 1000, range), R::SATISFIABLE);
+  EXPECT_EQ(range.start, 900);
+  EXPECT_EQ(range.end, 999);
+  ASSERT_EQ(HttpUtils::parseRange("bytes=900-5000", 1000, range),
+            R::SATISFIABLE);
+  EXPECT_EQ(range.end, 999);
+
+  // Suffix ranges
+  ASSERT_EQ(HttpUtils::parseRange("bytes=-100", 1000, range), R::SATISFIABLE);
+  EXPECT_EQ(range.start, 900);
+  EXPECT_EQ(range.end, 999);
+  ASSERT_EQ(HttpUtils::parseRange("bytes=-5000", 1000, range),
+            R::SATISFIABLE);
+  EXPECT_EQ(range.start, 0);
+}
+
+TEST(HttpUtilsTest, RejectsUnusableRanges) {
+  HttpUtils::ByteRange range;
+  using R = HttpUtils::RangeResult;
+
+  EXPECT_EQ(HttpUtils::parseRange("", 1000, range), R::NONE);
+  EXPECT_EQ(HttpUtils::parseRange("items=0-1", 1000, range), R::NONE);
+  EXPECT_EQ(HttpUtils::parseRange("bytes=0-1,5-9", 1000, range), R::NONE);
+  EXPECT_EQ(HttpUtils::parseRange("bytes=abc-", 1000, range), R::NONE);
+  EXPECT_EQ(HttpUtils::parseRange("bytes=500-100", 1000, range), R::NONE);
+
+  EXPECT_EQ(HttpUtils::parseRange("bytes=1000-", 1000, range),
+            R::UNSATISFIABLE);
+  EXPECT_EQ(HttpUtils::parseRange("bytes=-0", 1000, range), R::UNSATISFIABLE);
+}
+
+TEST(HttpUtilsTest, PlansRangeBodies) {
+  using B = HttpUtils::RangeBody;
+  const long long cap = HttpUtils::MAX_BUFFERED_RANGE_BYTES;
+  const long long size = 5 * cap;
+
+  HttpUtils::ByteRange whole{0, size - 1};
+  EXPECT_EQ(HttpUtils::planRangeBody(whole, size, false), B::WHOLE_FILE);
+
+  HttpUtils::ByteRange small{100, 100 + cap - 1};
+  EXPECT_EQ(HttpUtils::planRangeBody(small, size, false), B::BUFFER);
+  EXPECT_EQ(small.end, 100 + cap - 1);
+
+  // Resumes and other large ranges are never shortened...
+  HttpUtils::ByteRange resume{cap, size - 1};
+  EXPECT_EQ(HttpUtils::planRangeBody(resume, size, false), B::SPOOL);
+  EXPECT_EQ(resume.end, size - 1);
+
+  // ...except for a media element, which asks again for the rest
+  HttpUtils::ByteRange media{cap, size - 1};
+  EXPECT_EQ(HttpUtils::planRangeBody(media, size, true), B::BUFFER);
+  EXPECT_EQ(media.end, 2 * cap - 1);
+}
+
+TEST(HttpUtilsTest, OpenEndedResumeReassemblesLargeFile) {
+  namespace fs = std::filesystem;
+  std::string dir = "test_http_utils_resume";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+
+  // Several times the buffer limit, with no repeating pattern
+  std::string original((size_t)(3 * HttpUtils::MAX_BUFFERED_RANGE_BYTES + 777),
+                       '\0');
+  uint32_t state = 12345;
+  for (char &c : original) {
+    state = state * 1103515245 + 12345;
+    c = (char)(state >> 24);
+  }
+  std::string path = dir + "/original.bin";
+  std::ofstream(path, std::ios::binary) << original;
+
+  // A download that broke off part way resumes with "bytes=N-"
+  long long received = HttpUtils::MAX_BUFFERED_RANGE_BYTES / 2 + 3;
+  HttpUtils::ByteRange range;
+  ASSERT_EQ(HttpUtils::parseRange("bytes=" + std::to_string(received) + "-",
+                                  (long long)original.size(), range),
+            HttpUtils::RangeResult::SATISFIABLE);
+  ASSERT_EQ(HttpUtils::planRangeBody(range, (long long)original.size(), false),
+            HttpUtils::RangeBody::SPOOL);
+  ASSERT_EQ(range.end, (long long)original.size() - 1);
+
+  std::string spool = dir + "/range.part";
+  ASSERT_TRUE(FileManager::copyRange(path, range.start,
+                                     range.end - range.start + 1, spool));
+  std::ifstream in(spool, std::ios::binary);
+  std::string rest((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  in.close();
+  EXPECT_EQ(original.substr(0, (size_t)received) + rest, original);
+
+  // A range past the end of the source fails instead of coming up short
+  EXPECT_FALSE(FileManager::copyRange(path, range.start,
+                                      (long long)original.size(), spool));
+  fs::remove_all(dir);
+}
+
+TEST(HttpUtilsTest, FormatsHttpDate) {
+  EXPECT_EQ(HttpUtils::formatHttpDate(784111777),
+            "Sun, 06 Nov 1994 08:49:37 GMT");
+}
+
+TEST(HttpUtilsTest, AcceptEncodingNegotiation) {
+  EXPECT_TRUE(HttpUtils::acceptsEncoding("gzip, deflate, br", "br"));
+  EXPECT_TRUE(HttpUtils::acceptsEncoding("GZIP", "gzip"));
+  EXPECT_TRUE(HttpUtils::acceptsEncoding("br;q=0.8", "br"));
+  EXPECT_FALSE(HttpUtils::acceptsEncoding("", "gzip"));
+  EXPECT_FALSE(HttpUtils::acceptsEncoding("identity", "gzip"));
+  EXPECT_FALSE(HttpUtils::acceptsEncoding("gzip;q=0, br", "gzip"));
+  EXPECT_FALSE(HttpUtils::acceptsEncoding("br; q=0.000", "br"));
+
+  // Wildcard applies unless the coding is excluded explicitly
+  EXPECT_TRUE(HttpUtils::acceptsEncoding("*", "br"));
+  EXPECT_FALSE(HttpUtils::acceptsEncoding("*, br;q=0", "br"));
+  EXPECT_FALSE(HttpUtils::acceptsEncoding("*;q=0", "gzip"));
+}
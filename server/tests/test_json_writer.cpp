@@ -0,0 +1,62 @@
+#include "JsonWriter.h"
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+TEST(JsonWriterTest, WritesNestedDocument) {
+  std::string out;
+  JsonWriter w(out);
+  w.beginObject().key("items").beginArray();
+  for (int i = 0; i < 2; ++i) {
+    w.beginObject()
+        .field("id", i)
+        .field("name", std::string("item") + std::to_string(i))
+        .field("size", 5000000000LL)
+        .field("ok", i == 0)
+        .endObject();
+  }
+  w.endArray();
+  w.key("pagination").beginObject().field("total", 2).endObject();
+  w.key("empty").beginArray().endArray();
+  w.key("nothing").null();
+  w.endObject();
+
+  EXPECT_EQ(out, "{\"items\":[{\"id\":0,\"name\":\"item0\",\"size\":5000000000,"
+                 "\"ok\":true},{\"id\":1,\"name\":\"item1\",\"size\":"
+                 "5000000000,\"ok\":false}],\"pagination\":{\"total\":2},"
+                 "\"empty\":[],\"nothing\":null}");
+  EXPECT_NO_THROW(json::parse(out));
+}
+
+TEST(JsonWriterTest, EscapesStrings) {
+  std::string text = "quote\" back\\slash\nnew\ttab\x01 ctrl caf\xc3\xa9";
+  std::string out;
+  JsonWriter w(out);
+  w.beginArray().value(text).value("").endArray();
+
+  EXPECT_EQ(out, "[\"quote\\\" back\\\\slash\\nnew\\ttab\\u0001 ctrl "
+                 "caf\xc3\xa9\",\"\"]");
+  json parsed = json::parse(out);
+  EXPECT_EQ(parsed[0].get<std::string>(), text);
+}
+
+TEST(JsonWriterTest, NumbersMatchNlohmann) {
+  double values[] = {0.0, 1.0, 2.8, 0.1, -122.4194, 1e21, 1.5e-7};
+  for (double v : values) {
+    std::string out;
+    JsonWriter(out).value(v);
+    EXPECT_EQ(out, json(v).dump()) << v;
+  }
+
+  std::string out;
+  JsonWriter(out).beginArray().value(std::nan("")).value(-7).endArray();
+  EXPECT_EQ(out, "[null,-7]");
+}
+
+TEST(JsonWriterTest, RawValuesAreEmbedded) {
+  std::string out;
+  JsonWriter w(out);
+  w.beginObject().field("a", 1).key("ctx").raw("{\"k\":[1,2]}").endObject();
+  EXPECT_EQ(out, "{\"a\":1,\"ctx\":{\"k\":[1,2]}}");
+}
@@ -0,0 +1,128 @@
+#include "LogRing.h"
+#include "Logger.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <set>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+TEST(LogRingTest, FifoAndFullRing) {
+  LogRing ring(4);
+  EXPECT_EQ(ring.capacity(), 4u);
+
+  for (int i = 0; i < 4; ++i)
+    ASSERT_TRUE(ring.tryPush("line" + std::to_string(i)));
+  std::string extra = "overflow";
+  EXPECT_FALSE(ring.tryPush(std::move(extra)));
+  EXPECT_EQ(extra, "overflow"); // Not consumed on failure
+
+  std::string line;
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(ring.tryPop(line));
+    EXPECT_EQ(line, "line" + std::to_string(i));
+  }
+  EXPECT_FALSE(ring.tryPop(line));
+
+  // Wraps around after a full lap
+  ASSERT_TRUE(ring.tryPush("again"));
+  ASSERT_TRUE(ring.tryPop(line));
+  EXPECT_EQ(line, "again");
+}
+
+TEST(LogRingTest, ConcurrentProducersLoseNothing) {
+  LogRing ring(1024);
+  const int producers = 4;
+  const int perProducer = 5000;
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&ring, p] {
+      for (int i = 0; i < perProducer; ++i) {
+        std::string line = std::to_string(p) + ":" + std::to_string(i);
+        while (!ring.tryPush(std::move(line)))
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  std::set<std::string> seen;
+  std::string line;
+  while ((int)seen.size() < producers * perProducer) {
+    if (ring.tryPop(line))
+      seen.insert(line);
+    else
+      std::this_thread::yield();
+  }
+  for (auto &thread : threads)
+    thread.join();
+  EXPECT_FALSE(ring.tryPop(line));
+  EXPECT_EQ(seen.size(), (size_t)(producers * perProducer));
+}
+
+TEST(LoggerTest, AsyncWriterRotatesBySize) {
+  std::string dir = "test_logger_dir";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  std::string path = dir + "/server.log";
+
+  Logger &logger = Logger::getInstance();
+  logger.init(path, LogLevel::L_DEBUG, false, 2048, 2, 256);
+  for (int i = 0; i < 200; ++i) {
+    LOG_INFO("rotation test line " + std::to_string(i));
+    // Give the writer a chance so batches stay small
+    if (i % 20 == 0)
+      logger.flush();
+  }
+  LOG_DEBUG("last line");
+  logger.flush();
+  logger.shutdown();
+
+  EXPECT_TRUE(fs::exists(path));
+  EXPECT_TRUE(fs::exists(path + ".1"));
+  EXPECT_TRUE(fs::exists(path + ".2"));
+  EXPECT_FALSE(fs::exists(path + ".3"));
+
+  std::ifstream live(path);
+  std::string content((std::istreambuf_iterator<char>(live)),
+                      std::istreambuf_iterator<char>());
+  EXPECT_NE(content.find("[DEBUG] last line"), std::string::npos);
+
+  // Back to synchronous console logging for the remaining tests
+  logger.init("", LogLevel::L_INFO, true);
+  logger.shutdown();
+  fs::remove_all(dir);
+}
+
+TEST(LoggerTest, FormatSubstitutesPlaceholders) {
+  EXPECT_EQ(Logger::format("{} of {} bytes from {}", 512, 1024LL,
+                           std::string("10.0.0.2")),
+            "512 of 1024 bytes from 10.0.0.2");
+  EXPECT_EQ(Logger::format("{} {} {}", true, LogLevel::L_WARN, "x"),
+            "true 2 x");
+  EXPECT_EQ(Logger::format("ratio {}", 0.5), "ratio 0.5");
+  // Missing arguments keep the placeholder, extra ones are ignored
+  EXPECT_EQ(Logger::format("{} and {}", 1), "1 and {}");
+  EXPECT_EQ(Logger::format("none", 1, 2), "none");
+  EXPECT_EQ(Logger::format("plain"), "plain");
+}
+
+TEST(LoggerTest, DisabledLevelSkipsMessageConstruction) {
+  Logger &logger = Logger::getInstance();
+  logger.setLevel(LogLevel::L_WARN);
+
+  int evaluated = 0;
+  auto message = [&evaluated] {
+    evaluated++;
+    return std::string("expensive");
+  };
+  LOG_DEBUG(message());
+  LOG_INFOF("{}", message());
+  EXPECT_EQ(evaluated, 0);
+  EXPECT_FALSE(logger.isEnabled(LogLevel::L_INFO));
+  EXPECT_TRUE(logger.isEnabled(LogLevel::L_ERROR));
+
+  logger.setLevel(LogLevel::L_INFO);
+  EXPECT_TRUE(Logger::compiledIn(LogLevel::L_FATAL));
+}
@@ -0,0 +1,100 @@
+#include "MetricsRegistry.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+TEST(MetricsRegistryTest, HistogramBucketsAreLogLinear) {
+  Histogram h;
+  h.observeMicros(0);
+  h.observeMicros(1);
+  h.observeMicros(3);          // <= 3us
+  h.observeMicros(600);        // <= 512 + 2 * 64us
+  h.observeMicros(1ULL << 40); // Overflow
+
+  auto counts = h.bucketCounts();
+  EXPECT_EQ(counts[0], 2u);
+  EXPECT_EQ(counts[2], 1u);
+  EXPECT_EQ(Histogram::bucketUpperMicros(57), 640u);
+  EXPECT_EQ(counts[57], 1u);
+  EXPECT_EQ(counts[Histogram::BUCKETS], 1u);
+  EXPECT_EQ(h.count(), 5u);
+  EXPECT_EQ(h.sumMicros(), 604u + (1ULL << 40));
+}
+
+TEST(MetricsRegistryTest, HistogramBoundsAreInclusiveAndFine) {
+  EXPECT_EQ(Histogram::bucketUpperMicros(Histogram::BUCKETS - 1),
+            1ULL << Histogram::MAX_POWER);
+  for (int i = 0; i < Histogram::BUCKETS; ++i) {
+    uint64_t bound = Histogram::bucketUpperMicros(i);
+    Histogram h;
+    h.observeMicros(bound);
+    h.observeMicros(bound + 1);
+    auto counts = h.bucketCounts();
+    ASSERT_EQ(counts[i], 1u) << "bound " << bound;
+    ASSERT_EQ(counts[i + 1], 1u) << "bound " << bound;
+
+    // Each bucket is at most 1/SUB_BUCKETS of the values below it wide
+    if (i >= Histogram::SUB_BUCKETS) {
+      uint64_t previous = Histogram::bucketUpperMicros(i - 1);
+      EXPECT_GT(bound, previous);
+      EXPECT_LE((bound - previous) * Histogram::SUB_BUCKETS, previous);
+    }
+  }
+}
+
+TEST(MetricsRegistryTest, SameNameAndLabelsShareOneMetric) {
+  auto &metrics = MetricsRegistry::getInstance();
+  Counter &a = metrics.counter("test_shared_total", "help", {{"k", "v"}});
+  Counter &b = metrics.counter("test_shared_total", "help", {{"k", "v"}});
+  Counter &other = metrics.counter("test_shared_total", "help", {{"k", "w"}});
+  EXPECT_EQ(&a, &b);
+  EXPECT_NE(&a, &other);
+}
+
+TEST(MetricsRegistryTest, RendersPrometheusText) {
+  auto &metrics = MetricsRegistry::getInstance();
+  metrics.counter("test_render_bytes_total", "Bytes seen",
+                  {{"device", "pixel \"7\""}})
+      .inc(42);
+  Histogram &latency =
+      metrics.histogram("test_render_seconds", "Op latency", {{"op", "x"}});
+  latency.observeMicros(2);
+  latency.observeMicros(1500);
+
+  std::string text = metrics.renderPrometheus();
+  EXPECT_NE(text.find("# TYPE test_render_bytes_total counter\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("test_render_bytes_total{device=\"pixel \\\"7\\\"\"} 42\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("# TYPE test_render_seconds histogram\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("test_render_seconds_bucket{op=\"x\",le=\"2e-06\"} 1\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("test_render_seconds_bucket{op=\"x\",le=\"0.002048\"} 2\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("test_render_seconds_bucket{op=\"x\",le=\"+Inf\"} 2\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("test_render_seconds_sum{op=\"x\"} 0.001502\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("test_render_seconds_count{op=\"x\"} 2\n"),
+            std::string::npos);
+}
+
+TEST(MetricsRegistryTest, ConcurrentIncrementsAreNotLost) {
+  Counter &c = MetricsRegistry::getInstance().counter("test_concurrent_total",
+                                                      "help");
+  Histogram &h = MetricsRegistry::getInstance().histogram(
+      "test_concurrent_seconds", "help");
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 10000; ++i) {
+        c.inc();
+        ScopedTimer timer(h);
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+  EXPECT_EQ(c.value(), 40000u);
+  EXPECT_EQ(h.count(), 40000u);
+}
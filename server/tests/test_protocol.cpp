@@ -88,3 +88,238 @@ TEST_F(ProtocolParserTest, FileChunkHeader) {
   EXPECT_EQ(headerPacket.header.type, PacketType::FILE_CHUNK);
   EXPECT_EQ(headerPacket.header.payloadLength, payloadSize);
 }
+
+TEST_F(ProtocolParserTest, UploadAckAdvertisesWindowOnlyWhenGranted) {
+  auto plain =
+      ProtocolParser::createUploadAckPacket("id", UPLOAD_CHUNK_SIZE, 0, "NEW");
+  json plainPayload = ProtocolParser::parsePayload(plain);
+  EXPECT_EQ(plainPayload["chunkSize"], UPLOAD_CHUNK_SIZE);
+  EXPECT_FALSE(plainPayload.contains("windowBytes"));
+  EXPECT_FALSE(plainPayload.contains("ackEvery"));
+
+  auto windowed = ProtocolParser::createUploadAckPacket(
+      "id", UPLOAD_CHUNK_SIZE, 4096, "RESUMING", 8LL * 1024 * 1024, 4);
+  json windowedPayload = ProtocolParser::parsePayload(windowed);
+  EXPECT_EQ(windowedPayload["receivedBytes"], 4096);
+  EXPECT_EQ(windowedPayload["windowBytes"], 8LL * 1024 * 1024);
+  EXPECT_EQ(windowedPayload["ackEvery"], 4);
+}
+
+TEST_F(ProtocolParserTest, AppendPacketCoalescesIntoOneBuffer) {
+  auto ack = ProtocolParser::createUploadChunkAckPacket("id", 1024, "OK");
+  auto heartbeat = ProtocolParser::createHeartbeatPacket();
+
+  std::vector<char> batch;
+  ProtocolParser::appendPacket(ack, batch);
+  ProtocolParser::appendPacket(heartbeat, batch);
+
+  std::vector<char> expected = ProtocolParser::serializePacket(ack);
+  std::vector<char> second = ProtocolParser::serializePacket(heartbeat);
+  expected.insert(expected.end(), second.begin(), second.end());
+  EXPECT_EQ(batch, expected);
+}
+
+TEST_F(ProtocolParserTest, UploadInlineRoundTrip) {
+  std::string body = "tiny jpeg bytes";
+  UploadInlinePayload upload;
+  upload.filename = "shot.png";
+  upload.size = (long long)body.size();
+  upload.sha256 = "abc123";
+  upload.data = body.data();
+  upload.dataLength = body.size();
+
+  auto packet = ProtocolParser::createUploadInlinePacket(upload);
+  EXPECT_EQ(packet.header.version, PROTOCOL_VERSION_2);
+  EXPECT_EQ(static_cast<uint8_t>(packet.header.type),
+            static_cast<uint8_t>(PacketTypeV2::UPLOAD_INLINE));
+
+  UploadInlinePayload parsed;
+  ASSERT_TRUE(ProtocolParser::parseUploadInline(packet.payload, parsed));
+  EXPECT_EQ(parsed.filename, "shot.png");
+  EXPECT_EQ(parsed.sha256, "abc123");
+  EXPECT_TRUE(parsed.traceId.empty());
+  EXPECT_EQ(std::string(parsed.data, parsed.dataLength), body);
+
+  // Body shorter than the declared size
+  std::vector<char> truncated(packet.payload.begin(),
+                              packet.payload.end() - 1);
+  EXPECT_FALSE(ProtocolParser::parseUploadInline(truncated, parsed));
+
+  // Metadata length past the end of the payload
+  std::vector<char> bogus = {0x7f, 0x00, 0x00, 0x00, '{', '}'};
+  EXPECT_FALSE(ProtocolParser::parseUploadInline(bogus, parsed));
+}
+
+TEST_F(ProtocolParserTest, PairingResponseAdvertisesInlineLimit) {
+  json plain = ProtocolParser::parsePayload(
+      ProtocolParser::createPairingResponse(1, true, "Connected"));
+  EXPECT_FALSE(plain.contains("inlineMaxBytes"));
+
+  json advertised = ProtocolParser::parsePayload(
+      ProtocolParser::createPairingResponse(1, true, "Connected", 1048576));
+  EXPECT_EQ(advertised["inlineMaxBytes"], 1048576);
+}
+
+// Split one serialized packet back into a Packet
+static Packet readPacket(const std::vector<char> &bytes) {
+  std::vector<char> header(bytes.begin(), bytes.begin() + HEADER_SIZE);
+  Packet packet = ProtocolParser::deserializePacketHeader(header);
+  packet.payload.assign(bytes.begin() + HEADER_SIZE, bytes.end());
+  return packet;
+}
+
+TEST_F(ProtocolParserTest, BinaryControlMessagesRoundTrip) {
+  UploadAckPayload ack;
+  ack.uploadId = std::string(32, 'a');
+  ack.status = "RESUMING";
+  ack.receivedBytes = 5LL * 1024 * 1024 * 1024; // Needs all 64 bits
+  ack.windowBytes = 8LL * 1024 * 1024;
+  ack.ackEvery = 4;
+  ack.maxConcurrentUploads = 8;
+
+  std::vector<char> bytes;
+  ProtocolParser::appendUploadAck(ack, bytes);
+  Packet packet = readPacket(bytes);
+  EXPECT_EQ(packet.header.version, PROTOCOL_VERSION_3);
+  EXPECT_EQ(packet.header.payloadLength, packet.payload.size());
+
+  UploadAckPayload decoded;
+  ASSERT_TRUE(ProtocolParser::decodeUploadAck(
+      packet.payload.data(), packet.payload.size(), decoded));
+  EXPECT_EQ(decoded.uploadId, ack.uploadId);
+  EXPECT_EQ(decoded.status, "RESUMING");
+  EXPECT_EQ(decoded.chunkSize, UPLOAD_CHUNK_SIZE);
+  EXPECT_EQ(decoded.receivedBytes, ack.receivedBytes);
+  EXPECT_EQ(decoded.windowBytes, ack.windowBytes);
+  EXPECT_EQ(decoded.ackEvery, 4);
+  EXPECT_EQ(decoded.maxConcurrentUploads, 8);
+
+  // The per-chunk ack is about half its JSON form
+  std::vector<char> chunkAck;
+  ProtocolParser::appendUploadChunkAck(ack.uploadId, 1048576, "OK", chunkAck);
+  EXPECT_EQ(chunkAck.size(), HEADER_SIZE + 1 + 8 + 1 + 32);
+  EXPECT_LT(chunkAck.size(),
+            ProtocolParser::serializePacket(
+                ProtocolParser::createUploadChunkAckPacket(ack.uploadId,
+                                                           1048576, "OK"))
+                .size());
+
+  UploadChunkAckPayload chunkDecoded;
+  packet = readPacket(chunkAck);
+  ASSERT_TRUE(ProtocolParser::decodeUploadChunkAck(
+      packet.payload.data(), packet.payload.size(), chunkDecoded));
+  EXPECT_EQ(chunkDecoded.nextExpectedOffset, 1048576);
+  EXPECT_EQ(chunkDecoded.status, "OK");
+
+  std::vector<char> result;
+  ProtocolParser::appendUploadResult("id", "ABORTED", "Session Aborted",
+                                     result);
+  UploadResultPayload resultDecoded;
+  packet = readPacket(result);
+  ASSERT_TRUE(ProtocolParser::decodeUploadResult(
+      packet.payload.data(), packet.payload.size(), resultDecoded));
+  EXPECT_EQ(resultDecoded.uploadId, "id");
+  EXPECT_EQ(resultDecoded.status, "ABORTED");
+  EXPECT_EQ(resultDecoded.message, "Session Aborted");
+
+  // Truncated payloads and unknown status codes are rejected
+  EXPECT_FALSE(ProtocolParser::decodeUploadResult(
+      packet.payload.data(), packet.payload.size() - 1, resultDecoded));
+  packet.payload[0] = 0x7f;
+  EXPECT_FALSE(ProtocolParser::decodeUploadResult(
+      packet.payload.data(), packet.payload.size(), resultDecoded));
+}
+
+TEST_F(ProtocolParserTest, ParseUploadControlAcceptsBothEncodings) {
+  UploadInitPayload init;
+  init.filename = "IMG_0001.jpg";
+  init.size = 123456;
+  init.hash = std::string(64, 'f');
+  init.traceId = "trace";
+  init.windowed = true;
+
+  std::vector<char> bytes;
+  ProtocolParser::appendUploadInit(init, bytes);
+  UploadInitPayload binary = ProtocolParser::parseUploadInit(readPacket(bytes));
+
+  json j = {{"filename", init.filename}, {"size", init.size},
+            {"hash", init.hash},         {"traceId", init.traceId},
+            {"windowed", true}};
+  Packet jsonPacket;
+  jsonPacket.header.version = PROTOCOL_VERSION_2;
+  std::string s = j.dump();
+  jsonPacket.payload.assign(s.begin(), s.end());
+  UploadInitPayload parsed = ProtocolParser::parseUploadInit(jsonPacket);
+
+  for (const UploadInitPayload *p : {&binary, &parsed}) {
+    EXPECT_EQ(p->filename, init.filename);
+    EXPECT_EQ(p->size, init.size);
+    EXPECT_EQ(p->hash, init.hash);
+    EXPECT_EQ(p->traceId, init.traceId);
+    EXPECT_TRUE(p->windowed);
+  }
+
+  bytes.clear();
+  ProtocolParser::appendUploadFinish({"id", "sha"}, bytes);
+  UploadFinishPayload finish =
+      ProtocolParser::parseUploadFinish(readPacket(bytes));
+  EXPECT_EQ(finish.uploadId, "id");
+  EXPECT_EQ(finish.sha256, "sha");
+
+  bytes.clear();
+  ProtocolParser::appendUploadAbort("id", bytes);
+  EXPECT_EQ(ProtocolParser::parseUploadAbort(readPacket(bytes)), "id");
+
+  Packet truncated = readPacket(bytes);
+  truncated.payload.pop_back();
+  EXPECT_THROW(ProtocolParser::parseUploadAbort(truncated), std::runtime_error);
+}
+
+TEST_F(ProtocolParserTest, UploadIdPacksToSixteenBytes) {
+  std::string text = "0123abcd-4567-89ef-0a1b-2c3d4e5f6789";
+  RawUploadId raw;
+  ASSERT_TRUE(ProtocolParser::packUploadId(text, raw));
+  EXPECT_EQ(raw[0], 0x01);
+  EXPECT_EQ(raw[3], 0xcd);
+  EXPECT_EQ(raw[15], 0x89);
+  EXPECT_EQ(ProtocolParser::unpackUploadId(raw), text);
+
+  EXPECT_FALSE(ProtocolParser::packUploadId("0123abcd", raw));
+  EXPECT_FALSE(
+      ProtocolParser::packUploadId("0123abcd-4567-89ef-0a1b-2c3d4e5f678g", raw));
+  EXPECT_FALSE(
+      ProtocolParser::packUploadId("0123abcd04567-89ef-0a1b-2c3d4e5f6789", raw));
+}
+
+TEST_F(ProtocolParserTest, ParseUploadChunkBothVersions) {
+  std::string text = "0123abcd-4567-89ef-0a1b-2c3d4e5f6789";
+  RawUploadId raw;
+  ASSERT_TRUE(ProtocolParser::packUploadId(text, raw));
+  const char offset[8] = {0, 0, 0, 0, 0, 0x10, 0, 0}; // 1 MB, big-endian
+  std::string data = "chunk";
+
+  std::vector<char> v2(text.begin(), text.end());
+  v2.insert(v2.end(), offset, offset + 8);
+  v2.insert(v2.end(), data.begin(), data.end());
+
+  std::vector<char> v3(raw.begin(), raw.end());
+  v3.insert(v3.end(), offset, offset + 8);
+  v3.insert(v3.end(), data.begin(), data.end());
+  EXPECT_EQ(v3.size() + 20, v2.size());
+
+  for (auto [payload, version] : {std::make_pair(&v2, PROTOCOL_VERSION_2),
+                                  std::make_pair(&v3, PROTOCOL_VERSION_3)}) {
+    UploadChunkHeader chunk;
+    ASSERT_TRUE(ProtocolParser::parseUploadChunk(*payload, version, chunk));
+    EXPECT_EQ(chunk.uploadId, raw);
+    EXPECT_EQ(chunk.offset, 1048576);
+    EXPECT_EQ(std::string(chunk.data, chunk.dataLength), data);
+  }
+
+  // A V3 header read as V2 is neither long enough nor UUID text
+  std::vector<char> shortHeader(v3.begin(), v3.begin() + 20);
+  UploadChunkHeader chunk;
+  EXPECT_FALSE(ProtocolParser::parseUploadChunk(shortHeader,
+                                                PROTOCOL_VERSION_3, chunk));
+  EXPECT_FALSE(ProtocolParser::parseUploadChunk(v3, PROTOCOL_VERSION_2, chunk));
+}
@@ -0,0 +1,115 @@
+#include "StaticAssetCache.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string gunzip(const std::string &input) {
+  z_stream stream{};
+  if (inflateInit2(&stream, 15 + 16) != Z_OK)
+    return "";
+  std::string output(64 * 1024, '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  stream.avail_in = (uInt)input.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+  stream.avail_out = (uInt)output.size();
+  int result = inflate(&stream, Z_FINISH);
+  output.resize(stream.total_out);
+  inflateEnd(&stream);
+  return result == Z_STREAM_END ? output : "";
+}
+
+} // namespace
+
+class StaticAssetCacheTest : public ::testing::Test {
+protected:
+  std::string rootDir = "test_static_assets";
+  std::string script;
+
+  void SetUp() override {
+    fs::remove_all(rootDir);
+    fs::create_directories(rootDir + "/assets");
+    fs::create_directories(rootDir + "/node_modules/pkg");
+
+    for (int i = 0; i < 200; ++i)
+      script += "console.log('line " + std::to_string(i) + "');\n";
+
+    write("index.html", "<!doctype html><div id=root></div>");
+    write("assets/index-3f2a9c1b.js", script);
+    write("favicon.PNG", "\x89PNG");
+    write("node_modules/pkg/index.js", script);
+  }
+
+  void TearDown() override { fs::remove_all(rootDir); }
+
+  void write(const std::string &name, const std::string &content) {
+    std::ofstream(rootDir + "/" + name, std::ios::binary) << content;
+  }
+};
+
+TEST_F(StaticAssetCacheTest, LoadsBundleWithMetadata) {
+  StaticAssetCache cache;
+  ASSERT_TRUE(cache.load(rootDir));
+  EXPECT_EQ(cache.size(), 3u);
+  EXPECT_EQ(cache.find("node_modules/pkg/index.js"), nullptr);
+  EXPECT_EQ(cache.find("missing.js"), nullptr);
+
+  const StaticAssetCache::Asset *index = cache.find("index.html");
+  ASSERT_NE(index, nullptr);
+  EXPECT_EQ(index->contentType, "text/html; charset=utf-8");
+  EXPECT_FALSE(index->immutable);
+  // Too small to be worth compressing
+  EXPECT_TRUE(index->gzip.empty());
+
+  const StaticAssetCache::Asset *js = cache.find("assets/index-3f2a9c1b.js");
+  ASSERT_NE(js, nullptr);
+  EXPECT_EQ(js->contentType, "application/javascript; charset=utf-8");
+  EXPECT_TRUE(js->immutable);
+  EXPECT_EQ(js->identity, script);
+  ASSERT_FALSE(js->gzip.empty());
+  EXPECT_LT(js->gzip.size(), js->identity.size());
+  EXPECT_EQ(gunzip(js->gzip), script);
+  EXPECT_EQ(js->etag.size(), 18u);
+
+  const StaticAssetCache::Asset *icon = cache.find("favicon.PNG");
+  ASSERT_NE(icon, nullptr);
+  EXPECT_EQ(icon->contentType, "image/png");
+  EXPECT_TRUE(icon->gzip.empty());
+}
+
+TEST_F(StaticAssetCacheTest, SelectsAcceptedEncoding) {
+  StaticAssetCache cache;
+  ASSERT_TRUE(cache.load(rootDir));
+  const StaticAssetCache::Asset *js = cache.find("assets/index-3f2a9c1b.js");
+  ASSERT_NE(js, nullptr);
+
+  auto identity = StaticAssetCache::select(*js, "");
+  EXPECT_EQ(identity.encoding, nullptr);
+  EXPECT_EQ(identity.body, &js->identity);
+  EXPECT_EQ(identity.etag, js->etag);
+
+  auto gzip = StaticAssetCache::select(*js, "gzip;q=0.5, br;q=0");
+  ASSERT_NE(gzip.encoding, nullptr);
+  EXPECT_STREQ(gzip.encoding, "gzip");
+  EXPECT_EQ(gzip.body, &js->gzip);
+  EXPECT_NE(gzip.etag, js->etag);
+
+  auto best = StaticAssetCache::select(*js, "gzip, deflate, br");
+  ASSERT_NE(best.encoding, nullptr);
+  if (js->brotli.empty()) {
+    EXPECT_STREQ(best.encoding, "gzip");
+  } else {
+    EXPECT_STREQ(best.encoding, "br");
+    EXPECT_NE(best.etag, gzip.etag);
+  }
+}
+
+TEST_F(StaticAssetCacheTest, MissingDirectoryFails) {
+  StaticAssetCache cache;
+  EXPECT_FALSE(cache.load(rootDir + "/does-not-exist"));
+  EXPECT_EQ(cache.size(), 0u);
+}
@@ -0,0 +1,122 @@
+#include "TarWriter.h"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+long long parseOctal(const std::string &archive, size_t offset, size_t width) {
+  return std::strtoll(archive.substr(offset, width).c_str(), nullptr, 8);
+}
+
+bool checksumValid(const std::string &archive, size_t offset) {
+  unsigned int sum = 0;
+  for (size_t i = 0; i < 512; ++i) {
+    bool inField = i >= 148 && i < 156;
+    sum += inField ? ' ' : (unsigned char)archive[offset + i];
+  }
+  return (long long)sum == parseOctal(archive, offset + 148, 8);
+}
+
+} // namespace
+
+class TarWriterTest : public ::testing::Test {
+protected:
+  std::string smallPath = "test_tar_small.bin";
+  std::string bigPath = "test_tar_big.bin";
+  std::string bigData;
+
+  void SetUp() override {
+    std::ofstream(smallPath, std::ios::binary) << "hello";
+    // Larger than TarWriter's copy buffer
+    bigData.resize(TarWriter::BUFFER_SIZE + 123);
+    for (size_t i = 0; i < bigData.size(); ++i)
+      bigData[i] = (char)(i % 251);
+    std::ofstream(bigPath, std::ios::binary) << bigData;
+  }
+
+  void TearDown() override {
+    fs::remove(smallPath);
+    fs::remove(bigPath);
+  }
+};
+
+TEST_F(TarWriterTest, WritesUstarEntries) {
+  std::ostringstream out;
+  TarWriter tar(out);
+  ASSERT_TRUE(tar.addFile("client-1/a.txt", smallPath, 5, 1700000000));
+  ASSERT_TRUE(tar.addFile("client-1/big.bin", bigPath,
+                          (long long)bigData.size(), 1700000000));
+  ASSERT_TRUE(tar.finish());
+
+  std::string archive = out.str();
+  EXPECT_EQ(archive.size() % 512, 0u);
+  EXPECT_EQ((long long)archive.size(), tar.bytesWritten());
+
+  // First entry
+  EXPECT_EQ(std::string(archive.c_str()), "client-1/a.txt");
+  EXPECT_EQ(parseOctal(archive, 124, 12), 5);
+  EXPECT_EQ(parseOctal(archive, 136, 12), 1700000000);
+  EXPECT_EQ(archive[156], '0');
+  EXPECT_EQ(archive.substr(257, 5), "ustar");
+  EXPECT_TRUE(checksumValid(archive, 0));
+  EXPECT_EQ(archive.substr(512, 5), "hello");
+
+  // Second entry starts on the next block boundary
+  size_t second = 1024;
+  EXPECT_EQ(std::string(archive.c_str() + second), "client-1/big.bin");
+  EXPECT_TRUE(checksumValid(archive, second));
+  EXPECT_EQ(archive.substr(second + 512, bigData.size()), bigData);
+
+  // Archive ends with two zero blocks
+  EXPECT_EQ(archive.substr(archive.size() - 1024), std::string(1024, '\0'));
+}
+
+TEST_F(TarWriterTest, LongNamesUseGnuLongLink) {
+  std::string longName = "client-1/" + std::string(200, 'n') + ".jpg";
+
+  std::ostringstream out;
+  TarWriter tar(out);
+  ASSERT_TRUE(tar.addFile(longName, smallPath, 5, 0));
+  ASSERT_TRUE(tar.finish());
+
+  std::string archive = out.str();
+  EXPECT_EQ(std::string(archive.c_str()), "././@LongLink");
+  EXPECT_EQ(archive[156], 'L');
+  EXPECT_TRUE(checksumValid(archive, 0));
+  EXPECT_EQ(std::string(archive.c_str() + 512), longName);
+
+  // The real entry follows the padded name block
+  size_t entry = 512 + 512;
+  EXPECT_EQ(archive[entry + 156], '0');
+  EXPECT_EQ(parseOctal(archive, entry + 124, 12), 5);
+  EXPECT_EQ(archive.substr(entry + 512, 5), "hello");
+}
+
+TEST_F(TarWriterTest, MissingSourceFails) {
+  std::ostringstream out;
+  TarWriter tar(out);
+  EXPECT_FALSE(tar.addFile("x", "does_not_exist.bin", 10, 0));
+  EXPECT_EQ(tar.bytesWritten(), 0);
+}
+
+TEST_F(TarWriterTest, EntrySizeBoundsWrittenBytes) {
+  std::string longName = "client-1/" + std::string(200, 'n') + ".jpg";
+
+  std::ostringstream out;
+  TarWriter tar(out);
+  ASSERT_TRUE(tar.addFile("client-1/a.txt", smallPath, 5, 0));
+  EXPECT_EQ(tar.bytesWritten(), TarWriter::entrySize("client-1/a.txt", 5));
+  ASSERT_TRUE(tar.addFile(longName, bigPath, (long long)bigData.size(), 0));
+  ASSERT_TRUE(tar.finish());
+
+  EXPECT_EQ(tar.bytesWritten(),
+            TarWriter::entrySize("client-1/a.txt", 5) +
+                TarWriter::entrySize(longName, (long long)bigData.size()) +
+                TarWriter::TRAILER_SIZE);
+}
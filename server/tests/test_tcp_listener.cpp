@@ -0,0 +1,360 @@
+#include "ConfigManager.h"
+#include "DatabaseManager.h"
+#include "FileManager.h"
+#include "ProtocolParser.h"
+#include "TcpListener.h"
+#include "TlsContext.h"
+#include "test_certificate.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Runs a real TcpListener on a loopback port, on its own io_context thread,
+// and talks to it through blocking TLS clients
+class TcpListenerTest : public ::testing::Test {
+protected:
+  using SslStream = boost::asio::ssl::stream<tcp::socket>;
+
+  std::string dir = "test_tcp_listener";
+  std::string savedConfig;
+  boost::asio::ssl::context serverContext{
+      boost::asio::ssl::context::tls_server};
+  boost::asio::ssl::context clientContext{
+      boost::asio::ssl::context::tls_client};
+  // Declared before the io_context so Sessions it still holds are freed
+  // while the database and file manager are alive
+  std::unique_ptr<DatabaseManager> db;
+  std::unique_ptr<FileManager> files;
+  boost::asio::io_context io;
+  boost::asio::io_context clientIo;
+  std::unique_ptr<TcpListener> listener;
+  std::thread ioThread;
+
+  void SetUp() override {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    // The config is a process-wide singleton; put back what tests change
+    ConfigManager &config = ConfigManager::getInstance();
+    savedConfig = "[network]\nmax_connections = " +
+                  std::to_string(config.getMaxConnections()) +
+                  "\n[upload]\nwindow_mb = " +
+                  std::to_string(config.getUploadWindowMB()) +
+                  "\nack_every_chunks = " +
+                  std::to_string(config.getUploadAckEveryChunks()) +
+                  "\nmax_concurrent = " +
+                  std::to_string(config.getUploadMaxConcurrent()) + "\n";
+
+    TlsContext::Options options;
+    options.certificateChainFile = dir + "/server.crt";
+    options.privateKeyFile = dir + "/server.key";
+    writeSelfSignedCertificate(options.certificateChainFile,
+                               options.privateKeyFile);
+    TlsContext::configure(serverContext, options);
+    clientContext.set_verify_mode(boost::asio::ssl::verify_none);
+
+    db = std::make_unique<DatabaseManager>();
+    ASSERT_TRUE(db->open(dir + "/photosync.db"));
+    ASSERT_TRUE(db->createSchema());
+    files = std::make_unique<FileManager>(dir + "/photos", dir + "/temp",
+                                          1LL << 30);
+    ASSERT_TRUE(files->initialize());
+  }
+
+  void TearDown() override {
+    io.stop();
+    if (ioThread.joinable())
+      ioThread.join();
+    listener.reset();
+    applyConfig(savedConfig);
+    fs::remove_all(dir);
+  }
+
+  void applyConfig(const std::string &text) {
+    std::string path = dir + "/test.conf";
+    std::ofstream(path) << text;
+    ConfigManager::getInstance().loadFromFile(path);
+  }
+
+  // Apply server.conf-style settings and start accepting connections
+  void start(const std::string &config) {
+    applyConfig(config);
+    listener =
+        std::make_unique<TcpListener>(io, serverContext, 0, *db, *files);
+    ioThread = std::thread([this] { io.run(); });
+  }
+
+  // Stop the server thread so its state can be inspected
+  void stop() {
+    io.stop();
+    ioThread.join();
+  }
+
+  std::unique_ptr<SslStream> connect() {
+    auto client = std::make_unique<SslStream>(clientIo, clientContext);
+    client->next_layer().connect(tcp::endpoint(
+        boost::asio::ip::address_v4::loopback(), listener->port()));
+    // A reply that never comes fails the test instead of hanging it
+#ifdef _WIN32
+    DWORD timeout = 10000;
+#else
+    timeval timeout{10, 0};
+#endif
+    setsockopt(client->next_layer().native_handle(), SOL_SOCKET, SO_RCVTIMEO,
+               (const char *)&timeout, sizeof(timeout));
+    client->handshake(boost::asio::ssl::stream_base::client);
+    return client;
+  }
+
+  static void send(SslStream &client, uint8_t version, uint8_t type,
+                   const std::vector<char> &payload) {
+    Packet packet;
+    packet.header.version = version;
+    packet.header.type = static_cast<PacketType>(type);
+    packet.header.payloadLength = (uint32_t)payload.size();
+    packet.payload = payload;
+    boost::asio::write(client,
+                       boost::asio::buffer(ProtocolParser::serializePacket(packet)));
+  }
+
+  static void sendJson(SslStream &client, uint8_t version, uint8_t type,
+                       const json &payload) {
+    std::string text = payload.dump();
+    send(client, version, type, std::vector<char>(text.begin(), text.end()));
+  }
+
+  static Packet receive(SslStream &client) {
+    std::vector<char> header(8);
+    boost::asio::read(client, boost::asio::buffer(header));
+    Packet packet = ProtocolParser::deserializePacketHeader(header);
+    packet.payload.resize(packet.header.payloadLength);
+    boost::asio::read(client, boost::asio::buffer(packet.payload));
+    return packet;
+  }
+
+  // Next packet, which must be of the given type, as JSON
+  static json receiveJson(SslStream &client, uint8_t type) {
+    Packet reply = receive(client);
+    EXPECT_EQ((int)(uint8_t)reply.header.type, (int)type);
+    return ProtocolParser::parsePayload(reply);
+  }
+
+  // V2 UPLOAD_CHUNK: uploadId text, big-endian offset, data
+  static void sendChunk(SslStream &client, const std::string &uploadId,
+                        long long offset, const std::string &data) {
+    std::vector<char> payload(uploadId.begin(), uploadId.end());
+    for (int shift = 56; shift >= 0; shift -= 8)
+      payload.push_back((char)((offset >> shift) & 0xFF));
+    payload.insert(payload.end(), data.begin(), data.end());
+    send(client, PROTOCOL_VERSION_2, (uint8_t)PacketTypeV2::UPLOAD_CHUNK,
+         payload);
+  }
+
+  static void sendInit(SslStream &client, const std::string &filename,
+                       const std::string &content, bool windowed) {
+    sendJson(client, PROTOCOL_VERSION_2, (uint8_t)PacketTypeV2::UPLOAD_INIT,
+             {{"filename", filename},
+              {"size", content.size()},
+              {"hash", FileManager::calculateSHA256(content.data(),
+                                                    content.size())},
+              {"windowed", windowed}});
+  }
+
+  static void sendFinish(SslStream &client, const std::string &uploadId,
+                         const std::string &content) {
+    sendJson(client, PROTOCOL_VERSION_2, (uint8_t)PacketTypeV2::UPLOAD_FINISH,
+             {{"uploadId", uploadId},
+              {"sha256", FileManager::calculateSHA256(content.data(),
+                                                      content.size())}});
+  }
+
+  static bool pair(SslStream &client, const std::string &deviceId) {
+    sendJson(client, PROTOCOL_VERSION,
+             (uint8_t)PacketType::PAIRING_REQUEST,
+             {{"deviceId", deviceId}, {"userName", "test"}});
+    Packet reply = receive(client);
+    return reply.header.type == PacketType::PAIRING_RESPONSE &&
+           ProtocolParser::parsePayload(reply).value("success", false);
+  }
+};
+
+TEST_F(TcpListenerTest, UnlimitedConnectionsAreNotTracked) {
+  start("[network]\nmax_connections = 0\n");
+
+  for (int i = 0; i < 20; ++i) {
+    auto client = connect();
+    ASSERT_TRUE(pair(*client, "cycling-device"));
+    client->lowest_layer().close();
+  }
+
+  stop();
+  EXPECT_EQ(listener->trackedSessions(), 0u);
+}
+
+TEST_F(TcpListenerTest, LimitedConnectionsForgetEndedSessions) {
+  start("[network]\nmax_connections = 3\n");
+
+  for (int i = 0; i < 20; ++i) {
+    auto client = connect();
+    ASSERT_TRUE(pair(*client, "cycling-device"));
+    client->lowest_layer().close();
+  }
+
+  stop();
+  EXPECT_LE(listener->trackedSessions(), 3u);
+}
+
+TEST_F(TcpListenerTest, WindowedUploadAcksCumulativelyAndReportsGapOnce) {
+  // 100 chunks per ack is clamped to two acks per 8 MB window of 1 MB chunks
+  start("[upload]\nwindow_mb = 8\nack_every_chunks = 100\n"
+        "max_concurrent = 8\n");
+  const uint8_t ERROR_PACKET = (uint8_t)PacketType::PROTOCOL_ERROR;
+  const uint8_t CHUNK_ACK = (uint8_t)PacketTypeV2::UPLOAD_CHUNK_ACK;
+
+  std::string content(10 * 1000, '\0');
+  for (size_t i = 0; i < content.size(); ++i)
+    content[i] = (char)(i % 251);
+  auto chunk = [&](int i) { return content.substr(i * 1000, 1000); };
+
+  auto client = connect();
+  ASSERT_TRUE(pair(*client, "windowed-device"));
+  sendInit(*client, "windowed.bin", content, true);
+  json ack = receiveJson(*client, (uint8_t)PacketTypeV2::UPLOAD_ACK);
+  EXPECT_EQ(ack["windowBytes"].get<long long>(), 8LL * 1024 * 1024);
+  EXPECT_EQ(ack["ackEvery"].get<int>(), 4);
+  std::string uploadId = ack["uploadId"];
+
+  // Chunk 3 goes missing; 4 and 5 arrive behind the gap
+  for (int i : {0, 1, 2, 4, 5})
+    sendChunk(*client, uploadId, i * 1000LL, chunk(i));
+  // Resend from the gap; a second gap error would arrive before these acks
+  for (int i = 3; i < 10; ++i)
+    sendChunk(*client, uploadId, i * 1000LL, chunk(i));
+
+  json error = receiveJson(*client, ERROR_PACKET);
+  EXPECT_EQ(error["code"].get<int>(), (int)ErrorCode::INVALID_OFFSET);
+  // Every fourth chunk, then the last one whatever the count
+  for (long long expected : {4000LL, 8000LL, 10000LL}) {
+    json chunkAck = receiveJson(*client, CHUNK_ACK);
+    EXPECT_EQ(chunkAck["nextExpectedOffset"].get<long long>(), expected);
+  }
+
+  // A duplicate is re-acked at the current offset straight away
+  sendChunk(*client, uploadId, 2000, chunk(2));
+  EXPECT_EQ(receiveJson(*client, CHUNK_ACK)["nextExpectedOffset"]
+                .get<long long>(),
+            10000);
+
+  sendFinish(*client, uploadId, content);
+  EXPECT_EQ(receiveJson(*client, (uint8_t)PacketTypeV2::UPLOAD_RESULT)
+                .value("status", ""),
+            "SUCCESS");
+}
+
+TEST_F(TcpListenerTest, InterleavedUploadsFinishIndependently) {
+  start("[upload]\nwindow_mb = 8\nack_every_chunks = 4\nmax_concurrent = 2\n");
+  const uint8_t ACK = (uint8_t)PacketTypeV2::UPLOAD_ACK;
+  const uint8_t CHUNK_ACK = (uint8_t)PacketTypeV2::UPLOAD_CHUNK_ACK;
+
+  std::string a(3000, '\0'), b(3000, '\0');
+  for (size_t i = 0; i < a.size(); ++i) {
+    a[i] = (char)(i % 251);
+    b[i] = (char)(i * 7 % 253);
+  }
+
+  auto client = connect();
+  ASSERT_TRUE(pair(*client, "interleaving-device"));
+  sendInit(*client, "a.bin", a, false);
+  std::string idA = receiveJson(*client, ACK)["uploadId"];
+  sendInit(*client, "b.bin", b, false);
+  std::string idB = receiveJson(*client, ACK)["uploadId"];
+  ASSERT_NE(idA, idB);
+
+  // A third upload is over the limit
+  sendInit(*client, "c.bin", std::string(10, 'c'), false);
+  EXPECT_EQ(receiveJson(*client, (uint8_t)PacketType::PROTOCOL_ERROR)["code"]
+                .get<int>(),
+            (int)ErrorCode::TOO_MANY_UPLOADS);
+
+  for (long long offset : {0LL, 1000LL}) {
+    sendChunk(*client, idA, offset, a.substr(offset, 1000));
+    sendChunk(*client, idB, offset, b.substr(offset, 1000));
+    EXPECT_EQ(receiveJson(*client, CHUNK_ACK)["uploadId"], idA);
+    EXPECT_EQ(receiveJson(*client, CHUNK_ACK)["uploadId"], idB);
+  }
+
+  // Resuming an upload already open here is not another upload
+  sendInit(*client, "a.bin", a, false);
+  json resumed = receiveJson(*client, ACK);
+  EXPECT_EQ(resumed["uploadId"], idA);
+  EXPECT_EQ(resumed["status"], "RESUMING");
+  EXPECT_EQ(resumed["receivedBytes"].get<long long>(), 2000);
+
+  sendChunk(*client, idB, 2000, b.substr(2000));
+  sendChunk(*client, idA, 2000, a.substr(2000));
+  EXPECT_EQ(receiveJson(*client, CHUNK_ACK)["nextExpectedOffset"]
+                .get<long long>(),
+            3000);
+  EXPECT_EQ(receiveJson(*client, CHUNK_ACK)["nextExpectedOffset"]
+                .get<long long>(),
+            3000);
+
+  const uint8_t RESULT = (uint8_t)PacketTypeV2::UPLOAD_RESULT;
+  sendFinish(*client, idB, b);
+  EXPECT_EQ(receiveJson(*client, RESULT).value("status", ""), "SUCCESS");
+  sendFinish(*client, idA, a);
+  EXPECT_EQ(receiveJson(*client, RESULT).value("status", ""), "SUCCESS");
+
+  for (const std::string *content : {&a, &b}) {
+    std::string hash =
+        FileManager::calculateSHA256(content->data(), content->size());
+    EXPECT_EQ(FileManager::calculateSHA256(files->getPhotoPath(hash, ".bin")),
+              hash);
+  }
+}
+
+TEST_F(TcpListenerTest, ChunksOfEarlierUploadsCountAgainstUploadLimit) {
+  start("[upload]\nwindow_mb = 8\nack_every_chunks = 4\nmax_concurrent = 2\n");
+  const uint8_t ACK = (uint8_t)PacketTypeV2::UPLOAD_ACK;
+  const uint8_t CHUNK_ACK = (uint8_t)PacketTypeV2::UPLOAD_CHUNK_ACK;
+  std::string a(2000, 'a'), b(2000, 'b');
+
+  // Start two uploads, then drop the connection
+  std::string idA, idB;
+  {
+    auto client = connect();
+    ASSERT_TRUE(pair(*client, "reconnecting-device"));
+    sendInit(*client, "a.bin", a, false);
+    idA = receiveJson(*client, ACK)["uploadId"];
+    sendInit(*client, "b.bin", b, false);
+    idB = receiveJson(*client, ACK)["uploadId"];
+    sendChunk(*client, idA, 0, a.substr(0, 1000));
+    receiveJson(*client, CHUNK_ACK);
+    sendChunk(*client, idB, 0, b.substr(0, 1000));
+    receiveJson(*client, CHUNK_ACK);
+    client->lowest_layer().close();
+  }
+
+  // A new connection opens them again on their first chunk
+  auto client = connect();
+  ASSERT_TRUE(pair(*client, "reconnecting-device"));
+  sendInit(*client, "c.bin", std::string(10, 'c'), false);
+  EXPECT_EQ(receiveJson(*client, ACK)["status"], "NEW");
+  sendChunk(*client, idA, 1000, a.substr(1000));
+  EXPECT_EQ(receiveJson(*client, CHUNK_ACK)["nextExpectedOffset"]
+                .get<long long>(),
+            2000);
+  sendChunk(*client, idB, 1000, b.substr(1000));
+  EXPECT_EQ(receiveJson(*client, (uint8_t)PacketType::PROTOCOL_ERROR)["code"]
+                .get<int>(),
+            (int)ErrorCode::TOO_MANY_UPLOADS);
+}
@@ -0,0 +1,61 @@
+#include "ThumbnailCache.h"
+#include "ThumbnailStore.h"
+#include <filesystem>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+TEST(ThumbnailCacheTest, EvictsLeastRecentlyUsedWithinBudget) {
+  ThumbnailCache cache(10);
+  cache.put(1, 300, 11, std::make_shared<std::string>("aaaa"));
+  cache.put(2, 300, 22, std::make_shared<std::string>("bbbb"));
+
+  // Touch 1 so 2 becomes the eviction victim
+  ASSERT_NE(cache.get(1, 300, 11), nullptr);
+  cache.put(3, 300, 33, std::make_shared<std::string>("cccc"));
+
+  EXPECT_NE(cache.get(1, 300, 11), nullptr);
+  EXPECT_EQ(cache.get(2, 300, 22), nullptr);
+  EXPECT_NE(cache.get(3, 300, 33), nullptr);
+  EXPECT_LE(cache.getStats().bytes, 10u);
+
+  // Blobs larger than the whole budget are never cached
+  cache.put(4, 300, 44, std::make_shared<std::string>(32, 'x'));
+  EXPECT_EQ(cache.get(4, 300, 44), nullptr);
+}
+
+TEST(ThumbnailCacheTest, RejectsStaleChecksum) {
+  ThumbnailCache cache(1024);
+  cache.put(1, 300, 11, std::make_shared<std::string>("old"));
+  EXPECT_EQ(cache.get(1, 300, 99), nullptr);
+  EXPECT_NE(cache.get(1, 300, 11), nullptr);
+  EXPECT_EQ(cache.get(1, 128, 11), nullptr);
+
+  ThumbnailCache::Stats stats = cache.getStats();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 2u);
+}
+
+TEST(ThumbnailCacheTest, StoreServesRepeatReadsFromCache) {
+  const std::string storeDir = "test_thumbnail_cache_store";
+  fs::remove_all(storeDir);
+  {
+    ThumbnailStore store(storeDir);
+    ASSERT_TRUE(store.open());
+    ASSERT_TRUE(store.put(1, 300, "v1"));
+
+    std::string data;
+    uint64_t first = 0, second = 0;
+    ASSERT_TRUE(store.get(1, 300, data, &first));
+    ASSERT_TRUE(store.get(1, 300, data, &second));
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(store.getCacheStats().hits, 1u);
+
+    // Overwriting invalidates the cached copy and changes the checksum
+    ASSERT_TRUE(store.put(1, 300, "v2"));
+    ASSERT_TRUE(store.get(1, 300, data, &second));
+    EXPECT_EQ(data, "v2");
+    EXPECT_NE(first, second);
+  }
+  fs::remove_all(storeDir);
+}
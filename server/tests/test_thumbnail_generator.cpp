@@ -0,0 +1,231 @@
+#include "ThumbnailGenerator.h"
+#include "ThumbnailStore.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <vector>
+
+// Declarations only; the implementations are compiled into
+// ThumbnailGenerator.cpp
+#include "external/stb_image.h"
+#include "external/stb_image_write.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void appendBytes(void *context, void *data, int size) {
+  auto *out = static_cast<std::vector<unsigned char> *>(context);
+  auto *bytes = static_cast<unsigned char *>(data);
+  out->insert(out->end(), bytes, bytes + size);
+}
+
+// Solid-colour RGB JPEG in memory
+std::vector<unsigned char> encodeJpeg(int width, int height, unsigned char r,
+                                      unsigned char g, unsigned char b) {
+  std::vector<unsigned char> pixels((size_t)width * height * 3);
+  for (size_t i = 0; i < pixels.size(); i += 3) {
+    pixels[i] = r;
+    pixels[i + 1] = g;
+    pixels[i + 2] = b;
+  }
+  std::vector<unsigned char> jpeg;
+  stbi_write_jpg_to_func(appendBytes, &jpeg, width, height, 3, pixels.data(),
+                         90);
+  return jpeg;
+}
+
+void putU16(std::vector<unsigned char> &v, uint16_t x) {
+  v.push_back(x & 0xFF);
+  v.push_back(x >> 8);
+}
+
+void putU32(std::vector<unsigned char> &v, uint32_t x) {
+  for (int i = 0; i < 4; ++i)
+    v.push_back((x >> (8 * i)) & 0xFF);
+}
+
+// Insert an EXIF APP1 segment (little-endian TIFF, empty IFD0, IFD1 holding
+// only the JPEGInterchangeFormat tags) right after the SOI of mainJpeg
+std::vector<unsigned char>
+withEmbeddedThumbnail(const std::vector<unsigned char> &mainJpeg,
+                      const std::vector<unsigned char> &thumbJpeg) {
+  std::vector<unsigned char> tiff = {'I', 'I', 0x2A, 0x00};
+  putU32(tiff, 8); // IFD0 offset
+  putU16(tiff, 0); // IFD0: no entries
+  putU32(tiff, 14); // next IFD (IFD1)
+  putU16(tiff, 2);
+  uint32_t thumbOffset = 14 + 2 + 2 * 12 + 4;
+  putU16(tiff, 0x0201);
+  putU16(tiff, 4);
+  putU32(tiff, 1);
+  putU32(tiff, thumbOffset);
+  putU16(tiff, 0x0202);
+  putU16(tiff, 4);
+  putU32(tiff, 1);
+  putU32(tiff, (uint32_t)thumbJpeg.size());
+  putU32(tiff, 0); // no IFD2
+  tiff.insert(tiff.end(), thumbJpeg.begin(), thumbJpeg.end());
+
+  std::vector<unsigned char> app1 = {'E', 'x', 'i', 'f', 0, 0};
+  app1.insert(app1.end(), tiff.begin(), tiff.end());
+  size_t segLen = app1.size() + 2;
+
+  std::vector<unsigned char> out = {0xFF, 0xD8, 0xFF, 0xE1,
+                                    (unsigned char)(segLen >> 8),
+                                    (unsigned char)(segLen & 0xFF)};
+  out.insert(out.end(), app1.begin(), app1.end());
+  out.insert(out.end(), mainJpeg.begin() + 2, mainJpeg.end());
+  return out;
+}
+
+void writeFile(const std::string &path, const std::vector<unsigned char> &d) {
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char *>(d.data()), d.size());
+}
+
+} // namespace
+
+class ThumbnailGeneratorTest : public ::testing::Test {
+protected:
+  std::string sourcePath = "test_thumbgen_source.jpg";
+  std::string outputPath = "test_thumbgen_output.jpg";
+
+  void TearDown() override {
+    fs::remove(sourcePath);
+    fs::remove(outputPath);
+  }
+
+  // Average colour of the generated thumbnail
+  void readOutput(int &width, int &height, int &r, int &g, int &b) {
+    int channels;
+    unsigned char *pixels =
+        stbi_load(outputPath.c_str(), &width, &height, &channels, 3);
+    ASSERT_NE(pixels, nullptr);
+    long sum[3] = {0, 0, 0};
+    for (int i = 0; i < width * height; ++i) {
+      for (int c = 0; c < 3; ++c)
+        sum[c] += pixels[i * 3 + c];
+    }
+    stbi_image_free(pixels);
+    r = (int)(sum[0] / (width * height));
+    g = (int)(sum[1] / (width * height));
+    b = (int)(sum[2] / (width * height));
+  }
+};
+
+TEST_F(ThumbnailGeneratorTest, LargeJpegKeepsAspectRatio) {
+  writeFile(sourcePath, encodeJpeg(1600, 1200, 0, 0, 255));
+
+  ASSERT_TRUE(
+      ThumbnailGenerator::generateThumbnail(sourcePath, outputPath, 300, 300));
+
+  int width, height, r, g, b;
+  readOutput(width, height, r, g, b);
+  EXPECT_EQ(width, 300);
+  EXPECT_EQ(height, 225);
+  EXPECT_GT(b, 200);
+  EXPECT_LT(r, 50);
+}
+
+TEST_F(ThumbnailGeneratorTest, UsesEmbeddedExifThumbnailWhenLargeEnough) {
+  // Main image is blue, embedded preview is red: the output colour shows
+  // which one was decoded
+  auto mainJpeg = encodeJpeg(1600, 1200, 0, 0, 255);
+  writeFile(sourcePath,
+            withEmbeddedThumbnail(mainJpeg, encodeJpeg(320, 240, 255, 0, 0)));
+
+  ASSERT_TRUE(
+      ThumbnailGenerator::generateThumbnail(sourcePath, outputPath, 300, 300));
+
+  int width, height, r, g, b;
+  readOutput(width, height, r, g, b);
+  EXPECT_EQ(width, 300);
+  EXPECT_EQ(height, 225);
+  EXPECT_GT(r, 200);
+  EXPECT_LT(b, 50);
+}
+
+TEST_F(ThumbnailGeneratorTest, IgnoresEmbeddedThumbnailThatIsTooSmall) {
+  auto mainJpeg = encodeJpeg(1600, 1200, 0, 0, 255);
+  writeFile(sourcePath,
+            withEmbeddedThumbnail(mainJpeg, encodeJpeg(160, 120, 255, 0, 0)));
+
+  ASSERT_TRUE(
+      ThumbnailGenerator::generateThumbnail(sourcePath, outputPath, 300, 300));
+
+  int width, height, r, g, b;
+  readOutput(width, height, r, g, b);
+  EXPECT_EQ(width, 300);
+  EXPECT_GT(b, 200);
+  EXPECT_LT(r, 50);
+}
+
+TEST_F(ThumbnailGeneratorTest, WrappingExifOffsetsFallBackToMainImage) {
+  auto jpeg = withEmbeddedThumbnail(encodeJpeg(1600, 1200, 0, 0, 255),
+                                    encodeJpeg(320, 240, 255, 0, 0));
+  // The TIFF header starts after SOI, the APP1 marker and length, and
+  // "Exif\0\0"; IFD0's offset is at +4 and IFD1's at +10
+  const size_t tiff = 2 + 4 + 6;
+  for (size_t field : {tiff + 4, tiff + 10}) {
+    auto crafted = jpeg;
+    std::memset(crafted.data() + field, 0xFF, 4);
+    crafted[field] = 0xFE; // 0xFFFFFFFE: wraps when 2 is added in 32 bits
+    writeFile(sourcePath, crafted);
+
+    ASSERT_TRUE(ThumbnailGenerator::generateThumbnail(sourcePath, outputPath,
+                                                      300, 300));
+    int width, height, r, g, b;
+    readOutput(width, height, r, g, b);
+    EXPECT_GT(b, 200);
+    EXPECT_LT(r, 50);
+  }
+}
+
+TEST_F(ThumbnailGeneratorTest, RejectsCorruptInput) {
+  std::vector<unsigned char> garbage = {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10};
+  writeFile(sourcePath, garbage);
+  EXPECT_FALSE(
+      ThumbnailGenerator::generateThumbnail(sourcePath, outputPath, 300, 300));
+}
+
+TEST_F(ThumbnailGeneratorTest, RenditionsComeFromOneSourceWithoutUpscaling) {
+  const int photoId = 900101;
+  const std::string storeDir = "test_thumbgen_store";
+  writeFile(sourcePath, encodeJpeg(1600, 1200, 0, 0, 255));
+  fs::remove_all(storeDir);
+  {
+    ThumbnailStore store(storeDir);
+    ASSERT_TRUE(store.open());
+
+    ASSERT_TRUE(
+        ThumbnailGenerator::generateRenditions(sourcePath, photoId, store));
+    EXPECT_TRUE(ThumbnailGenerator::renditionsExist(store, photoId));
+
+    const std::pair<int, int> expected[] = {
+        {128, 96}, {300, 225}, {1024, 768}, {1600, 1200}};
+    const auto &sizes = ThumbnailGenerator::renditionSizes();
+    ASSERT_EQ(sizes.size(), 4u);
+    for (size_t i = 0; i < sizes.size(); ++i) {
+      std::string data;
+      ASSERT_TRUE(store.get(photoId, sizes[i], data));
+      int width, height, channels;
+      ASSERT_TRUE(stbi_info_from_memory(
+          reinterpret_cast<const unsigned char *>(data.data()),
+          (int)data.size(), &width, &height, &channels));
+      EXPECT_EQ(width, expected[i].first) << sizes[i];
+      EXPECT_EQ(height, expected[i].second) << sizes[i];
+    }
+  }
+  fs::remove_all(storeDir);
+}
+
+TEST_F(ThumbnailGeneratorTest, SelectsSmallestCoveringRendition) {
+  EXPECT_EQ(ThumbnailGenerator::selectRenditionSize(0),
+            ThumbnailGenerator::DEFAULT_SIZE);
+  EXPECT_EQ(ThumbnailGenerator::selectRenditionSize(64), 128);
+  EXPECT_EQ(ThumbnailGenerator::selectRenditionSize(300), 300);
+  EXPECT_EQ(ThumbnailGenerator::selectRenditionSize(800), 1024);
+  EXPECT_EQ(ThumbnailGenerator::selectRenditionSize(5000), 2048);
+}
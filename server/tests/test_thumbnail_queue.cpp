@@ -0,0 +1,85 @@
+#include "ThumbnailGenerator.h"
+#include "ThumbnailQueue.h"
+#include "ThumbnailStore.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+
+namespace fs = std::filesystem;
+
+// Test fixture for the background thumbnail queue
+class ThumbnailQueueTest : public ::testing::Test {
+protected:
+  std::string sourcePath = "test_thumb_source.ppm";
+  std::string storeDir = "test_thumb_queue_store";
+  std::vector<int> photoIds = {900001, 900002, 900003};
+  std::unique_ptr<ThumbnailStore> store;
+
+  void SetUp() override {
+    // Small binary PPM (P6) so the test doesn't need an encoder
+    std::ofstream out(sourcePath, std::ios::binary);
+    int width = 64, height = 48;
+    out << "P6\n" << width << " " << height << "\n255\n";
+    for (int i = 0; i < width * height; ++i) {
+      unsigned char px[3] = {static_cast<unsigned char>(i % 256), 128, 64};
+      out.write(reinterpret_cast<const char *>(px), 3);
+    }
+    fs::remove_all(storeDir);
+    store = std::make_unique<ThumbnailStore>(storeDir);
+    ASSERT_TRUE(store->open());
+  }
+
+  void TearDown() override {
+    store.reset();
+    fs::remove(sourcePath);
+    fs::remove_all(storeDir);
+  }
+};
+
+TEST_F(ThumbnailQueueTest, RequestAndWaitRendersThumbnail) {
+  ThumbnailQueue queue(*store);
+  queue.start(ThumbnailQueue::Config{1});
+
+  EXPECT_TRUE(queue.requestAndWait(photoIds[0], sourcePath,
+                                   std::chrono::seconds(10)));
+  EXPECT_TRUE(ThumbnailGenerator::renditionsExist(*store, photoIds[0]));
+  EXPECT_EQ(queue.pendingCount(), 0u);
+
+  queue.stop();
+}
+
+TEST_F(ThumbnailQueueTest, BackgroundJobsDrain) {
+  ThumbnailQueue queue(*store);
+  queue.start(ThumbnailQueue::Config{2});
+
+  EXPECT_TRUE(queue.enqueue(photoIds[1], sourcePath,
+                            ThumbnailQueue::Priority::INGEST));
+  EXPECT_TRUE(queue.enqueue(photoIds[2], sourcePath,
+                            ThumbnailQueue::Priority::REBUILD, true));
+  // Duplicate enqueue is folded into the pending job
+  EXPECT_TRUE(queue.enqueue(photoIds[2], sourcePath,
+                            ThumbnailQueue::Priority::VISIBLE));
+
+  // Waiting on the last job implies the pool drained
+  EXPECT_TRUE(queue.requestAndWait(photoIds[1], sourcePath,
+                                   std::chrono::seconds(10)));
+  EXPECT_TRUE(queue.requestAndWait(photoIds[2], sourcePath,
+                                   std::chrono::seconds(10)));
+  EXPECT_TRUE(ThumbnailGenerator::renditionsExist(*store, photoIds[1]));
+  EXPECT_TRUE(ThumbnailGenerator::renditionsExist(*store, photoIds[2]));
+
+  queue.stop();
+}
+
+TEST_F(ThumbnailQueueTest, RejectsMissingSourceAndStoppedQueue) {
+  ThumbnailQueue queue(*store);
+  EXPECT_FALSE(queue.enqueue(photoIds[0], sourcePath,
+                             ThumbnailQueue::Priority::INGEST));
+
+  queue.start(ThumbnailQueue::Config{1});
+  EXPECT_FALSE(queue.enqueue(photoIds[0], "", ThumbnailQueue::Priority::INGEST));
+  EXPECT_FALSE(queue.requestAndWait(photoIds[0], "does_not_exist.jpg",
+                                    std::chrono::seconds(10)));
+  queue.stop();
+}
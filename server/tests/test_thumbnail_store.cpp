@@ -0,0 +1,186 @@
+#include "ThumbnailStore.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+class ThumbnailStoreTest : public ::testing::Test {
+protected:
+  std::string storeDir = "test_thumbnail_store";
+
+  void SetUp() override { fs::remove_all(storeDir); }
+
+  void TearDown() override { fs::remove_all(storeDir); }
+
+  size_t segmentFiles() {
+    size_t count = 0;
+    for (const auto &entry : fs::directory_iterator(storeDir)) {
+      if (entry.path().extension() == ".pack")
+        count++;
+    }
+    return count;
+  }
+};
+
+TEST_F(ThumbnailStoreTest, PutGetOverwriteAndRemove) {
+  ThumbnailStore store(storeDir);
+  ASSERT_TRUE(store.open());
+
+  std::string data;
+  EXPECT_FALSE(store.get(1, 300, data));
+
+  ASSERT_TRUE(store.put(1, 300, "first"));
+  ASSERT_TRUE(store.put(1, 128, "small"));
+  ASSERT_TRUE(store.get(1, 300, data));
+  EXPECT_EQ(data, "first");
+
+  ASSERT_TRUE(store.put(1, 300, "second"));
+  ASSERT_TRUE(store.get(1, 300, data));
+  EXPECT_EQ(data, "second");
+
+  ASSERT_TRUE(store.remove(1));
+  EXPECT_FALSE(store.contains(1, 300));
+  EXPECT_FALSE(store.contains(1, 128));
+}
+
+TEST_F(ThumbnailStoreTest, IndexIsRebuiltOnReopen) {
+  {
+    ThumbnailStore store(storeDir);
+    ASSERT_TRUE(store.open());
+    ASSERT_TRUE(store.put(1, 300, "one"));
+    ASSERT_TRUE(store.put(2, 300, "two"));
+    ASSERT_TRUE(store.put(1, 300, "one-v2"));
+    ASSERT_TRUE(store.remove(2));
+  }
+
+  ThumbnailStore store(storeDir);
+  ASSERT_TRUE(store.open());
+  std::string data;
+  ASSERT_TRUE(store.get(1, 300, data));
+  EXPECT_EQ(data, "one-v2");
+  EXPECT_FALSE(store.contains(2, 300));
+  EXPECT_EQ(store.getStats().entries, 1u);
+}
+
+TEST_F(ThumbnailStoreTest, TornTailIsTruncated) {
+  {
+    ThumbnailStore store(storeDir);
+    ASSERT_TRUE(store.open());
+    ASSERT_TRUE(store.put(1, 300, "intact"));
+  }
+
+  // Simulate a crash halfway through appending a record
+  std::string segment = storeDir + "/seg-000001.pack";
+  uintmax_t goodSize = fs::file_size(segment);
+  {
+    std::ofstream out(segment, std::ios::binary | std::ios::app);
+    out.write("PTHB\x02\x00\x00", 7);
+  }
+
+  ThumbnailStore store(storeDir);
+  ASSERT_TRUE(store.open());
+  EXPECT_EQ(fs::file_size(segment), goodSize);
+  std::string data;
+  ASSERT_TRUE(store.get(1, 300, data));
+  EXPECT_EQ(data, "intact");
+
+  // New records go after the last good one
+  ASSERT_TRUE(store.put(2, 300, "after"));
+  ASSERT_TRUE(store.get(2, 300, data));
+  EXPECT_EQ(data, "after");
+}
+
+TEST_F(ThumbnailStoreTest, CompactionReclaimsDeadSegments) {
+  // Tiny segments so every few records roll over
+  ThumbnailStore store(storeDir, 256);
+  ASSERT_TRUE(store.open());
+
+  std::string payload(100, 'x');
+  for (int round = 0; round < 5; ++round) {
+    for (int id = 1; id <= 4; ++id) {
+      ASSERT_TRUE(store.put(id, 300, payload + std::to_string(round)));
+    }
+  }
+  ASSERT_TRUE(store.remove(4));
+  ASSERT_TRUE(store.compact(1.0));
+
+  ThumbnailStore::Stats stats = store.getStats();
+  EXPECT_EQ(stats.entries, 3u);
+  EXPECT_EQ(stats.segments, segmentFiles());
+  // Only the last round of three photos (plus tombstones) should remain
+  EXPECT_LT(stats.totalBytes, 4u * 256);
+
+  std::string data;
+  for (int id = 1; id <= 3; ++id) {
+    ASSERT_TRUE(store.get(id, 300, data));
+    EXPECT_EQ(data, payload + "4");
+  }
+  EXPECT_FALSE(store.contains(4, 300));
+
+  // Compaction must survive a restart with the same contents
+  store.close();
+  ThumbnailStore reopened(storeDir, 256);
+  ASSERT_TRUE(reopened.open());
+  EXPECT_EQ(reopened.getStats().entries, 3u);
+  EXPECT_FALSE(reopened.contains(4, 300));
+  ASSERT_TRUE(reopened.get(2, 300, data));
+  EXPECT_EQ(data, payload + "4");
+}
+
+TEST_F(ThumbnailStoreTest, CompactionKeepsConcurrentWrites) {
+  ThumbnailStore store(storeDir, 256);
+  ASSERT_TRUE(store.open());
+
+  std::string payload(100, 'x');
+  for (int round = 0; round < 20; ++round) {
+    for (int id = 1; id <= 4; ++id) {
+      ASSERT_TRUE(store.put(id, 300, payload + std::to_string(round)));
+    }
+  }
+
+  // Overwrites racing the compaction must win over the records it copies
+  std::thread writer([&] {
+    for (int round = 0; round < 50; ++round) {
+      for (int id = 1; id <= 4; ++id) {
+        store.put(id, 300, payload + "w" + std::to_string(round));
+      }
+    }
+  });
+  ASSERT_TRUE(store.compact(1.0));
+  writer.join();
+
+  std::string data;
+  for (int id = 1; id <= 4; ++id) {
+    ASSERT_TRUE(store.get(id, 300, data));
+    EXPECT_EQ(data, payload + "w49");
+  }
+
+  store.close();
+  ThumbnailStore reopened(storeDir, 256);
+  ASSERT_TRUE(reopened.open());
+  EXPECT_EQ(reopened.getStats().entries, 4u);
+  ASSERT_TRUE(reopened.get(3, 300, data));
+  EXPECT_EQ(data, payload + "w49");
+}
+
+TEST_F(ThumbnailStoreTest, ImportsLegacyThumbnailFiles) {
+  fs::create_directories(storeDir);
+  {
+    std::ofstream(storeDir + "/42.jpg", std::ios::binary) << "legacy-default";
+    std::ofstream(storeDir + "/42_1024.jpg", std::ios::binary) << "legacy-big";
+    std::ofstream(storeDir + "/7.jpg.tmp", std::ios::binary) << "partial";
+  }
+
+  ThumbnailStore store(storeDir);
+  ASSERT_TRUE(store.open());
+
+  std::string data;
+  ASSERT_TRUE(store.get(42, 300, data));
+  EXPECT_EQ(data, "legacy-default");
+  ASSERT_TRUE(store.get(42, 1024, data));
+  EXPECT_EQ(data, "legacy-big");
+  EXPECT_FALSE(fs::exists(storeDir + "/42.jpg"));
+  EXPECT_FALSE(fs::exists(storeDir + "/7.jpg.tmp"));
+}
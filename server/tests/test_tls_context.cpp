@@ -0,0 +1,281 @@
+#include "MetricsRegistry.h"
+#include "TlsContext.h"
+#include "test_certificate.h"
+#include <boost/asio/read.hpp>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+// Drives server and client handshakes in memory, through BIO pairs
+class TlsContextTest : public ::testing::Test {
+protected:
+  std::string dir = "test_tls_context";
+  TlsContext::Options options;
+  SSL_CTX *clientCtx = nullptr;
+
+  void SetUp() override {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    options.certificateChainFile = dir + "/server.crt";
+    options.privateKeyFile = dir + "/server.key";
+    writeSelfSignedCertificate(options.certificateChainFile,
+                               options.privateKeyFile);
+
+    clientCtx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_verify(clientCtx, SSL_VERIFY_NONE, nullptr);
+  }
+
+  void TearDown() override {
+    SSL_CTX_free(clientCtx);
+    fs::remove_all(dir);
+  }
+
+  // Pump both ends until they finish or stop making progress
+  static bool handshake(SSL *s, SSL *c) {
+    bool serverDone = false, clientDone = false;
+    for (int i = 0; i < 20 && !(serverDone && clientDone); ++i) {
+      if (!clientDone)
+        clientDone = SSL_do_handshake(c) == 1;
+      if (!serverDone)
+        serverDone = SSL_do_handshake(s) == 1;
+    }
+    return serverDone && clientDone;
+  }
+
+  static SSL *newEnd(SSL_CTX *ctx, BIO *bio) {
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_bio(ssl, bio, bio);
+    return ssl;
+  }
+
+  // Suite the server picks for a client limited to maxVersion, or "" if
+  // the handshake fails
+  std::string negotiatedCipher(boost::asio::ssl::context &server,
+                               int maxVersion) {
+    SSL_CTX_set_max_proto_version(clientCtx, maxVersion);
+    BIO *serverBio = nullptr, *clientBio = nullptr;
+    BIO_new_bio_pair(&serverBio, 0, &clientBio, 0);
+    SSL *s = newEnd(server.native_handle(), serverBio);
+    SSL *c = newEnd(clientCtx, clientBio);
+    SSL_set_accept_state(s);
+    SSL_set_connect_state(c);
+
+    std::string cipher;
+    if (handshake(s, c))
+      cipher = SSL_CIPHER_get_name(SSL_get_current_cipher(s));
+    SSL_free(c);
+    SSL_free(s);
+    return cipher;
+  }
+
+  // One connection; returns the client's session for the next attempt and
+  // whether the server resumed
+  SSL_SESSION *connect(boost::asio::ssl::context &server,
+                       SSL_SESSION *previous, bool &resumed) {
+    BIO *serverBio = nullptr, *clientBio = nullptr;
+    BIO_new_bio_pair(&serverBio, 0, &clientBio, 0);
+    SSL *s = newEnd(server.native_handle(), serverBio);
+    SSL *c = newEnd(clientCtx, clientBio);
+    SSL_set_accept_state(s);
+    SSL_set_connect_state(c);
+    if (previous)
+      SSL_set_session(c, previous);
+
+    EXPECT_TRUE(handshake(s, c));
+
+    // TLS 1.3 tickets arrive after the handshake; reading processes them
+    char byte;
+    SSL_read(c, &byte, 1);
+
+    resumed = SSL_session_reused(s) == 1;
+    TlsContext::recordHandshake(s, std::chrono::milliseconds(1));
+    SSL_SESSION *session = SSL_get1_session(c);
+
+    // Both ends drop the connection without a close_notify
+    TlsContext::keepResumable(c);
+    TlsContext::keepResumable(s);
+    SSL_free(c);
+    SSL_free(s);
+    return session;
+  }
+};
+
+TEST_F(TlsContextTest, ReconnectingClientResumes) {
+  Counter &resumedCount = MetricsRegistry::getInstance().counter(
+      "photosync_tls_handshakes_total",
+      "Completed TLS handshakes on the upload port", {{"mode", "resumed"}});
+  uint64_t before = resumedCount.value();
+
+  boost::asio::ssl::context server(boost::asio::ssl::context::tls_server);
+  TlsContext::configure(server, options);
+
+  bool resumed = true;
+  SSL_SESSION *first = connect(server, nullptr, resumed);
+  EXPECT_FALSE(resumed);
+  ASSERT_NE(first, nullptr);
+
+  SSL_SESSION *second = connect(server, first, resumed);
+  EXPECT_TRUE(resumed);
+  EXPECT_EQ(resumedCount.value(), before + 1);
+
+  SSL_SESSION_free(first);
+  SSL_SESSION_free(second);
+}
+
+TEST_F(TlsContextTest, SessionCacheResumesWithoutTickets) {
+  options.sessionTickets = false;
+  boost::asio::ssl::context server(boost::asio::ssl::context::tls_server);
+  TlsContext::configure(server, options);
+
+  bool resumed = true;
+  SSL_SESSION *first = connect(server, nullptr, resumed);
+  EXPECT_FALSE(resumed);
+  SSL_SESSION *second = connect(server, first, resumed);
+  EXPECT_TRUE(resumed);
+
+  SSL_SESSION_free(first);
+  SSL_SESSION_free(second);
+}
+
+TEST_F(TlsContextTest, ResumptionCanBeDisabled) {
+  options.sessionTickets = false;
+  options.sessionCacheSize = 0;
+  boost::asio::ssl::context server(boost::asio::ssl::context::tls_server);
+  TlsContext::configure(server, options);
+
+  bool resumed = true;
+  SSL_SESSION *first = connect(server, nullptr, resumed);
+  EXPECT_FALSE(resumed);
+  SSL_SESSION *second = connect(server, first, resumed);
+  EXPECT_FALSE(resumed);
+
+  SSL_SESSION_free(first);
+  SSL_SESSION_free(second);
+}
+
+TEST_F(TlsContextTest, MissingCertificateThrows) {
+  options.certificateChainFile = dir + "/missing.crt";
+  boost::asio::ssl::context server(boost::asio::ssl::context::tls_server);
+  EXPECT_THROW(TlsContext::configure(server, options),
+               boost::system::system_error);
+}
+
+TEST_F(TlsContextTest, ServerCipherPreferenceWins) {
+  boost::asio::ssl::context chacha(boost::asio::ssl::context::tls_server);
+  options.cipherPreference = TlsContext::CipherPreference::CHACHA20;
+  TlsContext::configure(chacha, options);
+  EXPECT_EQ(negotiatedCipher(chacha, TLS1_3_VERSION),
+            "TLS_CHACHA20_POLY1305_SHA256");
+  EXPECT_EQ(negotiatedCipher(chacha, TLS1_2_VERSION),
+            "ECDHE-ECDSA-CHACHA20-POLY1305");
+
+  boost::asio::ssl::context aes(boost::asio::ssl::context::tls_server);
+  options.cipherPreference = TlsContext::CipherPreference::AES_GCM;
+  TlsContext::configure(aes, options);
+  EXPECT_EQ(negotiatedCipher(aes, TLS1_3_VERSION), "TLS_AES_128_GCM_SHA256");
+  EXPECT_EQ(negotiatedCipher(aes, TLS1_2_VERSION),
+            "ECDHE-ECDSA-AES128-GCM-SHA256");
+}
+
+TEST_F(TlsContextTest, Tls13OnlyRefusesTls12Clients) {
+  options.tls13Only = true;
+  boost::asio::ssl::context server(boost::asio::ssl::context::tls_server);
+  TlsContext::configure(server, options);
+
+  EXPECT_EQ(negotiatedCipher(server, TLS1_2_VERSION), "");
+  EXPECT_NE(negotiatedCipher(server, TLS1_3_VERSION), "");
+}
+
+TEST(TlsCipherPreferenceTest, ParsesAndResolves) {
+  using Preference = TlsContext::CipherPreference;
+  EXPECT_EQ(TlsContext::parseCipherPreference("AESGCM"), Preference::AES_GCM);
+  EXPECT_EQ(TlsContext::parseCipherPreference("chacha20"),
+            Preference::CHACHA20);
+  EXPECT_EQ(TlsContext::parseCipherPreference("rc4"), Preference::AUTO);
+
+  EXPECT_EQ(TlsContext::resolve(Preference::CHACHA20), Preference::CHACHA20);
+  EXPECT_EQ(TlsContext::resolve(Preference::AUTO),
+            TlsContext::hasAesHardware() ? Preference::AES_GCM
+                                         : Preference::CHACHA20);
+}
+
+// kTLS needs a real TCP socket, so these run over loopback
+class KernelReceiveTest : public TlsContextTest {
+protected:
+  using tcp = boost::asio::ip::tcp;
+
+  // Handshake over loopback, try to offload the server's receive path and
+  // check that what the client sends still arrives
+  bool offloadAndReceive(const std::string &message) {
+    boost::asio::io_context io;
+    tcp::acceptor acceptor(
+        io, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    tcp::socket clientSocket(io);
+    clientSocket.connect(acceptor.local_endpoint());
+    boost::asio::ssl::context context(boost::asio::ssl::context::tls_server);
+    TlsContext::configure(context, options);
+    boost::asio::ssl::stream<tcp::socket> server(acceptor.accept(), context);
+
+    SSL *client = SSL_new(clientCtx);
+    SSL_set_fd(client, (int)clientSocket.native_handle());
+    std::thread clientThread([client] { SSL_connect(client); });
+    server.handshake(boost::asio::ssl::stream_base::server);
+    clientThread.join();
+
+    bool enabled = TlsContext::enableKernelReceive(
+        server.native_handle(), server.next_layer().native_handle());
+    EXPECT_EQ(SSL_write(client, message.data(), (int)message.size()),
+              (int)message.size());
+
+    std::string received(message.size(), '\0');
+    if (enabled)
+      boost::asio::read(server.next_layer(), boost::asio::buffer(received));
+    else
+      boost::asio::read(server, boost::asio::buffer(received));
+    EXPECT_EQ(received, message);
+
+    SSL_free(client);
+    return enabled;
+  }
+
+  Counter &offloadCounter(const char *mode) {
+    return MetricsRegistry::getInstance().counter(
+        "photosync_tls_receive_offload_total",
+        "Upload connections by where received records are decrypted",
+        {{"mode", mode}});
+  }
+};
+
+TEST_F(KernelReceiveTest, OffloadsOrFallsBackToOpenSsl) {
+  options.kernelReceive = true;
+  uint64_t kernel = offloadCounter("kernel").value();
+  uint64_t userspace = offloadCounter("userspace").value();
+
+  // Without the tls kernel module this exercises the fallback
+  bool enabled = offloadAndReceive("hello kernel");
+  EXPECT_EQ(offloadCounter("kernel").value(), kernel + (enabled ? 1 : 0));
+  EXPECT_EQ(offloadCounter("userspace").value(),
+            userspace + (enabled ? 0 : 1));
+}
+
+TEST_F(KernelReceiveTest, OffIsANoOp) {
+  uint64_t kernel = offloadCounter("kernel").value();
+  uint64_t userspace = offloadCounter("userspace").value();
+
+  EXPECT_FALSE(offloadAndReceive("hello openssl"));
+  EXPECT_EQ(offloadCounter("kernel").value(), kernel);
+  EXPECT_EQ(offloadCounter("userspace").value(), userspace);
+}
+
+TEST_F(KernelReceiveTest, Tls12StaysInUserSpace) {
+  options.kernelReceive = true;
+  SSL_CTX_set_max_proto_version(clientCtx, TLS1_2_VERSION);
+  uint64_t kernel = offloadCounter("kernel").value();
+  uint64_t userspace = offloadCounter("userspace").value();
+
+  EXPECT_FALSE(offloadAndReceive("hello tls 1.2"));
+  EXPECT_EQ(offloadCounter("kernel").value(), kernel);
+  EXPECT_EQ(offloadCounter("userspace").value(), userspace + 1);
+}
@@ -0,0 +1,110 @@
+#include "JsonWriter.h"
+#include "TraceRecorder.h"
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+TEST(TraceRecorderTest, RecordsSpansWithMonotonicTimes) {
+  TraceRecorder recorder(16);
+  auto start = steady_clock::now();
+  recorder.record(SpanPhase::CHUNK, "upload-1", start,
+                  start + microseconds(250), 4096);
+  {
+    ScopedSpan span(SpanPhase::HASH, "", 0, recorder);
+    span.setTraceId("upload-1");
+    span.setValue(8192);
+  }
+  {
+    ScopedSpan dropped(SpanPhase::EXIF, "upload-1", 0, recorder);
+    dropped.cancel();
+  }
+
+  auto spans = recorder.snapshot();
+  ASSERT_EQ(spans.size(), 2u);
+  EXPECT_EQ(spans[0].phase, SpanPhase::CHUNK);
+  EXPECT_EQ(spans[0].traceId, "upload-1");
+  EXPECT_EQ(spans[0].durationMicros, 250u);
+  EXPECT_EQ(spans[0].value, 4096u);
+  EXPECT_EQ(spans[1].phase, SpanPhase::HASH);
+  EXPECT_EQ(spans[1].value, 8192u);
+  EXPECT_GE(spans[1].startMicros, spans[0].startMicros);
+}
+
+TEST(TraceRecorderTest, RingKeepsMostRecentSpans) {
+  TraceRecorder recorder(8);
+  auto now = steady_clock::now();
+  for (uint64_t i = 0; i < 20; ++i) {
+    recorder.record(SpanPhase::CHUNK, i % 2 ? "odd" : "even", now, now, i);
+  }
+
+  auto spans = recorder.snapshot();
+  ASSERT_EQ(spans.size(), 8u);
+  EXPECT_EQ(spans.front().value, 12u);
+  EXPECT_EQ(spans.back().value, 19u);
+
+  auto odd = recorder.snapshot("odd", 2);
+  ASSERT_EQ(odd.size(), 2u);
+  EXPECT_EQ(odd[0].value, 17u);
+  EXPECT_EQ(odd[1].value, 19u);
+}
+
+TEST(TraceRecorderTest, LongTraceIdsAreTruncated) {
+  TraceRecorder recorder(4);
+  std::string id(100, 'x');
+  auto now = steady_clock::now();
+  recorder.record(SpanPhase::INIT, id, now, now);
+  { ScopedSpan span(SpanPhase::CHUNK, id, 0, recorder); }
+
+  auto spans = recorder.snapshot();
+  ASSERT_EQ(spans.size(), 2u);
+  EXPECT_EQ(spans[0].traceId, id.substr(0, TraceRecorder::MAX_TRACE_ID));
+  EXPECT_EQ(spans[1].traceId, spans[0].traceId);
+}
+
+TEST(TraceRecorderTest, ConcurrentWritersDoNotCorruptSpans) {
+  TraceRecorder recorder(1024);
+  auto now = steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&recorder, now, t] {
+      std::string id = "trace-" + std::to_string(t);
+      for (uint64_t i = 0; i < 200; ++i) {
+        recorder.record(SpanPhase::CHUNK, id, now, now, (uint64_t)t);
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  auto spans = recorder.snapshot();
+  EXPECT_EQ(spans.size(), 800u);
+  for (const auto &span : spans) {
+    EXPECT_EQ(span.traceId, "trace-" + std::to_string(span.value));
+  }
+}
+
+TEST(TraceRecorderTest, ExportsChromeTraceEvents) {
+  TraceRecorder recorder(4);
+  auto start = steady_clock::now();
+  recorder.record(SpanPhase::THUMBNAIL, "abc", start,
+                  start + milliseconds(3), 42);
+  recorder.record(SpanPhase::DB_INSERT, "abc", start, start);
+
+  std::string body;
+  JsonWriter w(body);
+  TraceRecorder::writeChromeTrace(w, recorder.snapshot());
+
+  auto parsed = nlohmann::json::parse(body);
+  ASSERT_EQ(parsed["traceEvents"].size(), 2u);
+  const auto &event = parsed["traceEvents"][0];
+  EXPECT_EQ(event["name"], "thumbnail");
+  EXPECT_EQ(event["ph"], "X");
+  EXPECT_EQ(event["dur"], 3000);
+  EXPECT_EQ(event["args"]["traceId"], "abc");
+  EXPECT_EQ(event["args"]["photoId"], 42);
+  EXPECT_FALSE(parsed["traceEvents"][1]["args"].contains("value"));
+  EXPECT_EQ(parsed["displayTimeUnit"], "ms");
+}
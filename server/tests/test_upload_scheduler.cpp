@@ -0,0 +1,99 @@
+#include "TokenBucket.h"
+#include "UploadScheduler.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+using Clock = TokenBucket::Clock;
+
+TEST(TokenBucketTest, AdmitsBurstThenPacesToRate) {
+  auto t0 = Clock::now();
+  TokenBucket bucket(1000, 1000, t0);
+  EXPECT_EQ(bucket.waitTime(1000, t0), Clock::duration::zero());
+  bucket.consume(1000, t0);
+
+  EXPECT_EQ(duration_cast<milliseconds>(bucket.waitTime(500, t0)).count(),
+            500);
+  EXPECT_EQ(bucket.waitTime(500, t0 + milliseconds(500)),
+            Clock::duration::zero());
+  // Refill stops at the burst size
+  EXPECT_DOUBLE_EQ(bucket.tokens(t0 + seconds(10)), 1000);
+}
+
+TEST(TokenBucketTest, OversizedRequestsGoIntoDebt) {
+  auto t0 = Clock::now();
+  TokenBucket bucket(1000, 1000, t0);
+  // Larger than the burst, but admitted once the bucket is full
+  EXPECT_EQ(bucket.waitTime(5000, t0), Clock::duration::zero());
+  bucket.consume(5000, t0);
+  EXPECT_DOUBLE_EQ(bucket.tokens(t0), -4000);
+  EXPECT_EQ(duration_cast<milliseconds>(bucket.waitTime(1000, t0)).count(),
+            5000);
+}
+
+TEST(TokenBucketTest, ZeroRateIsUnlimited) {
+  TokenBucket bucket;
+  EXPECT_TRUE(bucket.unlimited());
+  bucket.consume(1 << 30, Clock::now());
+  EXPECT_EQ(bucket.waitTime(1 << 30, Clock::now()), Clock::duration::zero());
+}
+
+TEST(UploadSchedulerTest, UnlimitedRunsInline) {
+  boost::asio::io_context io;
+  UploadScheduler scheduler(io, UploadScheduler::Options{});
+  std::vector<int> ran;
+  for (int i = 0; i < 3; ++i)
+    scheduler.submit("phone", 1 << 20, 1, [&ran, i] { ran.push_back(i); });
+  EXPECT_EQ(ran, (std::vector<int>{0, 1, 2}));
+  EXPECT_EQ(scheduler.queued(), 0u);
+}
+
+TEST(UploadSchedulerTest, SmallUploadsOvertakeBulkBacklog) {
+  const size_t rate = 1 << 20;
+  UploadScheduler::Options options;
+  options.globalBytesPerSecond = rate;
+  options.smallUploadBytes = rate;
+  boost::asio::io_context io;
+  UploadScheduler scheduler(io, options);
+
+  std::vector<std::string> order;
+  // A second's worth of video goes straight through; the next chunk waits
+  for (int i = 0; i < 11; ++i) {
+    scheduler.submit("video", rate / 10, scheduler.weightFor(1LL << 32),
+                     [&order] { order.push_back("video"); });
+  }
+  EXPECT_EQ(order.size(), 10u);
+  EXPECT_EQ(scheduler.queued(), 1u);
+
+  for (int i = 0; i < 2; ++i) {
+    scheduler.submit("photos", rate / 100, scheduler.weightFor(rate / 100),
+                     [&order] { order.push_back("photos"); });
+  }
+  io.run();
+
+  ASSERT_EQ(order.size(), 13u);
+  EXPECT_EQ(order[10], "photos");
+  EXPECT_EQ(order[11], "photos");
+  EXPECT_EQ(order[12], "video");
+}
+
+TEST(UploadSchedulerTest, DeviceCapOnlyHoldsBackThatDevice) {
+  const size_t rate = 1 << 20;
+  UploadScheduler::Options options;
+  options.deviceBytesPerSecond = rate;
+  boost::asio::io_context io;
+  UploadScheduler scheduler(io, options);
+
+  auto started = Clock::now();
+  Clock::duration videoDelay{}, photoDelay{};
+  scheduler.submit("video", rate, 1, [] {});
+  scheduler.submit("video", rate / 10, 1,
+                   [&] { videoDelay = Clock::now() - started; });
+  scheduler.submit("photos", rate / 10, 1,
+                   [&] { photoDelay = Clock::now() - started; });
+  io.run();
+
+  EXPECT_LT(photoDelay, milliseconds(50));
+  EXPECT_GE(videoDelay, milliseconds(90));
+}
@@ -0,0 +1,69 @@
+#include "FileManager.h"
+#include "UploadStream.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+class UploadStreamTest : public ::testing::Test {
+protected:
+  std::string dir = "test_upload_stream";
+  std::string path = dir + "/upload.tmp";
+
+  void SetUp() override {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+  }
+
+  void TearDown() override { fs::remove_all(dir); }
+};
+
+TEST_F(UploadStreamTest, HashesChunksAsTheyArrive) {
+  UploadStream stream;
+  ASSERT_TRUE(stream.open(path, 0));
+  ASSERT_TRUE(stream.append("hello ", 6));
+  ASSERT_TRUE(stream.append("world", 5));
+  EXPECT_EQ(stream.size(), 11);
+
+  std::string digest = stream.finish();
+  EXPECT_FALSE(stream.isOpen());
+  EXPECT_EQ(digest, FileManager::calculateSHA256(path));
+  EXPECT_EQ(fs::file_size(path), 11u);
+}
+
+TEST_F(UploadStreamTest, ResumeHashesExistingPrefixAndDropsTail) {
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << "hello XXXX"; // Bytes past the resume offset were never acked
+  }
+
+  UploadStream stream;
+  ASSERT_TRUE(stream.open(path, 6));
+  ASSERT_TRUE(stream.append("world", 5));
+  std::string digest = stream.finish();
+
+  std::ifstream in(path, std::ios::binary);
+  std::string content((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+  EXPECT_EQ(content, "hello world");
+  EXPECT_EQ(digest, FileManager::calculateSHA256(path));
+}
+
+TEST_F(UploadStreamTest, ResumePastEndOfFileFails) {
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << "abc";
+  }
+  UploadStream stream;
+  EXPECT_FALSE(stream.open(path, 10));
+  EXPECT_FALSE(stream.open(dir + "/missing.tmp", 1));
+}
+
+TEST_F(UploadStreamTest, EmptyUploadCreatesFile) {
+  UploadStream stream;
+  ASSERT_TRUE(stream.open(path, 0));
+  std::string digest = stream.finish();
+  EXPECT_TRUE(fs::exists(path));
+  EXPECT_EQ(digest, FileManager::calculateSHA256(path));
+}